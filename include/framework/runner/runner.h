@@ -21,12 +21,14 @@
 
 #pragma once
 
+#include <sched.h>
 #include <stdbool.h>
 #include <stdint.h>
 
 #include "util/cru_vec.h"
 
 typedef enum runner_isolation_mode runner_isolation_mode_t;
+typedef enum runner_pin_mode runner_pin_mode_t;
 typedef struct runner_opts runner_opts_t;
 
 enum runner_isolation_mode {
@@ -37,6 +39,19 @@ enum runner_isolation_mode {
     RUNNER_ISOLATION_MODE_THREAD,
 };
 
+enum runner_pin_mode {
+    /// Every slave may run on any CPU of runner_opts_t::cpu_set.
+    RUNNER_PIN_MODE_NONE,
+
+    /// Bind each slave to its own block of CPUs, filling one NUMA node
+    /// before the next.
+    RUNNER_PIN_MODE_COMPACT,
+
+    /// Bind each slave to its own block of CPUs, spreading the slaves
+    /// round-robin across the NUMA nodes.
+    RUNNER_PIN_MODE_SCATTER,
+};
+
 struct runner_opts {
     /// Number of tests to run simultaneously. Similar to GNU Make's -j
     /// option.
@@ -49,12 +64,65 @@ struct runner_opts {
     bool use_separate_cleanup_threads;
     bool verbose;
 
+    /// With RUNNER_ISOLATION_MODE_THREAD, start the slave's next test once
+    /// the current one enters its cleanup phase, and let up to this many
+    /// tests finish cleanup in the background. 0 runs tests strictly one
+    /// after another.
+    uint32_t cleanup_depth;
+
+    /// If a slave dies, run each test that it had started but not finished
+    /// up to this many more times before reporting the test as lost. Tests
+    /// that the slave had not started are always run again.
+    uint32_t lost_retries;
+
+    /// Run the slaves only on these CPUs, if not NULL. Otherwise, on the
+    /// runner's own CPUs.
+    const cpu_set_t *cpu_set;
+
+    /// How to divide the CPUs among the slaves. If this is not
+    /// RUNNER_PIN_MODE_NONE or if cpu_set is set, each slave also gets
+    /// LP_NUM_THREADS set to the number of CPUs per concurrent test, unless
+    /// LP_NUM_THREADS is already set.
+    runner_pin_mode_t pin_slaves;
+
+    /// Fail each test that leaks Vulkan host allocations across its cleanup
+    /// phase.
+    bool check_leaks;
+
+    /// Disable suballocation of device memory by qonos, to compare
+    /// dedicated allocations against suballocated ones.
+    bool no_suballoc;
+
+    /// Enable every supported extension and feature on each test's instance
+    /// and device, rather than only those that the test declares.
+    bool no_minimal_device;
+
+    /// Call device-level Vulkan commands through tables filled by
+    /// vkGetDeviceProcAddr rather than through the loader's trampolines.
+    bool direct_dispatch;
+
     /// The runner will write JUnit XML to this path, if not NULL.
     const char *junit_xml_filepath;
 
+    /// The runner will write a Chrome trace of the run to this path, if not
+    /// NULL. See util/trace.h.
+    const char *trace_filepath;
+
+    /// Run only the (test, queue family) pairs in shard \a shard_index of
+    /// \a shard_count. The shard index is zero-based. A shard count of 0 or
+    /// 1 disables sharding.
+    uint32_t shard_index;
+    uint32_t shard_count;
+
+    /// If not NULL, balance the shards using the testcase times recorded in
+    /// this JUnit XML file rather than the count of tests.
+    const char *shard_durations_filepath;
+
     int device_id;
 };
 
 bool runner_init(runner_opts_t *opts);
-void runner_enable_matching_tests(const cru_cstr_vec_t *testname_globs);
+bool runner_parse_cpu_list(const char *str, cpu_set_t *set);
+bool runner_enable_matching_tests(const cru_cstr_vec_t *testname_globs);
 bool runner_run_tests(void);
+bool runner_list_tests(void);
@@ -37,6 +37,20 @@ struct test_create_info {
     uint32_t queue_family_index;
     bool verbose;
 
+    /// Fail the test if its cleanup phase does not free every Vulkan host
+    /// allocation made since the start of its setup phase. Requires
+    /// enable_cleanup_phase.
+    bool enable_leak_check;
+
+    /// Allow qonos to suballocate device memory when the caller opts in.
+    bool enable_suballoc;
+
+    /// Bypass the loader's trampolines for the test device's commands.
+    bool enable_direct_dispatch;
+
+    /// Enable only the extensions and features that the test declares.
+    bool enable_minimal_device;
+
     uint32_t bootstrap_image_width;
     uint32_t bootstrap_image_height;
 };
@@ -57,4 +71,6 @@ bool test_is_current(void);
 
 void test_start(test_t *test);
 void test_wait(test_t *test);
+void test_wait_cleanup(test_t *test);
 test_result_t test_get_result(test_t *test);
+uint64_t test_get_stop_time_ns(test_t *test);
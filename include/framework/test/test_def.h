@@ -23,9 +23,27 @@
 
 #include "util/misc.h"
 #include "util/cru_vec.h"
+#include "util/string.h"
 #include "tapi/t_def.h"
 
 typedef struct test_def_vec test_def_vec_t;
+typedef struct test_caps test_caps_t;
+
+/// \brief What a physical device offers a test on one queue family.
+///
+/// The test's declared requirements are checked against this, either by the
+/// runner before dispatching the test or by the test's own setup phase.
+struct test_caps {
+    uint32_t api_version;
+    VkPhysicalDeviceFeatures features;
+    VkQueueFlags queue_flags;
+
+    uint32_t instance_extension_count;
+    const VkExtensionProperties *instance_extensions;
+
+    uint32_t device_extension_count;
+    const VkExtensionProperties *device_extensions;
+};
 
 extern test_def_t __start_test_defs, __stop_test_defs;
 
@@ -36,6 +54,9 @@ extern test_def_t __start_test_defs, __stop_test_defs;
 
 bool test_def_match(const test_def_t *def, const char *glob);
 const test_def_t *cru_find_def(const char *name);
+bool test_def_check_caps(const test_def_t *def, const test_caps_t *caps,
+                         string_t *reason);
+bool test_def_requires_ext(const test_def_t *def, const char *name);
 
 static pure inline uint64_t
 test_def_get_id(const test_def_t *def)
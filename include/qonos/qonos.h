@@ -86,6 +86,8 @@
 
 #pragma once
 
+#include <stdbool.h>
+
 #include "util/vk_wrapper.h"
 
 #ifdef __cplusplus
@@ -99,6 +101,19 @@ typedef struct QoMemoryAllocateFromRequirementsInfo {
     VkDeviceSize            allocationSize;
     uint32_t                memoryTypeIndex;
     VkMemoryPropertyFlags   properties;
+
+    /// \brief Opt-in to suballocation.
+    ///
+    /// If set, then qoAllocBufferMemory() and qoAllocImageMemory() may return
+    /// a VkDeviceMemory shared with other resources, and write to *pOffset
+    /// the offset at which the caller must bind the resource. The offset is
+    /// 0 for dedicated allocations. Suballocation is skipped if pNext or
+    /// allocationSize is set, or if the runner disabled it (see
+    /// t_suballoc_enabled()).
+    ///
+    /// Suballocated memory must not be mapped, because Vulkan permits only
+    /// one mapping of a VkDeviceMemory at a time.
+    VkDeviceSize *          pOffset;
 } QoMemoryAllocateFromRequirementsInfo;
 
 typedef struct QoExtraGraphicsPipelineCreateInfo_ {
@@ -110,6 +125,15 @@ typedef struct QoExtraGraphicsPipelineCreateInfo_ {
     uint32_t dynamicStates; // Bitfield
 } QoExtraGraphicsPipelineCreateInfo;
 
+typedef struct QoGraphicsPipelineBatchInfo_ {
+    uint32_t count;
+    const QoExtraGraphicsPipelineCreateInfo *pInfos;
+
+    /// Number of threads to create the pipelines on. With 1, all are
+    /// created in one vkCreateGraphicsPipelines() call.
+    uint32_t threadCount;
+} QoGraphicsPipelineBatchInfo;
+
 typedef struct QoShaderModuleCreateInfo_ {
     void *pNext;
     size_t spirvSize;
@@ -117,9 +141,64 @@ typedef struct QoShaderModuleCreateInfo_ {
     VkShaderStageFlagBits stage;
 } QoShaderModuleCreateInfo;
 
+/// \brief A growable descriptor set allocator.
+///
+/// \see qoCreateDescriptorAllocator()
+typedef struct QoDescriptorAllocator_ *QoDescriptorAllocator;
+
+typedef struct QoDescriptorAllocatorCreateInfo_ {
+    /// If set, create a per-thread sub-allocator of this allocator.
+    QoDescriptorAllocator parent;
+
+    /// Number of sets in each VkDescriptorPool that the allocator creates.
+    uint32_t maxSetsPerPool;
+
+    /// Create the pools with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+    /// which qoFreeDescriptorSet() requires.
+    bool freeDescriptorSet;
+} QoDescriptorAllocatorCreateInfo;
+
+/// \brief A recycling command buffer manager.
+///
+/// \see qoCreateCommandBufferManager()
+typedef struct QoCommandBufferManager_ *QoCommandBufferManager;
+
+typedef struct QoCommandBufferManagerCreateInfo_ {
+    /// Flags for each VkCommandPool that the manager creates. Without
+    /// VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, completed buffers are
+    /// reused only after qoResetCommandBufferManager().
+    VkCommandPoolCreateFlags flags;
+} QoCommandBufferManagerCreateInfo;
+
+/// \brief A timeline semaphore and the last value submitted for it.
+///
+/// \see qoCreateTimeline()
+typedef struct QoTimeline_ *QoTimeline;
+
+typedef struct QoTimelineCreateInfo_ {
+    uint64_t initialValue;
+} QoTimelineCreateInfo;
+
+typedef struct QoSubmitBatchInfo_ {
+    uint32_t submitCount;
+    const VkSubmitInfo *pSubmits;
+    VkFence fence;
+
+    /// If set, the first submit waits for the timeline to reach waitValue.
+    QoTimeline waitTimeline;
+    uint64_t waitValue;
+    VkPipelineStageFlags waitDstStageMask;
+
+    /// If set, the last submit signals the timeline's next value.
+    QoTimeline signalTimeline;
+} QoSubmitBatchInfo;
+
 #define QO_EXTRA_GRAPHICS_PIPELINE_CREATE_INFO_DEFAULTS \
     .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
 
+#define QO_GRAPHICS_PIPELINE_BATCH_INFO_DEFAULTS \
+    .threadCount = 1
+
 #define QO_MEMORY_ALLOCATE_INFO_DEFAULTS \
     .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, \
     .memoryTypeIndex = QO_MEMORY_TYPE_INDEX_INVALID
@@ -160,6 +239,22 @@ typedef struct QoShaderModuleCreateInfo_ {
     .descriptorPool = VK_NULL_HANDLE, \
     .descriptorSetCount = 1
 
+#define QO_DESCRIPTOR_ALLOCATOR_CREATE_INFO_DEFAULTS \
+    .parent = NULL, \
+    .maxSetsPerPool = 64, \
+    .freeDescriptorSet = false
+
+#define QO_COMMAND_BUFFER_MANAGER_CREATE_INFO_DEFAULTS \
+    .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | \
+             VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+
+#define QO_TIMELINE_CREATE_INFO_DEFAULTS \
+    .initialValue = 0
+
+#define QO_SUBMIT_BATCH_INFO_DEFAULTS \
+    .fence = VK_NULL_HANDLE, \
+    .waitDstStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+
 #define QO_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO_DEFAULTS \
     .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO, \
     .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, \
@@ -407,6 +502,15 @@ VkDescriptorSetLayout qoCreateDescriptorSetLayout(VkDevice dev, ...);
         })
 #endif
 
+/// If descriptorPool is VK_NULL_HANDLE, then the set comes from the test's
+/// default descriptor allocator, t_descriptor_allocator.
+///
+/// Unlike the fixed pool that it replaced, t_descriptor_allocator does not
+/// create its pools with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+/// so its sets must not be passed to vkFreeDescriptorSets(). A test that
+/// frees sets one by one must create its own allocator with
+/// `.freeDescriptorSet = true`, allocate with qoAllocateDescriptorSetFrom(),
+/// and free with qoFreeDescriptorSet().
 #ifdef DOXYGEN
 VkDescriptorSet qoAllocateDescriptorSet(VkDevice dev, ...);
 #else
@@ -418,6 +522,17 @@ VkDescriptorSet qoAllocateDescriptorSet(VkDevice dev, ...);
         })
 #endif
 
+#ifdef DOXYGEN
+QoDescriptorAllocator qoCreateDescriptorAllocator(VkDevice dev, ...);
+#else
+#define qoCreateDescriptorAllocator(dev, ...) \
+    __qoCreateDescriptorAllocator(dev, \
+        &(QoDescriptorAllocatorCreateInfo) { \
+            QO_DESCRIPTOR_ALLOCATOR_CREATE_INFO_DEFAULTS, \
+            ##__VA_ARGS__, \
+        })
+#endif
+
 #ifdef DOXYGEN
 VkCommandBuffer qoAllocateCommandBuffer(VkDevice dev, VkCommandPool pool, ...);
 #else
@@ -430,6 +545,39 @@ VkCommandBuffer qoAllocateCommandBuffer(VkDevice dev, VkCommandPool pool, ...);
         })
 #endif
 
+#ifdef DOXYGEN
+QoCommandBufferManager qoCreateCommandBufferManager(VkDevice dev, ...);
+#else
+#define qoCreateCommandBufferManager(dev, ...) \
+    __qoCreateCommandBufferManager(dev, \
+        &(QoCommandBufferManagerCreateInfo) { \
+            QO_COMMAND_BUFFER_MANAGER_CREATE_INFO_DEFAULTS, \
+            ##__VA_ARGS__, \
+        })
+#endif
+
+#ifdef DOXYGEN
+QoTimeline qoCreateTimeline(VkDevice dev, ...);
+#else
+#define qoCreateTimeline(dev, ...) \
+    __qoCreateTimeline(dev, \
+        &(QoTimelineCreateInfo) { \
+            QO_TIMELINE_CREATE_INFO_DEFAULTS, \
+            ##__VA_ARGS__, \
+        })
+#endif
+
+#ifdef DOXYGEN
+uint64_t qoQueueSubmitBatch(VkQueue queue, ...);
+#else
+#define qoQueueSubmitBatch(queue, ...) \
+    __qoQueueSubmitBatch(queue, \
+        &(QoSubmitBatchInfo) { \
+            QO_SUBMIT_BATCH_INFO_DEFAULTS, \
+            ##__VA_ARGS__, \
+        })
+#endif
+
 #ifdef DOXYGEN
 VkResult qoBeginCommandBuffer(VkCommandBuffer cmd, ...);
 #else
@@ -469,6 +617,18 @@ VkRenderPass qoCreateRenderPass(dev, ...);
     })
 #endif
 
+#ifdef DOXYGEN
+void qoCreateGraphicsPipelines(VkDevice dev, VkPipelineCache pipeline_cache,
+                               VkPipeline *pipelines, ...);
+#else
+#define qoCreateGraphicsPipelines(dev, pipeline_cache, pipelines, ...) \
+    __qoCreateGraphicsPipelines(dev, pipeline_cache, \
+        &(QoGraphicsPipelineBatchInfo) { \
+            QO_GRAPHICS_PIPELINE_BATCH_INFO_DEFAULTS, \
+            ##__VA_ARGS__, \
+        }, pipelines)
+#endif
+
 #ifdef DOXYGEN
 VkImage qoCreateImage(VkDevice dev, ...);
 #else
@@ -507,10 +667,18 @@ void qoGetPhysicalDeviceProperties(VkPhysicalDevice physical_dev, VkPhysicalDevi
 void qoGetPhysicalDeviceMemoryProperties(VkPhysicalDevice physical_dev, VkPhysicalDeviceMemoryProperties *mem_props);
 VkResult qoQueueSubmit(VkQueue queue, uint32_t cmdBufferCount, const VkCommandBuffer *cmdBuffers, VkFence fence);
 VkResult qoQueueWaitIdle(VkQueue queue);
+uint64_t __qoQueueSubmitBatch(VkQueue queue, const QoSubmitBatchInfo *info);
+QoTimeline __qoCreateTimeline(VkDevice dev, const QoTimelineCreateInfo *info);
+VkSemaphore qoGetTimelineSemaphore(QoTimeline tl);
+uint64_t qoGetTimelineValue(QoTimeline tl);
+bool qoPollTimeline(QoTimeline tl, uint64_t value);
+void qoWaitTimeline(QoTimeline tl, uint64_t value);
+bool qoPollFence(VkDevice dev, VkFence fence);
 VkDeviceMemory __qoAllocMemory(VkDevice dev, const VkMemoryAllocateInfo *info);
 VkDeviceMemory __qoAllocMemoryFromRequirements(VkDevice dev, const VkMemoryRequirements *mem_reqs, const QoMemoryAllocateFromRequirementsInfo *info);
 VkDeviceMemory __qoAllocBufferMemory(VkDevice dev, VkBuffer buffer, const QoMemoryAllocateFromRequirementsInfo *info);
 VkDeviceMemory __qoAllocImageMemory(VkDevice dev, VkImage image, const QoMemoryAllocateFromRequirementsInfo *info);
+VkDeviceMemory __qoSubAllocMemory(VkDevice dev, const VkMemoryRequirements *mem_reqs, uint32_t memory_type_index, bool is_image, VkDeviceSize *offset);
 VkBuffer __qoCreateBuffer(VkDevice dev, const VkBufferCreateInfo *info);
 VkBufferView __qoCreateBufferView(VkDevice dev, const VkBufferViewCreateInfo *info);
 VkQueryPool __qoCreateQueryPool(VkDevice dev, const VkQueryPoolCreateInfo *info);
@@ -519,7 +687,17 @@ VkPipelineLayout __qoCreatePipelineLayout(VkDevice dev, const VkPipelineLayoutCr
 VkSampler __qoCreateSampler(VkDevice dev, const VkSamplerCreateInfo *info);
 VkDescriptorSetLayout __qoCreateDescriptorSetLayout(VkDevice dev, const VkDescriptorSetLayoutCreateInfo *info);
 VkDescriptorSet __qoAllocateDescriptorSet(VkDevice dev, const VkDescriptorSetAllocateInfo *info);
+void __qoRegisterDescriptorSetLayout(VkDevice dev, VkDescriptorSetLayout layout, const VkDescriptorSetLayoutCreateInfo *info);
+QoDescriptorAllocator __qoCreateDescriptorAllocator(VkDevice dev, const QoDescriptorAllocatorCreateInfo *info);
+VkDescriptorSet qoAllocateDescriptorSetFrom(QoDescriptorAllocator allocator, VkDescriptorSetLayout layout, VkDescriptorPool *pool);
+void qoFreeDescriptorSet(QoDescriptorAllocator allocator, VkDescriptorPool pool, VkDescriptorSet set);
+void qoResetDescriptorAllocator(QoDescriptorAllocator allocator);
 VkCommandBuffer __qoAllocateCommandBuffer(VkDevice dev, VkCommandPool pool, const VkCommandBufferAllocateInfo *info);
+QoCommandBufferManager __qoCreateCommandBufferManager(VkDevice dev, const QoCommandBufferManagerCreateInfo *info);
+VkCommandBuffer qoAcquireCommandBuffer(QoCommandBufferManager mgr, uint32_t queue_family_index);
+void qoSubmitCommandBuffer(QoCommandBufferManager mgr, VkQueue queue, VkCommandBuffer cmd);
+void qoReleaseCommandBuffer(QoCommandBufferManager mgr, VkCommandBuffer cmd);
+void qoResetCommandBufferManager(QoCommandBufferManager mgr);
 VkResult __qoBeginCommandBuffer(VkCommandBuffer cmd, const VkCommandBufferBeginInfo *info);
 VkResult __qoEndCommandBuffer(VkCommandBuffer cmd);
 VkFramebuffer __qoCreateFramebuffer(VkDevice dev, const VkFramebufferCreateInfo *info);
@@ -528,9 +706,14 @@ VkRenderPass __qoCreateRenderPass(VkDevice dev, const VkRenderPassCreateInfo *in
 VkPipeline qoCreateGraphicsPipeline(VkDevice dev,
                                     VkPipelineCache pipeline_cache,
                                     const QoExtraGraphicsPipelineCreateInfo *info);
+void __qoCreateGraphicsPipelines(VkDevice dev,
+                                 VkPipelineCache pipeline_cache,
+                                 const QoGraphicsPipelineBatchInfo *info,
+                                 VkPipeline *pipelines);
 VkImage __qoCreateImage(VkDevice dev, const VkImageCreateInfo *info);
 VkImageView __qoCreateImageView(VkDevice dev, const VkImageViewCreateInfo *info);
 VkShaderModule __qoCreateShaderModule(VkDevice dev, const QoShaderModuleCreateInfo *info);
+void qoGetShaderModuleCacheStats(uint64_t *hits, uint64_t *misses);
 
 #ifdef __cplusplus
 }
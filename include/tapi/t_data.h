@@ -31,6 +31,7 @@
 #include "util/vk_wrapper.h"
 
 typedef struct cru_image cru_image_t;
+typedef struct QoDescriptorAllocator_ *QoDescriptorAllocator;
 
 #define t_name __t_name()
 #define t_user_data __t_user_data()
@@ -42,7 +43,7 @@ typedef struct cru_image cru_image_t;
 #define t_device (*__t_device())
 #define t_queue (*__t_queue())
 #define t_queue_idx(q) (*__t_queue_idx(q))
-#define t_descriptor_pool (*__t_descriptor_pool())
+#define t_descriptor_allocator (*__t_descriptor_allocator())
 #define t_cmd_pool (*__t_cmd_pool())
 #define t_cmd_pool_idx(q) (*__t_cmd_pool_idx(q))
 #define t_cmd_buffer (*__t_cmd_buffer())
@@ -70,7 +71,7 @@ const VkPhysicalDeviceProperties *__t_physical_dev_props(void);
 const VkPhysicalDeviceMemoryProperties *__t_physical_dev_mem_props(void);
 const VkQueue *__t_queue(void);
 const VkQueue *__t_queue_idx(int q);
-const VkDescriptorPool *__t_descriptor_pool(void);
+const QoDescriptorAllocator *__t_descriptor_allocator(void);
 const VkCommandPool *__t_cmd_pool(void);
 const VkCommandPool *__t_cmd_pool_idx(int q);
 const VkCommandBuffer *__t_cmd_buffer(void);
@@ -87,10 +87,31 @@ struct test_def {
     /// and/or transfer operations.
     enum test_queue_setup queue_setup;
 
+    /// \brief The Vulkan version the test requests.
+    ///
+    /// The test skips if the physical device's major.minor version is
+    /// older. If unset, the test requests Vulkan 1.0.
     const uint32_t api_version;
 
     const bool robust_buffer_access;
 
+    /// \brief Instance or device extensions that the test requires.
+    ///
+    /// A NULL-terminated array of extension names, or NULL. The test skips if
+    /// any extension is unsupported, just as if it had called
+    /// t_require_ext().
+    const char *const *const required_extensions;
+
+    /// \brief Device features that the test requires.
+    ///
+    /// The test skips if any feature set here is unsupported.
+    const VkPhysicalDeviceFeatures required_features;
+
+    /// \brief Flags that the test's queue family must have.
+    ///
+    /// These are in addition to the flags that test_def::queue_setup implies.
+    const VkQueueFlags required_queue_flags;
+
     /// \brief Private data for the test framework.
     ///
     /// Test authors shouldn't touch this struct.
@@ -107,6 +128,18 @@ struct test_def {
     } priv;
 } __attribute__((aligned(32)));
 
+/// \brief Build a NULL-terminated list for test_def::required_extensions.
+///
+/// Example usage:
+///
+///    test_define {
+///       .name = "func.multiview",
+///       .start = test,
+///       .required_extensions = TEST_EXTENSIONS("VK_KHR_multiview"),
+///    };
+///
+#define TEST_EXTENSIONS(...) ((const char *const []) { __VA_ARGS__, NULL })
+
 /// Example usage:
 ///
 ///    static void
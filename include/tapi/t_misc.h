@@ -24,6 +24,8 @@
 
 #pragma once
 
+#include <stdbool.h>
+
 #include "util/vk_wrapper.h"
 
 typedef struct cru_format_info cru_format_info_t;
@@ -32,3 +34,8 @@ typedef struct cru_format_info cru_format_info_t;
 ///
 /// If Crucible does not have info for the given format, then the test fails.
 const cru_format_info_t *t_format_info(VkFormat format);
+
+/// \brief Return true if qonos may suballocate device memory for the test.
+///
+/// \see QoMemoryAllocateFromRequirementsInfo::pOffset
+bool t_suballoc_enabled(void);
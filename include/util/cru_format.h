@@ -22,6 +22,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "util/vk_wrapper.h"
@@ -37,6 +38,12 @@ enum cru_num_type {
     CRU_NUM_TYPE_UNORM,
     CRU_NUM_TYPE_UINT,
     CRU_NUM_TYPE_SFLOAT,
+    CRU_NUM_TYPE_SNORM,
+    CRU_NUM_TYPE_USCALED,
+    CRU_NUM_TYPE_SSCALED,
+    CRU_NUM_TYPE_SINT,
+    CRU_NUM_TYPE_UFLOAT,
+    CRU_NUM_TYPE_SRGB,
 };
 
 struct cru_format_info {
@@ -46,8 +53,23 @@ struct cru_format_info {
     VkFormat format;
     enum cru_num_type num_type;
     uint8_t num_channels;
+
+    /// Bytes per texel. This is zero for formats whose texels have no size of
+    /// their own: compressed, 4:2:2, and multi-planar formats.
     uint8_t cpp;
 
+    /// The texel block is the unit in which image data is addressed. It is
+    /// 1x1x1 for most uncompressed formats.
+    uint8_t block_width;
+    uint8_t block_height;
+    uint8_t block_depth;
+
+    /// Bytes per texel block. This is zero for multi-planar formats.
+    uint8_t block_size;
+
+    uint8_t num_planes;
+    VkImageAspectFlags aspects;
+
     /// This is zero (VK_FORMAT_UNDEFINED) if and only if the format has no
     /// depth component.
     VkFormat depth_format;
@@ -58,6 +80,7 @@ struct cru_format_info {
 
     bool is_color:1;
     bool has_alpha:1;
+    bool is_compressed:1;
 };
 
 /// \brief Lookup info for VkFormat.
@@ -65,6 +88,19 @@ struct cru_format_info {
 /// If Crucible does not have info for the given format, then return NULL.
 const struct cru_format_info *cru_format_get_info(VkFormat format);
 
+/// \brief Size in bytes of one row of texel blocks.
+///
+/// The width is in texels and is rounded up to whole blocks.
+uint32_t cru_format_get_row_size(const struct cru_format_info *info,
+                                 uint32_t width);
+
+/// \brief Size in bytes of an image's data, tightly packed.
+///
+/// Each dimension is in texels and is rounded up to whole blocks.
+size_t cru_format_get_image_size(const struct cru_format_info *info,
+                                 uint32_t width, uint32_t height,
+                                 uint32_t depth);
+
 #ifdef __cplusplus
 }
 #endif
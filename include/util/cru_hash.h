@@ -0,0 +1,59 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#pragma once
+
+/// \file
+/// \brief Non-cryptographic 64-bit hash of byte streams.
+///
+/// The algorithm is XXH64. Its four independent accumulator lanes consume 32
+/// bytes per step, so hashing a large image runs near memory bandwidth.
+/// Because the hash is streamed, callers may feed an image row by row
+/// without first packing its rows.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cru_hash cru_hash_t;
+
+struct cru_hash {
+    uint64_t acc[4];
+    uint8_t buf[32];
+    uint32_t buf_len;
+    uint64_t total_len;
+    uint64_t seed;
+};
+
+void cru_hash_init(cru_hash_t *h, uint64_t seed);
+void cru_hash_update(cru_hash_t *h, const void *data, size_t size);
+uint64_t cru_hash_final(const cru_hash_t *h);
+
+/// Hash a single buffer. Equivalent to init, update, and final.
+uint64_t cru_hash_buffer(const void *data, size_t size, uint64_t seed);
+
+#ifdef __cplusplus
+}
+#endif
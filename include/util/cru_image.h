@@ -102,6 +102,7 @@ bool cru_image_compare(cru_image_t *a, cru_image_t *b);
 bool cru_image_compare_rect(cru_image_t *a, uint32_t a_x, uint32_t a_y,
                             cru_image_t *b, uint32_t b_x, uint32_t b_y,
                             uint32_t width, uint32_t height);
+bool cru_image_hash(cru_image_t *image, uint64_t *out_hash);
 
 /// \brief Map the image to an array of pixels.
 ///
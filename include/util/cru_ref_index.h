@@ -0,0 +1,75 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#pragma once
+
+/// \file
+/// \brief Index of reference image hashes
+///
+/// The index is a text file, CRU_REF_INDEX_FILENAME, in Crucible's data
+/// directory. It maps each reference image to its dimensions and to the
+/// cru_image_hash() of its pixels, which lets a test compare its result
+/// against a reference without decoding the reference.
+///
+/// Each entry records the size and modification time of the file when it
+/// was hashed. If the file has since changed, the entry is stale and lookup
+/// ignores it.
+///
+/// The build generates the index with `crucible hash-refs`, and
+/// `crucible bootstrap` refreshes the entries of the images it writes.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRU_REF_INDEX_FILENAME "ref-hashes.txt"
+
+/// \brief Look up a reference image in the index.
+///
+/// The \a filename is relative to the data directory. The index is loaded
+/// on first use and cached for the life of the process. Return false if the
+/// image has no entry, or if its entry is stale.
+bool cru_ref_index_lookup(const char *filename, uint32_t *width,
+                          uint32_t *height, uint64_t *hash);
+
+/// \brief Hash the given reference images and write their index entries.
+///
+/// The filenames are relative to the data directory. If \a keep_others is
+/// set, then entries for other images are kept; otherwise the index is
+/// rewritten to contain only the given images. The index file is replaced
+/// atomically.
+///
+/// Updates are not visible to cru_ref_index_lookup() in the same process.
+bool cru_ref_index_update(const char *const *filenames, uint32_t count,
+                          bool keep_others);
+
+/// \brief Rewrite the index from all reference images in the data directory.
+///
+/// Reference images are those named `*.ref.png` or `*.ref-stencil.png`.
+bool cru_ref_index_rebuild(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,58 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/// \file
+/// \brief Chrome trace of the test run
+///
+/// With `crucible run --trace=FILE`, the runner's master and slaves record
+/// spans of work: dispatch, result collection, each test and each of its
+/// phases. At the end of the run, the master writes them all to FILE in the
+/// Chrome trace event format, which chrome://tracing and Perfetto load.
+///
+/// Each thread records into its own buffers, so recording takes no lock.
+/// Each slave writes its spans to FILE.<pid> when it exits, and the master
+/// merges those files into FILE. A slave that crashes loses its spans.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void trace_init(const char *filepath);
+bool trace_is_enabled(void);
+
+uint64_t trace_start(void);
+void trace_span(const char *name, const char *detail, uint64_t start_ns);
+void trace_span_ns(const char *name, const char *detail, uint64_t start_ns,
+                   uint64_t end_ns);
+
+void trace_add_child(pid_t pid);
+void trace_write_process(const char *process_name);
+bool trace_finish(void);
+
+#ifdef __cplusplus
+}
+#endif
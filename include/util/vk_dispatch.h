@@ -0,0 +1,99 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+/// \file
+/// \brief Per-device dispatch of Vulkan device-level commands
+///
+/// Every core device-level command called through util/vk_wrapper.h is
+/// redirected to an inline wrapper. By default the wrapper calls the loader's
+/// exported trampoline, as a plain call would. After
+/// cru_vk_set_direct_dispatch(), calls on that device, its queues, and its
+/// command buffers instead go straight to the entry points returned by
+/// vkGetDeviceProcAddr, skipping the trampoline.
+///
+/// The wrapper recognizes the device by its loader dispatch key, the pointer
+/// that the loader stores at the start of every dispatchable object. Calls on
+/// any other device, such as one a test creates for itself, still go through
+/// the loader.
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include <vulkan/vulkan.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Defines CRU_VK_DEVICE_ENTRYPOINTS.
+#include "util/vk_dispatch_gen.h"
+
+struct cru_vk_device_dispatch {
+    /// The loader dispatch key shared by the device and its children.
+    const void *key;
+
+#define CRU_VK_DISPATCH_ENTRY(name) PFN_vk##name name;
+    CRU_VK_DEVICE_ENTRYPOINTS(CRU_VK_DISPATCH_ENTRY)
+#undef CRU_VK_DISPATCH_ENTRY
+};
+
+/// Calls every command through the loader's trampolines.
+extern const struct cru_vk_device_dispatch cru_vk_loader_dispatch;
+
+/// The direct table in use, or NULL.
+extern _Atomic(const struct cru_vk_device_dispatch *) cru_vk_direct_dispatch;
+
+/// Fill \a d with the device's own entry points. Any that the device does not
+/// expose fall back to the loader's.
+void cru_vk_device_dispatch_init(struct cru_vk_device_dispatch *d,
+                                 VkDevice device);
+
+/// Route calls on d's device through \a d until it is cleared.
+void cru_vk_set_direct_dispatch(const struct cru_vk_device_dispatch *d);
+
+/// Stop using \a d, if it is in use. The caller must clear the table before
+/// destroying its device, because a later device may reuse the key.
+void cru_vk_clear_direct_dispatch(const struct cru_vk_device_dispatch *d);
+
+static inline const struct cru_vk_device_dispatch *
+cru_vk_get_dispatch(const void *handle)
+{
+    const struct cru_vk_device_dispatch *d =
+        atomic_load_explicit(&cru_vk_direct_dispatch, memory_order_relaxed);
+
+    if (d && handle && *(const void *const *) handle == d->key)
+        return d;
+
+    return &cru_vk_loader_dispatch;
+}
+
+#ifndef CRU_VK_NO_DISPATCH_WRAPPERS
+#define CRU_VK_DISPATCH_WRAPPERS
+#include "util/vk_dispatch_gen.h"
+#undef CRU_VK_DISPATCH_WRAPPERS
+#endif
+
+#ifdef __cplusplus
+}
+#endif
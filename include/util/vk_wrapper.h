@@ -24,3 +24,6 @@
 #define VK_PROTOTYPES
 
 #include <vulkan/vulkan.h>
+
+// Route device-level commands through the per-device dispatch tables.
+#include "util/vk_dispatch.h"
@@ -1,4 +1,4 @@
-__crucible_commands="bootstrap dump-image test help ls-tests run version"
+__crucible_commands="bootstrap dump-image hash-refs test help ls-tests merge-junit run version"
 
 __crucible_bootstrap()
 {
@@ -10,6 +10,11 @@ __crucible_dump_image()
    COMPREPLY=($(compgen -o filenames -A file -W "--help" -- ${COMP_WORDS[COMP_CWORD]}))
 }
 
+__crucible_hash_refs()
+{
+   COMPREPLY=($(compgen -W "--help" -- ${COMP_WORDS[COMP_CWORD]}))
+}
+
 __crucible_help()
 {
     COMPREPLY=($(compgen -W "$__crucible_commands" -- ${COMP_WORDS[COMP_CWORD]}))
@@ -17,7 +22,12 @@ __crucible_help()
 
 __crucible_ls_tests()
 {
-    COMPREPLY=($(compgen -W "--help" -- ${COMP_WORDS[COMP_CWORD]}))
+    COMPREPLY=($(compgen -W "--help --pairs --shard --shard-durations" -- ${COMP_WORDS[COMP_CWORD]}))
+}
+
+__crucible_merge_junit()
+{
+   COMPREPLY=($(compgen -o filenames -A file -W "--help -o --output" -- ${COMP_WORDS[COMP_CWORD]}))
 }
 
 __crucible_run()
@@ -36,6 +46,15 @@ __crucible_run()
       --use-spir-v
       --junit-xml
       --device-id
+      --check-leaks
+      --no-check-leaks
+      --suballoc
+      --no-suballoc
+      --minimal-device
+      --no-minimal-device
+      --dispatch
+      --shard
+      --shard-durations
    "
 
    COMPREPLY=($(compgen -W "$flags $($1 ls-tests)" -- ${COMP_WORDS[COMP_CWORD]}))
@@ -67,8 +86,10 @@ __crucible()
     case "$command" in
 	bootstrap) __crucible_bootstrap $1 ;;
 	dump-image) __crucible_dump_image $1 ;;
+	hash-refs) __crucible_hash_refs ;;
 	help) __crucible_help ;;
 	ls-tests) __crucible_ls_tests $1 ;;
+	merge-junit) __crucible_merge_junit ;;
 	run) __crucible_run $1 ;;
 	*) COMPREPLY=() ;;
     esac
@@ -0,0 +1,327 @@
+#!/usr/bin/env python3
+
+# Copyright 2015 Intel Corporation
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+"""Generate Crucible's VkFormat info table from vulkan_core.h.
+
+Every property of a VkFormat that Crucible cares about is encoded in the
+format's name, so the table is derived from the names in the VkFormat enum.
+Core formats are dense and small, so they are emitted as an array indexed by
+VkFormat. Extension formats have huge, sparse values; they are emitted into a
+separate array reached through an open-addressed hash table whose hash
+function must match cru_format_ext_hash() in cru_format.c.
+"""
+
+import argparse
+import os
+import re
+import sys
+from collections import namedtuple
+from textwrap import dedent
+
+PROG_NAME = os.path.basename(sys.argv[0])
+
+# Values at or above this belong to extensions.
+EXT_ENUM_BASE = 1000000000
+
+VENDOR_SUFFIXES = ('KHR', 'EXT', 'IMG', 'NV', 'AMD', 'ARM', 'QCOM', 'INTEL')
+
+NUM_TYPES = ('UNORM', 'SNORM', 'USCALED', 'SSCALED', 'UINT', 'SINT',
+             'UFLOAT', 'SFLOAT', 'SRGB')
+
+Info = namedtuple('Info', (
+    'name', 'value', 'num_type', 'num_channels', 'cpp',
+    'block_width', 'block_height', 'block_depth', 'block_size',
+    'num_planes', 'aspects', 'depth_format', 'stencil_format',
+    'is_color', 'has_alpha', 'is_compressed'))
+
+# name prefix -> (block width, block height, block size, channels)
+COMPRESSED_FAMILIES = (
+    ('BC1_RGB_',    (4, 4, 8, 3)),
+    ('BC1_RGBA_',   (4, 4, 8, 4)),
+    ('BC2_',        (4, 4, 16, 4)),
+    ('BC3_',        (4, 4, 16, 4)),
+    ('BC4_',        (4, 4, 8, 1)),
+    ('BC5_',        (4, 4, 16, 2)),
+    ('BC6H_',       (4, 4, 16, 3)),
+    ('BC7_',        (4, 4, 16, 4)),
+    ('ETC2_R8G8B8_',    (4, 4, 8, 3)),
+    ('ETC2_R8G8B8A1_',  (4, 4, 8, 4)),
+    ('ETC2_R8G8B8A8_',  (4, 4, 16, 4)),
+    ('EAC_R11_',    (4, 4, 8, 1)),
+    ('EAC_R11G11_', (4, 4, 16, 2)),
+    ('PVRTC1_2BPP_', (8, 4, 8, 4)),
+    ('PVRTC1_4BPP_', (4, 4, 8, 4)),
+    ('PVRTC2_2BPP_', (8, 4, 8, 4)),
+    ('PVRTC2_4BPP_', (4, 4, 8, 4)),
+)
+
+component_re = re.compile(r'([RGBADSXE])(\d+)')
+components_token_re = re.compile(r'^(?:[RGBADSXE]\d+)+$')
+astc_re = re.compile(r'^ASTC_(\d+)x(\d+)_')
+
+def die(msg):
+    print('{}: error: {}'.format(PROG_NAME, msg), file=sys.stderr)
+    sys.exit(1)
+
+def parse_args():
+    p = argparse.ArgumentParser()
+    p.add_argument('-o', dest='out_filename', required=True)
+    p.add_argument('vulkan_core_h')
+    return p.parse_args()
+
+def read_formats(filename):
+    """Return the (name, value) of each VkFormat, skipping aliases."""
+    with open(filename) as f:
+        text = f.read()
+
+    match = re.search(r'typedef enum VkFormat \{(.*?)\} VkFormat;', text,
+                      re.DOTALL)
+    if match is None:
+        die('{!r} does not define VkFormat'.format(filename))
+
+    formats = []
+    for m in re.finditer(r'\b(VK_FORMAT_\w+)\s*=\s*(\d+)\s*,', match.group(1)):
+        formats.append((m.group(1), int(m.group(2))))
+    return formats
+
+def strip_vendor(short_name):
+    head, _, tail = short_name.rpartition('_')
+    if tail in VENDOR_SUFFIXES:
+        return head
+    return short_name
+
+def get_num_type(tokens):
+    types = set(t for t in tokens if t in NUM_TYPES)
+    if len(types) != 1:
+        return 'UNDEFINED'
+    return types.pop()
+
+def get_aspects(is_color, has_depth, has_stencil, num_planes):
+    aspects = []
+    if is_color:
+        aspects.append('VK_IMAGE_ASPECT_COLOR_BIT')
+    if has_depth:
+        aspects.append('VK_IMAGE_ASPECT_DEPTH_BIT')
+    if has_stencil:
+        aspects.append('VK_IMAGE_ASPECT_STENCIL_BIT')
+    if num_planes > 1:
+        for i in range(num_planes):
+            aspects.append('VK_IMAGE_ASPECT_PLANE_{}_BIT'.format(i))
+    return aspects
+
+def parse_compressed(name, value, short_name):
+    block_width = block_height = block_size = channels = None
+
+    m = astc_re.match(short_name)
+    if m:
+        block_width, block_height = int(m.group(1)), int(m.group(2))
+        block_size, channels = 16, 4
+    else:
+        for prefix, props in COMPRESSED_FAMILIES:
+            if short_name.startswith(prefix):
+                block_width, block_height, block_size, channels = props
+                break
+
+    if block_width is None:
+        die('unknown compressed format {}'.format(name))
+
+    return Info(
+        name=name, value=value,
+        num_type=get_num_type(short_name.split('_')),
+        num_channels=channels, cpp=0,
+        block_width=block_width, block_height=block_height, block_depth=1,
+        block_size=block_size, num_planes=1,
+        aspects=get_aspects(True, False, False, 1),
+        depth_format=None, stencil_format=None,
+        is_color=True, has_alpha=(channels == 4), is_compressed=True)
+
+def parse_uncompressed(name, value, short_name):
+    tokens = short_name.split('_')
+
+    # Each component, including padding (X) and shared exponents (E), with
+    # its size in bits. For multi-planar formats, these span all planes.
+    components = []
+    for t in tokens:
+        if components_token_re.match(t):
+            components += [(c, int(bits)) for c, bits in component_re.findall(t)]
+    if not components:
+        die('cannot parse components of {}'.format(name))
+
+    channels = set(c for c, bits in components if c not in 'XE')
+    has_depth = 'D' in channels
+    has_stencil = 'S' in channels
+    is_color = not has_depth and not has_stencil
+
+    num_planes = 1
+    for t in tokens:
+        if t in ('2PLANE', '3PLANE'):
+            num_planes = int(t[0])
+
+    # In 4:2:2 formats, a block is a pair of horizontally adjacent texels.
+    block_width = 2 if '422' in tokens and num_planes == 1 else 1
+
+    total_bits = sum(bits for c, bits in components)
+    if total_bits % 8 != 0:
+        die('{} has a fractional byte size'.format(name))
+
+    # A multi-planar format has no size of its own; each plane does.
+    block_size = total_bits // 8 if num_planes == 1 else 0
+    cpp = block_size if block_width == 1 else 0
+
+    depth_format = None
+    if has_depth:
+        depth_bits = dict(components)['D']
+        depth_format = {
+            16: 'VK_FORMAT_D16_UNORM',
+            24: 'VK_FORMAT_X8_D24_UNORM_PACK32',
+            32: 'VK_FORMAT_D32_SFLOAT',
+        }[depth_bits]
+
+    return Info(
+        name=name, value=value,
+        num_type=get_num_type(tokens),
+        num_channels=len(channels), cpp=cpp,
+        block_width=block_width, block_height=1, block_depth=1,
+        block_size=block_size, num_planes=num_planes,
+        aspects=get_aspects(is_color, has_depth, has_stencil, num_planes),
+        depth_format=depth_format,
+        stencil_format='VK_FORMAT_S8_UINT' if has_stencil else None,
+        is_color=is_color, has_alpha='A' in channels, is_compressed=False)
+
+def parse_format(name, value):
+    short_name = strip_vendor(name[len('VK_FORMAT_'):])
+    if short_name.endswith('_BLOCK'):
+        return parse_compressed(name, value, short_name)
+    else:
+        return parse_uncompressed(name, value, short_name)
+
+def ext_hash(value, bits):
+    # Must match cru_format_ext_hash().
+    return ((value * 2654435761) & 0xffffffff) >> (32 - bits)
+
+def build_ext_slots(ext_infos):
+    bits = 1
+    while (1 << bits) < 2 * len(ext_infos):
+        bits += 1
+
+    slots = [0] * (1 << bits)
+    for i, info in enumerate(ext_infos):
+        h = ext_hash(info.value, bits)
+        while slots[h] != 0:
+            h = (h + 1) & ((1 << bits) - 1)
+        slots[h] = i + 1
+
+    return bits, slots
+
+def format_info(info, indent):
+    lines = [
+        '.name = "{}",'.format(info.name),
+        '.format = {},'.format(info.name),
+        '.num_type = CRU_NUM_TYPE_{},'.format(info.num_type),
+        '.num_channels = {},'.format(info.num_channels),
+        '.cpp = {},'.format(info.cpp),
+        '.block_width = {},'.format(info.block_width),
+        '.block_height = {},'.format(info.block_height),
+        '.block_depth = {},'.format(info.block_depth),
+        '.block_size = {},'.format(info.block_size),
+        '.num_planes = {},'.format(info.num_planes),
+        '.aspects = {},'.format(' | '.join(info.aspects) or '0'),
+    ]
+    if info.depth_format:
+        lines.append('.depth_format = {},'.format(info.depth_format))
+    if info.stencil_format:
+        lines.append('.stencil_format = {},'.format(info.stencil_format))
+    for flag in ('is_color', 'has_alpha', 'is_compressed'):
+        if getattr(info, flag):
+            lines.append('.{} = true,'.format(flag))
+
+    return ''.join(indent + l + '\n' for l in lines)
+
+copyright = dedent("""\
+    // Copyright 2015 Intel Corporation
+    //
+    // Permission is hereby granted, free of charge, to any person obtaining a
+    // copy of this software and associated documentation files (the "Software"),
+    // to deal in the Software without restriction, including without limitation
+    // the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    // and/or sell copies of the Software, and to permit persons to whom the
+    // Software is furnished to do so, subject to the following conditions:
+    //
+    // The above copyright notice and this permission notice (including the next
+    // paragraph) shall be included in all copies or substantial portions of the
+    // Software.
+    //
+    // THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    // IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    // FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+    // THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    // LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    // IN THE SOFTWARE.
+    """)
+
+def main():
+    args = parse_args()
+
+    infos = [parse_format(name, value)
+             for name, value in read_formats(args.vulkan_core_h)
+             if name != 'VK_FORMAT_UNDEFINED']
+
+    core_infos = sorted((i for i in infos if i.value < EXT_ENUM_BASE),
+                        key=lambda i: i.value)
+    ext_infos = sorted((i for i in infos if i.value >= EXT_ENUM_BASE),
+                       key=lambda i: i.value)
+    ext_hash_bits, ext_slots = build_ext_slots(ext_infos)
+
+    with open(args.out_filename, 'w') as f:
+        f.write(copyright)
+        f.write('\n// Generated by {} from {}. Do not edit.\n\n'.format(
+                PROG_NAME, os.path.basename(args.vulkan_core_h)))
+
+        f.write('static const struct cru_format_info\n'
+                'cru_format_core_table[] = {\n')
+        for info in core_infos:
+            f.write('    [{}] = {{\n'.format(info.name))
+            f.write(format_info(info, ' ' * 8))
+            f.write('    },\n')
+        f.write('};\n\n')
+
+        f.write('static const struct cru_format_info\n'
+                'cru_format_ext_table[] = {\n')
+        for info in ext_infos:
+            f.write('    {\n')
+            f.write(format_info(info, ' ' * 8))
+            f.write('    },\n')
+        f.write('};\n\n')
+
+        f.write('#define CRU_FORMAT_EXT_HASH_BITS {}\n\n'.format(ext_hash_bits))
+        f.write('/// Index plus one into cru_format_ext_table, or 0 if empty.\n')
+        f.write('static const uint16_t\n'
+                'cru_format_ext_slots[1 << CRU_FORMAT_EXT_HASH_BITS] = {\n')
+        for i in range(0, len(ext_slots), 16):
+            f.write('    ' + ', '.join(str(s) for s in ext_slots[i:i+16]) +
+                    ',\n')
+        f.write('};\n')
+
+if __name__ == '__main__':
+    main()
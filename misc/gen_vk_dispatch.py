@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+
+# Copyright 2015 Intel Corporation
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+"""Generate Crucible's device dispatch wrappers from vulkan_core.h.
+
+The output is included twice by util/vk_dispatch.h. The first pass, with
+CRU_VK_DISPATCH_WRAPPERS undefined, defines the X-macro list of device-level
+commands. The second pass defines, for each command, an inline wrapper that
+calls through cru_vk_get_dispatch() and a macro that redirects the vk* name to
+the wrapper.
+"""
+
+import argparse
+import os
+import re
+import sys
+from textwrap import dedent
+
+PROG_NAME = os.path.basename(sys.argv[0])
+
+# Only core commands are wrapped, because only they are exported by the loader
+# and so have a loader trampoline to fall back to.
+CORE_VERSIONS = ('VK_VERSION_1_0', 'VK_VERSION_1_1')
+
+DISPATCHABLE_DEVICE_TYPES = ('VkDevice', 'VkQueue', 'VkCommandBuffer')
+
+# The loader must see these calls, because they create or destroy
+# dispatchable objects and the loader initializes or frees the objects'
+# dispatch keys. vkGetDeviceProcAddr is how the table is filled.
+LOADER_ONLY = (
+    'vkGetDeviceProcAddr',
+    'vkDestroyDevice',
+    'vkGetDeviceQueue',
+    'vkGetDeviceQueue2',
+    'vkAllocateCommandBuffers',
+)
+
+proto_re = re.compile(
+    r'VKAPI_ATTR\s+(?P<ret>[\w\s\*]+?)\s+VKAPI_CALL\s+(?P<name>vk\w+)\s*\('
+    r'(?P<params>.*?)\)\s*;', re.DOTALL)
+
+# Each core version and extension begins with a line like this.
+feature_re = re.compile(r'^#define (VK_\w+) 1$', re.MULTILINE)
+
+param_name_re = re.compile(r'(\w+)\s*(\[\w+\])?\s*$')
+
+def die(msg):
+    print('{}: error: {}'.format(PROG_NAME, msg), file=sys.stderr)
+    sys.exit(1)
+
+def parse_args():
+    p = argparse.ArgumentParser()
+    p.add_argument('-o', dest='out_filename', required=True)
+    p.add_argument('vulkan_core_h')
+    return p.parse_args()
+
+def get_version_text(text, version):
+    """Return the part of vulkan_core.h that declares a core version."""
+    features = list(feature_re.finditer(text))
+    for i, m in enumerate(features):
+        if m.group(1) == version:
+            end = features[i + 1].start() if i + 1 < len(features) else None
+            return text[m.start():end]
+
+    die('vulkan_core.h does not define {}'.format(version))
+
+def parse_commands(text):
+    commands = []
+    for m in proto_re.finditer(text):
+        params = [' '.join(p.split()) for p in m.group('params').split(',')]
+        names = []
+        for p in params:
+            pm = param_name_re.search(p)
+            if pm is None:
+                die('cannot parse parameter {!r} of {}'.format(
+                    p, m.group('name')))
+            names.append(pm.group(1))
+
+        commands.append({
+            'ret': ' '.join(m.group('ret').split()),
+            'name': m.group('name'),
+            'params': params,
+            'arg_names': names,
+        })
+    return commands
+
+def is_device_command(cmd):
+    first_type = cmd['params'][0].split()[0]
+    return (first_type in DISPATCHABLE_DEVICE_TYPES and
+            cmd['name'] not in LOADER_ONLY)
+
+copyright = dedent("""\
+    // Copyright 2015 Intel Corporation
+    //
+    // Permission is hereby granted, free of charge, to any person obtaining a
+    // copy of this software and associated documentation files (the "Software"),
+    // to deal in the Software without restriction, including without limitation
+    // the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    // and/or sell copies of the Software, and to permit persons to whom the
+    // Software is furnished to do so, subject to the following conditions:
+    //
+    // The above copyright notice and this permission notice (including the next
+    // paragraph) shall be included in all copies or substantial portions of the
+    // Software.
+    //
+    // THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    // IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    // FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+    // THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    // LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    // IN THE SOFTWARE.
+    """)
+
+def write_wrapper(f, cmd):
+    short_name = cmd['name'][len('vk'):]
+    params = (',\n' + ' ' * (len('cru_vk_') + len(short_name) + 1)).join(
+        cmd['params'])
+    args = ', '.join(cmd['arg_names'])
+    ret = '' if cmd['ret'] == 'void' else 'return '
+
+    f.write('static inline {}\n'.format(cmd['ret']))
+    f.write('cru_vk_{}({})\n'.format(short_name, params))
+    f.write('{\n')
+    f.write('    {}cru_vk_get_dispatch({})->{}({});\n'.format(
+            ret, cmd['arg_names'][0], short_name, args))
+    f.write('}\n')
+    f.write('#define {} cru_vk_{}\n\n'.format(cmd['name'], short_name))
+
+def main():
+    args = parse_args()
+
+    with open(args.vulkan_core_h) as f:
+        text = f.read()
+
+    commands = []
+    for version in CORE_VERSIONS:
+        commands += [c for c in parse_commands(get_version_text(text, version))
+                     if is_device_command(c)]
+    if not commands:
+        die('found no device commands in {!r}'.format(args.vulkan_core_h))
+
+    with open(args.out_filename, 'w') as f:
+        f.write(copyright)
+        f.write('\n// Generated by {} from {}. Do not edit.\n\n'.format(
+                PROG_NAME, os.path.basename(args.vulkan_core_h)))
+
+        f.write('#ifndef CRU_VK_DISPATCH_WRAPPERS\n\n')
+        f.write('#define CRU_VK_DEVICE_ENTRYPOINTS(X) \\\n')
+        for cmd in commands:
+            f.write('    X({}) \\\n'.format(cmd['name'][len('vk'):]))
+        f.write('    /* end */\n\n')
+        f.write('#else // CRU_VK_DISPATCH_WRAPPERS\n\n')
+        for cmd in commands:
+            write_wrapper(f, cmd)
+        f.write('#endif // CRU_VK_DISPATCH_WRAPPERS\n')
+
+if __name__ == '__main__':
+    main()
@@ -68,7 +68,6 @@ cru_usage_error(const cru_command_t *cmd, const char *format, ...)
     exit(129);
 }
 
-
 void
 cru_pop_argv(int start, int count, int *argc, char **argv)
 {
@@ -79,6 +78,33 @@ cru_pop_argv(int start, int count, int *argc, char **argv)
    *argc -= count;
 }
 
+/// Parse the argument of --shard, which has form "K/N" with 1 <= K <= N.
+/// Return the zero-based shard index K-1 and the shard count N.
+bool
+cru_parse_shard(const char *str, uint32_t *index, uint32_t *count)
+{
+    unsigned long k, n;
+    char *endptr;
+
+    errno = 0;
+
+    k = strtoul(str, &endptr, 10);
+    if (endptr == str || endptr[0] != '/')
+        return false;
+
+    str = endptr + 1;
+    n = strtoul(str, &endptr, 10);
+    if (endptr == str || endptr[0] != 0)
+        return false;
+
+    if (errno || k < 1 || k > n || n > UINT32_MAX)
+        return false;
+
+    *index = k - 1;
+    *count = n;
+    return true;
+}
+
 /// Open the manpage "crucible-{suffix}({volume})" by exec'ing man.
 noreturn void
 cru_open_crucible_manpage(int volume, const char *suffix)
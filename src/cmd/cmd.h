@@ -22,6 +22,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdnoreturn.h>
@@ -46,6 +47,7 @@ void cru_pop_argv(int start, int count, int *argc, char **argv);
 noreturn void cru_usage_error(const cru_command_t *cmd, const char *format, ...) printflike(2, 3);
 noreturn void cru_command_page_help(const cru_command_t *cmd);
 noreturn void cru_open_crucible_manpage(int volume, const char *suffix);
+bool cru_parse_shard(const char *str, uint32_t *index, uint32_t *count);
 
 extern const cru_command_t __start_cru_commands, __stop_cru_commands;
 
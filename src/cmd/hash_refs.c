@@ -0,0 +1,102 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+/// \file
+/// \brief Generate the index of reference image hashes
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/cru_ref_index.h"
+#include "util/cru_vec.h"
+
+#include "cmd.h"
+
+static cru_cstr_vec_t ref_files = CRU_VEC_INIT;
+
+// See the comment in run.c about the leading '+' and ':'.
+static const char *shortopts = "+:h";
+
+static const struct option longopts[] = {
+    {"help",          no_argument,       NULL,           'h'},
+    {0},
+};
+
+static void
+parse_args(const cru_command_t *cmd, int argc, char **argv)
+{
+    // Suppress getopt from printing error messages.
+    opterr = 0;
+
+    // Reset getopt.
+    optind = 1;
+
+    while (true) {
+        int optchar;
+
+        optchar = getopt_long(argc, argv, shortopts, longopts, NULL);
+
+        switch (optchar) {
+        case -1:
+            goto done_getopt;
+        case 'h':
+            cru_command_page_help(cmd);
+            exit(0);
+            break;
+        case ':':
+            cru_usage_error(cmd, "%s requires an argument", argv[optind-1]);
+            break;
+        case '?':
+        default:
+            cru_usage_error(cmd, "unknown option: %s", argv[optind-1]);
+            break;
+        }
+    }
+
+done_getopt:
+    while (optind < argc)
+        *cru_vec_push(&ref_files, 1) = argv[optind++];
+}
+
+static int
+cmd_start(const cru_command_t *cmd, int argc, char **argv)
+{
+    bool ok;
+
+    parse_args(cmd, argc, argv);
+
+    if (ref_files.len == 0) {
+        ok = cru_ref_index_rebuild();
+    } else {
+        ok = cru_ref_index_update((const char *const *) ref_files.data,
+                                  ref_files.len, /*keep_others*/ true);
+    }
+
+    cru_vec_finish(&ref_files);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+cru_define_command {
+    .name = "hash-refs",
+    .start = cmd_start,
+};
@@ -20,16 +20,35 @@
 // IN THE SOFTWARE.
 
 #include "cmd.h"
+#include "framework/runner/runner.h"
 #include "framework/test/test.h"
 #include "framework/test/test_def.h"
 
-static const char *shortopts = "h";
+static const char *shortopts = "+:h";
+
+enum opt_name {
+    OPT_NAME_HELP = 'h',
+
+    // Begin long-only options.
+    OPT_NAME_SHARD = 128,
+    OPT_NAME_SHARD_DURATIONS,
+    OPT_NAME_PAIRS,
+};
 
 static const struct option longopts[] = {
-    {"help", no_argument, NULL, 'h'},
+    {"help",            no_argument,       NULL, OPT_NAME_HELP},
+    {"pairs",           no_argument,       NULL, OPT_NAME_PAIRS},
+    {"shard",           required_argument, NULL, OPT_NAME_SHARD},
+    {"shard-durations", required_argument, NULL, OPT_NAME_SHARD_DURATIONS},
     {0},
 };
 
+static bool opt_pairs = false;
+static uint32_t opt_shard_index = 0;
+static uint32_t opt_shard_count = 0;
+static char *opt_shard_durations = NULL;
+static cru_cstr_vec_t test_patterns = CRU_VEC_INIT;
+
 static void
 parse_args(const cru_command_t *cmd, int argc, char **argv)
 {
@@ -37,7 +56,7 @@ parse_args(const cru_command_t *cmd, int argc, char **argv)
     opterr = 0;
 
     // Reset getopt.
-    optind = 0;
+    optind = 1;
 
     while (true) {
         int optchar = getopt_long(argc, argv, shortopts, longopts, NULL);
@@ -45,10 +64,22 @@ parse_args(const cru_command_t *cmd, int argc, char **argv)
         switch (optchar) {
         case -1:
             goto done_getopt;
-        case 'h':
+        case OPT_NAME_HELP:
             cru_command_page_help(cmd);
             exit(0);
             break;
+        case OPT_NAME_PAIRS:
+            opt_pairs = true;
+            break;
+        case OPT_NAME_SHARD:
+            if (!cru_parse_shard(optarg, &opt_shard_index, &opt_shard_count)) {
+                cru_usage_error(cmd, "invalid value '%s' for --shard, "
+                                "expected K/N with 1 <= K <= N", optarg);
+            }
+            break;
+        case OPT_NAME_SHARD_DURATIONS:
+            opt_shard_durations = strdup(optarg);
+            break;
         case ':':
             cru_usage_error(cmd, "%s requires an argument", argv[optind-1]);
             break;
@@ -60,8 +91,24 @@ parse_args(const cru_command_t *cmd, int argc, char **argv)
     }
 
 done_getopt:
-    if (optind < argc)
-        cru_usage_error(cmd, "trailing arguments");
+    while (optind < argc) {
+        char *arg = argv[optind++];
+
+        if (arg[0] == '-') {
+            cru_usage_error(cmd, "option %s follows a non-option",
+                            argv[optind-1]);
+        }
+
+        *cru_vec_push(&test_patterns, 1) = arg;
+    }
+
+    if (opt_shard_durations && opt_shard_count == 0)
+        cru_usage_error(cmd, "--shard-durations requires --shard");
+
+    // Shards partition (test, queue family) pairs, not tests. Require the
+    // flag rather than silently switching the output format.
+    if (opt_shard_count > 0 && !opt_pairs)
+        cru_usage_error(cmd, "--shard requires --pairs");
 }
 
 static int
@@ -71,10 +118,42 @@ start(const cru_command_t *cmd, int argc, char **argv)
 
     parse_args(cmd, argc, argv);
 
-    cru_foreach_test_def(def) {
-        printf("%s\n", def->name);
+    if (test_patterns.len == 0 && !opt_pairs) {
+        cru_foreach_test_def(def) {
+            printf("%s\n", def->name);
+        }
+
+        return 0;
     }
 
+    if (!runner_init(&(runner_opts_t) {
+            .jobs = 1,
+            .isolation_mode = RUNNER_ISOLATION_MODE_PROCESS,
+            .shard_index = opt_shard_index,
+            .shard_count = opt_shard_count,
+            .shard_durations_filepath = opt_shard_durations,
+        })) {
+        loge("failed to initialize the test runner");
+        return EXIT_FAILURE;
+    }
+
+    if (!runner_enable_matching_tests(&test_patterns))
+        return EXIT_FAILURE;
+
+    if (!opt_pairs) {
+        cru_foreach_test_def(def) {
+            if (def->priv.enable)
+                printf("%s\n", def->name);
+        }
+
+        return 0;
+    }
+
+    // Listing the (test, queue family) pairs that `crucible run` would run
+    // requires the queue family count, and hence a Vulkan device.
+    if (!runner_list_tests())
+        return EXIT_FAILURE;
+
     return 0;
 }
 
@@ -0,0 +1,230 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+/// \file
+/// \brief Merge the JUnit XML files of several `crucible run` shards
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include "util/cru_vec.h"
+#include "util/string.h"
+
+#include "cmd.h"
+
+static const char *opt_output = NULL;
+static cru_cstr_vec_t input_files = CRU_VEC_INIT;
+
+static struct {
+    uint32_t tests;
+    uint32_t failures;
+    uint32_t errors;
+    uint32_t disabled;
+    double time;
+} totals;
+
+// See the comment in run.c about the leading '+' and ':'.
+static const char *shortopts = "+:ho:";
+
+static const struct option longopts[] = {
+    {"help",          no_argument,       NULL,           'h'},
+    {"output",        required_argument, NULL,           'o'},
+    {0},
+};
+
+static void
+parse_args(const cru_command_t *cmd, int argc, char **argv)
+{
+    // Suppress getopt from printing error messages.
+    opterr = 0;
+
+    // Reset getopt.
+    optind = 1;
+
+    while (true) {
+        int optchar;
+
+        optchar = getopt_long(argc, argv, shortopts, longopts, NULL);
+
+        switch (optchar) {
+        case -1:
+            goto done_getopt;
+        case 'h':
+            cru_command_page_help(cmd);
+            exit(0);
+            break;
+        case 'o':
+            opt_output = optarg;
+            break;
+        case ':':
+            cru_usage_error(cmd, "%s requires an argument", argv[optind-1]);
+            break;
+        case '?':
+        default:
+            cru_usage_error(cmd, "unknown option: %s", argv[optind-1]);
+            break;
+        }
+    }
+
+done_getopt:
+    while (optind < argc)
+        *cru_vec_push(&input_files, 1) = argv[optind++];
+
+    if (input_files.len == 0)
+        cru_usage_error(cmd, "missing <junit-xml-file>");
+}
+
+static inline const xmlChar *
+u(const char *str)
+{
+    return (const xmlChar *) str;
+}
+
+static bool
+testcase_has_child(xmlNodePtr testcase, const char *name)
+{
+    for (xmlNodePtr child = testcase->children; child; child = child->next) {
+        if (child->type == XML_ELEMENT_NODE && xmlStrEqual(child->name, u(name)))
+            return true;
+    }
+
+    return false;
+}
+
+/// Copy each testcase found under \a node into \a testsuite, and tally it.
+static void
+merge_testcases(xmlNodePtr node, xmlDocPtr doc, xmlNodePtr testsuite)
+{
+    for (; node; node = node->next) {
+        if (node->type != XML_ELEMENT_NODE)
+            continue;
+
+        if (!xmlStrEqual(node->name, u("testcase"))) {
+            merge_testcases(node->children, doc, testsuite);
+            continue;
+        }
+
+        ++totals.tests;
+
+        if (testcase_has_child(node, "failure"))
+            ++totals.failures;
+        else if (testcase_has_child(node, "error"))
+            ++totals.errors;
+        else if (testcase_has_child(node, "skipped"))
+            ++totals.disabled;
+
+        xmlChar *time = xmlGetProp(node, u("time"));
+        if (time) {
+            totals.time += strtod((const char *) time, NULL);
+            xmlFree(time);
+        }
+
+        xmlAddChild(testsuite, xmlDocCopyNode(node, doc, /*recursive*/ 1));
+    }
+}
+
+static void
+set_total(xmlNodePtr root, xmlNodePtr testsuite, const char *attr,
+          uint32_t value)
+{
+    string_t buf = STRING_INIT;
+
+    string_printf(&buf, "%u", value);
+    xmlNewProp(root, u(attr), u(string_data(&buf)));
+    xmlNewProp(testsuite, u(attr), u(string_data(&buf)));
+    string_finish(&buf);
+}
+
+static int
+cmd_start(const cru_command_t *cmd, int argc, char **argv)
+{
+    int exit_code = EXIT_FAILURE;
+    char **input;
+
+    parse_args(cmd, argc, argv);
+
+    xmlDocPtr doc = xmlNewDoc(u("1.0"));
+    doc->encoding = u(strdup("UTF-8"));
+
+    xmlNodePtr root = xmlNewNode(NULL, u("testsuites"));
+    xmlDocSetRootElement(doc, root);
+
+    xmlNodePtr testsuite = xmlNewChild(root, /*namespace*/ NULL,
+                                       /*name*/ u("testsuite"),
+                                       /*context*/ NULL);
+    xmlNewProp(testsuite, u("name"), u("crucible"));
+
+    cru_vec_foreach(input, &input_files) {
+        xmlDocPtr in = xmlReadFile(*input, NULL, XML_PARSE_NONET);
+        if (!in) {
+            loge("failed to parse junit xml file: %s", *input);
+            goto cleanup;
+        }
+
+        merge_testcases(xmlDocGetRootElement(in), doc, testsuite);
+        xmlFreeDoc(in);
+    }
+
+    set_total(root, testsuite, "tests", totals.tests);
+    set_total(root, testsuite, "failures", totals.failures);
+    set_total(root, testsuite, "errors", totals.errors);
+    set_total(root, testsuite, "disabled", totals.disabled);
+
+    string_t time = STRING_INIT;
+    string_printf(&time, "%.3f", totals.time);
+    xmlNewProp(testsuite, u("time"), u(string_data(&time)));
+    string_finish(&time);
+
+    FILE *file = stdout;
+    if (opt_output) {
+        file = fopen(opt_output, "w");
+        if (!file) {
+            loge("failed to open junit xml file: %s", opt_output);
+            goto cleanup;
+        }
+    }
+
+    if (xmlDocFormatDump(file, doc, /*format*/ 1) == -1) {
+        loge("failed to write junit xml file: %s",
+             opt_output ? opt_output : "<stdout>");
+    } else {
+        exit_code = EXIT_SUCCESS;
+    }
+
+    if (file != stdout && fclose(file) == -1) {
+        loge("failed to close junit xml file: %s", opt_output);
+        exit_code = EXIT_FAILURE;
+    }
+
+cleanup:
+    xmlFreeDoc(doc);
+    cru_vec_finish(&input_files);
+    return exit_code;
+}
+
+cru_define_command {
+    .name = "merge-junit",
+    .start = cmd_start,
+};
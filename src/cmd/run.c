@@ -37,9 +37,22 @@ static int opt_log_pids = 0;
 static int opt_no_cleanup = 0;
 static int opt_dump = 0;
 static int opt_separate_cleanup_thread = 1;
+static int opt_cleanup_depth = 0;
+static int opt_lost_retries = 0;
+static bool opt_has_cpu_set = false;
+static cpu_set_t opt_cpu_set;
+static runner_pin_mode_t opt_pin_slaves = RUNNER_PIN_MODE_NONE;
 static char *opt_junit_xml = NULL;
+static char *opt_trace = NULL;
 static int opt_device_id = 1;
 static int opt_verbose = 0;
+static int opt_check_leaks = 0;
+static int opt_suballoc = 1;
+static int opt_minimal_device = 1;
+static bool opt_direct_dispatch = false;
+static uint32_t opt_shard_index = 0;
+static uint32_t opt_shard_count = 0;
+static char *opt_shard_durations = NULL;
 
 // From man:getopt(3) :
 //
@@ -64,6 +77,14 @@ enum opt_name {
     // Begin long-only options. They begin with the first char value outside
     // the ASCII range.
     OPT_NAME_JUNIT_XML = 128,
+    OPT_NAME_SHARD,
+    OPT_NAME_SHARD_DURATIONS,
+    OPT_NAME_DISPATCH,
+    OPT_NAME_CLEANUP_DEPTH,
+    OPT_NAME_LOST_RETRIES,
+    OPT_NAME_TRACE,
+    OPT_NAME_CPU_SET,
+    OPT_NAME_PIN_SLAVES,
 };
 
 static const struct option longopts[] = {
@@ -77,7 +98,15 @@ static const struct option longopts[] = {
     {"dump",          no_argument,       &opt_dump,       true},
     {"no-dump",       no_argument,       &opt_dump,       false},
     {"junit-xml",     required_argument, NULL,            OPT_NAME_JUNIT_XML},
+    {"trace",         required_argument, NULL,            OPT_NAME_TRACE},
+    {"shard",         required_argument, NULL,            OPT_NAME_SHARD},
+    {"shard-durations", required_argument, NULL,          OPT_NAME_SHARD_DURATIONS},
     {"device-id",     required_argument, NULL,            OPT_NAME_DEVICE_ID},
+    {"dispatch",      required_argument, NULL,            OPT_NAME_DISPATCH},
+    {"cleanup-depth", required_argument, NULL,            OPT_NAME_CLEANUP_DEPTH},
+    {"lost-retries",  required_argument, NULL,            OPT_NAME_LOST_RETRIES},
+    {"cpu-set",       required_argument, NULL,            OPT_NAME_CPU_SET},
+    {"pin-slaves",    required_argument, NULL,            OPT_NAME_PIN_SLAVES},
 
     {"separate-cleanup-threads",    no_argument, &opt_separate_cleanup_thread, true},
     {"no-separate-cleanup-threads", no_argument, &opt_separate_cleanup_thread, false},
@@ -85,6 +114,15 @@ static const struct option longopts[] = {
     {"verbose",    no_argument, &opt_verbose, true},
     {"no-verbose", no_argument, &opt_verbose, false},
 
+    {"check-leaks",    no_argument, &opt_check_leaks, true},
+    {"no-check-leaks", no_argument, &opt_check_leaks, false},
+
+    {"suballoc",    no_argument, &opt_suballoc, true},
+    {"no-suballoc", no_argument, &opt_suballoc, false},
+
+    {"minimal-device",    no_argument, &opt_minimal_device, true},
+    {"no-minimal-device", no_argument, &opt_minimal_device, false},
+
     {0},
 };
 
@@ -155,12 +193,71 @@ parse_args(const cru_command_t *cmd, int argc, char **argv)
         case OPT_NAME_JUNIT_XML:
             opt_junit_xml = strdup(optarg);
             break;
+        case OPT_NAME_TRACE:
+            opt_trace = strdup(optarg);
+            break;
+        case OPT_NAME_SHARD:
+            if (!cru_parse_shard(optarg, &opt_shard_index, &opt_shard_count)) {
+                cru_usage_error(cmd, "invalid value '%s' for --shard, "
+                                "expected K/N with 1 <= K <= N", optarg);
+            }
+            break;
+        case OPT_NAME_SHARD_DURATIONS:
+            opt_shard_durations = strdup(optarg);
+            break;
         case OPT_NAME_DEVICE_ID:
             opt_device_id = strtol(optarg, NULL, 10);
             if (opt_device_id <= 0) {
                 cru_usage_error(cmd, "--device must be at least 1");
             }
             break;
+        case OPT_NAME_DISPATCH:
+            if (cru_streq(optarg, "loader")) {
+                opt_direct_dispatch = false;
+            } else if (cru_streq(optarg, "direct")) {
+                opt_direct_dispatch = true;
+            } else {
+                cru_usage_error(cmd, "invalid value '%s' for --dispatch",
+                                optarg);
+            }
+            break;
+        case OPT_NAME_CLEANUP_DEPTH:
+            if (!parse_i32(optarg, &opt_cleanup_depth)) {
+                cru_usage_error(cmd, "invalid value for --cleanup-depth");
+            }
+            if (opt_cleanup_depth < 0 || opt_cleanup_depth > 64) {
+                cru_usage_error(cmd, "--cleanup-depth must be between 0 "
+                                "and 64");
+            }
+            break;
+        case OPT_NAME_LOST_RETRIES:
+            if (!parse_i32(optarg, &opt_lost_retries)) {
+                cru_usage_error(cmd, "invalid value for --lost-retries");
+            }
+            if (opt_lost_retries < 0) {
+                cru_usage_error(cmd, "--lost-retries must not be negative");
+            }
+            break;
+        case OPT_NAME_CPU_SET:
+            if (!runner_parse_cpu_list(optarg, &opt_cpu_set) ||
+                CPU_COUNT(&opt_cpu_set) == 0) {
+                cru_usage_error(cmd, "invalid value '%s' for --cpu-set",
+                                optarg);
+            }
+            opt_has_cpu_set = true;
+            break;
+        case OPT_NAME_PIN_SLAVES:
+            if (cru_streq(optarg, "none")) {
+                opt_pin_slaves = RUNNER_PIN_MODE_NONE;
+            } else if (cru_streq(optarg, "compact")) {
+                opt_pin_slaves = RUNNER_PIN_MODE_COMPACT;
+            } else if (cru_streq(optarg, "scatter")) {
+                opt_pin_slaves = RUNNER_PIN_MODE_SCATTER;
+            } else {
+                cru_usage_error(cmd, "invalid value '%s' for --pin-slaves",
+                                optarg);
+            }
+            break;
         case ':':
             cru_usage_error(cmd, "%s requires an argument", argv[optind-1]);
             break;
@@ -182,6 +279,17 @@ done_getopt:
 
         *cru_vec_push(&test_patterns, 1) = arg;
     }
+
+    if (opt_check_leaks && opt_no_cleanup) {
+        cru_usage_error(cmd, "--check-leaks and --no-cleanup are mutually "
+                        "exclusive");
+    }
+
+    if (opt_cleanup_depth > 0 && opt_isolation != RUNNER_ISOLATION_MODE_THREAD)
+        cru_usage_error(cmd, "--cleanup-depth requires --isolation=thread");
+
+    if (opt_shard_durations && opt_shard_count == 0)
+        cru_usage_error(cmd, "--shard-durations requires --shard");
 }
 
 // Do the command line args specify exactly one test?
@@ -272,10 +380,22 @@ cmd_start(const cru_command_t *cmd, int argc, char **argv)
         .no_fork = !get_fork_mode(),
         .no_cleanup_phase = opt_no_cleanup,
         .use_separate_cleanup_threads = opt_separate_cleanup_thread,
+        .cleanup_depth = opt_cleanup_depth,
+        .lost_retries = opt_lost_retries,
+        .cpu_set = opt_has_cpu_set ? &opt_cpu_set : NULL,
+        .pin_slaves = opt_pin_slaves,
         .no_image_dumps = !opt_dump,
         .junit_xml_filepath = opt_junit_xml,
+        .trace_filepath = opt_trace,
         .device_id = opt_device_id,
         .verbose = opt_verbose,
+        .check_leaks = opt_check_leaks,
+        .no_suballoc = !opt_suballoc,
+        .no_minimal_device = !opt_minimal_device,
+        .direct_dispatch = opt_direct_dispatch,
+        .shard_index = opt_shard_index,
+        .shard_count = opt_shard_count,
+        .shard_durations_filepath = opt_shard_durations,
     });
 
     if (opt_log_pids)
@@ -286,7 +406,8 @@ cmd_start(const cru_command_t *cmd, int argc, char **argv)
         exit(EXIT_FAILURE);
     }
 
-    runner_enable_matching_tests(&test_patterns);
+    if (!runner_enable_matching_tests(&test_patterns))
+        exit(EXIT_FAILURE);
 
     if (runner_run_tests()) {
         exit(EXIT_SUCCESS);
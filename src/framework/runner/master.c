@@ -42,10 +42,14 @@
 #include "framework/test/test.h"
 #include "framework/test/test_def.h"
 
+#include "util/cru_vec.h"
 #include "util/log.h"
 #include "util/string.h"
+#include "util/trace.h"
 
 #include "runner.h"
+#include "runner_affinity.h"
+#include "runner_shard.h"
 #include "runner_vk.h"
 #include "master.h"
 #include "slave.h"
@@ -67,6 +71,21 @@ struct slave_pipe {
     slave_t *slave;
 };
 
+/// \brief A (test, queue family) pair owned by a slave or awaiting requeue.
+typedef struct slave_test {
+    const test_def_t *def;
+    uint32_t queue_family_index;
+
+    /// Set when the slave reports, before running the test, that it has
+    /// started it.
+    bool started;
+
+    /// Number of times the test was lost and run again.
+    uint32_t retries;
+} slave_test_t;
+
+CRU_VEC_DEFINE(struct slave_test_vec, slave_test_t)
+
 /// \brief A slave process's proxy in the master process.
 ///
 /// The struct is valid if and only if slave::pid != 0.
@@ -79,7 +98,7 @@ struct slave {
 
     struct {
         uint32_t len;
-        const test_def_t *data[256];
+        slave_test_t data[256];
     } tests;
 
     slave_pipe_t dispatch_pipe;
@@ -96,6 +115,9 @@ struct slave {
 
     bool recvd_sentinel;
     bool is_dead;
+
+    /// The master killed the slave on SIGINT.
+    bool killed;
 };
 
 static struct master {
@@ -111,6 +133,7 @@ static struct master {
     /// Maximum allowed count of currently dispatched tests.
     uint32_t max_dispatched_tests;
 
+    /// Count of (test, queue family) pairs in the runner's shard.
     uint32_t num_tests;
     uint32_t num_pass;
     uint32_t num_fail;
@@ -120,8 +143,16 @@ static struct master {
     uint32_t num_slaves;
     slave_t slaves[64];
 
+    /// Tests that a dead slave owned but had not started, and lost tests
+    /// with retries left. They are dispatched again to new slaves.
+    struct slave_test_vec requeued;
+
     uint32_t num_vulkan_queues;
 
+    /// Capabilities of the device that tests run on. Tests whose
+    /// requirements these do not meet are skipped without being dispatched.
+    runner_vk_caps_t vk_caps;
+
     struct {
         char *filepath;
         FILE *file;
@@ -132,11 +163,14 @@ static struct master {
 } master = {
     .epoll_fd = -1,
     .signal_fd = -1,
+    .requeued = CRU_VEC_INIT,
 };
 
 static uint32_t master_get_num_ran_tests(void);
 static void master_print_header(void);
 static void master_gather_vulkan_info(void);
+static bool master_check_test_caps(const test_def_t *def,
+                                   uint32_t queue_family_index);
 static void master_enter_dispatch_phase(void);
 static void master_enter_cleanup_phase(void);
 static void master_print_summary(void);
@@ -144,8 +178,8 @@ static void master_print_summary(void);
 static void master_dispatch_loop_no_fork(void);
 static void master_dispatch_loop_with_fork(void);
 
-static void master_dispatch_test(const test_def_t *def,
-                                 uint32_t queue_family_index);
+static void master_dispatch_test(const slave_test_t *test);
+static void master_dispatch_requeued_tests(void);
 static slave_t * master_get_open_slave(void);
 static slave_t * master_get_new_slave(void);
 static slave_t * master_find_unborn_slave(void);
@@ -154,7 +188,8 @@ static void master_cleanup_dead_slave(slave_t *slave);
 static void master_collect_result(int timeout_ms);
 
 static void master_report_result(const test_def_t *def, uint32_t queue_family_index,
-                                 pid_t pid, test_result_t result);
+                                 pid_t pid, test_result_t result,
+                                 uint64_t duration_ns);
 static bool master_send_packet(slave_t *slave, const dispatch_packet_t *pk);
 
 static void master_kill_all_slaves(void);
@@ -171,12 +206,13 @@ static void master_handle_sigint(int sig);
 static void master_yield_to_sigint(void);
 
 static bool slave_is_open(const slave_t *slave);
-static int32_t slave_find_test(slave_t *slave, const test_def_t *def);
-static bool slave_insert_test(slave_t *slave, const test_def_t *def);
-static void slave_rm_test(slave_t *slave, const test_def_t *def);
+static int32_t slave_find_test(slave_t *slave, const test_def_t *def,
+                               uint32_t queue_family_index);
+static bool slave_insert_test(slave_t *slave, const slave_test_t *test);
+static void slave_rm_test(slave_t *slave, const test_def_t *def,
+                          uint32_t queue_family_index);
 
-static bool slave_start_test(slave_t *slave, const test_def_t *def,
-                             uint32_t queue_family_index);
+static bool slave_start_test(slave_t *slave, const slave_test_t *test);
 static void slave_send_sentinel(slave_t *slave);
 static void slave_drain_result_pipe(slave_t *slave);
 
@@ -260,7 +296,7 @@ junit_init(void)
 }
 
 static void
-junit_add_result(const char *name, test_result_t result)
+junit_add_result(const char *name, test_result_t result, uint64_t duration_ns)
 {
     if (!master.junit.doc)
         return;
@@ -277,6 +313,14 @@ junit_add_result(const char *name, test_result_t result)
     xmlNewProp(testcase_node, u("status"), u(test_result_to_string(result)));
     xmlNewProp(testcase_node, u("name"), u(name));
 
+    // The time lets `crucible run --shard-durations` balance later runs.
+    if (duration_ns > 0) {
+        string_t time = STRING_INIT;
+        string_printf(&time, "%.3f", duration_ns / 1e9);
+        xmlNewProp(testcase_node, u("time"), u(string_data(&time)));
+        string_finish(&time);
+    }
+
     switch (result) {
     case TEST_RESULT_PASS:
         break;
@@ -357,18 +401,44 @@ junit_finish(void)
 }
 
 bool
-master_run(uint32_t num_tests)
+master_run(void)
 {
-    master.num_tests = num_tests;
     master.max_dispatched_tests = CLAMP(runner_opts.jobs,
                                         1, ARRAY_LENGTH(master.slaves));
 
+    // A thread-isolated slave also owns the tests still in cleanup, so let
+    // the next tests wait in its dispatch pipe.
+    if (runner_opts.isolation_mode == RUNNER_ISOLATION_MODE_THREAD)
+        master.max_dispatched_tests += runner_opts.cleanup_depth;
+
     master_gather_vulkan_info();
     if (master.goto_next_phase)
         return false;
 
-    if (!junit_init())
+    if (!runner_shard_init(master.num_vulkan_queues, &master.num_tests)) {
+        runner_vk_caps_finish(&master.vk_caps);
         return false;
+    }
+
+    // A process-isolated slave runs one test, so each of the concurrent
+    // tests gets its own slot. A thread-isolated slave runs them all.
+    if (!runner_affinity_init(
+            runner_opts.isolation_mode == RUNNER_ISOLATION_MODE_PROCESS
+            ? master.max_dispatched_tests : 1)) {
+        runner_shard_finish();
+        runner_vk_caps_finish(&master.vk_caps);
+        return false;
+    }
+
+    if (!junit_init()) {
+        runner_affinity_finish();
+        runner_shard_finish();
+        runner_vk_caps_finish(&master.vk_caps);
+        return false;
+    }
+
+    if (runner_opts.trace_filepath)
+        trace_init(runner_opts.trace_filepath);
 
     master_init_epoll();
     set_sigint_handler(master_handle_sigint);
@@ -380,8 +450,16 @@ master_run(uint32_t num_tests)
 
     set_sigint_handler(SIG_DFL);
     master_finish_epoll();
+    cru_vec_finish(&master.requeued);
+
+    // All slaves have exited, so their trace files are complete.
+    bool trace_ok = trace_finish();
+
+    runner_affinity_finish();
+    runner_shard_finish();
+    runner_vk_caps_finish(&master.vk_caps);
 
-    if (!junit_finish())
+    if (!junit_finish() || !trace_ok)
         return false;
 
     return master.num_pass + master.num_skip == master.num_tests;
@@ -418,14 +496,21 @@ master_print_summary(void)
     logi("lost %u", master.num_lost);
 }
 
+/// Probe the device's capabilities. To keep the driver out of the master
+/// process, the probe runs in a child process, which sends the result
+/// through a pipe.
 static void
 master_gather_vulkan_info(void)
 {
-    uint32_t num_vulkan_queues;
+    FILE *f = NULL;
 
     if (runner_opts.no_fork) {
-        if (!runner_get_vulkan_queue_count(&master.num_vulkan_queues))
+        if (!runner_vk_probe_caps(runner_opts.device_id, &master.vk_caps)) {
+            loge("test runner failed to gather vulkan info");
             master.goto_next_phase = true;
+            return;
+        }
+        master.num_vulkan_queues = master.vk_caps.queue_flags.len;
         return;
     }
     slave_pipe_t pipe;
@@ -439,37 +524,51 @@ master_gather_vulkan_info(void)
 
     if (pid == 0) {
         // Send any child process (driver) output to /dev/null while
-        // reading the number of queues.
+        // probing the device.
         int devnull = open("/dev/null", O_WRONLY);
         dup2(devnull, 1);
         dup2(devnull, 2);
 
-        // Read the number of queues and send it through the pipe
+        // Probe the device and send its capabilities through the pipe.
+        runner_vk_caps_t caps;
         slave_pipe_become_writer(&pipe);
-        if (!runner_get_vulkan_queue_count(&num_vulkan_queues)) {
+        if (!runner_vk_probe_caps(runner_opts.device_id, &caps))
             exit(EXIT_FAILURE);
-        } else {
-            if (write(pipe.write_fd, &num_vulkan_queues,
-                      sizeof(num_vulkan_queues)) != sizeof(num_vulkan_queues))
-                exit(EXIT_FAILURE);
-        }
+
+        f = fdopen(pipe.write_fd, "w");
+        if (!f || !runner_vk_caps_write(&caps, f) || fclose(f) != 0)
+            exit(EXIT_FAILURE);
+
         exit(EXIT_SUCCESS);
     } else {
-        // Read the number of queues from the pipe
+        // Read the capabilities from the pipe until the child closes it.
         slave_pipe_become_reader(&pipe);
-        if (read(pipe.read_fd, &num_vulkan_queues,
-                 sizeof(num_vulkan_queues)) != sizeof(num_vulkan_queues))
+        f = fdopen(pipe.read_fd, "r");
+        if (!f)
             goto fail;
+
+        // The stream now owns the fd.
+        pipe.read_fd = -1;
+
+        bool ok = runner_vk_caps_read(&master.vk_caps, f,
+                                      "vulkan info pipe");
+        fclose(f);
+        if (!ok) {
+            waitpid(pid, NULL, 0);
+            goto fail;
+        }
     }
 
     int result;
     waitpid(pid, &result, 0);
     result = WIFEXITED(result) ? WEXITSTATUS(result) : EXIT_FAILURE;
-    if (result != 0)
+    if (result != 0) {
+        runner_vk_caps_finish(&master.vk_caps);
         goto fail;
+    }
 
     slave_pipe_finish(&pipe);
-    master.num_vulkan_queues = num_vulkan_queues;
+    master.num_vulkan_queues = master.vk_caps.queue_flags.len;
     return;
 
  fail:
@@ -478,10 +577,33 @@ master_gather_vulkan_info(void)
     master.goto_next_phase = true;
 }
 
+/// Return false if the device lacks something that the test declares it
+/// requires. The test would skip itself; skip it without dispatching it.
+static bool
+master_check_test_caps(const test_def_t *def, uint32_t queue_family_index)
+{
+    test_caps_t caps;
+    string_t reason = STRING_INIT;
+    bool result;
+
+    runner_vk_caps_get_test_caps(&master.vk_caps, queue_family_index, &caps);
+
+    result = test_def_check_caps(def, &caps, &reason);
+    if (!result) {
+        logi("%s.q%u: %s", def->name, queue_family_index,
+             string_data(&reason));
+    }
+
+    string_finish(&reason);
+    return result;
+}
+
 static void
 master_enter_dispatch_phase(void)
 {
     if (runner_opts.no_fork) {
+        // The master runs the tests itself.
+        runner_affinity_apply(0);
         master_dispatch_loop_no_fork();
     } else {
         master_dispatch_loop_with_fork();
@@ -496,17 +618,25 @@ master_enter_cleanup_phase(void)
     if (runner_opts.no_fork)
         return;
 
-    // Tell each slave that it will receive no more tests.
-    master_for_each_slave_slot(slave) {
-        if (!slave->pid)
-            continue;
-
-        slave_send_sentinel(slave);
+    for (;;) {
+        // A slave that dies now may leave tests to run on a new slave.
+        master_dispatch_requeued_tests();
         if (master.goto_next_phase)
             return;
-    }
 
-    while (master.num_slaves > 0) {
+        // Tell each slave that it will receive no more tests.
+        master_for_each_slave_slot(slave) {
+            if (!slave->pid)
+                continue;
+
+            slave_send_sentinel(slave);
+            if (master.goto_next_phase)
+                return;
+        }
+
+        if (master.num_slaves == 0 && master.requeued.len == 0)
+            return;
+
         master_collect_result(-1);
         if (master.goto_next_phase)
             return;
@@ -521,34 +651,35 @@ master_dispatch_loop_no_fork(void)
 
     cru_foreach_test_def(def) {
         uint32_t queue_start, queue_end;
-        if (def->priv.queue_family_index == NO_QUEUE_FAMILY_INDEX_PREF) {
-            queue_start = 0;
-            queue_end = master.num_vulkan_queues;
-        } else {
-            queue_start = def->priv.queue_family_index;
-            queue_end = def->priv.queue_family_index + 1;
-        }
+        runner_get_queue_range(def, master.num_vulkan_queues,
+                               &queue_start, &queue_end);
 
         for (uint32_t qi = queue_start; qi < queue_end; qi++) {
             test_result_t result;
+            uint64_t start_ns;
 
             if (!def->priv.enable)
                 continue;
 
+            if (!runner_shard_contains(def, qi))
+                continue;
+
             if (qi >= master.num_vulkan_queues) {
                 logi("queue-family-index %d does not exist", qi);
-                master_report_result(def, qi, 0, TEST_RESULT_SKIP);
+                master_report_result(def, qi, 0, TEST_RESULT_SKIP, 0);
                 continue;
             }
 
-            if (def->skip) {
-                master_report_result(def, qi, 0, TEST_RESULT_SKIP);
+            if (def->skip || !master_check_test_caps(def, qi)) {
+                master_report_result(def, qi, 0, TEST_RESULT_SKIP, 0);
                 continue;
             }
 
             log_tag("start", 0, "%s.q%d", def->name, qi);
+            start_ns = runner_get_time_ns();
             result = run_test_def(def, qi);
-            master_report_result(def, qi, 0, result);
+            master_report_result(def, qi, 0, result,
+                                 runner_get_time_ns() - start_ns);
         }
     }
 }
@@ -561,43 +692,67 @@ master_dispatch_loop_with_fork(void)
 
     cru_foreach_test_def(def) {
         uint32_t queue_start, queue_end;
-        if (def->priv.queue_family_index == NO_QUEUE_FAMILY_INDEX_PREF) {
-            queue_start = 0;
-            queue_end = master.num_vulkan_queues;
-        } else {
-            queue_start = def->priv.queue_family_index;
-            queue_end = def->priv.queue_family_index + 1;
-        }
+        runner_get_queue_range(def, master.num_vulkan_queues,
+                               &queue_start, &queue_end);
 
         for (uint32_t qi = queue_start; qi < queue_end; qi++) {
             if (!def->priv.enable)
                 continue;
 
+            if (!runner_shard_contains(def, qi))
+                continue;
+
             if (qi >= master.num_vulkan_queues) {
                 logi("queue-family-index %d does not exist", qi);
-                master_report_result(def, qi, 0, TEST_RESULT_SKIP);
+                master_report_result(def, qi, 0, TEST_RESULT_SKIP, 0);
                 continue;
             }
 
-            if (def->skip) {
-                master_report_result(def, qi, 0, TEST_RESULT_SKIP);
+            if (def->skip || !master_check_test_caps(def, qi)) {
+                master_report_result(def, qi, 0, TEST_RESULT_SKIP, 0);
                 continue;
             }
 
-            master_dispatch_test(def, qi);
+            master_dispatch_test(&(slave_test_t) {
+                .def = def,
+                .queue_family_index = qi,
+            });
             if (master.goto_next_phase)
                 return;
 
             master_collect_result(0);
             if (master.goto_next_phase)
                 return;
+
+            master_dispatch_requeued_tests();
+            if (master.goto_next_phase)
+                return;
         }
     }
 }
 
+/// Dispatch the tests that dead slaves left behind.
+static void
+master_dispatch_requeued_tests(void)
+{
+    while (master.requeued.len > 0) {
+        // Dispatching may requeue more tests, so take this one first.
+        slave_test_t test = master.requeued.data[0];
+
+        --master.requeued.len;
+        memmove(master.requeued.data, master.requeued.data + 1,
+                master.requeued.len * sizeof(master.requeued.data[0]));
+
+        master_dispatch_test(&test);
+        if (master.goto_next_phase)
+            return;
+    }
+}
+
 static void
-master_dispatch_test(const test_def_t *def, uint32_t queue_family_index)
+master_dispatch_test(const slave_test_t *test)
 {
+    const uint64_t trace_ns = trace_start();
     slave_t *slave = NULL;
 
     assert(master.cur_dispatched_tests <= master.max_dispatched_tests);
@@ -622,7 +777,8 @@ master_dispatch_test(const test_def_t *def, uint32_t queue_family_index)
             return;
     }
 
-    slave_start_test(slave, def, queue_family_index);
+    slave_start_test(slave, test);
+    trace_span("dispatch", test->def->name, trace_ns);
 }
 
 static slave_t *
@@ -712,6 +868,8 @@ master_get_new_slave(void)
         set_sigint_handler(SIG_DFL);
         master_finish_epoll();
 
+        runner_affinity_apply(slave - master.slaves);
+
         if (!slave_pipe_become_reader(&slave->dispatch_pipe))
             exit(EXIT_FAILURE);
         if (!slave_pipe_become_writer(&slave->result_pipe))
@@ -722,6 +880,8 @@ master_get_new_slave(void)
         exit(EXIT_SUCCESS);
     }
 
+    trace_add_child(slave->pid);
+
     if (!slave_pipe_become_writer(&slave->dispatch_pipe))
         goto fail;
     if (!slave_pipe_become_reader(&slave->result_pipe))
@@ -770,10 +930,46 @@ master_cleanup_dead_slave(slave_t *slave)
     slave_pipe_drain_to_fd(&slave->stdout_pipe, STDOUT_FILENO);
     slave_pipe_drain_to_fd(&slave->stderr_pipe, STDERR_FILENO);
 
-    // Any remaining tests owned by the slave are lost.
+    // If the slave reported no test as started, then no test can be blamed
+    // for its death. Treat them all as started, so that a slave that dies
+    // before running anything does not requeue its tests forever.
+    bool any_started = false;
+    for (uint32_t i = 0; i < slave->tests.len; ++i)
+        any_started |= slave->tests.data[i].started;
+
     for (uint32_t i = 0; i < slave->tests.len; ++i) {
-        const test_def_t *def = slave->tests.data[i];
-        master_report_result(def, 0, slave->pid, TEST_RESULT_LOST);
+        slave_test_t *test = &slave->tests.data[i];
+        bool started = test->started || !any_started;
+        string_t name = STRING_INIT;
+
+        string_printf(&name, "%s.q%d", test->def->name,
+                      test->queue_family_index);
+
+        if (slave->killed || master.goto_next_phase) {
+            // The user interrupted the test. Don't run it again.
+            master_report_result(test->def, test->queue_family_index,
+                                 slave->pid, TEST_RESULT_LOST, 0);
+        } else if (!started) {
+            // The test never ran, so it is innocent of the slave's death.
+            log_tag("requeue", slave->pid, "%s", string_data(&name));
+            *cru_vec_push(&master.requeued, 1) = (slave_test_t) {
+                .def = test->def,
+                .queue_family_index = test->queue_family_index,
+                .retries = test->retries,
+            };
+        } else if (test->retries < runner_opts.lost_retries) {
+            log_tag("retry", slave->pid, "%s", string_data(&name));
+            *cru_vec_push(&master.requeued, 1) = (slave_test_t) {
+                .def = test->def,
+                .queue_family_index = test->queue_family_index,
+                .retries = test->retries + 1,
+            };
+        } else {
+            master_report_result(test->def, test->queue_family_index,
+                                 slave->pid, TEST_RESULT_LOST, 0);
+        }
+
+        string_finish(&name);
     }
 
     assert(master.cur_dispatched_tests >= slave->tests.len);
@@ -823,12 +1019,15 @@ master_collect_result(int timeout_ms)
     if (epoll_wait(master.epoll_fd, &event, 1, timeout_ms) <= 0)
         return;
 
+    // Trace only the handling of the event, not the wait for it.
+    const uint64_t trace_ns = trace_start();
     master_handle_epoll_event(&event);
+    trace_span("collect", NULL, trace_ns);
 }
 
 static void
 master_report_result(const test_def_t *def, uint32_t queue_family_index,
-                     pid_t pid, test_result_t result)
+                     pid_t pid, test_result_t result, uint64_t duration_ns)
 {
     string_t name = STRING_INIT;
     string_printf(&name, "%s.q%d", def->name, queue_family_index);
@@ -842,7 +1041,7 @@ master_report_result(const test_def_t *def, uint32_t queue_family_index,
     case TEST_RESULT_LOST: master.num_lost++; break;
     }
 
-    junit_add_result(string_data(&name), result);
+    junit_add_result(string_data(&name), result, duration_ns);
     string_finish(&name);
 }
 
@@ -894,6 +1093,8 @@ master_kill_all_slaves(void)
             loge("runner failed to kill child process %d", slave->pid);
             abort();
         }
+
+        slave->killed = true;
     }
 }
 
@@ -1032,6 +1233,7 @@ master_handle_signal_event(const struct epoll_event *event)
 static void
 master_handle_sigchld(void)
 {
+    const uint64_t trace_ns = trace_start();
     pid_t pid;
 
     while ((pid = waitpid(-1, /*status*/ NULL, WNOHANG)) > 0) {
@@ -1047,6 +1249,8 @@ master_handle_sigchld(void)
         slave->is_dead = true;
         master_cleanup_dead_slave(slave);
     }
+
+    trace_span("sigchld", NULL, trace_ns);
 }
 
 static void
@@ -1087,6 +1291,9 @@ slave_is_open(const slave_t *slave)
     if (slave->is_dead)
         return false;
 
+    if (slave->recvd_sentinel || slave->killed)
+        return false;
+
     switch (runner_opts.isolation_mode) {
     case RUNNER_ISOLATION_MODE_PROCESS:
         // The master sends each slave exactly one test.
@@ -1099,10 +1306,12 @@ slave_is_open(const slave_t *slave)
 }
 
 static int32_t
-slave_find_test(slave_t *slave, const test_def_t *def)
+slave_find_test(slave_t *slave, const test_def_t *def,
+                uint32_t queue_family_index)
 {
     for (uint32_t i = 0; i < slave->tests.len; ++i) {
-        if (slave->tests.data[i] == def) {
+        if (slave->tests.data[i].def == def &&
+            slave->tests.data[i].queue_family_index == queue_family_index) {
             return i;
         }
     }
@@ -1111,7 +1320,7 @@ slave_find_test(slave_t *slave, const test_def_t *def)
 }
 
 static bool
-slave_insert_test(slave_t *slave, const test_def_t *def)
+slave_insert_test(slave_t *slave, const slave_test_t *test)
 {
     if (slave->is_dead)
         return false;
@@ -1119,18 +1328,19 @@ slave_insert_test(slave_t *slave, const test_def_t *def)
     if (slave->tests.len >= ARRAY_LENGTH(slave->tests.data))
         return false;
 
-    slave->tests.data[slave->tests.len++] = def;
+    slave->tests.data[slave->tests.len++] = *test;
     ++master.cur_dispatched_tests;
 
     return true;
 }
 
 static void
-slave_rm_test(slave_t *slave, const test_def_t *def)
+slave_rm_test(slave_t *slave, const test_def_t *def,
+              uint32_t queue_family_index)
 {
     int32_t i;
 
-    i = slave_find_test(slave, def);
+    i = slave_find_test(slave, def, queue_family_index);
     if (i < 0) {
         loge("slave cannot remove test it doesn't own");
         return;
@@ -1143,16 +1353,16 @@ slave_rm_test(slave_t *slave, const test_def_t *def)
     --master.cur_dispatched_tests;
 
     memmove(slave->tests.data + i, slave->tests.data + i + 1,
-            slave->tests.len);
+            (slave->tests.len - i) * sizeof(slave->tests.data[0]));
 }
 
 static bool
-slave_start_test(slave_t *slave, const test_def_t *def,
-                 uint32_t queue_family_index)
+slave_start_test(slave_t *slave, const slave_test_t *test)
 {
+    const test_def_t *def = test->def;
     const dispatch_packet_t pk = {
         .test_def = def,
-        .queue_family_index = queue_family_index,
+        .queue_family_index = test->queue_family_index,
     };
 
     if (!def)
@@ -1164,13 +1374,14 @@ slave_start_test(slave_t *slave, const test_def_t *def,
     if (master.cur_dispatched_tests >= master.max_dispatched_tests)
         return false;
 
-    if (!slave_insert_test(slave, def))
+    if (!slave_insert_test(slave, test))
         return false;
 
-    log_tag("start", slave->pid, "%s.q%d", def->name, 0);
+    log_tag("start", slave->pid, "%s.q%d", def->name,
+            test->queue_family_index);
 
     if (!master_send_packet(slave, &pk)) {
-        slave_rm_test(slave, def);
+        slave_rm_test(slave, def, test->queue_family_index);
         return false;
     }
 
@@ -1216,9 +1427,17 @@ slave_drain_result_pipe(slave_t *slave)
         if (read(slave->result_pipe.read_fd, &pk, sizeof(pk)) != sizeof(pk))
             return;
 
-        slave_rm_test(slave, pk.test_def);
+        if (pk.started) {
+            int32_t i = slave_find_test(slave, pk.test_def,
+                                        pk.queue_family_index);
+            if (i >= 0)
+                slave->tests.data[i].started = true;
+            continue;
+        }
+
+        slave_rm_test(slave, pk.test_def, pk.queue_family_index);
         master_report_result(pk.test_def, pk.queue_family_index, slave->pid,
-                             pk.result);
+                             pk.result, pk.duration_ns);
     }
 }
 
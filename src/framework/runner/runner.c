@@ -27,14 +27,15 @@
 /// test results and prints their summary. The separation ensures that test
 /// results and summary are printed even when a test crashes its process.
 
+#include <ctype.h>
 #include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-
-#include <regex.h>
+#include <time.h>
 
 #include "util/log.h"
+#include "util/xalloc.h"
 
 #include "framework/runner/runner.h"
 #include "framework/test/test.h"
@@ -42,8 +43,10 @@
 
 #include "master.h"
 #include "runner.h"
+#include "runner_glob.h"
+#include "runner_shard.h"
+#include "runner_vk.h"
 
-static uint32_t runner_num_tests;
 static bool runner_is_init = false;
 runner_opts_t runner_opts = {0};
 
@@ -79,19 +82,31 @@ runner_init(runner_opts_t *opts)
         return false;
     }
 
+    if (opts->cleanup_depth > 0
+        && opts->isolation_mode != RUNNER_ISOLATION_MODE_THREAD) {
+        loge("overlapping cleanup requires RUNNER_ISOLATION_MODE_THREAD");
+        return false;
+    }
+
+    if (opts->shard_count > 1 && opts->shard_index >= opts->shard_count) {
+        loge("shard index %u is out of range for %u shards",
+             opts->shard_index, opts->shard_count);
+        return false;
+    }
+
     runner_opts = *opts;
     runner_is_init = true;
 
     return true;
 }
 
-test_result_t
-run_test_def(const test_def_t *def, uint32_t queue_family_index)
+/// Create and start the test. Return NULL on failure.
+test_t *
+start_test_def(const test_def_t *def, uint32_t queue_family_index)
 {
     ASSERT_RUNNER_IS_INIT;
 
     test_t *test;
-    test_result_t result;
 
     assert(def->priv.enable);
 
@@ -102,25 +117,121 @@ run_test_def(const test_def_t *def, uint32_t queue_family_index)
                             runner_opts.use_separate_cleanup_threads,
                        .device_id = runner_opts.device_id,
                        .queue_family_index = queue_family_index,
-                       .verbose = runner_opts.verbose);
+                       .verbose = runner_opts.verbose,
+                       .enable_leak_check = runner_opts.check_leaks,
+                       .enable_suballoc = !runner_opts.no_suballoc,
+                       .enable_direct_dispatch = runner_opts.direct_dispatch,
+                       .enable_minimal_device =
+                            !runner_opts.no_minimal_device);
     if (!test)
-        return TEST_RESULT_FAIL;
+        return NULL;
 
     test_start(test);
+
+    return test;
+}
+
+/// Wait for a test from start_test_def() to stop, then destroy it. If
+/// \a stop_ns is not NULL, return in it the time at which the test stopped.
+test_result_t
+finish_test_def(test_t *test, uint64_t *stop_ns)
+{
+    test_result_t result;
+
     test_wait(test);
     result = test_get_result(test);
+    if (stop_ns)
+        *stop_ns = test_get_stop_time_ns(test);
     test_destroy(test);
 
     return result;
 }
 
+test_result_t
+run_test_def(const test_def_t *def, uint32_t queue_family_index)
+{
+    test_t *test = start_test_def(def, queue_family_index);
+
+    if (!test)
+        return TEST_RESULT_FAIL;
+
+    return finish_test_def(test, NULL);
+}
+
+/// Return the queue families on which the runner runs the test, as the
+/// half-open range [queue_start, queue_end). If the user requested a queue
+/// family, the range may lie beyond \a num_queues.
+void
+runner_get_queue_range(const test_def_t *def, uint32_t num_queues,
+                       uint32_t *queue_start, uint32_t *queue_end)
+{
+    if (def->priv.queue_family_index == NO_QUEUE_FAMILY_INDEX_PREF) {
+        *queue_start = 0;
+        *queue_end = num_queues;
+    } else {
+        *queue_start = def->priv.queue_family_index;
+        *queue_end = def->priv.queue_family_index + 1;
+    }
+}
+
+uint64_t
+runner_get_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /// Return true if and only all tests pass or skip.
 bool
 runner_run_tests(void)
 {
     ASSERT_RUNNER_IS_INIT;
 
-    return master_run(runner_num_tests);
+    return master_run();
+}
+
+/// Print the name of each enabled (test, queue family) pair in the runner's
+/// shard, in the order that the runner would dispatch them.
+bool
+runner_list_tests(void)
+{
+    ASSERT_RUNNER_IS_INIT;
+
+    const test_def_t *def;
+    runner_vk_caps_t caps;
+    uint32_t num_queues;
+    uint32_t num_pairs;
+
+    if (!runner_vk_probe_caps(runner_opts.device_id, &caps)) {
+        loge("failed to query the vulkan queue family count");
+        return false;
+    }
+
+    num_queues = caps.queue_flags.len;
+    runner_vk_caps_finish(&caps);
+
+    if (!runner_shard_init(num_queues, &num_pairs))
+        return false;
+
+    cru_foreach_test_def(def) {
+        uint32_t queue_start, queue_end;
+
+        if (!def->priv.enable)
+            continue;
+
+        runner_get_queue_range(def, num_queues, &queue_start, &queue_end);
+
+        for (uint32_t qi = queue_start; qi < queue_end; ++qi) {
+            if (runner_shard_contains(def, qi))
+                printf("%s.q%u\n", def->name, qi);
+        }
+    }
+
+    runner_shard_finish();
+
+    return true;
 }
 
 static bool
@@ -166,17 +277,98 @@ parse_u32(const char *str, uint32_t *u32)
     return true;
 }
 
-void
+/// If the glob ends with a queue family suffix, such as ".q1", return the
+/// suffix's offset. Otherwise return -1.
+static ssize_t
+find_queue_family_suffix(const char *glob)
+{
+    const char *dot = strrchr(glob, '.');
+
+    if (!dot || dot[1] != 'q' || dot[2] == '\0')
+        return -1;
+
+    for (const char *c = dot + 2; *c; ++c) {
+        if (*c < '0' || *c > '9')
+            return -1;
+    }
+
+    return dot - glob;
+}
+
+static void
+push_split_glob(split_glob_vec_t *split_globs, char *glob, bool free_string)
+{
+    split_glob_t *split_glob = cru_vec_push(split_globs, 1);
+    ssize_t suffix = find_queue_family_suffix(glob);
+
+    if (suffix >= 0) {
+        if (!free_string)
+            glob = strdup(glob);
+
+        glob[suffix] = '\0';
+        split_glob->glob = glob;
+        split_glob->free_string = true;
+
+        uint32_t queue_family_index;
+        if (parse_u32(&glob[suffix + 2], &queue_family_index)) {
+            split_glob->queue_family_index = queue_family_index;
+        } else {
+            split_glob->queue_family_index = INVALID_QUEUE_FAMILY_INDEX_PREF;
+        }
+    } else {
+        split_glob->glob = glob;
+        split_glob->free_string = free_string;
+        split_glob->queue_family_index = NO_QUEUE_FAMILY_INDEX_PREF;
+    }
+}
+
+/// Append the globs listed in the file, one per line. Blank lines and lines
+/// beginning with '#' are ignored.
+static bool
+push_glob_file(split_glob_vec_t *split_globs, const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+
+    if (!file) {
+        loge("failed to open test pattern file: %s", filename);
+        return false;
+    }
+
+    while ((len = getline(&line, &line_size, file)) != -1) {
+        char *start = line;
+
+        while (len > 0 && isspace((unsigned char) line[len - 1]))
+            line[--len] = '\0';
+
+        while (isspace((unsigned char) *start))
+            ++start;
+
+        if (start[0] == '\0' || start[0] == '#')
+            continue;
+
+        push_split_glob(split_globs, strdup(start), true);
+    }
+
+    free(line);
+    fclose(file);
+
+    return true;
+}
+
+/// Enable the tests that match the globs. An argument of the form "@file"
+/// is replaced by the globs listed in the file.
+bool
 runner_enable_matching_tests(const cru_cstr_vec_t *testname_globs)
 {
     ASSERT_RUNNER_IS_INIT;
 
-    regex_t device_suffix_re;
-    if (regcomp(&device_suffix_re, "\\.q[0-9]+$", REG_EXTENDED) != 0)
-        abort();
-
     test_def_t *def;
     char **glob;
+    split_glob_t *split_glob;
+    bool ok = true;
 
     cru_foreach_test_def(def) {
         def->priv.queue_family_index = NO_QUEUE_FAMILY_INDEX_PREF;
@@ -184,60 +376,58 @@ runner_enable_matching_tests(const cru_cstr_vec_t *testname_globs)
 
     split_glob_vec_t split_globs = CRU_VEC_INIT;
     cru_vec_foreach(glob, testname_globs) {
-        split_glob_t *split_glob = cru_vec_push(&split_globs, 1);
-        regmatch_t match;
-        if (regexec(&device_suffix_re, *glob, 1, &match, 0) == 0) {
-            split_glob->glob = strdup(*glob);
-            split_glob->glob[match.rm_so] = '\0';
-            split_glob->free_string = true;
-            char *queue_family_index_str = &split_glob->glob[match.rm_so + 2];
-            uint32_t queue_family_index;
-            if (parse_u32(queue_family_index_str, &queue_family_index)) {
-                split_glob->queue_family_index = queue_family_index;
-            } else {
-                split_glob->queue_family_index = INVALID_QUEUE_FAMILY_INDEX_PREF;
+        if ((*glob)[0] == '@') {
+            if (!push_glob_file(&split_globs, *glob + 1)) {
+                ok = false;
+                goto cleanup;
             }
         } else {
-            split_glob->glob = *glob;
-            split_glob->free_string = false;
-            split_glob->queue_family_index = NO_QUEUE_FAMILY_INDEX_PREF;
+            push_split_glob(&split_globs, *glob, false);
         }
     }
 
-    const bool first_glob_is_neg = testname_globs->len > 0 &&
-                                   glob_is_negative(testname_globs->data[0]);
+    const bool first_glob_is_neg = split_globs.len > 0 &&
+                                   glob_is_negative(split_globs.data[0].glob);
 
-    const bool implicit_all = testname_globs->len == 0 || first_glob_is_neg;
+    const bool implicit_all = split_globs.len == 0 || first_glob_is_neg;
+
+    const char **glob_strs = xmalloc(MAX(split_globs.len, 1) *
+                                     sizeof(*glob_strs));
+    for (uint32_t i = 0; i < split_globs.len; ++i)
+        glob_strs[i] = split_globs.data[i].glob;
+
+    runner_glob_set_t *glob_set = runner_glob_set_create(glob_strs,
+                                                         split_globs.len);
+    free(glob_strs);
 
-    split_glob_t *split_glob;
     cru_foreach_test_def(def) {
         bool enable = false;
 
-        if (implicit_all) {
-            enable = test_def_match(def, "*");
-        }
-
         // Last matching glob wins.
-        cru_vec_foreach(split_glob, &split_globs) {
-            if (test_def_match(def, split_glob->glob)) {
-                enable =
-                    (split_glob->queue_family_index !=
-                     INVALID_QUEUE_FAMILY_INDEX_PREF) &&
-                    !glob_is_negative(split_glob->glob);
-                def->priv.queue_family_index = split_glob->queue_family_index;
-            }
+        int32_t i = runner_glob_set_match_last(glob_set, def);
+        if (i >= 0) {
+            split_glob = &split_globs.data[i];
+            enable =
+                (split_glob->queue_family_index !=
+                 INVALID_QUEUE_FAMILY_INDEX_PREF) &&
+                !glob_is_negative(split_glob->glob);
+            def->priv.queue_family_index = split_glob->queue_family_index;
+        } else if (implicit_all) {
+            enable = test_def_match(def, "*");
         }
 
-        if (enable) {
+        if (enable)
             def->priv.enable = true;
-            ++runner_num_tests;
-        }
     }
 
+    runner_glob_set_destroy(glob_set);
+
+cleanup:
     cru_vec_foreach(split_glob, &split_globs) {
         if (split_glob->free_string)
             free(split_glob->glob);
     }
     cru_vec_finish(&split_globs);
-    regfree(&device_suffix_re);
+
+    return ok;
 }
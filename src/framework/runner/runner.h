@@ -38,9 +38,23 @@ struct dispatch_packet {
 struct result_packet {
     const test_def_t *test_def;
     uint32_t queue_family_index;
+
+    /// If set, the packet only announces that the slave is starting the
+    /// test, and carries no result. The master blames a slave's death on
+    /// the tests it started but did not finish.
+    bool started;
+
     test_result_t result;
+
+    /// Wall-clock time spent in run_test_def(), in nanoseconds.
+    uint64_t duration_ns;
 };
 
 extern runner_opts_t runner_opts;
 
+test_t *start_test_def(const test_def_t *def, uint32_t queue_family_index);
+test_result_t finish_test_def(test_t *test, uint64_t *stop_ns);
 test_result_t run_test_def(const test_def_t *def, uint32_t queue_family_index);
+void runner_get_queue_range(const test_def_t *def, uint32_t num_queues,
+                            uint32_t *queue_start, uint32_t *queue_end);
+uint64_t runner_get_time_ns(void);
@@ -0,0 +1,343 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+/// \file
+/// \brief Bind slaves to CPUs and NUMA nodes
+///
+/// Without affinity control, the worker threads of every concurrent slave
+/// (for example, llvmpipe's) spread across every CPU, and concurrent tests
+/// oversubscribe the machine. With `--cpu-set` or `--pin-slaves`, the master
+/// divides its CPUs into one set per slave slot, where a slot is the index
+/// of the slave in the master's slave array. A slave binds itself to its
+/// slot's set right after fork, prefers memory from the set's NUMA node if
+/// the set lies on a single node, and advertises the size of the set as its
+/// thread budget in LP_NUM_THREADS.
+///
+/// The CPUs are ordered by NUMA node, then by number. RUNNER_PIN_MODE_COMPACT
+/// deals consecutive slots consecutive blocks of CPUs, so slots fill one node
+/// before the next. RUNNER_PIN_MODE_SCATTER deals slots round-robin to the
+/// nodes, then splits each node's CPUs among its slots. RUNNER_PIN_MODE_NONE
+/// gives every slot the whole set, and a budget of the set's share per job.
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "util/log.h"
+#include "util/misc.h"
+#include "util/string.h"
+#include "util/xalloc.h"
+
+#include "runner.h"
+#include "runner_affinity.h"
+
+#define MAX_NODES 1024
+
+typedef struct affinity_slot affinity_slot_t;
+
+struct affinity_slot {
+    cpu_set_t cpus;
+
+    /// The NUMA node of all CPUs in the set, or -1 if they span nodes or
+    /// the node is unknown.
+    int node;
+
+    /// Value of LP_NUM_THREADS.
+    uint32_t num_threads;
+};
+
+static struct {
+    bool enabled;
+    uint32_t num_slots;
+    affinity_slot_t *slots;
+} affinity;
+
+/// Parse a CPU list, such as "0-7,16,18-23", in the format of
+/// /sys/devices/system/node/node*/cpulist and taskset(1). Return false if it
+/// is malformed or names a CPU beyond CPU_SETSIZE.
+bool
+runner_parse_cpu_list(const char *str, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+
+    while (*str && *str != '\n') {
+        unsigned long first, last;
+        char *endptr;
+
+        first = strtoul(str, &endptr, 10);
+        if (endptr == str)
+            return false;
+        str = endptr;
+
+        last = first;
+        if (*str == '-') {
+            ++str;
+            last = strtoul(str, &endptr, 10);
+            if (endptr == str)
+                return false;
+            str = endptr;
+        }
+
+        if (first > last || last >= CPU_SETSIZE)
+            return false;
+
+        for (unsigned long cpu = first; cpu <= last; ++cpu)
+            CPU_SET(cpu, set);
+
+        if (*str == ',')
+            ++str;
+        else if (*str && *str != '\n')
+            return false;
+    }
+
+    return true;
+}
+
+/// Fill \a cpu_nodes with the NUMA node of each CPU, or -1 if unknown, as
+/// reported by sysfs.
+static void
+get_cpu_nodes(int cpu_nodes[CPU_SETSIZE])
+{
+    DIR *dir;
+    struct dirent *ent;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        cpu_nodes[cpu] = -1;
+
+    dir = opendir("/sys/devices/system/node");
+    if (!dir)
+        return;
+
+    while ((ent = readdir(dir))) {
+        string_t path = STRING_INIT;
+        char buf[4096];
+        cpu_set_t cpus;
+        size_t n;
+        FILE *f;
+        int node;
+
+        if (sscanf(ent->d_name, "node%d", &node) != 1 ||
+            node < 0 || node >= MAX_NODES)
+            continue;
+
+        string_printf(&path, "/sys/devices/system/node/%s/cpulist",
+                      ent->d_name);
+        f = fopen(string_data(&path), "r");
+        string_finish(&path);
+        if (!f)
+            continue;
+
+        n = fread(buf, 1, sizeof(buf) - 1, f);
+        buf[n] = '\0';
+        fclose(f);
+
+        if (!runner_parse_cpu_list(buf, &cpus))
+            continue;
+
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpus))
+                cpu_nodes[cpu] = node;
+        }
+    }
+
+    closedir(dir);
+}
+
+/// Give \a slot the CPUs cpus[start, end) and a budget of \a num_threads.
+static void
+init_slot(affinity_slot_t *slot, const int *cpus, const int *cpu_nodes,
+          uint32_t start, uint32_t end, uint32_t num_threads)
+{
+    CPU_ZERO(&slot->cpus);
+    slot->node = cpu_nodes[cpus[start]];
+    slot->num_threads = MAX(num_threads, 1);
+
+    for (uint32_t i = start; i < end; ++i) {
+        CPU_SET(cpus[i], &slot->cpus);
+
+        if (cpu_nodes[cpus[i]] != slot->node)
+            slot->node = -1;
+    }
+}
+
+/// Give slot \a index of \a count a block of the \a num_cpus CPUs. Each
+/// block has at least one CPU, so blocks overlap only if there are more
+/// slots than CPUs.
+static void
+init_slot_block(affinity_slot_t *slot, const int *cpus, const int *cpu_nodes,
+                uint32_t num_cpus, uint32_t index, uint32_t count)
+{
+    uint32_t start = (uint64_t) index * num_cpus / count;
+    uint32_t end = (uint64_t) (index + 1) * num_cpus / count;
+
+    if (start == num_cpus)
+        start = num_cpus - 1;
+    if (end <= start)
+        end = start + 1;
+
+    init_slot(slot, cpus, cpu_nodes, start, end, end - start);
+}
+
+/// Plan the CPU set of each of \a num_slots slave slots. Do nothing unless
+/// the user asked for a CPU set or for pinning.
+bool
+runner_affinity_init(uint32_t num_slots)
+{
+    int *cpu_nodes = NULL;
+    int *cpus = NULL;
+    uint32_t num_cpus = 0;
+    cpu_set_t avail;
+    bool ok = false;
+
+    if (!runner_opts.cpu_set && runner_opts.pin_slaves == RUNNER_PIN_MODE_NONE)
+        return true;
+
+    if (sched_getaffinity(0, sizeof(avail), &avail) == -1) {
+        loge("runner failed to get its CPU affinity");
+        return false;
+    }
+
+    if (runner_opts.cpu_set)
+        CPU_AND(&avail, &avail, runner_opts.cpu_set);
+
+    if (CPU_COUNT(&avail) == 0) {
+        loge("--cpu-set contains none of the runner's CPUs");
+        return false;
+    }
+
+    cpu_nodes = xmalloc(CPU_SETSIZE * sizeof(cpu_nodes[0]));
+    get_cpu_nodes(cpu_nodes);
+
+    // List the available CPUs by node, then by number. CPUs of unknown node
+    // come first.
+    cpus = xmalloc(CPU_COUNT(&avail) * sizeof(cpus[0]));
+    for (int node = -1; node < MAX_NODES; ++node) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &avail) && cpu_nodes[cpu] == node)
+                cpus[num_cpus++] = cpu;
+        }
+    }
+
+    assert(num_cpus == (uint32_t) CPU_COUNT(&avail));
+
+    affinity.num_slots = MAX(num_slots, 1);
+    affinity.slots = xzalloc(affinity.num_slots * sizeof(affinity.slots[0]));
+
+    switch (runner_opts.pin_slaves) {
+    case RUNNER_PIN_MODE_NONE:
+        for (uint32_t i = 0; i < affinity.num_slots; ++i) {
+            init_slot(&affinity.slots[i], cpus, cpu_nodes, 0, num_cpus,
+                      num_cpus / affinity.num_slots);
+        }
+        break;
+    case RUNNER_PIN_MODE_COMPACT:
+        for (uint32_t i = 0; i < affinity.num_slots; ++i) {
+            init_slot_block(&affinity.slots[i], cpus, cpu_nodes, num_cpus,
+                            i, affinity.num_slots);
+        }
+        break;
+    case RUNNER_PIN_MODE_SCATTER: {
+        // Each node's CPUs are contiguous in cpus[]. Find each node's range.
+        uint32_t node_start[MAX_NODES + 1];
+        uint32_t num_nodes = 0;
+
+        for (uint32_t i = 0; i < num_cpus; ++i) {
+            if (i == 0 || cpu_nodes[cpus[i]] != cpu_nodes[cpus[i - 1]])
+                node_start[num_nodes++] = i;
+        }
+        node_start[num_nodes] = num_cpus;
+
+        for (uint32_t i = 0; i < affinity.num_slots; ++i) {
+            const uint32_t node = i % num_nodes;
+            const uint32_t start = node_start[node];
+            const uint32_t end = node_start[node + 1];
+
+            // The node hosts slots node, node + num_nodes, ...
+            const uint32_t count = (affinity.num_slots - node +
+                                    num_nodes - 1) / num_nodes;
+
+            init_slot_block(&affinity.slots[i], cpus + start, cpu_nodes,
+                            end - start, i / num_nodes, count);
+        }
+        break;
+    }
+    default:
+        loge("invalid pin mode %d", runner_opts.pin_slaves);
+        goto out;
+    }
+
+    affinity.enabled = true;
+    ok = true;
+
+out:
+    free(cpus);
+    free(cpu_nodes);
+    return ok;
+}
+
+void
+runner_affinity_finish(void)
+{
+    free(affinity.slots);
+    memset(&affinity, 0, sizeof(affinity));
+}
+
+/// Bind the calling process to the CPUs of \a slot, prefer memory from its
+/// node, and set its thread budget. Call in the slave right after fork,
+/// before it creates any threads, so that the threads inherit the binding.
+void
+runner_affinity_apply(uint32_t slot)
+{
+    const affinity_slot_t *s;
+    char num_threads[16];
+
+    if (!affinity.enabled)
+        return;
+
+    s = &affinity.slots[slot % affinity.num_slots];
+
+    if (sched_setaffinity(0, sizeof(s->cpus), &s->cpus) == -1)
+        loge("runner failed to set slave's CPU affinity");
+
+    if (s->node >= 0) {
+        unsigned long nodemask[MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+        const unsigned bits = 8 * sizeof(nodemask[0]);
+
+        nodemask[s->node / bits] |= 1ul << (s->node % bits);
+
+        // Call the syscall directly to avoid depending on libnuma.
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodemask,
+                    MAX_NODES + 1) == -1)
+            loge("runner failed to set slave's NUMA memory policy");
+    }
+
+    // Respect a budget set by the user.
+    snprintf(num_threads, sizeof(num_threads), "%u", s->num_threads);
+    setenv("LP_NUM_THREADS", num_threads, /*overwrite*/ 0);
+}
@@ -0,0 +1,546 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+/// \file
+/// \brief Compiled test name globs
+///
+/// Selecting tests by calling test_def_match() for each (test, glob) pair
+/// costs O(tests * globs) calls to fnmatch(), which is noticeable with
+/// thousands of tests and long exclude lists. Instead, the runner compiles its
+/// globs once into a runner_glob_set_t, which answers "which glob is the last
+/// to match this test?" for each test.
+///
+/// Each glob is split into its literal prefix, which is inserted into a trie,
+/// and the remainder, which is compiled into a short token sequence. Walking
+/// a test's name through the trie yields the few globs whose literal prefix
+/// the name begins with. The runner then simulates each candidate's token
+/// sequence as an NFA, in order of decreasing glob index, and stops at the
+/// first match.
+///
+/// The set matches exactly as test_def_match() does, including its treatment
+/// of special test prefixes. Globs using bracket features that the compiler
+/// does not understand, such as equivalence classes, fall back to fnmatch().
+
+#include <ctype.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/xalloc.h"
+
+#include "runner_glob.h"
+
+#define NO_NODE UINT32_MAX
+#define NO_GLOB UINT32_MAX
+
+typedef struct glob_token glob_token_t;
+typedef struct compiled_glob compiled_glob_t;
+typedef struct trie_node trie_node_t;
+typedef struct glob_candidate glob_candidate_t;
+
+enum glob_token_type {
+    GLOB_TOKEN_LITERAL,
+    GLOB_TOKEN_ANY,
+    GLOB_TOKEN_STAR,
+    GLOB_TOKEN_SET,
+};
+
+struct glob_token {
+    enum glob_token_type type;
+    unsigned char c;
+
+    /// Bitset of the bytes matched by a GLOB_TOKEN_SET.
+    uint32_t set[256 / 32];
+};
+
+struct compiled_glob {
+    /// The glob with any leading '!' stripped. Owned by the caller.
+    const char *text;
+
+    /// Bitmask of the special prefixes with which the glob's text begins.
+    uint32_t special_mask;
+
+    /// If set, match with fnmatch() rather than with the tokens.
+    bool use_fnmatch;
+
+    /// Length of the literal prefix in the test name.
+    uint32_t prefix_len;
+
+    /// Tokens that follow the literal prefix.
+    uint32_t num_tokens;
+    glob_token_t *tokens;
+
+    /// Next glob attached to the same trie node, in decreasing index order.
+    uint32_t next_in_node;
+};
+
+struct trie_node {
+    unsigned char c;
+    uint32_t first_child;
+    uint32_t next_sibling;
+
+    /// Globs whose literal prefix ends at this node, in decreasing index
+    /// order.
+    uint32_t first_glob;
+};
+
+struct glob_candidate {
+    uint32_t glob;
+};
+
+typedef struct glob_token_vec glob_token_vec_t;
+typedef struct trie_node_vec trie_node_vec_t;
+
+CRU_VEC_DEFINE(struct glob_token_vec, glob_token_t)
+CRU_VEC_DEFINE(struct trie_node_vec, trie_node_t)
+
+struct runner_glob_set {
+    uint32_t num_globs;
+    compiled_glob_t *globs;
+
+    /// Node 0 is the root, which represents the empty prefix.
+    trie_node_vec_t nodes;
+};
+
+/// Most sets have few globs, so runner_glob_set_match_last() gathers their
+/// candidates on the stack.
+#define MAX_STACK_CANDIDATES 64
+
+/// Crucible's bench, example and self tests match only globs that begin
+/// with the entire literal prefix. See test_def_match().
+static const char *special_prefixes[] = {
+    "bench.",
+    "example.",
+    "self.",
+};
+
+static uint32_t
+get_special_mask(const char *str)
+{
+    uint32_t mask = 0;
+
+    for (uint32_t i = 0; i < ARRAY_LENGTH(special_prefixes); ++i) {
+        const char *prefix = special_prefixes[i];
+        if (strncmp(prefix, str, strlen(prefix)) == 0)
+            mask |= 1u << i;
+    }
+
+    return mask;
+}
+
+static inline void
+set_add(glob_token_t *tok, unsigned char c)
+{
+    tok->set[c / 32] |= 1u << (c % 32);
+}
+
+static inline bool
+set_has(const glob_token_t *tok, unsigned char c)
+{
+    return tok->set[c / 32] & (1u << (c % 32));
+}
+
+static bool
+set_add_class(glob_token_t *tok, const char *name, size_t len)
+{
+    static const struct {
+        const char *name;
+        int (*func)(int);
+    } classes[] = {
+        { "alnum", isalnum }, { "alpha", isalpha }, { "blank", isblank },
+        { "cntrl", iscntrl }, { "digit", isdigit }, { "graph", isgraph },
+        { "lower", islower }, { "print", isprint }, { "punct", ispunct },
+        { "space", isspace }, { "upper", isupper }, { "xdigit", isxdigit },
+    };
+
+    for (uint32_t i = 0; i < ARRAY_LENGTH(classes); ++i) {
+        if (strlen(classes[i].name) != len ||
+            strncmp(classes[i].name, name, len) != 0)
+            continue;
+
+        for (int c = 1; c < 256; ++c) {
+            if (classes[i].func(c))
+                set_add(tok, c);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+/// Parse the bracket expression that begins at \a p, which points just past
+/// the '['. Return a pointer past the closing ']', or NULL if the bracket is
+/// malformed or needs fnmatch().
+static const char *
+parse_bracket(const char *p, glob_token_t *tok)
+{
+    bool negate = false;
+    bool first = true;
+
+    if (*p == '!' || *p == '^') {
+        negate = true;
+        ++p;
+    }
+
+    for (;;) {
+        unsigned char lo, hi;
+
+        if (*p == '\0')
+            return NULL;
+
+        if (*p == ']' && !first)
+            break;
+
+        first = false;
+
+        if (p[0] == '[' && (p[1] == '=' || p[1] == '.'))
+            return NULL;
+
+        if (p[0] == '[' && p[1] == ':') {
+            const char *end = strstr(p + 2, ":]");
+            if (!end || !set_add_class(tok, p + 2, end - (p + 2)))
+                return NULL;
+
+            p = end + 2;
+            continue;
+        }
+
+        if (p[0] == '\\' && p[1] != '\0')
+            ++p;
+
+        lo = hi = *p++;
+
+        if (p[0] == '-' && p[1] != ']' && p[1] != '\0') {
+            ++p;
+
+            if (p[0] == '\\' && p[1] != '\0')
+                ++p;
+
+            if (p[0] == '[' && (p[1] == '.' || p[1] == '=' || p[1] == ':'))
+                return NULL;
+
+            hi = *p++;
+        }
+
+        for (unsigned c = lo; c <= hi; ++c)
+            set_add(tok, c);
+    }
+
+    if (negate) {
+        for (uint32_t i = 0; i < ARRAY_LENGTH(tok->set); ++i)
+            tok->set[i] = ~tok->set[i];
+    }
+
+    // fnmatch() never matches the string's terminating NUL.
+    tok->set[0] &= ~1u;
+
+    return p + 1;
+}
+
+/// Compile the glob's text into tokens. Return false if the glob requires
+/// fnmatch().
+static bool
+compile_glob(compiled_glob_t *glob, glob_token_vec_t *tokens)
+{
+    const char *p = glob->text;
+
+    while (*p) {
+        glob_token_t tok = { .type = GLOB_TOKEN_LITERAL };
+
+        switch (*p) {
+        case '*':
+            ++p;
+
+            // Consecutive stars are equivalent to one.
+            if (tokens->len > 0 &&
+                tokens->data[tokens->len - 1].type == GLOB_TOKEN_STAR)
+                continue;
+
+            tok.type = GLOB_TOKEN_STAR;
+            break;
+        case '?':
+            ++p;
+            tok.type = GLOB_TOKEN_ANY;
+            break;
+        case '[':
+            // Leave unterminated brackets, whose meaning varies between
+            // libc implementations, to fnmatch().
+            tok.type = GLOB_TOKEN_SET;
+            p = parse_bracket(p + 1, &tok);
+            if (!p)
+                return false;
+            break;
+        case '\\':
+            // fnmatch() fails on a trailing backslash.
+            if (p[1] == '\0')
+                return false;
+            tok.c = p[1];
+            p += 2;
+            break;
+        default:
+            tok.c = *p++;
+            break;
+        }
+
+        *cru_vec_push(tokens, 1) = tok;
+    }
+
+    return true;
+}
+
+static uint32_t
+trie_get_child(trie_node_vec_t *nodes, uint32_t parent, unsigned char c)
+{
+    uint32_t n;
+
+    for (n = nodes->data[parent].first_child; n != NO_NODE;
+         n = nodes->data[n].next_sibling) {
+        if (nodes->data[n].c == c)
+            return n;
+    }
+
+    n = nodes->len;
+    *cru_vec_push(nodes, 1) = (trie_node_t) {
+        .c = c,
+        .first_child = NO_NODE,
+        .next_sibling = nodes->data[parent].first_child,
+        .first_glob = NO_GLOB,
+    };
+    nodes->data[parent].first_child = n;
+
+    return n;
+}
+
+/// Compile the globs. The set borrows the strings, which must outlive it.
+/// Leading '!' characters are ignored, as in test_def_match().
+runner_glob_set_t *
+runner_glob_set_create(const char *const *globs, uint32_t count)
+{
+    runner_glob_set_t *set = xzalloc(sizeof(*set));
+    glob_token_vec_t tokens = CRU_VEC_INIT;
+
+    set->num_globs = count;
+    set->globs = xzalloc(MAX(count, 1) * sizeof(set->globs[0]));
+
+    cru_vec_init(&set->nodes);
+    *cru_vec_push(&set->nodes, 1) = (trie_node_t) {
+        .first_child = NO_NODE,
+        .next_sibling = NO_NODE,
+        .first_glob = NO_GLOB,
+    };
+
+    for (uint32_t i = 0; i < count; ++i) {
+        compiled_glob_t *glob = &set->globs[i];
+        const char *text = globs[i];
+        uint32_t node = 0;
+        uint32_t t = 0;
+
+        while (text[0] == '!')
+            ++text;
+
+        glob->text = text;
+        glob->special_mask = get_special_mask(text);
+
+        cru_vec_clear(&tokens);
+        glob->use_fnmatch = !compile_glob(glob, &tokens);
+
+        if (!glob->use_fnmatch) {
+            // Insert the literal prefix into the trie.
+            for (; t < tokens.len &&
+                   tokens.data[t].type == GLOB_TOKEN_LITERAL; ++t) {
+                node = trie_get_child(&set->nodes, node, tokens.data[t].c);
+            }
+
+            glob->prefix_len = t;
+            glob->num_tokens = tokens.len - t;
+            if (glob->num_tokens > 0) {
+                glob->tokens = xmalloc(glob->num_tokens *
+                                       sizeof(glob->tokens[0]));
+                memcpy(glob->tokens, tokens.data + t,
+                       glob->num_tokens * sizeof(glob->tokens[0]));
+            }
+        }
+
+        glob->next_in_node = set->nodes.data[node].first_glob;
+        set->nodes.data[node].first_glob = i;
+    }
+
+    cru_vec_finish(&tokens);
+
+    return set;
+}
+
+void
+runner_glob_set_destroy(runner_glob_set_t *set)
+{
+    if (!set)
+        return;
+
+    for (uint32_t i = 0; i < set->num_globs; ++i)
+        free(set->globs[i].tokens);
+
+    cru_vec_finish(&set->nodes);
+    free(set->globs);
+    free(set);
+}
+
+/// Simulate the glob's tokens as an NFA whose states are the token
+/// positions.
+static bool
+glob_match_tokens(const compiled_glob_t *glob, const char *str)
+{
+    const uint32_t n = glob->num_tokens;
+    const glob_token_t *tokens = glob->tokens;
+
+    // Fast paths for the most common globs, "foo.bar" and "foo.*".
+    if (n == 0)
+        return *str == '\0';
+    if (n == 1 && tokens[0].type == GLOB_TOKEN_STAR)
+        return true;
+
+    bool cur[n + 1];
+    bool next[n + 1];
+
+    memset(cur, 0, sizeof(cur));
+    cur[0] = true;
+
+    for (const unsigned char *s = (const unsigned char *) str; ; ++s) {
+        // Epsilon closure: a star may match the empty string.
+        for (uint32_t i = 0; i < n; ++i) {
+            if (cur[i] && tokens[i].type == GLOB_TOKEN_STAR)
+                cur[i + 1] = true;
+        }
+
+        if (*s == '\0')
+            return cur[n];
+
+        bool any = false;
+        memset(next, 0, sizeof(next));
+
+        for (uint32_t i = 0; i < n; ++i) {
+            if (!cur[i])
+                continue;
+
+            const glob_token_t *tok = &tokens[i];
+            switch (tok->type) {
+            case GLOB_TOKEN_LITERAL:
+                next[i + 1] |= tok->c == *s;
+                break;
+            case GLOB_TOKEN_ANY:
+                next[i + 1] = true;
+                break;
+            case GLOB_TOKEN_STAR:
+                next[i] = true;
+                break;
+            case GLOB_TOKEN_SET:
+                next[i + 1] |= set_has(tok, *s);
+                break;
+            }
+
+            any |= next[i] | next[i + 1];
+        }
+
+        if (!any)
+            return false;
+
+        memcpy(cur, next, sizeof(cur));
+    }
+}
+
+static int
+cmp_u32_decreasing(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+
+    return (x < y) - (x > y);
+}
+
+/// Return the index of the last glob that matches the test, or -1 if none
+/// does. The set is not modified, so multiple threads may match against it
+/// at once.
+int32_t
+runner_glob_set_match_last(const runner_glob_set_t *set,
+                           const test_def_t *def)
+{
+    const char *name = def->name;
+    const uint32_t def_special_mask = get_special_mask(name);
+    uint32_t stack_candidates[MAX_STACK_CANDIDATES];
+    uint32_t *candidates = stack_candidates;
+    uint32_t num_candidates = 0;
+    uint32_t node = 0;
+    int32_t result = -1;
+
+    if (set->num_globs > MAX_STACK_CANDIDATES)
+        candidates = xmalloc(set->num_globs * sizeof(candidates[0]));
+
+    // Gather the globs whose literal prefix begins the name.
+    for (const char *s = name; ; ++s) {
+        const trie_node_t *tn = &set->nodes.data[node];
+
+        for (uint32_t g = tn->first_glob; g != NO_GLOB;
+             g = set->globs[g].next_in_node) {
+            candidates[num_candidates++] = g;
+        }
+
+        if (*s == '\0')
+            break;
+
+        for (node = tn->first_child; node != NO_NODE;
+             node = set->nodes.data[node].next_sibling) {
+            if (set->nodes.data[node].c == (unsigned char) *s)
+                break;
+        }
+
+        if (node == NO_NODE)
+            break;
+    }
+
+    qsort(candidates, num_candidates, sizeof(candidates[0]),
+          cmp_u32_decreasing);
+
+    for (uint32_t i = 0; i < num_candidates; ++i) {
+        const compiled_glob_t *glob = &set->globs[candidates[i]];
+
+        if (def_special_mask & ~glob->special_mask)
+            continue;
+
+        bool match;
+        if (glob->use_fnmatch) {
+            match = fnmatch(glob->text, name, 0) == 0;
+        } else {
+            match = glob_match_tokens(glob, name + glob->prefix_len);
+        }
+
+        if (match) {
+            result = candidates[i];
+            break;
+        }
+    }
+
+    if (candidates != stack_candidates)
+        free(candidates);
+
+    return result;
+}
@@ -0,0 +1,355 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+/// \file
+/// \brief Partition the runner's tests into shards
+///
+/// The unit of partitioning is the (test, queue family) pair, enumerated in
+/// the same order in which the master dispatches them. A shard is a pure
+/// function of the enabled tests, the queue family count, the shard count,
+/// and the optional durations file. Therefore N independent invocations of
+/// `crucible run --shard=K/N`, one for each K, run each pair exactly once
+/// provided they agree on everything else.
+///
+/// Without a durations file, pairs are dealt round-robin to the shards. With
+/// one, each pair's cost is its "time" attribute in a previous run's JUnit
+/// XML, and pairs are assigned longest-first to the least loaded shard.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include "util/log.h"
+#include "util/string.h"
+#include "util/xalloc.h"
+
+#include "runner.h"
+#include "runner_shard.h"
+
+typedef struct shard_pair shard_pair_t;
+typedef struct shard_duration shard_duration_t;
+
+struct shard_pair {
+    const test_def_t *def;
+    uint32_t queue_family_index;
+
+    /// Order in which the master dispatches the pair. Breaks ties between
+    /// equal costs so that the partition is deterministic.
+    uint32_t ordinal;
+
+    double cost;
+    uint32_t shard;
+};
+
+struct shard_duration {
+    char *name;
+    double seconds;
+};
+
+typedef struct shard_pair_vec shard_pair_vec_t;
+typedef struct shard_duration_vec shard_duration_vec_t;
+
+CRU_VEC_DEFINE(struct shard_pair_vec, shard_pair_t)
+CRU_VEC_DEFINE(struct shard_duration_vec, shard_duration_t)
+
+static struct {
+    /// Number of slots per test def. The last slot holds any nonexistent
+    /// queue family requested on the command line.
+    uint32_t num_slots;
+
+    /// Indexed by test_def_get_id() * num_slots + slot. NULL if the runner
+    /// is not sharding, in which case every pair belongs to this shard.
+    bool *member;
+} shard;
+
+static uint32_t
+shard_slot(uint32_t queue_family_index)
+{
+    return MIN(queue_family_index, shard.num_slots - 1);
+}
+
+static int
+cmp_duration_name(const void *a, const void *b)
+{
+    const shard_duration_t *da = a;
+    const shard_duration_t *db = b;
+
+    return strcmp(da->name, db->name);
+}
+
+static void
+collect_durations(xmlNodePtr node, shard_duration_vec_t *durations)
+{
+    for (; node; node = node->next) {
+        if (node->type != XML_ELEMENT_NODE)
+            continue;
+
+        if (!xmlStrEqual(node->name, (const xmlChar *) "testcase")) {
+            collect_durations(node->children, durations);
+            continue;
+        }
+
+        xmlChar *name = xmlGetProp(node, (const xmlChar *) "name");
+        xmlChar *time = xmlGetProp(node, (const xmlChar *) "time");
+
+        if (name && time) {
+            char *endptr;
+            double seconds = strtod((const char *) time, &endptr);
+
+            if (endptr != (const char *) time && seconds >= 0) {
+                shard_duration_t *d = cru_vec_push(durations, 1);
+                d->name = xstrdup((const char *) name);
+                d->seconds = seconds;
+            }
+        }
+
+        xmlFree(name);
+        xmlFree(time);
+    }
+}
+
+/// Load the durations of a previous run, sorted by name. If a pair appears
+/// more than once, as it may in a merged file, keep its longest duration.
+static bool
+load_durations(const char *filepath, shard_duration_vec_t *durations)
+{
+    xmlDocPtr doc = xmlReadFile(filepath, NULL, XML_PARSE_NONET);
+    if (!doc) {
+        loge("failed to parse shard durations file: %s", filepath);
+        return false;
+    }
+
+    collect_durations(xmlDocGetRootElement(doc), durations);
+    xmlFreeDoc(doc);
+
+    if (durations->len == 0) {
+        loge("shard durations file has no testcase times: %s", filepath);
+        return false;
+    }
+
+    qsort(durations->data, durations->len, sizeof(durations->data[0]),
+          cmp_duration_name);
+
+    size_t n = 0;
+    for (size_t i = 0; i < durations->len; ++i) {
+        shard_duration_t *d = &durations->data[i];
+
+        if (n > 0 && strcmp(durations->data[n - 1].name, d->name) == 0) {
+            durations->data[n - 1].seconds =
+                MAX(durations->data[n - 1].seconds, d->seconds);
+            free(d->name);
+        } else {
+            durations->data[n++] = *d;
+        }
+    }
+    durations->len = n;
+
+    return true;
+}
+
+static void
+free_durations(shard_duration_vec_t *durations)
+{
+    shard_duration_t *d;
+
+    cru_vec_foreach(d, durations) {
+        free(d->name);
+    }
+    cru_vec_finish(durations);
+}
+
+/// Does the master skip the pair without running it?
+static bool
+pair_is_skipped(const shard_pair_t *pair, uint32_t num_queues)
+{
+    return pair->def->skip || pair->queue_family_index >= num_queues;
+}
+
+static void
+assign_pairs_by_cost(shard_pair_vec_t *pairs,
+                     const shard_duration_vec_t *durations,
+                     uint32_t num_queues)
+{
+    string_t name = STRING_INIT;
+    shard_pair_t *pair;
+    double known_sum = 0.0;
+    uint32_t known_count = 0;
+
+    cru_vec_foreach(pair, pairs) {
+        pair->cost = -1.0;
+
+        if (pair_is_skipped(pair, num_queues)) {
+            pair->cost = 0.0;
+            continue;
+        }
+
+        string_printf(&name, "%s.q%u", pair->def->name,
+                      pair->queue_family_index);
+
+        const shard_duration_t key = { .name = string_data(&name) };
+        const shard_duration_t *d = bsearch(&key, durations->data,
+                                            durations->len,
+                                            sizeof(durations->data[0]),
+                                            cmp_duration_name);
+        if (d) {
+            pair->cost = d->seconds;
+            known_sum += d->seconds;
+            ++known_count;
+        }
+    }
+
+    string_finish(&name);
+
+    // Tests absent from the durations file, such as new tests, cost the
+    // average of the known tests.
+    const double default_cost = known_count > 0 ? known_sum / known_count
+                                                : 1.0;
+    cru_vec_foreach(pair, pairs) {
+        if (pair->cost < 0)
+            pair->cost = default_cost;
+    }
+
+    // Longest processing time first: visit pairs by decreasing cost, and
+    // give each to the least loaded shard.
+    shard_pair_t **order = xmalloc(pairs->len * sizeof(*order));
+    double *load = xzalloc(runner_opts.shard_count * sizeof(*load));
+
+    for (size_t i = 0; i < pairs->len; ++i)
+        order[i] = &pairs->data[i];
+
+    // Insertion sort keeps equal costs in dispatch order. The pair count is
+    // small enough that the quadratic worst case does not matter.
+    for (size_t i = 1; i < pairs->len; ++i) {
+        shard_pair_t *p = order[i];
+        size_t j = i;
+
+        while (j > 0 && order[j - 1]->cost < p->cost) {
+            order[j] = order[j - 1];
+            --j;
+        }
+        order[j] = p;
+    }
+
+    for (size_t i = 0; i < pairs->len; ++i) {
+        uint32_t best = 0;
+
+        for (uint32_t s = 1; s < runner_opts.shard_count; ++s) {
+            if (load[s] < load[best])
+                best = s;
+        }
+
+        order[i]->shard = best;
+        load[best] += order[i]->cost;
+    }
+
+    free(order);
+    free(load);
+}
+
+/// Compute the pairs that belong to the shard selected by
+/// runner_opts::shard_index, and return their count in \a num_pairs.
+bool
+runner_shard_init(uint32_t num_queues, uint32_t *num_pairs)
+{
+    shard_pair_vec_t pairs = CRU_VEC_INIT;
+    shard_duration_vec_t durations = CRU_VEC_INIT;
+    const test_def_t *def;
+    shard_pair_t *pair;
+    bool ok = false;
+
+    assert(!shard.member);
+
+    cru_foreach_test_def(def) {
+        uint32_t queue_start, queue_end;
+
+        if (!def->priv.enable)
+            continue;
+
+        runner_get_queue_range(def, num_queues, &queue_start, &queue_end);
+
+        for (uint32_t qi = queue_start; qi < queue_end; ++qi) {
+            pair = cru_vec_push(&pairs, 1);
+            *pair = (shard_pair_t) {
+                .def = def,
+                .queue_family_index = qi,
+                .ordinal = pairs.len - 1,
+            };
+        }
+    }
+
+    if (runner_opts.shard_count <= 1) {
+        *num_pairs = pairs.len;
+        ok = true;
+        goto cleanup;
+    }
+
+    if (runner_opts.shard_durations_filepath) {
+        if (!load_durations(runner_opts.shard_durations_filepath, &durations))
+            goto cleanup;
+
+        assign_pairs_by_cost(&pairs, &durations, num_queues);
+    } else {
+        cru_vec_foreach(pair, &pairs) {
+            pair->shard = pair->ordinal % runner_opts.shard_count;
+        }
+    }
+
+    shard.num_slots = num_queues + 1;
+    shard.member = xzalloc(cru_num_defs() * shard.num_slots *
+                           sizeof(*shard.member));
+
+    *num_pairs = 0;
+    cru_vec_foreach(pair, &pairs) {
+        if (pair->shard != runner_opts.shard_index)
+            continue;
+
+        shard.member[test_def_get_id(pair->def) * shard.num_slots +
+                     shard_slot(pair->queue_family_index)] = true;
+        ++*num_pairs;
+    }
+
+    ok = true;
+
+cleanup:
+    free_durations(&durations);
+    cru_vec_finish(&pairs);
+    return ok;
+}
+
+void
+runner_shard_finish(void)
+{
+    free(shard.member);
+    shard.member = NULL;
+}
+
+bool
+runner_shard_contains(const test_def_t *def, uint32_t queue_family_index)
+{
+    if (!shard.member)
+        return true;
+
+    return shard.member[test_def_get_id(def) * shard.num_slots +
+                        shard_slot(queue_family_index)];
+}
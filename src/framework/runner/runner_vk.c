@@ -19,53 +19,115 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+
 /// \file
 /// \brief The runner's vulkan helper routines
 
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "runner_vk.h"
 
-#include <stdlib.h>
+#include "util/log.h"
 
-#include "util/vk_wrapper.h"
+#define NUM_FEATURES \
+    (sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32))
 
-bool
-runner_get_vulkan_queue_count(uint32_t *count)
+static bool
+enumerate_instance_extensions(struct runner_vk_ext_vec *exts)
 {
-    if (count == NULL)
+    uint32_t count;
+    VkResult res;
+
+    res = vkEnumerateInstanceExtensionProperties(NULL, &count, NULL);
+    if (res != VK_SUCCESS)
         return false;
 
-    VkResult res;
-    uint32_t instance_extension_count;
-    res = vkEnumerateInstanceExtensionProperties(NULL,
-        &instance_extension_count, NULL);
+    cru_vec_clear(exts);
+    VkExtensionProperties *props = cru_vec_push(exts, count);
+
+    res = vkEnumerateInstanceExtensionProperties(NULL, &count, props);
     if (res != VK_SUCCESS)
         return false;
 
-    VkExtensionProperties *instance_extension_props;
-    instance_extension_props =
-        malloc(instance_extension_count * sizeof(*instance_extension_props));
-    if (instance_extension_props == NULL)
+    exts->len = count;
+    return true;
+}
+
+static bool
+enumerate_device_extensions(VkPhysicalDevice phy_dev,
+                            struct runner_vk_ext_vec *exts)
+{
+    uint32_t count;
+    VkResult res;
+
+    res = vkEnumerateDeviceExtensionProperties(phy_dev, NULL, &count, NULL);
+    if (res != VK_SUCCESS)
         return false;
 
-    res = vkEnumerateInstanceExtensionProperties(NULL,
-        &instance_extension_count, instance_extension_props);
-    if (res != VK_SUCCESS) {
-        free(instance_extension_props);
+    cru_vec_clear(exts);
+    VkExtensionProperties *props = cru_vec_push(exts, count);
+
+    res = vkEnumerateDeviceExtensionProperties(phy_dev, NULL, &count, props);
+    if (res != VK_SUCCESS)
         return false;
-    }
 
-    const char **ext_names;
-    ext_names = malloc(instance_extension_count * sizeof(*ext_names));
-    if (ext_names == NULL) {
-        free(instance_extension_props);
+    exts->len = count;
+    return true;
+}
+
+static bool
+probe_device_caps(VkPhysicalDevice phy_dev, runner_vk_caps_t *caps)
+{
+    VkPhysicalDeviceProperties props;
+    uint32_t count;
+
+    vkGetPhysicalDeviceProperties(phy_dev, &props);
+    caps->api_version = props.apiVersion;
+
+    vkGetPhysicalDeviceFeatures(phy_dev, &caps->features);
+
+    vkGetPhysicalDeviceQueueFamilyProperties(phy_dev, &count, NULL);
+
+    VkQueueFamilyProperties *qf_props = malloc(count * sizeof(*qf_props));
+    if (!qf_props)
         return false;
-    }
 
-    for (uint32_t i = 0; i < instance_extension_count; i++) {
-        ext_names[i] = instance_extension_props[i].extensionName;
-    }
+    vkGetPhysicalDeviceQueueFamilyProperties(phy_dev, &count, qf_props);
+
+    cru_vec_clear(&caps->queue_flags);
+    VkQueueFlags *flags = cru_vec_push(&caps->queue_flags, count);
+    for (uint32_t i = 0; i < count; i++)
+        flags[i] = qf_props[i].queueFlags;
+    free(qf_props);
+
+    return enumerate_device_extensions(phy_dev, &caps->device_extensions);
+}
+
+/// Probe the capabilities of the physical device with the given 1-based
+/// \a device_id, as the test setup phase would select it.
+bool
+runner_vk_probe_caps(uint32_t device_id, runner_vk_caps_t *caps)
+{
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice *phy_devs = NULL;
+    bool result = false;
+    VkResult res;
+
+    *caps = (runner_vk_caps_t) {0};
+
+    if (!enumerate_instance_extensions(&caps->instance_extensions))
+        goto cleanup;
+
+    const char **ext_names =
+        malloc(caps->instance_extensions.len * sizeof(*ext_names));
+    if (ext_names == NULL)
+        goto cleanup;
+
+    for (uint32_t i = 0; i < caps->instance_extensions.len; i++)
+        ext_names[i] = caps->instance_extensions.data[i].extensionName;
 
-    VkInstance instance;
     res = vkCreateInstance(
         &(VkInstanceCreateInfo) {
             .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -74,34 +136,208 @@ runner_get_vulkan_queue_count(uint32_t *count)
                 .pApplicationName = "crucible",
                 .apiVersion = VK_MAKE_VERSION(1, 0, 0),
             },
-            .enabledExtensionCount = instance_extension_count,
+            .enabledExtensionCount = caps->instance_extensions.len,
             .ppEnabledExtensionNames = ext_names,
         }, NULL, &instance);
-    free(instance_extension_props);
     free(ext_names);
-    if (res != VK_SUCCESS)
-        return false;
+    if (res != VK_SUCCESS) {
+        instance = VK_NULL_HANDLE;
+        goto cleanup;
+    }
 
     uint32_t phy_dev_count = 0;
     res = vkEnumeratePhysicalDevices(instance, &phy_dev_count, NULL);
-    if (res != VK_SUCCESS || phy_dev_count == 0) {
+    if (res != VK_SUCCESS || device_id == 0 || device_id > phy_dev_count)
+        goto cleanup;
+
+    phy_devs = malloc(phy_dev_count * sizeof(*phy_devs));
+    if (phy_devs == NULL)
+        goto cleanup;
+
+    res = vkEnumeratePhysicalDevices(instance, &phy_dev_count, phy_devs);
+    if ((res != VK_SUCCESS && res != VK_INCOMPLETE) ||
+        device_id > phy_dev_count)
+        goto cleanup;
+
+    if (!probe_device_caps(phy_devs[device_id - 1], caps))
+        goto cleanup;
+
+    result = true;
+
+cleanup:
+    if (instance != VK_NULL_HANDLE)
         vkDestroyInstance(instance, NULL);
-        return false;
+    free(phy_devs);
+    if (!result)
+        runner_vk_caps_finish(caps);
+    return result;
+}
+
+void
+runner_vk_caps_finish(runner_vk_caps_t *caps)
+{
+    cru_vec_finish(&caps->queue_flags);
+    cru_vec_finish(&caps->instance_extensions);
+    cru_vec_finish(&caps->device_extensions);
+    *caps = (runner_vk_caps_t) {0};
+}
+
+bool
+runner_vk_caps_write(const runner_vk_caps_t *caps, FILE *f)
+{
+    const VkBool32 *features = (const VkBool32 *) &caps->features;
+    const VkExtensionProperties *ext;
+    const VkQueueFlags *flags;
+
+    fprintf(f, "api-version %" PRIu32 "\n", caps->api_version);
+
+    // One character per VkBool32 member of VkPhysicalDeviceFeatures.
+    fputs("features ", f);
+    for (size_t i = 0; i < NUM_FEATURES; i++)
+        fputc(features[i] ? '1' : '0', f);
+    fputc('\n', f);
+
+    cru_vec_foreach(flags, &caps->queue_flags) {
+        fprintf(f, "queue-family 0x%" PRIx32 "\n", *flags);
     }
 
-    VkPhysicalDevice phy_dev;
-    phy_dev_count = 1;
-    res = vkEnumeratePhysicalDevices(instance, &phy_dev_count, &phy_dev);
-    if ((res != VK_SUCCESS && res != VK_INCOMPLETE) || phy_dev_count != 1) {
-        vkDestroyInstance(instance, NULL);
-        return false;
+    cru_vec_foreach(ext, &caps->instance_extensions) {
+        fprintf(f, "instance-extension %s %" PRIu32 "\n",
+                ext->extensionName, ext->specVersion);
     }
 
-    uint32_t queue_family_count;
-    vkGetPhysicalDeviceQueueFamilyProperties(phy_dev,
-                                             &queue_family_count, NULL);
-    *count = queue_family_count;
+    cru_vec_foreach(ext, &caps->device_extensions) {
+        fprintf(f, "device-extension %s %" PRIu32 "\n",
+                ext->extensionName, ext->specVersion);
+    }
+
+    if (fflush(f) != 0 || ferror(f))
+        return false;
+
+    return true;
+}
+
+static bool
+parse_ext(const char *s, struct runner_vk_ext_vec *exts)
+{
+    VkExtensionProperties ext = {0};
+    int n = 0;
+
+    static_assert(VK_MAX_EXTENSION_NAME_SIZE == 256,
+                  "the scanf width below is VK_MAX_EXTENSION_NAME_SIZE - 1");
+    if (sscanf(s, "%255s %" SCNu32 "%n", ext.extensionName,
+               &ext.specVersion, &n) != 2 || s[n] != '\0')
+        return false;
+
+    *cru_vec_push(exts, 1) = ext;
+    return true;
+}
+
+static bool
+parse_features(const char *s, VkPhysicalDeviceFeatures *f)
+{
+    VkBool32 *features = (VkBool32 *) f;
+
+    if (strlen(s) != NUM_FEATURES)
+        return false;
+
+    for (size_t i = 0; i < NUM_FEATURES; i++) {
+        if (s[i] != '0' && s[i] != '1')
+            return false;
+
+        features[i] = s[i] == '1';
+    }
 
-    vkDestroyInstance(instance, NULL);
     return true;
 }
+
+/// Parse the output of runner_vk_caps_write(). The \a name of the stream
+/// appears only in error messages.
+bool
+runner_vk_caps_read(runner_vk_caps_t *caps, FILE *f, const char *name)
+{
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t line_len;
+    uint32_t line_num = 0;
+    bool result = false;
+
+    *caps = (runner_vk_caps_t) {0};
+
+    while ((line_len = getline(&line, &line_cap, f)) != -1) {
+        const char *value;
+        bool ok;
+
+        ++line_num;
+
+        if (line_len > 0 && line[line_len - 1] == '\n')
+            line[--line_len] = '\0';
+
+        if (line_len == 0)
+            continue;
+
+        value = strchr(line, ' ');
+        if (!value) {
+            loge("%s:%u: malformed line", name, line_num);
+            goto cleanup;
+        }
+
+        *(char *) value++ = '\0';
+
+        if (cru_streq(line, "api-version")) {
+            ok = sscanf(value, "%" SCNu32, &caps->api_version) == 1;
+        } else if (cru_streq(line, "features")) {
+            ok = parse_features(value, &caps->features);
+        } else if (cru_streq(line, "queue-family")) {
+            ok = sscanf(value, "%" SCNx32, cru_vec_push(&caps->queue_flags,
+                                                       1)) == 1;
+        } else if (cru_streq(line, "instance-extension")) {
+            ok = parse_ext(value, &caps->instance_extensions);
+        } else if (cru_streq(line, "device-extension")) {
+            ok = parse_ext(value, &caps->device_extensions);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            loge("%s:%u: malformed line", name, line_num);
+            goto cleanup;
+        }
+    }
+
+    if (ferror(f)) {
+        loge("failed to read %s", name);
+        goto cleanup;
+    }
+
+    if (caps->queue_flags.len == 0) {
+        loge("%s: incomplete device capabilities", name);
+        goto cleanup;
+    }
+
+    result = true;
+
+cleanup:
+    free(line);
+    if (!result)
+        runner_vk_caps_finish(caps);
+    return result;
+}
+
+void
+runner_vk_caps_get_test_caps(const runner_vk_caps_t *caps,
+                             uint32_t queue_family_index,
+                             test_caps_t *test_caps)
+{
+    assert(queue_family_index < caps->queue_flags.len);
+
+    *test_caps = (test_caps_t) {
+        .api_version = caps->api_version,
+        .features = caps->features,
+        .queue_flags = caps->queue_flags.data[queue_family_index],
+        .instance_extension_count = caps->instance_extensions.len,
+        .instance_extensions = caps->instance_extensions.data,
+        .device_extension_count = caps->device_extensions.len,
+        .device_extensions = caps->device_extensions.data,
+    };
+}
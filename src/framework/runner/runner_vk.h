@@ -19,9 +19,43 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+
 #pragma once
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+
+#include "framework/test/test_def.h"
+#include "util/cru_vec.h"
+#include "util/vk_wrapper.h"
+
+typedef struct runner_vk_caps runner_vk_caps_t;
+
+CRU_VEC_DEFINE(struct runner_vk_ext_vec, VkExtensionProperties)
+CRU_VEC_DEFINE(struct runner_vk_queue_flags_vec, VkQueueFlags)
+
+/// \brief The capabilities of the physical device that tests run on.
+///
+/// The master probes these once, before dispatching any test, so that it can
+/// skip tests whose requirements are unmet without starting them.
+struct runner_vk_caps {
+    uint32_t api_version;
+    VkPhysicalDeviceFeatures features;
+
+    /// Flags of each queue family, indexed by queue family index.
+    struct runner_vk_queue_flags_vec queue_flags;
+
+    struct runner_vk_ext_vec instance_extensions;
+    struct runner_vk_ext_vec device_extensions;
+};
+
+bool runner_vk_probe_caps(uint32_t device_id, runner_vk_caps_t *caps);
+void runner_vk_caps_finish(runner_vk_caps_t *caps);
+
+bool runner_vk_caps_write(const runner_vk_caps_t *caps, FILE *f);
+bool runner_vk_caps_read(runner_vk_caps_t *caps, FILE *f, const char *name);
 
-bool runner_get_vulkan_queue_count(uint32_t *count);
+void runner_vk_caps_get_test_caps(const runner_vk_caps_t *caps,
+                                  uint32_t queue_family_index,
+                                  test_caps_t *test_caps);
@@ -20,16 +20,35 @@
 // IN THE SOFTWARE.
 
 #include <limits.h>
+#include <string.h>
 
 #include <fcntl.h>
 #include <unistd.h>
 
+#include "util/trace.h"
+#include "util/xalloc.h"
+
 #include "runner.h"
 #include "slave.h"
 
 static int dispatch_fd;
 static int result_fd;
 
+/// A test whose cleanup phase overlaps the slave's later tests.
+typedef struct cleanup_slot {
+    test_t *test;
+    const test_def_t *def;
+    uint32_t queue_family_index;
+    uint64_t start_ns;
+} cleanup_slot_t;
+
+/// Tests in their cleanup phase, oldest first. At most
+/// runner_opts_t::cleanup_depth.
+static struct {
+    uint32_t len;
+    cleanup_slot_t *data;
+} cleaning;
+
 /// Return NULL if the pipe is empty or has errors.
 static void
 slave_recv_test(const test_def_t **test_def, uint32_t *queue_family_index)
@@ -48,14 +67,27 @@ slave_recv_test(const test_def_t **test_def, uint32_t *queue_family_index)
     *test_def = pk.test_def;
 }
 
+static bool
+slave_send_started(const test_def_t *def, uint32_t queue_family_index)
+{
+    const result_packet_t pk = {
+        .test_def = def,
+        .queue_family_index = queue_family_index,
+        .started = true,
+    };
+
+    return write(result_fd, &pk, sizeof(pk)) == sizeof(pk);
+}
+
 static bool
 slave_send_result(const test_def_t *def, uint32_t queue_family_index,
-                  test_result_t result)
+                  test_result_t result, uint64_t duration_ns)
 {
     const result_packet_t pk = {
         .test_def = def,
         .queue_family_index = queue_family_index,
         .result = result,
+        .duration_ns = duration_ns,
     };
 
     static_assert(sizeof(pk) <= PIPE_BUF, "result packets will not be read "
@@ -64,22 +96,99 @@ slave_send_result(const test_def_t *def, uint32_t queue_family_index,
     return write(result_fd, &pk, sizeof(pk)) == sizeof(pk);
 }
 
+/// Wait for the oldest test in cleanup to stop, and report its result.
+static void
+slave_finish_oldest(void)
+{
+    cleanup_slot_t slot = cleaning.data[0];
+    test_result_t result;
+    uint64_t stop_ns;
+
+    assert(cleaning.len > 0);
+
+    --cleaning.len;
+    memmove(cleaning.data, cleaning.data + 1,
+            cleaning.len * sizeof(cleaning.data[0]));
+
+    // The test may have stopped long ago, while later tests ran. Measure it
+    // only until it stopped.
+    result = finish_test_def(slot.test, &stop_ns);
+    slave_send_result(slot.def, slot.queue_family_index, result,
+                      stop_ns - slot.start_ns);
+
+    // runner_get_time_ns(), the test's stop time and the trace share a
+    // clock.
+    trace_span_ns("test", slot.def->name, slot.start_ns, stop_ns);
+}
+
+/// Run the test until it enters its cleanup phase, then queue it to finish
+/// in the background. Each test's result is still reported only after the
+/// test stops, so a failure during cleanup is attributed to its own test.
+static void
+slave_run_test_overlapped(const test_def_t *def, uint32_t queue_family_index,
+                          uint64_t start_ns)
+{
+    test_t *test;
+
+    test = start_test_def(def, queue_family_index);
+    if (!test) {
+        slave_send_result(def, queue_family_index, TEST_RESULT_FAIL,
+                          runner_get_time_ns() - start_ns);
+        return;
+    }
+
+    test_wait_cleanup(test);
+
+    if (cleaning.len == runner_opts.cleanup_depth)
+        slave_finish_oldest();
+
+    cleaning.data[cleaning.len++] = (cleanup_slot_t) {
+        .test = test,
+        .def = def,
+        .queue_family_index = queue_family_index,
+        .start_ns = start_ns,
+    };
+}
+
 static void
 slave_loop(void)
 {
     const test_def_t *def;
 
+    if (runner_opts.cleanup_depth > 0) {
+        cleaning.data = xmalloc(runner_opts.cleanup_depth *
+                                sizeof(cleaning.data[0]));
+    }
+
     for (;;) {
         test_result_t result;
         uint32_t queue_family_index;
+        uint64_t start_ns;
 
+        start_ns = trace_start();
         slave_recv_test(&def, &queue_family_index);
+        trace_span("recv", NULL, start_ns);
         if (!def)
-            return;
+            break;
+
+        slave_send_started(def, queue_family_index);
+        start_ns = runner_get_time_ns();
+
+        if (runner_opts.cleanup_depth > 0) {
+            slave_run_test_overlapped(def, queue_family_index, start_ns);
+            continue;
+        }
 
         result = run_test_def(def, queue_family_index);
-        slave_send_result(def, queue_family_index, result);
+        slave_send_result(def, queue_family_index, result,
+                          runner_get_time_ns() - start_ns);
+        trace_span("test", def->name, start_ns);
     }
+
+    while (cleaning.len > 0)
+        slave_finish_oldest();
+
+    free(cleaning.data);
 }
 
 void
@@ -92,4 +201,5 @@ slave_run(int _dispatch_fd, int _result_fd)
     result_fd = _result_fd;
 
     slave_loop();
+    trace_write_process("crucible slave");
 }
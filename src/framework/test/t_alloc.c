@@ -0,0 +1,276 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <inttypes.h>
+
+#include "test.h"
+#include "t_alloc.h"
+
+/// Maximum number of leaked allocations that t_alloc_check_leaks() reports
+/// individually. The per-scope summary always covers all of them.
+#define MAX_REPORTED_LEAKS 16
+
+/// Each allocation made through test::alloc::cb is immediately preceded by
+/// this header.
+struct t_alloc_header {
+    t_alloc_header_t *prev;
+    t_alloc_header_t *next;
+
+    /// The pointer returned by posix_memalign().
+    void *base;
+
+    size_t size;
+    uint64_t serial;
+    VkSystemAllocationScope scope;
+};
+
+static const char *
+scope_name(VkSystemAllocationScope scope)
+{
+    switch (scope) {
+    case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+        return "command";
+    case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+        return "object";
+    case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:
+        return "cache";
+    case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:
+        return "device";
+    case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE:
+        return "instance";
+    default:
+        return "unknown";
+    }
+}
+
+static t_alloc_header_t *
+get_header(void *mem)
+{
+    return (t_alloc_header_t *) mem - 1;
+}
+
+static void
+lock(test_t *t)
+{
+    if (pthread_mutex_lock(&t->alloc.mutex))
+        log_abort("%s: failed to lock mutex", __func__);
+}
+
+static void
+unlock(test_t *t)
+{
+    if (pthread_mutex_unlock(&t->alloc.mutex))
+        log_abort("%s: failed to unlock mutex", __func__);
+}
+
+static void
+link_header(test_t *t, t_alloc_header_t *h)
+{
+    h->prev = NULL;
+    h->next = t->alloc.live;
+
+    if (h->next)
+        h->next->prev = h;
+
+    t->alloc.live = h;
+}
+
+static void
+unlink_header(test_t *t, t_alloc_header_t *h)
+{
+    if (h->prev)
+        h->prev->next = h->next;
+    else
+        t->alloc.live = h->next;
+
+    if (h->next)
+        h->next->prev = h->prev;
+}
+
+static void *
+test_vk_alloc(void *pUserData, size_t size, size_t alignment,
+              VkSystemAllocationScope scope)
+{
+    test_t *t = pUserData;
+    void *base;
+
+    alignment = MAX(alignment, _Alignof(max_align_t));
+
+    // Place the header in the padding before the aligned user pointer.
+    const size_t pad = cru_align_size(sizeof(t_alloc_header_t), alignment);
+
+    if (posix_memalign(&base, alignment, pad + size))
+        return NULL;
+
+    void *mem = (uint8_t *) base + pad;
+    memset(mem, 139, size);
+
+    t_alloc_header_t *h = get_header(mem);
+    h->base = base;
+    h->size = size;
+    h->scope = scope;
+
+    lock(t);
+    h->serial = t->alloc.serial++;
+    link_header(t, h);
+    unlock(t);
+
+    return mem;
+}
+
+static void
+test_vk_free(void *pUserData, void *pMem)
+{
+    test_t *t = pUserData;
+
+    if (!pMem)
+        return;
+
+    t_alloc_header_t *h = get_header(pMem);
+
+    lock(t);
+    unlink_header(t, h);
+    unlock(t);
+
+    free(h->base);
+}
+
+static void *
+test_vk_realloc(void *pUserData, void *pOriginal, size_t size,
+                size_t alignment, VkSystemAllocationScope scope)
+{
+    if (!pOriginal)
+        return test_vk_alloc(pUserData, size, alignment, scope);
+
+    if (size == 0) {
+        test_vk_free(pUserData, pOriginal);
+        return NULL;
+    }
+
+    t_alloc_header_t *old = get_header(pOriginal);
+
+    // realloc() cannot honor the alignment, so always move the allocation.
+    void *mem = test_vk_alloc(pUserData, size, alignment, scope);
+    if (!mem)
+        return NULL;
+
+    memcpy(mem, pOriginal, MIN(size, old->size));
+
+    // The allocation is logically the same, so it keeps its serial number.
+    get_header(mem)->serial = old->serial;
+
+    test_vk_free(pUserData, pOriginal);
+
+    return mem;
+}
+
+static void
+test_vk_dummy_notify(void *pUserData, size_t size,
+                     VkInternalAllocationType allocationType,
+                     VkSystemAllocationScope allocationScope)
+{ }
+
+void
+t_alloc_init(test_t *t)
+{
+    ASSERT_TEST_IN_PRESTART_PHASE(t);
+
+    t->alloc.cb = (VkAllocationCallbacks) {
+        .pUserData = t,
+        .pfnAllocation = test_vk_alloc,
+        .pfnReallocation = test_vk_realloc,
+        .pfnFree = test_vk_free,
+        .pfnInternalAllocation = test_vk_dummy_notify,
+        .pfnInternalFree = test_vk_dummy_notify,
+    };
+
+    if (pthread_mutex_init(&t->alloc.mutex, NULL)) {
+        // Abort to avoid destroying an uninitialized mutex later.
+        loge("%s: failed to init allocation mutex", string_data(&t->name));
+        abort();
+    }
+}
+
+void
+t_alloc_finish(test_t *t)
+{
+    pthread_mutex_destroy(&t->alloc.mutex);
+}
+
+/// Mark all currently live allocations as the baseline for
+/// t_alloc_check_leaks().
+void
+t_alloc_snapshot(test_t *t)
+{
+    lock(t);
+    t->alloc.snapshot_serial = t->alloc.serial;
+    unlock(t);
+}
+
+/// Return false, and log each leak, if any allocation made since
+/// t_alloc_snapshot() is still live.
+bool
+t_alloc_check_leaks(test_t *t)
+{
+    size_t count[VK_SYSTEM_ALLOCATION_SCOPE_RANGE_SIZE] = {0};
+    size_t bytes[VK_SYSTEM_ALLOCATION_SCOPE_RANGE_SIZE] = {0};
+    size_t num_leaks = 0;
+    const char *name = string_data(&t->name);
+
+    lock(t);
+
+    for (t_alloc_header_t *h = t->alloc.live; h; h = h->next) {
+        if (h->serial < t->alloc.snapshot_serial)
+            continue;
+
+        if (num_leaks < MAX_REPORTED_LEAKS) {
+            loge("%s: leaked allocation #%"PRIu64": %zu bytes, scope %s",
+                 name, h->serial, h->size, scope_name(h->scope));
+        }
+
+        if (h->scope < VK_SYSTEM_ALLOCATION_SCOPE_RANGE_SIZE) {
+            count[h->scope] += 1;
+            bytes[h->scope] += h->size;
+        }
+
+        ++num_leaks;
+    }
+
+    unlock(t);
+
+    if (num_leaks == 0)
+        return true;
+
+    if (num_leaks > MAX_REPORTED_LEAKS) {
+        loge("%s: ... and %zu more leaked allocations", name,
+             num_leaks - MAX_REPORTED_LEAKS);
+    }
+
+    for (uint32_t i = 0; i < VK_SYSTEM_ALLOCATION_SCOPE_RANGE_SIZE; i++) {
+        if (count[i] == 0)
+            continue;
+
+        loge("%s: leaked %zu allocations totaling %zu bytes in scope %s",
+             name, count[i], bytes[i], scope_name(i));
+    }
+
+    return false;
+}
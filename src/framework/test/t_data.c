@@ -21,6 +21,7 @@
 
 #include "util/string.h"
 #include "test.h"
+#include "t_phase_setup.h"
 
 const VkInstance *
 __t_instance(void)
@@ -94,13 +95,15 @@ __t_queue_idx(int q)
     return &t->vk.queue[q];
 }
 
-const VkDescriptorPool *
-__t_descriptor_pool(void)
+const QoDescriptorAllocator *
+__t_descriptor_allocator(void)
 {
     ASSERT_TEST_IN_MAJOR_PHASE;
     GET_CURRENT_TEST(t);
 
-    return &t->vk.descriptor_pool;
+    t_setup_descriptor_allocator();
+
+    return &t->vk.descriptor_allocator;
 }
 
 const VkCommandPool *
@@ -109,6 +112,8 @@ __t_cmd_pool(void)
     ASSERT_TEST_IN_MAJOR_PHASE;
     GET_CURRENT_TEST(t);
 
+    t_setup_cmd_pool(t_queue_family_index);
+
     return &t->vk.cmd_pool[t_queue_family_index];
 }
 
@@ -118,6 +123,8 @@ __t_cmd_pool_idx(int q)
     ASSERT_TEST_IN_MAJOR_PHASE;
     GET_CURRENT_TEST(t);
 
+    t_setup_cmd_pool(q);
+
     return &t->vk.cmd_pool[q];
 }
 
@@ -127,6 +134,8 @@ __t_cmd_buffer(void)
     ASSERT_TEST_IN_MAJOR_PHASE;
     GET_CURRENT_TEST(t);
 
+    t_setup_cmd_buffer();
+
     return &t->vk.cmd_buffer;
 }
 
@@ -137,6 +146,7 @@ __t_color_image(void)
     GET_CURRENT_TEST(t);
 
     t_assert(!t->def->no_image);
+    t_setup_framebuffer();
 
     return &t->vk.color_image;
 }
@@ -148,6 +158,7 @@ __t_color_image_view(void)
     GET_CURRENT_TEST(t);
 
     t_assert(!t->def->no_image);
+    t_setup_framebuffer();
 
     return &t->vk.color_image_view;
 }
@@ -159,6 +170,7 @@ __t_depthstencil_image(void)
     GET_CURRENT_TEST(t);
 
     t_assert(!t->def->no_image);
+    t_setup_framebuffer();
     t_assert(t->vk.ds_image != VK_NULL_HANDLE);
 
     return &t->vk.ds_image;
@@ -171,6 +183,7 @@ __t_depthstencil_image_view(void)
     GET_CURRENT_TEST(t);
 
     t_assert(!t->def->no_image);
+    t_setup_framebuffer();
     t_assert(t->vk.depthstencil_image_view != VK_NULL_HANDLE);
 
     return &t->vk.depthstencil_image_view;
@@ -183,6 +196,7 @@ __t_render_pass(void)
     GET_CURRENT_TEST(t);
 
     t_assert(!t->def->no_image);
+    t_setup_framebuffer();
 
     return &t->vk.render_pass;
 }
@@ -194,6 +208,7 @@ __t_framebuffer(void)
     GET_CURRENT_TEST(t);
 
     t_assert(!t->def->no_image);
+    t_setup_framebuffer();
 
     return &t->vk.framebuffer;
 }
@@ -204,6 +219,8 @@ __t_pipeline_cache(void)
     ASSERT_TEST_IN_MAJOR_PHASE;
     GET_CURRENT_TEST(t);
 
+    t_setup_pipeline_cache();
+
     return &t->vk.pipeline_cache;
 }
 
@@ -256,6 +273,41 @@ __t_user_data(void)
     return t->def->user_data;
 }
 
+/// Load the reference image if it is not yet loaded.
+///
+/// The image is not loaded during setup if the reference index provides its
+/// size. The first call must not race with another test thread.
+cru_image_t *
+t_load_ref_image(void)
+{
+    GET_CURRENT_TEST(t);
+
+    assert(!t->opt.bootstrap);
+
+    if (!t->ref.image) {
+        t->ref.image =
+            t_new_cru_image_from_filename(string_data(&t->ref.filename));
+    }
+
+    return t->ref.image;
+}
+
+/// \see t_load_ref_image()
+cru_image_t *
+t_load_ref_stencil_image(void)
+{
+    GET_CURRENT_TEST(t);
+
+    assert(!t->opt.bootstrap);
+
+    if (!t->ref.stencil_image) {
+        t->ref.stencil_image =
+            t_new_cru_image_from_filename(string_data(&t->ref.stencil_filename));
+    }
+
+    return t->ref.stencil_image;
+}
+
 cru_image_t *
 t_ref_image(void)
 {
@@ -264,7 +316,10 @@ t_ref_image(void)
 
     t_assert(!t->def->no_image);
 
-    return t->ref.image;
+    if (t->opt.bootstrap)
+        return NULL;
+
+    return t_load_ref_image();
 }
 
 cru_image_t *
@@ -276,5 +331,8 @@ t_ref_stencil_image(void)
     t_assert(t->def->ref_stencil_filename);
     t_assert(!t->def->no_image);
 
-    return t->ref.stencil_image;
+    if (t->opt.bootstrap)
+        return NULL;
+
+    return t_load_ref_stencil_image();
 }
@@ -23,6 +23,8 @@
 #include <inttypes.h>
 #include "test.h"
 
+#include "util/trace.h"
+
 bool
 t_is_dump_enabled(void)
 {
@@ -46,7 +48,10 @@ t_dump_seq_image(cru_image_t *image)
 
     string_t filename = STRING_INIT;
     string_printf(&filename, "%s.seq%04" PRIu64 ".png", t_name, seq);
+
+    const uint64_t trace_ns = trace_start();
     cru_image_write_file(image, string_data(&filename));
+    trace_span("dump", t->def->name, trace_ns);
 }
 
 void printflike(2, 3)
@@ -75,5 +80,7 @@ t_dump_image_fv(cru_image_t *image, const char *format, va_list va)
     string_append_char(&filename, '.');
     string_vappendf(&filename, format, va);
 
+    const uint64_t trace_ns = trace_start();
     cru_image_write_file(image, string_data(&filename));
+    trace_span("dump", t->def->name, trace_ns);
 }
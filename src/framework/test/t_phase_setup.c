@@ -23,48 +23,18 @@
 #include <inttypes.h>
 #include "test.h"
 #include "t_phase_setup.h"
+#include "t_thread.h"
+#include "framework/test/test_def.h"
+#include "util/cru_ref_index.h"
 
 /* Maximum supported physical devs. */
 #define MAX_PHYSICAL_DEVS 4
 
-static void *
-test_vk_alloc(void *pUserData, size_t size, size_t alignment,
-              VkSystemAllocationScope scope)
-{
-    assert(pUserData == (void *)0xdeadbeef);
-    void *mem = malloc(size);
-    memset(mem, 139, size);
-    return mem;
-}
-
-static void *
-test_vk_realloc(void *pUserData, void *pOriginal, size_t size,
-                size_t alignment, VkSystemAllocationScope scope)
-{
-    assert(pUserData == (void *)0xdeadbeef);
-    return realloc(pOriginal, size);
-}
-
-static void
-test_vk_free(void *pUserData, void *pMem)
-{
-    assert(pUserData == (void *)0xdeadbeef);
-    free(pMem);
-}
+struct t_lazy_ctx {
+    test_t *t;
 
-static void
-test_vk_dummy_notify(void *pUserData, size_t size,
-                     VkInternalAllocationType allocationType,
-                     VkSystemAllocationScope allocationScope)
-{ }
-
-static const VkAllocationCallbacks test_alloc_cb = {
-    .pUserData = (void *)0xdeadbeef,
-    .pfnAllocation = test_vk_alloc,
-    .pfnReallocation = test_vk_realloc,
-    .pfnFree = test_vk_free,
-    .pfnInternalAllocation = test_vk_dummy_notify,
-    .pfnInternalFree = test_vk_dummy_notify,
+    /// The calling thread's cleanup stack.
+    cru_cleanup_stack_t *cleanup;
 };
 
 static void
@@ -89,14 +59,59 @@ t_setup_phys_dev(void)
 }
 
 static void
-t_setup_framebuffer(void)
+t_lazy_unlock(void *arg)
+{
+    struct t_lazy_ctx *ctx = arg;
+
+    current.cleanup = ctx->cleanup;
+    pthread_mutex_unlock(&ctx->t->vk.lazy_mutex);
+}
+
+/// Run init() unless it has already run, setting \a done after it returns.
+///
+/// The first thread to get here runs init() with test::vk::lazy_mutex held,
+/// and with its cleanup commands going to test::vk::lazy_cleanup rather than
+/// to the thread's own stack. So the lazily created objects are destroyed in
+/// the reverse order of their creation, before the device, no matter which
+/// test thread created them. The mutex is recursive so that init() may
+/// itself create objects lazily.
+static void
+t_lazy_init(atomic_bool *done, void (*init)(void *arg), void *arg)
 {
-    ASSERT_TEST_IN_SETUP_PHASE;
     GET_CURRENT_TEST(t);
 
-    if (t->def->no_image)
+    if (atomic_load_explicit(done, memory_order_acquire))
         return;
 
+    struct t_lazy_ctx ctx = {
+        .t = t,
+        .cleanup = current.cleanup,
+    };
+
+    if (pthread_mutex_lock(&t->vk.lazy_mutex))
+        t_failf("%s: failed to lock mutex", __func__);
+
+    // If init() fails, then this thread may leave its path in t_end() while
+    // holding the mutex.
+    test_thread_exit_handler_t unlock_handler;
+    test_thread_push_exit_handler(&unlock_handler, t_lazy_unlock, &ctx);
+
+    if (!atomic_load_explicit(done, memory_order_relaxed)) {
+        current.cleanup = t->vk.lazy_cleanup;
+        init(arg);
+        atomic_store_explicit(done, true, memory_order_release);
+    }
+
+    test_thread_pop_exit_handler(true);
+}
+
+static void
+t_init_framebuffer(void *ignore)
+{
+    GET_CURRENT_TEST(t);
+
+    assert(!t->def->no_image);
+
     VkImageView attachments[2];
     uint32_t n_attachments = 0;
 
@@ -282,33 +297,98 @@ t_setup_framebuffer(void)
         .pAttachments = attachments);
 }
 
+/// The allocator's pools lack FREE_DESCRIPTOR_SET_BIT. See
+/// qoAllocateDescriptorSet().
 static void
-t_setup_descriptor_pool(void)
+t_init_descriptor_allocator(void *ignore)
 {
-    ASSERT_TEST_IN_SETUP_PHASE;
     GET_CURRENT_TEST(t);
 
-    VkDescriptorPoolSize pool_sizes[VK_DESCRIPTOR_TYPE_RANGE_SIZE];
-    for (uint32_t i = 0; i < VK_DESCRIPTOR_TYPE_RANGE_SIZE; i++) {
-        pool_sizes[i].type = i;
-        pool_sizes[i].descriptorCount = 5;
-    }
+    t->vk.descriptor_allocator = qoCreateDescriptorAllocator(t->vk.device);
+}
 
-    const VkDescriptorPoolCreateInfo create_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .pNext = NULL,
-        .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
-        .maxSets = 8,
-        .poolSizeCount = VK_DESCRIPTOR_TYPE_RANGE_SIZE,
-        .pPoolSizes = pool_sizes
-    };
+static void
+t_init_pipeline_cache(void *ignore)
+{
+    GET_CURRENT_TEST(t);
+
+    t->vk.pipeline_cache = qoCreatePipelineCache(t->vk.device);
+}
 
-    VkResult res = vkCreateDescriptorPool(t->vk.device, &create_info, NULL,
-                                          &t->vk.descriptor_pool);
+static void
+t_init_cmd_pool(void *arg)
+{
+    GET_CURRENT_TEST(t);
+
+    uint32_t q = (uintptr_t) arg;
+
+    VkResult res = vkCreateCommandPool(t->vk.device,
+        &(VkCommandPoolCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .queueFamilyIndex = q,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        }, NULL, &t->vk.cmd_pool[q]);
     t_assert(res == VK_SUCCESS);
-    t_assert(t->vk.descriptor_pool != VK_NULL_HANDLE);
+    t_cleanup_push_vk_cmd_pool(t->vk.device, t->vk.cmd_pool[q]);
+}
+
+static void
+t_init_cmd_buffer(void *ignore)
+{
+    GET_CURRENT_TEST(t);
+
+    t->vk.cmd_buffer = qoAllocateCommandBuffer(t->vk.device, t_cmd_pool);
+
+    qoBeginCommandBuffer(t->vk.cmd_buffer);
+}
+
+/// Create the default color and depthstencil images, render pass, and
+/// framebuffer if they don't exist yet. Illegal for no_image tests.
+void
+t_setup_framebuffer(void)
+{
+    GET_CURRENT_TEST(t);
+
+    t_lazy_init(&t->vk.has_framebuffer, t_init_framebuffer, NULL);
+}
+
+/// \see t_setup_framebuffer()
+void
+t_setup_descriptor_allocator(void)
+{
+    GET_CURRENT_TEST(t);
 
-    t_cleanup_push_vk_descriptor_pool(t->vk.device, t->vk.descriptor_pool);
+    t_lazy_init(&t->vk.has_descriptor_allocator, t_init_descriptor_allocator,
+                NULL);
+}
+
+/// \see t_setup_framebuffer()
+void
+t_setup_pipeline_cache(void)
+{
+    GET_CURRENT_TEST(t);
+
+    t_lazy_init(&t->vk.has_pipeline_cache, t_init_pipeline_cache, NULL);
+}
+
+/// \see t_setup_framebuffer()
+void
+t_setup_cmd_pool(uint32_t q)
+{
+    GET_CURRENT_TEST(t);
+
+    t_assert(q < t->vk.queue_family_count);
+    t_lazy_init(&t->vk.has_cmd_pool[q], t_init_cmd_pool, (void *)(uintptr_t) q);
+}
+
+/// Allocate the default command buffer from the test queue family's pool
+/// and begin it, if that isn't done yet.
+void
+t_setup_cmd_buffer(void)
+{
+    GET_CURRENT_TEST(t);
+
+    t_lazy_init(&t->vk.has_cmd_buffer, t_init_cmd_buffer, NULL);
 }
 
 static VkBool32 debug_cb(VkDebugReportFlagsEXT flags,
@@ -345,6 +425,46 @@ static VkBool32 debug_cb(VkDebugReportFlagsEXT flags,
     return false;
 }
 
+/// Remove from the array the extensions that the test doesn't declare,
+/// keeping their order.
+static void
+t_filter_extensions(VkExtensionProperties *props, uint32_t *count)
+{
+    GET_CURRENT_TEST(t);
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < *count; ++i) {
+        const char *name = props[i].extensionName;
+
+        // The framework itself uses VK_EXT_debug_report. Most device
+        // extensions depend on VK_KHR_get_physical_device_properties2, so
+        // keep it rather than make every test declare it.
+        if (test_def_requires_ext(t->def, name) ||
+            cru_streq(name, "VK_EXT_debug_report") ||
+            cru_streq(name, "VK_KHR_get_physical_device_properties2")) {
+            props[n++] = props[i];
+        }
+    }
+
+    *count = n;
+}
+
+/// Cleanup callback. Log how the test used the shader module cache. The
+/// counts are per process, so with thread isolation they include concurrent
+/// tests.
+static void
+t_log_shader_cache_stats(void *data)
+{
+    uint64_t *start = data;
+    uint64_t hits, misses;
+
+    qoGetShaderModuleCacheStats(&hits, &misses);
+    logi("shader module cache: %"PRIu64" hits, %"PRIu64" misses",
+         hits - start[0], misses - start[1]);
+
+    free(start);
+}
+
 void
 t_setup_vulkan(void)
 {
@@ -365,6 +485,11 @@ t_setup_vulkan(void)
         &t->vk.instance_extension_count, t->vk.instance_extension_props);
     t_assert(res == VK_SUCCESS);
 
+    if (t->opt.minimal_device) {
+        t_filter_extensions(t->vk.instance_extension_props,
+                            &t->vk.instance_extension_count);
+    }
+
     ext_names = malloc(t->vk.instance_extension_count * sizeof(*ext_names));
     t_assert(ext_names);
 
@@ -406,10 +531,10 @@ t_setup_vulkan(void)
             },
             .enabledExtensionCount = t->vk.instance_extension_count,
             .ppEnabledExtensionNames = ext_names,
-        }, &test_alloc_cb, &t->vk.instance);
+        }, &t->alloc.cb, &t->vk.instance);
     free(ext_names);
     t_assert(res == VK_SUCCESS);
-    t_cleanup_push_vk_instance(t->vk.instance, &test_alloc_cb);
+    t_cleanup_push_vk_instance(t->vk.instance, &t->alloc.cb);
 
     if (has_debug_report) {
 #define RESOLVE(func)\
@@ -446,31 +571,6 @@ t_setup_vulkan(void)
                                              &t->vk.queue_family_count,
                                              t->vk.queue_family_props);
 
-    uint32_t qf =
-        t->vk.queue_family_props[t_queue_family_index].queueFlags;
-    if (qf & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
-        qf &= ~VK_QUEUE_TRANSFER_BIT;
-    qf &= VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT |
-        VK_QUEUE_TRANSFER_BIT;
-    switch (t->def->queue_setup) {
-    case QUEUE_SETUP_GFX_AND_COMPUTE:
-        if (qf != (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
-            t_end(TEST_RESULT_SKIP);
-        break;
-    case QUEUE_SETUP_GRAPHICS:
-        if ((qf & VK_QUEUE_GRAPHICS_BIT) == 0)
-            t_end(TEST_RESULT_SKIP);
-        break;
-    case QUEUE_SETUP_COMPUTE:
-        if ((qf & VK_QUEUE_COMPUTE_BIT) == 0)
-            t_end(TEST_RESULT_SKIP);
-        break;
-    case QUEUE_SETUP_TRANSFER:
-        if (qf == 0 /* gfx and compute imply transfer */)
-            t_end(TEST_RESULT_SKIP);
-        break;
-    }
-
     qoGetPhysicalDeviceMemoryProperties(t->vk.physical_dev,
                                         &t->vk.physical_dev_mem_props);
 
@@ -487,6 +587,31 @@ t_setup_vulkan(void)
         &t->vk.device_extension_count, t->vk.device_extension_props);
     t_assert(res == VK_SUCCESS);
 
+    if (t->opt.minimal_device) {
+        t_filter_extensions(t->vk.device_extension_props,
+                            &t->vk.device_extension_count);
+    }
+
+    // The runner usually skips tests with unmet requirements before
+    // dispatching them. Check again here for runs that bypass that probe.
+    test_caps_t caps = {
+        .api_version = t->vk.physical_dev_props.apiVersion,
+        .features = t->vk.physical_dev_features,
+        .queue_flags =
+            t->vk.queue_family_props[t_queue_family_index].queueFlags,
+        .instance_extension_count = t->vk.instance_extension_count,
+        .instance_extensions = t->vk.instance_extension_props,
+        .device_extension_count = t->vk.device_extension_count,
+        .device_extensions = t->vk.device_extension_props,
+    };
+    string_t reason = STRING_INIT;
+    if (!test_def_check_caps(t->def, &caps, &reason)) {
+        char *msg = string_detach(&reason);
+        t_cleanup_push_free(msg);
+        t_skipf("%s", msg);
+    }
+    string_finish(&reason);
+
     ext_names = malloc(t->vk.device_extension_count * sizeof(*ext_names));
     t_assert(ext_names);
 
@@ -505,27 +630,69 @@ t_setup_vulkan(void)
         qci[i].pQueuePriorities = &priority;
     }
 
+    // test_def_check_caps() has already checked that the device supports the
+    // required features.
     VkPhysicalDeviceFeatures pdf;
-    vkGetPhysicalDeviceFeatures(t->vk.physical_dev, &pdf);
+    if (t->opt.minimal_device)
+        pdf = t->def->required_features;
+    else
+        pdf = t->vk.physical_dev_features;
     pdf.robustBufferAccess = t->def->robust_buffer_access;
 
+    // Every device that exposes VK_KHR_timeline_semaphore supports its
+    // feature, so enable the feature along with the extension. Qonos's
+    // timeline helpers need it.
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+        .timelineSemaphore = true,
+    };
+    bool has_timeline_semaphore = false;
+    for (uint32_t i = 0; i < t->vk.device_extension_count; i++) {
+        if (!strcmp(ext_names[i], VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+            has_timeline_semaphore = true;
+    }
+
     res = vkCreateDevice(t->vk.physical_dev,
         &(VkDeviceCreateInfo) {
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+            .pNext = has_timeline_semaphore ? &timeline_features : NULL,
             .queueCreateInfoCount = t->vk.queue_family_count,
             .pQueueCreateInfos = qci,
             .enabledExtensionCount = t->vk.device_extension_count,
             .ppEnabledExtensionNames = ext_names,
             .pEnabledFeatures = &pdf,
-        }, NULL, &t->vk.device);
+        }, &t->alloc.cb, &t->vk.device);
     free(qci);
     free(ext_names);
     t_assert(res == VK_SUCCESS);
-    t_cleanup_push_vk_device(t->vk.device, NULL);
+    t_cleanup_push_vk_device(t->vk.device, &t->alloc.cb);
+
+    if (t->opt.verbose) {
+        uint64_t *start = xmalloc(2 * sizeof(*start));
+        qoGetShaderModuleCacheStats(&start[0], &start[1]);
+        t_cleanup_push_callback(t_log_shader_cache_stats, start);
+    }
 
-    t_setup_descriptor_pool();
+    // As with the extensions, report to the test only what it enabled.
+    if (t->opt.minimal_device)
+        t->vk.physical_dev_features = pdf;
 
-    t_setup_framebuffer();
+    if (t->opt.direct_dispatch) {
+        cru_vk_device_dispatch_init(&t->vk.dispatch, t->vk.device);
+        cru_vk_set_direct_dispatch(&t->vk.dispatch);
+
+        // The cleanup stack unwinds in reverse, so the table is cleared
+        // before the device is destroyed.
+        t_cleanup_push_callback(
+            (cru_cleanup_callback_func_t) cru_vk_clear_direct_dispatch,
+            &t->vk.dispatch);
+    }
+
+    // The default descriptor allocator, pipeline cache, command pools, command
+    // buffer, and framebuffer are created on first use. Tests that never use
+    // them don't pay for them.
+    t->vk.lazy_cleanup = cru_cleanup_create();
+    t_cleanup_push_cru_cleanup_stack(t->vk.lazy_cleanup);
 
     t->vk.queue =
         calloc(t->vk.queue_family_count, sizeof(*t->vk.queue));
@@ -536,23 +703,15 @@ t_setup_vulkan(void)
         vkGetDeviceQueue(t->vk.device, i, 0, &t->vk.queue[i]);
     }
 
-    t->vk.pipeline_cache = qoCreatePipelineCache(t->vk.device);
-
     t->vk.cmd_pool =
         calloc(t->vk.queue_family_count, sizeof(*t->vk.cmd_pool));
     t_assert(t->vk.cmd_pool);
     t_cleanup_push_free(t->vk.cmd_pool);
 
-    for (uint32_t i = 0; i < t->vk.queue_family_count; i++) {
-        res = vkCreateCommandPool(t->vk.device,
-            &(VkCommandPoolCreateInfo) {
-                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-                .queueFamilyIndex = i,
-                .flags = 0,
-            }, NULL, &t->vk.cmd_pool[i]);
-        t_assert(res == VK_SUCCESS);
-        t_cleanup_push_vk_cmd_pool(t->vk.device, t->vk.cmd_pool[i]);
-    }
+    t->vk.has_cmd_pool =
+        calloc(t->vk.queue_family_count, sizeof(*t->vk.has_cmd_pool));
+    t_assert(t->vk.has_cmd_pool);
+    t_cleanup_push_free(t->vk.has_cmd_pool);
 
     t->vk.graphics_and_compute_queue = -1;
     t->vk.graphics_queue = -1;
@@ -590,10 +749,6 @@ t_setup_vulkan(void)
         if (t->vk.transfer_queue < 0 && (qf & VK_QUEUE_TRANSFER_BIT))
             t->vk.transfer_queue = i;
     }
-
-    t->vk.cmd_buffer = qoAllocateCommandBuffer(t->vk.device, t_cmd_pool);
-
-    qoBeginCommandBuffer(t->vk.cmd_buffer);
 }
 
 void
@@ -602,27 +757,41 @@ t_setup_ref_images(void)
     ASSERT_TEST_IN_SETUP_PHASE;
     GET_CURRENT_TEST(t);
 
-    if (t->ref.image)
+    if (t->ref.image || t->ref.has_hash)
         return;
 
     assert(!t->def->no_image);
     assert(t->ref.filename.len > 0);
 
-    t->ref.image = t_new_cru_image_from_filename(string_data(&t->ref.filename));
-
-    t->ref.width = cru_image_get_width(t->ref.image);
-    t->ref.height = cru_image_get_height(t->ref.image);
+    // If the reference index knows the image, then take its size from the
+    // index and defer opening the image until a comparison needs it.
+    t->ref.has_hash = cru_ref_index_lookup(string_data(&t->ref.filename),
+                                           &t->ref.width, &t->ref.height,
+                                           &t->ref.hash);
+    if (!t->ref.has_hash) {
+        cru_image_t *image = t_load_ref_image();
+        t->ref.width = cru_image_get_width(image);
+        t->ref.height = cru_image_get_height(image);
+    }
 
     t_assert(t->ref.width > 0);
     t_assert(t->ref.height > 0);
 
     if (t->def->ref_stencil_filename) {
+        uint32_t width, height;
+
         assert(t->ref.stencil_filename.len > 0);
 
-        t->ref.stencil_image = t_new_cru_image_from_filename(
-            string_data(&t->ref.stencil_filename));
+        t->ref.has_stencil_hash = cru_ref_index_lookup(
+            string_data(&t->ref.stencil_filename),
+            &width, &height, &t->ref.stencil_hash);
+        if (!t->ref.has_stencil_hash) {
+            cru_image_t *image = t_load_ref_stencil_image();
+            width = cru_image_get_width(image);
+            height = cru_image_get_height(image);
+        }
 
-        t_assert(t->ref.width == cru_image_get_width(t->ref.stencil_image));
-        t_assert(t->ref.height == cru_image_get_height(t->ref.stencil_image));
+        t_assert(t->ref.width == width);
+        t_assert(t->ref.height == height);
     }
 }
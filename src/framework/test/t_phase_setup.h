@@ -21,5 +21,13 @@
 
 #pragma once
 
+#include <stdint.h>
+
 void t_setup_vulkan(void);
 void t_setup_ref_images(void);
+
+void t_setup_framebuffer(void);
+void t_setup_descriptor_allocator(void);
+void t_setup_pipeline_cache(void);
+void t_setup_cmd_pool(uint32_t q);
+void t_setup_cmd_buffer(void);
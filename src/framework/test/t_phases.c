@@ -20,10 +20,13 @@
 // IN THE SOFTWARE.
 
 #include "test.h"
+#include "t_alloc.h"
 #include "t_phase_setup.h"
 #include "t_phases.h"
 #include "t_thread.h"
 
+#include "util/trace.h"
+
 static noreturn void
 t_enter_setup_phase(void)
 {
@@ -31,6 +34,9 @@ t_enter_setup_phase(void)
     assert(t->num_threads == 1);
     t->phase = TEST_PHASE_SETUP;
 
+    if (t->opt.check_leaks)
+        t_alloc_snapshot(t);
+
     if (!t->opt.bootstrap && !t->def->no_image) {
         t_setup_ref_images();
     }
@@ -88,7 +94,9 @@ t_enter_precleanup_phase(void)
     }
 
     if (!t->result_is_final && !t->def->no_image) {
+        const uint64_t trace_ns = trace_start();
         t_compare_image();
+        trace_span("compare", t->def->name, trace_ns);
     }
 
     t_enter_next_phase();
@@ -109,6 +117,11 @@ t_unwind_cleanup_stacks(void *ignore)
         cru_cleanup_release(cleanup);
     }
 
+    // The test is current in no other thread, so it is safe to modify the
+    // result directly.
+    if (t->opt.check_leaks && !t_alloc_check_leaks(t))
+        test_result_merge(&t->result, TEST_RESULT_FAIL);
+
     t_enter_next_phase();
 }
 
@@ -117,7 +130,7 @@ t_enter_cleanup_phase(void)
 {
     GET_CURRENT_TEST(t);
     assert(t->num_threads == 1);
-    t->phase = TEST_PHASE_CLEANUP;
+    test_broadcast_cleanup(t);
 
     if (t->opt.no_separate_cleanup_thread) {
         t_unwind_cleanup_stacks(NULL);
@@ -150,7 +163,25 @@ t_enter_stopped_phase(void)
     // extra care to avoid all code paths that modify the thread count or
     // expect it to be non-zero. That's easily accomplished by exiting the
     // thread.
-    pthread_exit(NULL);
+    test_thread_exit();
+}
+
+/// Record a trace span for the phase that the test is leaving.
+static void
+t_trace_phase(test_t *t)
+{
+    static const char *const names[] = {
+        [TEST_PHASE_SETUP] = "setup",
+        [TEST_PHASE_MAIN] = "main",
+        [TEST_PHASE_PRECLEANUP] = "precleanup",
+        [TEST_PHASE_CLEANUP] = "cleanup",
+    };
+
+    if (t->phase < ARRAY_LENGTH(names) && names[t->phase]) {
+        trace_span(names[t->phase], t->def->name, t->trace_phase_start_ns);
+    }
+
+    t->trace_phase_start_ns = trace_start();
 }
 
 noreturn void
@@ -158,9 +189,14 @@ t_enter_next_phase(void)
 {
     GET_CURRENT_TEST(t);
 
+    // This thread abandons its current execution path, whether it exits or
+    // continues to the next phase.
+    test_thread_run_exit_handlers();
+
     // Eliminate all race conditions during the phase transition by reducing
     // the test's thread count to 1.
     t_thread_sieve();
+    t_trace_phase(t);
 
     switch (t->phase) {
     case TEST_PHASE_PRESTART:
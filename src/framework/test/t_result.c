@@ -19,7 +19,10 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include "util/cru_ref_index.h"
+
 #include "test.h"
+#include "t_phase_setup.h"
 #include "t_thread.h"
 
 noreturn void
@@ -210,6 +213,27 @@ t_require_ext(const char *name)
         t_skipf("missing required extension %s", name);
 }
 
+/// Refresh the reference index entry of a freshly bootstrapped image. The
+/// index is only an optimization, so failure is not fatal.
+static void
+t_update_ref_index(const string_t *filename)
+{
+    const char *name = string_data(filename);
+
+    if (!cru_ref_index_update(&name, 1, /*keep_others*/ true))
+        loge("failed to update reference index for %s", name);
+}
+
+/// Return true if the image's hash equals \a ref_hash. On a match, the
+/// reference image need not be decoded.
+static bool
+t_image_hash_matches(cru_image_t *image, uint64_t ref_hash)
+{
+    uint64_t hash;
+
+    return cru_image_hash(image, &hash) && hash == ref_hash;
+}
+
 static bool
 t_compare_color_image(void)
 {
@@ -223,6 +247,8 @@ t_compare_color_image(void)
     assert(t->ref.width > 0);
     assert(t->ref.height > 0);
 
+    t_setup_framebuffer();
+
     cru_image_t *actual_image = t_new_cru_image_from_vk_image(t->vk.device,
             t->vk.queue[t_queue_family_index], t->vk.color_image,
             VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, t->ref.width,
@@ -232,12 +258,14 @@ t_compare_color_image(void)
         assert(!t->ref.image);
         t_assert(cru_image_write_file(actual_image,
                                       string_data(&t->ref.filename)));
+        t_update_ref_index(&t->ref.filename);
         return true;
     }
 
-    assert(t->ref.image);
+    if (t->ref.has_hash && t_image_hash_matches(actual_image, t->ref.hash))
+        return true;
 
-    if (!cru_image_compare(actual_image, t->ref.image)) {
+    if (!cru_image_compare(actual_image, t_load_ref_image())) {
         loge("actual and reference images differ");
 
         // Dump the actual image for inspection.
@@ -284,6 +312,8 @@ t_compare_stencil_image(void)
 
     const cru_format_info_t *finfo = t_format_info(t->def->depthstencil_format);
 
+    t_setup_framebuffer();
+
     cru_image_t *actual_image = t_new_cru_image_from_vk_image(t->vk.device,
             t->vk.queue[t_queue_family_index], t->vk.ds_image,
             finfo->stencil_format, VK_IMAGE_ASPECT_STENCIL_BIT, t->ref.width,
@@ -293,12 +323,15 @@ t_compare_stencil_image(void)
         assert(!t->ref.stencil_image);
         t_assert(cru_image_write_file(actual_image,
                                       string_data(&t->ref.stencil_filename)));
+        t_update_ref_index(&t->ref.stencil_filename);
         return true;
     }
 
-    assert(t->ref.stencil_image);
+    if (t->ref.has_stencil_hash &&
+        t_image_hash_matches(actual_image, t->ref.stencil_hash))
+        return true;
 
-    if (!cru_image_compare(actual_image, t->ref.stencil_image)) {
+    if (!cru_image_compare(actual_image, t_load_ref_stencil_image())) {
         loge("actual and reference stencil images differ");
 
         // Dump the actual image for inspection.
@@ -19,16 +19,69 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <setjmp.h>
+
 #include "test.h"
 #include "t_phases.h"
 #include "t_thread.h"
 
-static noreturn void *
-test_thread_start(void *arg)
+/// \brief The process's pool of test threads.
+///
+/// Test threads run on persistent worker threads. A worker binds itself to
+/// a test when it starts one of the test's threads, and unbinds itself when
+/// that test thread exits through test_thread_exit(), after which the worker
+/// waits for its next test thread. New workers are created only when no idle
+/// worker is available, so a slave that runs tests one after another creates
+/// a handful of threads in total rather than two per test.
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    /// Test threads waiting for a worker.
+    struct pool_task *head;
+    struct pool_task **tail;
+    uint32_t num_queued;
+
+    /// Workers waiting for a test thread.
+    uint32_t num_idle;
+} pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .tail = &pool.head,
+};
+
+struct pool_task {
+    struct pool_task *next;
+    test_thread_arg_t *arg;
+};
+
+/// Where test_thread_exit() returns the worker to its loop. Set only while
+/// the worker runs a test thread.
+static __thread jmp_buf *worker_exit;
+
+/// Handlers registered by the test thread's current execution path.
+static __thread test_thread_exit_handler_t *exit_handlers;
+
+static void
+pool_lock(void)
+{
+    if (pthread_mutex_lock(&pool.mutex))
+        log_abort("%s: failed to lock mutex", __func__);
+}
+
+static void
+pool_unlock(void)
+{
+    if (pthread_mutex_unlock(&pool.mutex))
+        log_abort("%s: failed to unlock mutex", __func__);
+}
+
+static noreturn void
+test_thread_run(test_thread_arg_t *arg)
 {
     ASSERT_NOT_IN_TEST_THREAD;
 
-    test_thread_arg_t targ = *(test_thread_arg_t *) arg;
+    test_thread_arg_t targ = *arg;
     free(arg);
 
     test_t *t = targ.test;
@@ -78,10 +131,138 @@ test_thread_start(void *arg)
     t_thread_release();
 }
 
+/// Block until a test thread is queued, and dequeue it.
+static test_thread_arg_t *
+pool_wait(void)
+{
+    struct pool_task *task;
+    test_thread_arg_t *arg;
+
+    pool_lock();
+
+    while (!pool.head) {
+        pool.num_idle += 1;
+        pthread_cond_wait(&pool.cond, &pool.mutex);
+        pool.num_idle -= 1;
+    }
+
+    task = pool.head;
+    pool.head = task->next;
+    if (!pool.head)
+        pool.tail = &pool.head;
+    pool.num_queued -= 1;
+
+    pool_unlock();
+
+    arg = task->arg;
+    free(task);
+
+    return arg;
+}
+
+static void *
+pool_worker_start(void *arg)
+{
+    test_thread_arg_t *targ = arg;
+    jmp_buf exit_buf;
+
+    for (;;) {
+        if (setjmp(exit_buf) == 0) {
+            worker_exit = &exit_buf;
+            test_thread_run(targ);
+        }
+
+        // The test thread has exited. Unbind the worker from its test.
+        worker_exit = NULL;
+        exit_handlers = NULL;
+        current = (cru_current_test_t) {0};
+
+        targ = pool_wait();
+    }
+
+    return NULL;
+}
+
+/// Hand the test thread to an idle worker, or create a worker for it.
+static bool
+pool_submit(test_thread_arg_t *targ)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+    int err;
+
+    pool_lock();
+
+    // Each queued test thread has claimed one of the idle workers.
+    if (pool.num_idle > pool.num_queued) {
+        struct pool_task *task = xmalloc(sizeof(*task));
+        *task = (struct pool_task) { .arg = targ };
+
+        *pool.tail = task;
+        pool.tail = &task->next;
+        pool.num_queued += 1;
+
+        pthread_cond_signal(&pool.cond);
+        pool_unlock();
+        return true;
+    }
+
+    pool_unlock();
+
+    if (pthread_attr_init(&attr))
+        return false;
+
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    err = pthread_create(&thread, &attr, pool_worker_start, targ);
+    pthread_attr_destroy(&attr);
+
+    return err == 0;
+}
+
+noreturn void
+test_thread_exit(void)
+{
+    if (!worker_exit)
+        pthread_exit(NULL);
+
+    longjmp(*worker_exit, 1);
+}
+
+void
+test_thread_push_exit_handler(test_thread_exit_handler_t *handler,
+                              void (*func)(void *arg), void *arg)
+{
+    *handler = (test_thread_exit_handler_t) {
+        .next = exit_handlers,
+        .func = func,
+        .arg = arg,
+    };
+
+    exit_handlers = handler;
+}
+
+void
+test_thread_pop_exit_handler(bool execute)
+{
+    test_thread_exit_handler_t *handler = exit_handlers;
+
+    assert(handler);
+    exit_handlers = handler->next;
+
+    if (execute)
+        handler->func(handler->arg);
+}
+
+void
+test_thread_run_exit_handlers(void)
+{
+    while (exit_handlers)
+        test_thread_pop_exit_handler(true);
+}
+
 bool
 test_thread_create(test_t *t, void (*start)(void *arg), void *arg)
 {
-    pthread_t thread;
     test_thread_arg_t *targ;
 
     targ = xmalloc(sizeof(*targ));
@@ -93,7 +274,7 @@ test_thread_create(test_t *t, void (*start)(void *arg), void *arg)
 
     // To prevent race conditions, this thread must increment the test's thread
     // count *before* the new thread starts. The increment remains tentative
-    // until phtread_create() returns, indicating success or failure. On
+    // until pool_submit() returns, indicating success or failure. On
     // failue, this thread rolls back the increment.
     //
     // This thread *must not* access the thread count during the increment's
@@ -106,8 +287,9 @@ test_thread_create(test_t *t, void (*start)(void *arg), void *arg)
     // needed safety.
     t->num_threads += 1;
 
-    if (pthread_create(&thread, NULL, test_thread_start, targ) == -1) {
+    if (!pool_submit(targ)) {
         t->num_threads -= 1;
+        free(targ);
         return false;
     }
 
@@ -184,6 +366,6 @@ t_thread_sieve(void)
         t_thread_yield();
         return;
     } else {
-        pthread_exit(NULL);
+        test_thread_exit();
     }
 }
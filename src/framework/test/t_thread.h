@@ -24,4 +24,24 @@
 #include "tapi/t_thread.h"
 #include "util/macros.h"
 
+typedef struct test_thread_exit_handler test_thread_exit_handler_t;
+
+/// \brief A function to run when the test thread abandons its current path.
+///
+/// Test threads run on pooled workers and leave a test by jumping back to the
+/// worker's loop, which skips pthread_cleanup_push() handlers. Code that may
+/// end the test while holding a resource registers one of these instead. The
+/// handler lives on the caller's stack.
+struct test_thread_exit_handler {
+    test_thread_exit_handler_t *next;
+    void (*func)(void *arg);
+    void *arg;
+};
+
 bool test_thread_create(test_t *t, void (*start)(void *arg), void *arg);
+noreturn void test_thread_exit(void);
+
+void test_thread_push_exit_handler(test_thread_exit_handler_t *handler,
+                                   void (*func)(void *arg), void *arg);
+void test_thread_pop_exit_handler(bool execute);
+void test_thread_run_exit_handlers(void);
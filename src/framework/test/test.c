@@ -19,7 +19,10 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <time.h>
+
 #include "test.h"
+#include "t_alloc.h"
 #include "t_thread.h"
 
 __thread cru_current_test_t current
@@ -60,6 +63,10 @@ test_broadcast_stop(test_t *t)
     assert(t->num_threads == 0);
     assert(t->phase < TEST_PHASE_STOPPED);
 
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    t->stop_ns = (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+
     t->phase = TEST_PHASE_STOPPED;
 
     err = pthread_mutex_unlock(&t->stop_mutex);
@@ -69,6 +76,27 @@ test_broadcast_stop(test_t *t)
     pthread_cond_broadcast(&t->stop_cond);
 }
 
+/// Enter TEST_PHASE_CLEANUP and wake test_wait_cleanup().
+void
+test_broadcast_cleanup(test_t *t)
+{
+    int err;
+
+    err = pthread_mutex_lock(&t->stop_mutex);
+    if (err)
+        log_abort("%s: failed to lock mutex", __func__);
+
+    assert(t->phase == TEST_PHASE_PRECLEANUP);
+
+    t->phase = TEST_PHASE_CLEANUP;
+
+    err = pthread_mutex_unlock(&t->stop_mutex);
+    if (err)
+        log_abort("%s: failed to lock mutex", __func__);
+
+    pthread_cond_broadcast(&t->stop_cond);
+}
+
 static void
 test_set_ref_filenames(test_t *t)
 {
@@ -120,7 +148,9 @@ test_destroy(test_t *t)
     assert(t->num_threads == 0);
 
     pthread_mutex_destroy(&t->stop_mutex);
+    pthread_mutex_destroy(&t->vk.lazy_mutex);
     pthread_cond_destroy(&t->stop_cond);
+    t_alloc_finish(t);
     string_finish(&t->name);
     string_finish(&t->ref.filename);
     string_finish(&t->ref.stencil_filename);
@@ -153,6 +183,17 @@ test_create_s(const test_create_info_t *info)
     t->opt.queue_family_index = info->queue_family_index;
     t->opt.device_id = info->device_id;
     t->opt.verbose = info->verbose;
+    t->opt.check_leaks = info->enable_leak_check;
+    t->opt.no_suballoc = !info->enable_suballoc;
+    t->opt.direct_dispatch = info->enable_direct_dispatch;
+    t->opt.minimal_device = info->enable_minimal_device;
+
+    t_alloc_init(t);
+
+    if (info->enable_leak_check && !info->enable_cleanup_phase) {
+        loge("%s: enable_leak_check requires enable_cleanup_phase", __func__);
+        goto fail;
+    }
 
     if (info->enable_bootstrap) {
         if (info->enable_cleanup_phase) {
@@ -188,6 +229,17 @@ test_create_s(const test_create_info_t *info)
         abort();
     }
 
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    err = pthread_mutex_init(&t->vk.lazy_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (err) {
+        loge("%s: failed to init mutex during test creation",
+             string_data(&t->name));
+        abort();
+    }
+
     err = pthread_cond_init(&t->stop_cond, NULL);
     if (err) {
         // Abort to avoid destroying an uninitialized cond later.
@@ -216,6 +268,18 @@ test_get_result(test_t *t)
     return t->result;
 }
 
+/// Return the CLOCK_MONOTONIC time, in nanoseconds, at which the test
+/// stopped. A runner that waits for the test only later, such as with
+/// overlapped cleanup, should measure the test's duration to this time.
+uint64_t
+test_get_stop_time_ns(test_t *t)
+{
+    ASSERT_NOT_IN_TEST_THREAD;
+    ASSERT_TEST_IN_STOPPED_PHASE(t);
+
+    return t->stop_ns;
+}
+
 const cru_format_info_t *
 t_format_info(VkFormat format)
 {
@@ -229,6 +293,15 @@ t_format_info(VkFormat format)
     return info;
 }
 
+bool
+t_suballoc_enabled(void)
+{
+    ASSERT_TEST_IN_MAJOR_PHASE;
+    GET_CURRENT_TEST(t);
+
+    return !t->opt.no_suballoc;
+}
+
 static void
 t_thread_release_wrapper(void *ignore)
 {
@@ -259,11 +332,9 @@ test_start(test_t *t)
     }
 }
 
-void
-test_wait(test_t *t)
+static void
+test_wait_phase(test_t *t, test_phase_t phase)
 {
-    ASSERT_NOT_IN_TEST_THREAD;
-
     int err;
 
     err = pthread_mutex_lock(&t->stop_mutex);
@@ -272,9 +343,10 @@ test_wait(test_t *t)
         abort();
     }
 
-    while (t->phase < TEST_PHASE_STOPPED) {
+    while (t->phase < phase) {
         // AVOID DEADLOCK! When a test thread transitions to
-        // TEST_PHASE_STOPPED, it must be holding the test::stop_mutex lock.
+        // TEST_PHASE_CLEANUP or TEST_PHASE_STOPPED, it must be holding the
+        // test::stop_mutex lock.
         err = pthread_cond_wait(&t->stop_cond, &t->stop_mutex);
         if (err) {
             loge("%s: failed to wait on test's result condition",
@@ -286,6 +358,25 @@ test_wait(test_t *t)
     pthread_mutex_unlock(&t->stop_mutex);
 }
 
+void
+test_wait(test_t *t)
+{
+    ASSERT_NOT_IN_TEST_THREAD;
+    test_wait_phase(t, TEST_PHASE_STOPPED);
+}
+
+/// Block until the test enters its cleanup phase or stops.
+///
+/// Once the test is in its cleanup phase, it only destroys its own objects.
+/// Its result may still change, for example if the leak check fails, so it
+/// is not final until test_wait() returns.
+void
+test_wait_cleanup(test_t *t)
+{
+    ASSERT_NOT_IN_TEST_THREAD;
+    test_wait_phase(t, TEST_PHASE_CLEANUP);
+}
+
 void
 test_result_merge(test_result_t *accum,
                       test_result_t new_result)
@@ -43,6 +43,7 @@ typedef enum test_phase test_phase_t;
 typedef struct cru_current_test cru_current_test_t;
 typedef struct test test_t;
 typedef struct test_thread_arg test_thread_arg_t;
+typedef struct t_alloc_header t_alloc_header_t;
 
 /// Tests proceed through the stages in the order listed.
 enum test_phase {
@@ -88,6 +89,10 @@ struct test {
     /// Threads coordinate activity with the phase.
     _Atomic test_phase_t phase;
 
+    /// When the current phase began, for the runner's trace. Zero if tracing
+    /// is disabled.
+    uint64_t trace_phase_start_ns;
+
     test_result_t result;
     atomic_bool result_is_final;
 
@@ -98,6 +103,10 @@ struct test {
     /// Protects cru_test::stop_cond.
     pthread_mutex_t stop_mutex;
 
+    /// CLOCK_MONOTONIC time, in nanoseconds, at which the test entered
+    /// TEST_PHASE_STOPPED.
+    uint64_t stop_ns;
+
     /// \brief Options that control the test's behavior.
     ///
     /// These must be set, if at all, before the test starts.
@@ -124,8 +133,54 @@ struct test {
         uint32_t queue_family_index;
 
         bool verbose;
+
+        /// After the cleanup phase, fail the test if any allocation made
+        /// through test::alloc::cb is still live.
+        ///
+        /// \see t_alloc_check_leaks()
+        bool check_leaks;
+
+        /// Make a dedicated VkDeviceMemory for each qonos allocation, even
+        /// if the caller opted in to suballocation.
+        ///
+        /// \see t_suballoc_enabled()
+        bool no_suballoc;
+
+        /// Call the test device's commands through test::vk::dispatch.
+        ///
+        /// \see cru_vk_set_direct_dispatch()
+        bool direct_dispatch;
+
+        /// Enable on the test's instance and device only the extensions and
+        /// features that the test declares in its test_def.
+        ///
+        /// \see t_setup_vulkan()
+        bool minimal_device;
     } opt;
 
+    /// \brief Host allocations made by the driver on behalf of the test.
+    ///
+    /// The callbacks are given to vkCreateInstance and vkCreateDevice. Every
+    /// object created with a NULL VkAllocationCallbacks, which includes all
+    /// objects created by qonos, inherits them from its parent device or
+    /// instance.
+    struct {
+        VkAllocationCallbacks cb;
+
+        /// Protects all members below.
+        pthread_mutex_t mutex;
+
+        /// List of live allocations, newest first.
+        t_alloc_header_t *live;
+
+        /// Serial number of the next allocation.
+        uint64_t serial;
+
+        /// Allocations with a smaller serial number predate the snapshot
+        /// taken by t_alloc_snapshot().
+        uint64_t snapshot_serial;
+    } alloc;
+
     /// Atomic counter for t_dump_seq_image().
     cru_refcount_t dump_seq;
 
@@ -135,18 +190,36 @@ struct test {
         uint32_t height;
 
         string_t filename;
+
+        /// Loaded by t_load_ref_image(). If the reference index has a fresh
+        /// entry for the image, then loading is deferred until the image is
+        /// needed.
         cru_image_t *image;
 
+        /// If has_hash, then hash is the image's hash from the reference
+        /// index.
+        bool has_hash;
+        uint64_t hash;
+
         string_t stencil_filename;
         cru_image_t *stencil_image;
+        bool has_stencil_hash;
+        uint64_t stencil_hash;
     } ref;
 
     /// Vulkan data
     struct {
         VkInstance instance;
+
+        /// The enabled instance and device extensions. Unless
+        /// test::opt::minimal_device is set, these are all the supported
+        /// extensions.
         uint32_t instance_extension_count;
         VkExtensionProperties *instance_extension_props;
         VkPhysicalDevice physical_dev;
+
+        /// The supported features, or, if test::opt::minimal_device is set,
+        /// the enabled features once the device exists.
         VkPhysicalDeviceFeatures physical_dev_features;
         VkPhysicalDeviceProperties physical_dev_props;
         VkPhysicalDeviceMemoryProperties physical_dev_mem_props;
@@ -176,7 +249,23 @@ struct test {
         /// then it will be preferred.
         int transfer_queue;
 
-        VkDescriptorPool descriptor_pool;
+        /// \brief Protects the lazy creation of the default objects below.
+        ///
+        /// The objects are created on first use by t_setup_framebuffer()
+        /// and friends. Each has_* flag is set once its object exists.
+        pthread_mutex_t lazy_mutex;
+
+        /// Owns the lazily created objects. It unwinds before the device is
+        /// destroyed.
+        cru_cleanup_stack_t *lazy_cleanup;
+
+        atomic_bool has_descriptor_allocator;
+        atomic_bool has_pipeline_cache;
+        atomic_bool *has_cmd_pool;
+        atomic_bool has_cmd_buffer;
+        atomic_bool has_framebuffer;
+
+        QoDescriptorAllocator descriptor_allocator;
         VkPipelineCache pipeline_cache;
         VkCommandPool *cmd_pool;
         VkCommandBuffer cmd_buffer;
@@ -192,11 +281,17 @@ struct test {
         PFN_vkCreateDebugReportCallbackEXT vkCreateDebugReportCallbackEXT;
         PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallbackEXT;
         VkDebugReportCallbackEXT debug_callback;
+
+        /// Filled only if test::opt::direct_dispatch is set.
+        struct cru_vk_device_dispatch dispatch;
     } vk;
 };
 
 void test_broadcast_stop(test_t *t);
+void test_broadcast_cleanup(test_t *t);
 void t_compare_image(void);
+cru_image_t *t_load_ref_image(void);
+cru_image_t *t_load_ref_stencil_image(void);
 
 extern __thread cru_current_test_t current
     __attribute__((tls_model("local-exec")));
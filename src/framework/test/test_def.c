@@ -20,6 +20,7 @@
 // IN THE SOFTWARE.
 
 #include <fnmatch.h>
+#include <stddef.h>
 
 #include "framework/test/test_def.h"
 
@@ -67,3 +68,218 @@ cru_find_def(const char *name)
 
     return NULL;
 }
+
+#define FEATURE(name) \
+    { offsetof(VkPhysicalDeviceFeatures, name), #name }
+
+static const struct feature_info {
+    size_t offset;
+    const char *name;
+} features[] = {
+    FEATURE(robustBufferAccess),
+    FEATURE(fullDrawIndexUint32),
+    FEATURE(imageCubeArray),
+    FEATURE(independentBlend),
+    FEATURE(geometryShader),
+    FEATURE(tessellationShader),
+    FEATURE(sampleRateShading),
+    FEATURE(dualSrcBlend),
+    FEATURE(logicOp),
+    FEATURE(multiDrawIndirect),
+    FEATURE(drawIndirectFirstInstance),
+    FEATURE(depthClamp),
+    FEATURE(depthBiasClamp),
+    FEATURE(fillModeNonSolid),
+    FEATURE(depthBounds),
+    FEATURE(wideLines),
+    FEATURE(largePoints),
+    FEATURE(alphaToOne),
+    FEATURE(multiViewport),
+    FEATURE(samplerAnisotropy),
+    FEATURE(textureCompressionETC2),
+    FEATURE(textureCompressionASTC_LDR),
+    FEATURE(textureCompressionBC),
+    FEATURE(occlusionQueryPrecise),
+    FEATURE(pipelineStatisticsQuery),
+    FEATURE(vertexPipelineStoresAndAtomics),
+    FEATURE(fragmentStoresAndAtomics),
+    FEATURE(shaderTessellationAndGeometryPointSize),
+    FEATURE(shaderImageGatherExtended),
+    FEATURE(shaderStorageImageExtendedFormats),
+    FEATURE(shaderStorageImageMultisample),
+    FEATURE(shaderStorageImageReadWithoutFormat),
+    FEATURE(shaderStorageImageWriteWithoutFormat),
+    FEATURE(shaderUniformBufferArrayDynamicIndexing),
+    FEATURE(shaderSampledImageArrayDynamicIndexing),
+    FEATURE(shaderStorageBufferArrayDynamicIndexing),
+    FEATURE(shaderStorageImageArrayDynamicIndexing),
+    FEATURE(shaderClipDistance),
+    FEATURE(shaderCullDistance),
+    FEATURE(shaderFloat64),
+    FEATURE(shaderInt64),
+    FEATURE(shaderInt16),
+    FEATURE(shaderResourceResidency),
+    FEATURE(shaderResourceMinLod),
+    FEATURE(sparseBinding),
+    FEATURE(sparseResidencyBuffer),
+    FEATURE(sparseResidencyImage2D),
+    FEATURE(sparseResidencyImage3D),
+    FEATURE(sparseResidency2Samples),
+    FEATURE(sparseResidency4Samples),
+    FEATURE(sparseResidency8Samples),
+    FEATURE(sparseResidency16Samples),
+    FEATURE(sparseResidencyAliased),
+    FEATURE(variableMultisampleRate),
+    FEATURE(inheritedQueries),
+};
+
+#undef FEATURE
+
+static_assert(ARRAY_LENGTH(features) * sizeof(VkBool32) ==
+              sizeof(VkPhysicalDeviceFeatures),
+              "feature table does not cover VkPhysicalDeviceFeatures");
+
+static bool
+has_feature(const VkPhysicalDeviceFeatures *f, const struct feature_info *info)
+{
+    return *(const VkBool32 *) ((const char *) f + info->offset);
+}
+
+static bool
+has_ext(uint32_t count, const VkExtensionProperties *props, const char *name)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        if (cru_streq(props[i].extensionName, name))
+            return true;
+    }
+
+    return false;
+}
+
+static bool
+queue_flags_match_setup(VkQueueFlags qf, enum test_queue_setup setup)
+{
+    // Graphics and compute imply transfer.
+    if (qf & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+        qf &= ~VK_QUEUE_TRANSFER_BIT;
+    qf &= VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT |
+          VK_QUEUE_TRANSFER_BIT;
+
+    switch (setup) {
+    case QUEUE_SETUP_GFX_AND_COMPUTE:
+        return qf == (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+    case QUEUE_SETUP_GRAPHICS:
+        return qf & VK_QUEUE_GRAPHICS_BIT;
+    case QUEUE_SETUP_COMPUTE:
+        return qf & VK_QUEUE_COMPUTE_BIT;
+    case QUEUE_SETUP_TRANSFER:
+        return qf != 0;
+    }
+
+    return false;
+}
+
+/// Extensions that require other extensions on a Vulkan 1.0 instance, for
+/// the extensions that tests declare. The framework always enables
+/// VK_KHR_get_physical_device_properties2, so it is omitted.
+static const struct ext_dep {
+    const char *ext;
+    const char *dep;
+} ext_deps[] = {
+    { "VK_EXT_external_memory_dma_buf", "VK_KHR_external_memory_fd" },
+    { "VK_KHR_buffer_device_address", "VK_KHR_device_group" },
+    { "VK_KHR_device_group", "VK_KHR_device_group_creation" },
+    { "VK_KHR_external_memory", "VK_KHR_external_memory_capabilities" },
+    { "VK_KHR_external_memory_fd", "VK_KHR_external_memory" },
+    { "VK_KHR_external_semaphore", "VK_KHR_external_semaphore_capabilities" },
+    { "VK_KHR_external_semaphore_fd", "VK_KHR_external_semaphore" },
+};
+
+/// Return true if extension \a ext requires \a name, directly or
+/// indirectly.
+static bool
+ext_requires(const char *ext, const char *name)
+{
+    for (size_t i = 0; i < ARRAY_LENGTH(ext_deps); i++) {
+        if (!cru_streq(ext_deps[i].ext, ext))
+            continue;
+
+        if (cru_streq(ext_deps[i].dep, name) ||
+            ext_requires(ext_deps[i].dep, name))
+            return true;
+    }
+
+    return false;
+}
+
+/// Return true if the test needs the extension: either
+/// test_def::required_extensions lists it, or a listed extension requires
+/// it. Thus a test may declare only the extensions that it uses.
+bool
+test_def_requires_ext(const test_def_t *def, const char *name)
+{
+    if (!def->required_extensions)
+        return false;
+
+    for (const char *const *ext = def->required_extensions; *ext; ++ext) {
+        if (cru_streq(*ext, name) || ext_requires(*ext, name))
+            return true;
+    }
+
+    return false;
+}
+
+/// Return true if the capabilities satisfy the test's declared requirements.
+/// Otherwise, describe the first unmet requirement in \a reason.
+bool
+test_def_check_caps(const test_def_t *def, const test_caps_t *caps,
+                    string_t *reason)
+{
+    if (!queue_flags_match_setup(caps->queue_flags, def->queue_setup)) {
+        string_printf(reason, "queue family does not match the test's "
+                      "queue setup");
+        return false;
+    }
+
+    if ((caps->queue_flags & def->required_queue_flags) !=
+        def->required_queue_flags) {
+        string_printf(reason, "queue family lacks required flags 0x%x",
+                      def->required_queue_flags & ~caps->queue_flags);
+        return false;
+    }
+
+    // Compare only the major and minor versions. Patch releases add no API.
+    uint32_t api_version = def->api_version & ~0xfffu;
+    if (caps->api_version < api_version) {
+        string_printf(reason, "device supports Vulkan %u.%u, test requires "
+                      "%u.%u",
+                      VK_VERSION_MAJOR(caps->api_version),
+                      VK_VERSION_MINOR(caps->api_version),
+                      VK_VERSION_MAJOR(api_version),
+                      VK_VERSION_MINOR(api_version));
+        return false;
+    }
+
+    for (size_t i = 0; i < ARRAY_LENGTH(features); i++) {
+        if (has_feature(&def->required_features, &features[i]) &&
+            !has_feature(&caps->features, &features[i])) {
+            string_printf(reason, "missing required feature %s",
+                          features[i].name);
+            return false;
+        }
+    }
+
+    if (def->required_extensions) {
+        for (const char *const *ext = def->required_extensions; *ext; ++ext) {
+            if (!has_ext(caps->instance_extension_count,
+                         caps->instance_extensions, *ext) &&
+                !has_ext(caps->device_extension_count,
+                         caps->device_extensions, *ext)) {
+                string_printf(reason, "missing required extension %s", *ext);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
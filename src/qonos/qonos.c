@@ -138,10 +138,17 @@ __qoAllocMemory(VkDevice dev, const VkMemoryAllocateInfo *info)
     return memory;
 }
 
-VkDeviceMemory
-__qoAllocMemoryFromRequirements(VkDevice dev,
-                                const VkMemoryRequirements *mem_reqs,
-                                const QoMemoryAllocateFromRequirementsInfo *info)
+enum alloc_target {
+    ALLOC_TARGET_UNKNOWN,
+    ALLOC_TARGET_BUFFER,
+    ALLOC_TARGET_IMAGE,
+};
+
+static VkDeviceMemory
+alloc_memory_from_requirements(VkDevice dev,
+                               const VkMemoryRequirements *mem_reqs,
+                               const QoMemoryAllocateFromRequirementsInfo *info,
+                               enum alloc_target target)
 {
     VkMemoryAllocateInfo alloc_info = {
         .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
@@ -170,9 +177,34 @@ __qoAllocMemoryFromRequirements(VkDevice dev,
     t_assert(alloc_info.memoryTypeIndex != QO_MEMORY_TYPE_INDEX_INVALID);
     t_assert((1 << alloc_info.memoryTypeIndex) & mem_reqs->memoryTypeBits);
 
+    if (info->pOffset) {
+        *info->pOffset = 0;
+
+        if (target != ALLOC_TARGET_UNKNOWN &&
+            info->pNext == NULL &&
+            info->allocationSize == 0 &&
+            t_suballoc_enabled()) {
+            VkDeviceMemory mem = __qoSubAllocMemory(dev, mem_reqs,
+                alloc_info.memoryTypeIndex, target == ALLOC_TARGET_IMAGE,
+                info->pOffset);
+            if (mem != VK_NULL_HANDLE)
+                return mem;
+        }
+    }
+
     return __qoAllocMemory(dev, &alloc_info);
 }
 
+VkDeviceMemory
+__qoAllocMemoryFromRequirements(VkDevice dev,
+                                const VkMemoryRequirements *mem_reqs,
+                                const QoMemoryAllocateFromRequirementsInfo *info)
+{
+    // The resource kind is unknown, so the memory is never suballocated.
+    return alloc_memory_from_requirements(dev, mem_reqs, info,
+                                          ALLOC_TARGET_UNKNOWN);
+}
+
 VkDeviceMemory
 __qoAllocBufferMemory(VkDevice dev, VkBuffer buffer,
                       const QoMemoryAllocateFromRequirementsInfo *info)
@@ -180,7 +212,8 @@ __qoAllocBufferMemory(VkDevice dev, VkBuffer buffer,
     VkMemoryRequirements mem_reqs =
         qoGetBufferMemoryRequirements(dev, buffer);
 
-    return __qoAllocMemoryFromRequirements(dev, &mem_reqs, info);
+    return alloc_memory_from_requirements(dev, &mem_reqs, info,
+                                          ALLOC_TARGET_BUFFER);
 }
 
 VkDeviceMemory
@@ -190,7 +223,8 @@ __qoAllocImageMemory(VkDevice dev, VkImage image,
     VkMemoryRequirements mem_reqs =
         qoGetImageMemoryRequirements(dev, image);
 
-    return __qoAllocMemoryFromRequirements(dev, &mem_reqs, info);
+    return alloc_memory_from_requirements(dev, &mem_reqs, info,
+                                          ALLOC_TARGET_IMAGE);
 }
 
 void *
@@ -267,6 +301,7 @@ __qoCreateDescriptorSetLayout(VkDevice dev,
     t_assert(result == VK_SUCCESS);
     t_assert(layout != VK_NULL_HANDLE);
     t_cleanup_push_vk_descriptor_set_layout(dev, layout);
+    __qoRegisterDescriptorSetLayout(dev, layout, info);
 
     return layout;
 }
@@ -280,6 +315,12 @@ __qoAllocateDescriptorSet(VkDevice dev, const VkDescriptorSetAllocateInfo *info)
     t_assert(info->descriptorSetCount == 1);
     t_assert(info->pSetLayouts != NULL);
 
+    if (info->descriptorPool == VK_NULL_HANDLE) {
+        t_assert(dev == t_device);
+        return qoAllocateDescriptorSetFrom(t_descriptor_allocator,
+                                           info->pSetLayouts[0], NULL);
+    }
+
     result = vkAllocateDescriptorSets(dev, info, &set);
 
     t_assert(result == VK_SUCCESS);
@@ -437,26 +478,3 @@ __qoCreateImageView(VkDevice dev, const VkImageViewCreateInfo *info)
 
     return view;
 }
-
-VkShaderModule
-__qoCreateShaderModule(VkDevice dev, const QoShaderModuleCreateInfo *info)
-{
-    VkShaderModule module = VK_NULL_HANDLE;
-    VkResult result;
-
-    VkShaderModuleCreateInfo module_info = {
-        .sType =VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO
-    };
-
-    assert(info->pSpirv != NULL);
-    module_info.codeSize = info->spirvSize;
-    module_info.pCode = info->pSpirv;
-
-    result = vkCreateShaderModule(dev, &module_info, NULL, &module);
-
-    t_assert(result == VK_SUCCESS);
-    t_assert(module != VK_NULL_HANDLE);
-    t_cleanup_push_vk_shader_module(dev, module);
-
-    return module;
-}
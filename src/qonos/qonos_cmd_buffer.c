@@ -0,0 +1,433 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/// \file
+/// \brief Recycling command buffer manager
+///
+/// A QoCommandBufferManager gives each thread its own VkCommandPool for each
+/// queue family, so threads record without contending for a pool. Each
+/// buffer that the manager hands out is tracked. A buffer submitted with
+/// qoSubmitCommandBuffer() carries a fence, and once the fence signals, the
+/// next qoAcquireCommandBuffer() on the same thread and queue family resets
+/// and reuses the buffer rather than allocating another. Thus a loop that
+/// records and submits a buffer per iteration allocates only as many buffers
+/// as are in flight at once.
+///
+/// The manager owns its pools and fences, and destroys them in the cleanup
+/// callback that qoCreateCommandBufferManager() pushes, after waiting for
+/// pending buffers to complete.
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "qonos/qonos.h"
+#include "tapi/t_cleanup.h"
+#include "tapi/t_result.h"
+#include "util/xalloc.h"
+
+enum record_state {
+    /// In the initial state, or resettable with vkResetCommandBuffer().
+    RECORD_FREE,
+    RECORD_ACQUIRED,
+    RECORD_PENDING,
+
+    /// Done, but reusable only after its pool is reset, because the pool
+    /// lacks VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT.
+    RECORD_RETIRED,
+};
+
+struct record {
+    VkCommandBuffer cmd;
+    VkFence fence;
+    enum record_state state;
+};
+
+/// The command pool of one (thread, queue family) pair.
+struct thread_pool {
+    struct thread_pool *next;
+    pthread_t thread;
+    uint32_t queue_family_index;
+
+    /// Protects the records, which qoSubmitCommandBuffer() may touch from
+    /// another thread. Only the owning thread allocates from the pool, so
+    /// the mutex is rarely contended.
+    pthread_mutex_t mutex;
+
+    VkCommandPool pool;
+    struct record *records;
+    uint32_t num_records;
+};
+
+struct QoCommandBufferManager_ {
+    VkDevice dev;
+    VkCommandPoolCreateFlags flags;
+
+    /// Distinguishes this manager from a freed one at the same address in
+    /// each thread's cache.
+    uint64_t serial;
+
+    /// Protects the list of pools, but not the pools themselves.
+    pthread_mutex_t mutex;
+    struct thread_pool *pools;
+};
+
+static atomic_uint_fast64_t next_serial = 1;
+
+/// The state of a buffer that is done executing.
+static enum record_state
+done_state(QoCommandBufferManager mgr)
+{
+    return (mgr->flags & VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT) ?
+           RECORD_FREE : RECORD_RETIRED;
+}
+
+/// Each thread's most recently used pool.
+static __thread struct {
+    uint64_t serial;
+    struct thread_pool *pool;
+} cache;
+
+static void
+lock(pthread_mutex_t *mutex)
+{
+    if (pthread_mutex_lock(mutex))
+        t_failf("%s: failed to lock mutex", __func__);
+}
+
+static void
+unlock(pthread_mutex_t *mutex)
+{
+    if (pthread_mutex_unlock(mutex))
+        t_failf("%s: failed to unlock mutex", __func__);
+}
+
+/// Cleanup callback.
+static void
+destroy_manager(void *data)
+{
+    QoCommandBufferManager mgr = data;
+
+    while (mgr->pools) {
+        struct thread_pool *p = mgr->pools;
+        mgr->pools = p->next;
+
+        for (uint32_t i = 0; i < p->num_records; i++) {
+            struct record *r = &p->records[i];
+
+            if (r->fence == VK_NULL_HANDLE)
+                continue;
+
+            if (r->state == RECORD_PENDING)
+                vkWaitForFences(mgr->dev, 1, &r->fence, true, UINT64_MAX);
+
+            vkDestroyFence(mgr->dev, r->fence, NULL);
+        }
+
+        // Destroying the pool frees its buffers.
+        vkDestroyCommandPool(mgr->dev, p->pool, NULL);
+
+        pthread_mutex_destroy(&p->mutex);
+        free(p->records);
+        free(p);
+    }
+
+    pthread_mutex_destroy(&mgr->mutex);
+    free(mgr);
+}
+
+/// Create a command buffer manager.
+QoCommandBufferManager
+__qoCreateCommandBufferManager(VkDevice dev,
+                               const QoCommandBufferManagerCreateInfo *info)
+{
+    QoCommandBufferManager mgr = xzalloc(sizeof(*mgr));
+    mgr->dev = dev;
+    mgr->flags = info->flags;
+    mgr->serial = atomic_fetch_add(&next_serial, 1);
+
+    if (pthread_mutex_init(&mgr->mutex, NULL)) {
+        free(mgr);
+        t_failf("%s: failed to create mutex", __func__);
+    }
+
+    t_cleanup_push_callback(destroy_manager, mgr);
+
+    return mgr;
+}
+
+/// Return the calling thread's pool for \a queue_family_index, creating it if
+/// needed.
+static struct thread_pool *
+get_thread_pool(QoCommandBufferManager mgr, uint32_t queue_family_index)
+{
+    const pthread_t self = pthread_self();
+    struct thread_pool *p;
+
+    if (cache.serial == mgr->serial &&
+        cache.pool->queue_family_index == queue_family_index)
+        return cache.pool;
+
+    lock(&mgr->mutex);
+
+    for (p = mgr->pools; p; p = p->next) {
+        if (pthread_equal(p->thread, self) &&
+            p->queue_family_index == queue_family_index)
+            break;
+    }
+
+    unlock(&mgr->mutex);
+
+    if (!p) {
+        // Only this thread creates pools for itself, so no other thread
+        // can race to create this one.
+        VkCommandPool pool;
+        VkResult result = vkCreateCommandPool(mgr->dev,
+            &(VkCommandPoolCreateInfo) {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags = mgr->flags,
+                .queueFamilyIndex = queue_family_index,
+            }, NULL, &pool);
+        t_assert(result == VK_SUCCESS);
+
+        p = xzalloc(sizeof(*p));
+        p->thread = self;
+        p->queue_family_index = queue_family_index;
+        p->pool = pool;
+        if (pthread_mutex_init(&p->mutex, NULL))
+            t_failf("%s: failed to create mutex", __func__);
+
+        lock(&mgr->mutex);
+        p->next = mgr->pools;
+        mgr->pools = p;
+        unlock(&mgr->mutex);
+    }
+
+    cache.serial = mgr->serial;
+    cache.pool = p;
+
+    return p;
+}
+
+/// Must be called with the pool locked.
+static bool
+find_record(struct thread_pool *p, VkCommandBuffer cmd, struct record **rec)
+{
+    for (uint32_t i = 0; i < p->num_records; i++) {
+        if (p->records[i].cmd == cmd) {
+            *rec = &p->records[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// Return a primary command buffer in the initial state, owned by the calling
+/// thread, for a queue of family \a queue_family_index.
+///
+/// The buffer is reused from those that the calling thread released or whose
+/// submission completed, if any, and otherwise newly allocated. The caller
+/// must later pass the buffer to qoSubmitCommandBuffer() or
+/// qoReleaseCommandBuffer().
+VkCommandBuffer
+qoAcquireCommandBuffer(QoCommandBufferManager mgr, uint32_t queue_family_index)
+{
+    struct thread_pool *p = get_thread_pool(mgr, queue_family_index);
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    VkResult result = VK_SUCCESS;
+
+    lock(&p->mutex);
+
+    for (uint32_t i = 0; i < p->num_records; i++) {
+        struct record *r = &p->records[i];
+
+        if (r->state == RECORD_PENDING &&
+            vkGetFenceStatus(mgr->dev, r->fence) == VK_SUCCESS)
+            r->state = done_state(mgr);
+
+        if (r->state != RECORD_FREE)
+            continue;
+
+        // Reset now, rather than implicitly in vkBeginCommandBuffer, so
+        // that the driver may reclaim the buffer's memory early.
+        if (mgr->flags & VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT)
+            result = vkResetCommandBuffer(r->cmd, 0);
+
+        r->state = RECORD_ACQUIRED;
+        cmd = r->cmd;
+        break;
+    }
+
+    unlock(&p->mutex);
+
+    t_assert(result == VK_SUCCESS);
+
+    if (cmd != VK_NULL_HANDLE)
+        return cmd;
+
+    result = vkAllocateCommandBuffers(mgr->dev,
+        &(VkCommandBufferAllocateInfo) {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = p->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        }, &cmd);
+    t_assert(result == VK_SUCCESS);
+
+    lock(&p->mutex);
+    p->records = xreallocn(p->records, p->num_records + 1,
+                           sizeof(*p->records));
+    p->records[p->num_records++] = (struct record) {
+        .cmd = cmd,
+        .fence = VK_NULL_HANDLE,
+        .state = RECORD_ACQUIRED,
+    };
+    unlock(&p->mutex);
+
+    return cmd;
+}
+
+/// Return the pool and record of \a cmd, and lock the pool.
+static struct thread_pool *
+lock_record(QoCommandBufferManager mgr, VkCommandBuffer cmd,
+            struct record **rec)
+{
+    // Try the calling thread's pool first.
+    if (cache.serial == mgr->serial) {
+        struct thread_pool *p = cache.pool;
+
+        lock(&p->mutex);
+        if (find_record(p, cmd, rec))
+            return p;
+        unlock(&p->mutex);
+    }
+
+    lock(&mgr->mutex);
+
+    for (struct thread_pool *p = mgr->pools; p; p = p->next) {
+        lock(&p->mutex);
+        if (find_record(p, cmd, rec)) {
+            unlock(&mgr->mutex);
+            return p;
+        }
+        unlock(&p->mutex);
+    }
+
+    unlock(&mgr->mutex);
+
+    t_failf("%s: command buffer was not acquired from the manager",
+            __func__);
+}
+
+/// Submit \a cmd, which must have been acquired from \a mgr and ended, to
+/// \a queue. The manager recycles the buffer once the submission completes.
+void
+qoSubmitCommandBuffer(QoCommandBufferManager mgr, VkQueue queue,
+                      VkCommandBuffer cmd)
+{
+    struct record *r;
+    VkResult result;
+
+    struct thread_pool *p = lock_record(mgr, cmd, &r);
+
+    if (r->fence == VK_NULL_HANDLE) {
+        result = vkCreateFence(mgr->dev,
+            &(VkFenceCreateInfo) {
+                .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            }, NULL, &r->fence);
+    } else {
+        result = vkResetFences(mgr->dev, 1, &r->fence);
+    }
+
+    if (result == VK_SUCCESS) {
+        result = vkQueueSubmit(queue, 1,
+            &(VkSubmitInfo) {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &cmd,
+            }, r->fence);
+    }
+
+    if (result == VK_SUCCESS)
+        r->state = RECORD_PENDING;
+
+    unlock(&p->mutex);
+
+    t_assert(result == VK_SUCCESS);
+}
+
+/// Return \a cmd, which must have been acquired from \a mgr, for reuse. The
+/// caller must ensure that no submission of the buffer is still executing;
+/// for example, by having waited for the queue to become idle.
+void
+qoReleaseCommandBuffer(QoCommandBufferManager mgr, VkCommandBuffer cmd)
+{
+    struct record *r;
+
+    struct thread_pool *p = lock_record(mgr, cmd, &r);
+    r->state = done_state(mgr);
+    unlock(&p->mutex);
+}
+
+/// Wait for every buffer that the calling thread acquired from \a mgr to
+/// complete, then reset each of the thread's pools as a whole. All the
+/// buffers return to the initial state and become free for reuse.
+///
+/// Resetting a pool is cheaper than resetting its buffers one by one, and
+/// returns the memory of all of them to the driver.
+void
+qoResetCommandBufferManager(QoCommandBufferManager mgr)
+{
+    const pthread_t self = pthread_self();
+    VkResult result = VK_SUCCESS;
+
+    lock(&mgr->mutex);
+
+    for (struct thread_pool *p = mgr->pools; p; p = p->next) {
+        if (!pthread_equal(p->thread, self))
+            continue;
+
+        lock(&p->mutex);
+
+        for (uint32_t i = 0; i < p->num_records; i++) {
+            struct record *r = &p->records[i];
+
+            if (r->state == RECORD_PENDING) {
+                VkResult res = vkWaitForFences(mgr->dev, 1, &r->fence, true,
+                                               UINT64_MAX);
+                if (res != VK_SUCCESS)
+                    result = res;
+            }
+
+            r->state = RECORD_FREE;
+        }
+
+        VkResult res = vkResetCommandPool(mgr->dev, p->pool, 0);
+        if (res != VK_SUCCESS)
+            result = res;
+
+        unlock(&p->mutex);
+    }
+
+    unlock(&mgr->mutex);
+
+    t_assert(result == VK_SUCCESS);
+}
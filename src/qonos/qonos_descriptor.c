@@ -0,0 +1,535 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/// \file
+/// \brief Growable descriptor set allocator
+///
+/// A QoDescriptorAllocator sorts set layouts into size classes by the number
+/// of descriptors of each type that one set consumes. Each size class owns a
+/// chain of VkDescriptorPools sized for exactly
+/// QoDescriptorAllocatorCreateInfo::maxSetsPerPool sets of that class. When
+/// the current pool is full, or the driver reports
+/// VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL, the allocator
+/// moves to the next pool in the chain, creating it if needed. Thus there is
+/// no limit on the number of sets, and no pool sizes to tune.
+///
+/// The allocator learns the size class of each layout created with
+/// qoCreateDescriptorSetLayout(). Sets of other layouts come from a generic
+/// class with GENERIC_DESCRIPTORS_PER_TYPE descriptors of each type.
+///
+/// Pools are destroyed by the cleanup stack, and sets are never freed
+/// individually unless the allocator was created with freeDescriptorSet.
+
+#include <pthread.h>
+#include <string.h>
+
+#include "qonos/qonos.h"
+#include "tapi/t_cleanup.h"
+#include "tapi/t_result.h"
+#include "util/misc.h"
+#include "util/xalloc.h"
+
+/// Descriptors of each type in each set of the generic size class.
+#define GENERIC_DESCRIPTORS_PER_TYPE 8
+
+struct size_class {
+    struct size_class *next;
+
+    /// Descriptors of each type that one set consumes.
+    uint32_t counts[VK_DESCRIPTOR_TYPE_RANGE_SIZE];
+
+    /// The chain of pools, oldest first. Pools before pools[cur] are full.
+    struct pool {
+        VkDescriptorPool pool;
+        uint32_t free_sets;
+    } *pools;
+    uint32_t num_pools;
+    uint32_t cur;
+};
+
+struct QoDescriptorAllocator_ {
+    VkDevice dev;
+    QoDescriptorAllocator parent;
+    uint32_t max_sets_per_pool;
+    bool free_descriptor_set;
+
+    /// Only allocators without a parent are thread-safe, and only they lock
+    /// this mutex. It also protects the list of children.
+    pthread_mutex_t mutex;
+
+    struct size_class *classes;
+    struct size_class *generic;
+
+    struct QoDescriptorAllocator_ *children;
+    struct QoDescriptorAllocator_ *next_sibling;
+};
+
+/// A layout created with qoCreateDescriptorSetLayout().
+struct layout_info {
+    struct layout_info *next;
+    VkDevice dev;
+    VkDescriptorSetLayout layout;
+    uint32_t counts[VK_DESCRIPTOR_TYPE_RANGE_SIZE];
+};
+
+/// Protects all_layouts.
+static pthread_mutex_t layouts_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct layout_info *all_layouts = NULL;
+
+static void
+lock(pthread_mutex_t *mutex)
+{
+    if (pthread_mutex_lock(mutex))
+        t_failf("%s: failed to lock mutex", __func__);
+}
+
+static void
+unlock(pthread_mutex_t *mutex)
+{
+    if (pthread_mutex_unlock(mutex))
+        t_failf("%s: failed to unlock mutex", __func__);
+}
+
+static void
+lock_allocator(QoDescriptorAllocator a)
+{
+    if (!a->parent)
+        lock(&a->mutex);
+}
+
+static void
+unlock_allocator(QoDescriptorAllocator a)
+{
+    if (!a->parent)
+        unlock(&a->mutex);
+}
+
+/// Cleanup callback. Runs before the layout's own cleanup command, because
+/// it is pushed after it, so that a later layout with the same handle does
+/// not inherit the stale entry.
+static void
+unregister_layout(void *data)
+{
+    struct layout_info *info = data;
+
+    pthread_mutex_lock(&layouts_mutex);
+
+    for (struct layout_info **l = &all_layouts; *l; l = &(*l)->next) {
+        if (*l == info) {
+            *l = info->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&layouts_mutex);
+
+    free(info);
+}
+
+/// Record the size class of \a layout. Called by
+/// qoCreateDescriptorSetLayout().
+void
+__qoRegisterDescriptorSetLayout(VkDevice dev, VkDescriptorSetLayout layout,
+                                const VkDescriptorSetLayoutCreateInfo *info)
+{
+    struct layout_info *l = xzalloc(sizeof(*l));
+    l->dev = dev;
+    l->layout = layout;
+
+    for (uint32_t i = 0; i < info->bindingCount; i++) {
+        const VkDescriptorSetLayoutBinding *b = &info->pBindings[i];
+
+        // The allocator cannot size pools for types outside the core range,
+        // such as inline uniform blocks. Sets of such layouts must come from
+        // the test's own pools.
+        if (b->descriptorType >= VK_DESCRIPTOR_TYPE_RANGE_SIZE) {
+            free(l);
+            return;
+        }
+
+        l->counts[b->descriptorType] += b->descriptorCount;
+    }
+
+    lock(&layouts_mutex);
+    l->next = all_layouts;
+    all_layouts = l;
+    unlock(&layouts_mutex);
+
+    t_cleanup_push_callback(unregister_layout, l);
+}
+
+/// Copy the descriptor counts of \a layout into \a counts. Return false if
+/// the layout was not created with qoCreateDescriptorSetLayout().
+static bool
+lookup_layout(VkDevice dev, VkDescriptorSetLayout layout,
+              uint32_t counts[VK_DESCRIPTOR_TYPE_RANGE_SIZE])
+{
+    bool found = false;
+
+    lock(&layouts_mutex);
+
+    for (struct layout_info *l = all_layouts; l; l = l->next) {
+        if (l->dev == dev && l->layout == layout) {
+            memcpy(counts, l->counts, sizeof(l->counts));
+            found = true;
+            break;
+        }
+    }
+
+    unlock(&layouts_mutex);
+
+    return found;
+}
+
+static void
+free_classes(struct size_class *c)
+{
+    while (c) {
+        struct size_class *next = c->next;
+        free(c->pools);
+        free(c);
+        c = next;
+    }
+}
+
+static void
+free_allocator(QoDescriptorAllocator a)
+{
+    while (a->children) {
+        QoDescriptorAllocator child = a->children;
+        a->children = child->next_sibling;
+        free_allocator(child);
+    }
+
+    free_classes(a->classes);
+    free_classes(a->generic);
+
+    if (!a->parent)
+        pthread_mutex_destroy(&a->mutex);
+
+    free(a);
+}
+
+/// Cleanup callback. Only frees host memory; each VkDescriptorPool has its
+/// own command on the cleanup stack.
+static void
+destroy_allocator(void *data)
+{
+    free_allocator(data);
+}
+
+/// Create a descriptor allocator.
+///
+/// If \a info->parent is set, then the new allocator is a sub-allocator of
+/// the parent. A sub-allocator does no locking, and so must be used by only
+/// one thread at a time. Give each thread its own sub-allocator to avoid
+/// contending for the parent. Resetting the parent also resets its
+/// sub-allocators, and destroying the parent destroys them.
+QoDescriptorAllocator
+__qoCreateDescriptorAllocator(VkDevice dev,
+                              const QoDescriptorAllocatorCreateInfo *info)
+{
+    t_assert(info->maxSetsPerPool > 0);
+
+    QoDescriptorAllocator a = xzalloc(sizeof(*a));
+    a->dev = dev;
+    a->parent = info->parent;
+    a->max_sets_per_pool = info->maxSetsPerPool;
+    a->free_descriptor_set = info->freeDescriptorSet;
+
+    if (a->parent) {
+        t_assert(a->parent->dev == dev);
+
+        lock_allocator(a->parent);
+        a->next_sibling = a->parent->children;
+        a->parent->children = a;
+        unlock_allocator(a->parent);
+    } else {
+        if (pthread_mutex_init(&a->mutex, NULL)) {
+            free(a);
+            t_failf("%s: failed to create mutex", __func__);
+        }
+
+        t_cleanup_push_callback(destroy_allocator, a);
+    }
+
+    return a;
+}
+
+/// Must be called with the allocator locked.
+static struct size_class *
+get_size_class(QoDescriptorAllocator a,
+               const uint32_t counts[VK_DESCRIPTOR_TYPE_RANGE_SIZE],
+               bool generic)
+{
+    struct size_class **list = generic ? &a->generic : &a->classes;
+
+    for (struct size_class *c = *list; c; c = c->next) {
+        if (memcmp(c->counts, counts, sizeof(c->counts)) == 0)
+            return c;
+    }
+
+    struct size_class *c = xzalloc(sizeof(*c));
+    memcpy(c->counts, counts, sizeof(c->counts));
+    c->next = *list;
+    *list = c;
+
+    return c;
+}
+
+/// Must be called with the allocator locked.
+static VkResult
+create_pool(QoDescriptorAllocator a, struct size_class *c,
+            VkDescriptorPool *pool)
+{
+    VkDescriptorPoolSize sizes[VK_DESCRIPTOR_TYPE_RANGE_SIZE];
+    uint32_t num_sizes = 0;
+
+    for (uint32_t i = 0; i < VK_DESCRIPTOR_TYPE_RANGE_SIZE; i++) {
+        if (c->counts[i] == 0)
+            continue;
+
+        sizes[num_sizes++] = (VkDescriptorPoolSize) {
+            .type = i,
+            .descriptorCount = c->counts[i] * a->max_sets_per_pool,
+        };
+    }
+
+    // Vulkan requires at least one pool size, even for sets of empty
+    // layouts.
+    if (num_sizes == 0) {
+        sizes[num_sizes++] = (VkDescriptorPoolSize) {
+            .type = VK_DESCRIPTOR_TYPE_SAMPLER,
+            .descriptorCount = 1,
+        };
+    }
+
+    return vkCreateDescriptorPool(a->dev,
+        &(VkDescriptorPoolCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .flags = a->free_descriptor_set ?
+                     VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : 0,
+            .maxSets = a->max_sets_per_pool,
+            .poolSizeCount = num_sizes,
+            .pPoolSizes = sizes,
+        }, NULL, pool);
+}
+
+/// Must be called with the allocator locked. On success, the new pool is
+/// c->pools[c->cur]; the caller must push it onto the cleanup stack after
+/// unlocking.
+static VkResult
+chain_pool(QoDescriptorAllocator a, struct size_class *c)
+{
+    VkDescriptorPool pool;
+    VkResult result;
+
+    result = create_pool(a, c, &pool);
+    if (result != VK_SUCCESS)
+        return result;
+
+    c->pools = xreallocn(c->pools, c->num_pools + 1, sizeof(*c->pools));
+    c->pools[c->num_pools] = (struct pool) {
+        .pool = pool,
+        .free_sets = a->max_sets_per_pool,
+    };
+    c->cur = c->num_pools++;
+
+    return VK_SUCCESS;
+}
+
+/// Allocate a descriptor set of \a layout from \a allocator.
+///
+/// If \a pool is not NULL, then write to it the pool from which the set was
+/// allocated, for qoFreeDescriptorSet().
+VkDescriptorSet
+qoAllocateDescriptorSetFrom(QoDescriptorAllocator allocator,
+                            VkDescriptorSetLayout layout,
+                            VkDescriptorPool *pool)
+{
+    QoDescriptorAllocator a = allocator;
+    uint32_t counts[VK_DESCRIPTOR_TYPE_RANGE_SIZE];
+    VkDescriptorPool new_pool = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    VkResult result = VK_SUCCESS;
+    bool generic = false;
+
+    if (!lookup_layout(a->dev, layout, counts)) {
+        for (uint32_t i = 0; i < VK_DESCRIPTOR_TYPE_RANGE_SIZE; i++)
+            counts[i] = GENERIC_DESCRIPTORS_PER_TYPE;
+        generic = true;
+    }
+
+    lock_allocator(a);
+
+    struct size_class *c = get_size_class(a, counts, generic);
+
+    while (true) {
+        bool fresh = false;
+
+        while (c->cur < c->num_pools && c->pools[c->cur].free_sets == 0)
+            c->cur++;
+
+        if (c->cur == c->num_pools) {
+            // Every pool in the chain is full. Chain a new one.
+            result = chain_pool(a, c);
+            if (result != VK_SUCCESS)
+                break;
+
+            new_pool = c->pools[c->cur].pool;
+            fresh = true;
+        }
+
+        struct pool *p = &c->pools[c->cur];
+
+        result = vkAllocateDescriptorSets(a->dev,
+            &(VkDescriptorSetAllocateInfo) {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .descriptorPool = p->pool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &layout,
+            }, &set);
+
+        if (result == VK_SUCCESS) {
+            p->free_sets--;
+            if (pool)
+                *pool = p->pool;
+            break;
+        }
+
+        // A fresh pool that cannot hold one set never will.
+        if (fresh || (result != VK_ERROR_OUT_OF_POOL_MEMORY &&
+                      result != VK_ERROR_FRAGMENTED_POOL))
+            break;
+
+        p->free_sets = 0;
+    }
+
+    unlock_allocator(a);
+
+    // Fail and push outside the lock, because both may end the test.
+    if (new_pool != VK_NULL_HANDLE)
+        t_cleanup_push_vk_descriptor_pool(a->dev, new_pool);
+
+    if (result != VK_SUCCESS) {
+        t_failf("%s: failed to allocate a descriptor set (VkResult %d)%s",
+                __func__, result,
+                generic ? "; create the layout with "
+                          "qoCreateDescriptorSetLayout() so that the "
+                          "allocator can size its pools" : "");
+    }
+
+    t_assert(set != VK_NULL_HANDLE);
+
+    return set;
+}
+
+/// Free a set allocated from \a allocator, whose pool was returned by
+/// qoAllocateDescriptorSetFrom(). The allocator must have been created with
+/// freeDescriptorSet.
+void
+qoFreeDescriptorSet(QoDescriptorAllocator allocator, VkDescriptorPool pool,
+                    VkDescriptorSet set)
+{
+    QoDescriptorAllocator a = allocator;
+    VkResult result;
+
+    t_assert(a->free_descriptor_set);
+
+    lock_allocator(a);
+
+    result = vkFreeDescriptorSets(a->dev, pool, 1, &set);
+
+    if (result == VK_SUCCESS) {
+        // Return the set to its pool, and let the next allocation retry the
+        // pool if it is earlier in the chain.
+        for (int g = 0; g < 2; g++) {
+            for (struct size_class *c = g ? a->generic : a->classes; c;
+                 c = c->next) {
+                for (uint32_t i = 0; i < c->num_pools; i++) {
+                    if (c->pools[i].pool != pool)
+                        continue;
+
+                    c->pools[i].free_sets++;
+                    c->cur = MIN(c->cur, i);
+                }
+            }
+        }
+    }
+
+    unlock_allocator(a);
+
+    t_assert(result == VK_SUCCESS);
+}
+
+/// Must be called with the allocator locked.
+static VkResult
+reset_allocator(QoDescriptorAllocator a)
+{
+    VkResult result = VK_SUCCESS;
+
+    for (int g = 0; g < 2; g++) {
+        for (struct size_class *c = g ? a->generic : a->classes; c;
+             c = c->next) {
+            for (uint32_t i = 0; i < c->num_pools; i++) {
+                VkResult r = vkResetDescriptorPool(a->dev, c->pools[i].pool, 0);
+                if (r != VK_SUCCESS)
+                    result = r;
+
+                c->pools[i].free_sets = a->max_sets_per_pool;
+            }
+
+            c->cur = 0;
+        }
+    }
+
+    for (QoDescriptorAllocator child = a->children; child;
+         child = child->next_sibling) {
+        VkResult r = reset_allocator(child);
+        if (r != VK_SUCCESS)
+            result = r;
+    }
+
+    return result;
+}
+
+/// Return every set allocated from \a allocator, and from its
+/// sub-allocators, to their pools. The pools are kept for reuse.
+///
+/// This is much cheaper than freeing sets one by one. Call it between steps
+/// of a test, such as between iterations of a benchmark, once the device no
+/// longer uses the sets. No other thread may be using any of the
+/// sub-allocators.
+///
+/// The framework never resets t_descriptor_allocator itself. Each test has
+/// its own device, and destroying the pools in the cleanup phase releases
+/// every set at once, so a reset at a phase boundary would gain nothing.
+void
+qoResetDescriptorAllocator(QoDescriptorAllocator allocator)
+{
+    VkResult result;
+
+    lock_allocator(allocator);
+    result = reset_allocator(allocator);
+    unlock_allocator(allocator);
+
+    t_assert(result == VK_SUCCESS);
+}
@@ -19,7 +19,17 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+/// \file
+/// \brief Graphics pipelines
+///
+/// qoCreateGraphicsPipeline() fills in default state for whatever the
+/// VkGraphicsPipelineCreateInfo in QoExtraGraphicsPipelineCreateInfo::pNext
+/// leaves unset. qoCreateGraphicsPipelines() does the same for many
+/// pipelines at once, and creates them in one vkCreateGraphicsPipelines()
+/// call or spreads them across threads that share the pipeline cache.
+
 #include <assert.h>
+#include <pthread.h>
 #include <string.h>
 
 #include "qonos/qonos.h"
@@ -27,14 +37,12 @@
 #include "tapi/t_cleanup.h"
 #include "tapi/t_data.h"
 #include "tapi/t_result.h"
+#include "util/xalloc.h"
 
 #define NUM_SHADER_STAGES 6
 
-VkPipeline
-qoCreateGraphicsPipeline(VkDevice device,
-                         VkPipelineCache pipeline_cache,
-                         const QoExtraGraphicsPipelineCreateInfo *extra)
-{
+/// A VkGraphicsPipelineCreateInfo and the default state that it points to.
+struct pipeline_state {
     VkGraphicsPipelineCreateInfo pipeline_info;
     VkPipelineInputAssemblyStateCreateInfo ia_info;
     VkViewport viewport;
@@ -48,109 +56,148 @@ qoCreateGraphicsPipeline(VkDevice device,
     VkPipelineShaderStageCreateInfo stage_info[NUM_SHADER_STAGES];
     VkDynamicState dynamic_states[VK_DYNAMIC_STATE_RANGE_SIZE];
     VkPipelineDynamicStateCreateInfo dy_info;
-    VkPipeline pipeline;
-    VkResult result;
+};
 
+static const VkPipelineVertexInputStateCreateInfo default_vi_info = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+    .vertexBindingDescriptionCount = 2,
+    .pVertexBindingDescriptions = (VkVertexInputBindingDescription[]) {
+        {
+            .binding = 0,
+            .stride = 8,
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+        },
+        {
+            .binding = 1,
+            .stride = 16,
+            .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
+        }
+    },
+    .vertexAttributeDescriptionCount = 2,
+    .pVertexAttributeDescriptions = (VkVertexInputAttributeDescription[]) {
+        {
+            .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32_SFLOAT,
+            .offset = 0
+        },
+        {
+            .location = 1,
+            .binding = 1,
+            .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+            .offset = 0
+        }
+    }
+};
+
+/// Fill \a s->pipeline_info from \a extra, pointing any state that \a extra
+/// leaves unset at defaults stored in \a s. The default shaders are created
+/// here, so this must run on the test thread.
+static void
+resolve_pipeline_state(VkDevice device,
+                       const QoExtraGraphicsPipelineCreateInfo *extra,
+                       struct pipeline_state *s)
+{
     if (extra->pNext) {
         // We must make a copy so that we can change the pNext pointer.
-        pipeline_info = *(extra->pNext);
+        s->pipeline_info = *(extra->pNext);
     } else {
-        pipeline_info = (VkGraphicsPipelineCreateInfo) {
+        s->pipeline_info = (VkGraphicsPipelineCreateInfo) {
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
             .pNext = NULL,
         };
     };
 
-    if (pipeline_info.pInputAssemblyState == NULL) {
-        ia_info = (VkPipelineInputAssemblyStateCreateInfo) {
+    if (s->pipeline_info.pInputAssemblyState == NULL) {
+        s->ia_info = (VkPipelineInputAssemblyStateCreateInfo) {
             QO_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO_DEFAULTS,
             .topology = extra->topology,
         };
-        pipeline_info.pInputAssemblyState = &ia_info;
+        s->pipeline_info.pInputAssemblyState = &s->ia_info;
     }
 
-    if (pipeline_info.pRasterizationState == NULL) {
-        rs_info = (VkPipelineRasterizationStateCreateInfo) {
+    if (s->pipeline_info.pRasterizationState == NULL) {
+        s->rs_info = (VkPipelineRasterizationStateCreateInfo) {
             QO_PIPELINE_RASTERIZATION_STATE_CREATE_INFO_DEFAULTS,
         };
-        pipeline_info.pRasterizationState = &rs_info;
+        s->pipeline_info.pRasterizationState = &s->rs_info;
     }
 
-    if (!pipeline_info.pRasterizationState->rasterizerDiscardEnable &&
-        pipeline_info.pViewportState == NULL) {
-        vp_info = (VkPipelineViewportStateCreateInfo) {
+    if (!s->pipeline_info.pRasterizationState->rasterizerDiscardEnable &&
+        s->pipeline_info.pViewportState == NULL) {
+        s->vp_info = (VkPipelineViewportStateCreateInfo) {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
             .viewportCount = 1,
             .scissorCount = 1,
         };
 
         if (!(extra->dynamicStates & (1u << VK_DYNAMIC_STATE_VIEWPORT))) {
-            viewport = (VkViewport) {
+            s->viewport = (VkViewport) {
                 0.0, 0.0,
                 t_width, t_height,
                 0.0, 1.0
             };
-            vp_info.pViewports = &viewport;
+            s->vp_info.pViewports = &s->viewport;
         }
 
         if (!(extra->dynamicStates & (1u << VK_DYNAMIC_STATE_SCISSOR))) {
-            scissor = (VkRect2D) {
+            s->scissor = (VkRect2D) {
                 { 0, 0 },
                 {t_width, t_height }
             };
-            vp_info.pScissors = &scissor;
+            s->vp_info.pScissors = &s->scissor;
         }
 
-        pipeline_info.pViewportState = &vp_info;
+        s->pipeline_info.pViewportState = &s->vp_info;
     }
 
-    if (pipeline_info.pMultisampleState == NULL) {
-        ms_info = (VkPipelineMultisampleStateCreateInfo) {
+    if (s->pipeline_info.pMultisampleState == NULL) {
+        s->ms_info = (VkPipelineMultisampleStateCreateInfo) {
             QO_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO_DEFAULTS,
         };
-        pipeline_info.pMultisampleState = &ms_info;
+        s->pipeline_info.pMultisampleState = &s->ms_info;
     }
 
-    if (pipeline_info.pDepthStencilState == NULL) {
-        ds_info = (VkPipelineDepthStencilStateCreateInfo) {
+    if (s->pipeline_info.pDepthStencilState == NULL) {
+        s->ds_info = (VkPipelineDepthStencilStateCreateInfo) {
             QO_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO_DEFAULTS,
         };
-        pipeline_info.pDepthStencilState = &ds_info;
+        s->pipeline_info.pDepthStencilState = &s->ds_info;
     }
 
-    if (pipeline_info.pColorBlendState == NULL) {
-        cb_att = (VkPipelineColorBlendAttachmentState) {
+    if (s->pipeline_info.pColorBlendState == NULL) {
+        s->cb_att = (VkPipelineColorBlendAttachmentState) {
             QO_PIPELINE_COLOR_BLEND_ATTACHMENT_STATE_DEFAULTS,
         };
-        cb_info = (VkPipelineColorBlendStateCreateInfo) {
+        s->cb_info = (VkPipelineColorBlendStateCreateInfo) {
             QO_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO_DEFAULTS,
             .attachmentCount = 1,
-            .pAttachments = &cb_att,
+            .pAttachments = &s->cb_att,
         };
-        pipeline_info.pColorBlendState = &cb_info;
+        s->pipeline_info.pColorBlendState = &s->cb_info;
     }
 
-    if (pipeline_info.pDynamicState == NULL) {
+    if (s->pipeline_info.pDynamicState == NULL) {
         int count = 0;
-        for (int s = 0; s < VK_DYNAMIC_STATE_RANGE_SIZE; s++) {
-            if (extra->dynamicStates & (1u << s))
-                dynamic_states[count++] = s;
+        for (int d = 0; d < VK_DYNAMIC_STATE_RANGE_SIZE; d++) {
+            if (extra->dynamicStates & (1u << d))
+                s->dynamic_states[count++] = d;
         }
 
         if (count > 0) {
-           dy_info = (VkPipelineDynamicStateCreateInfo) {
+           s->dy_info = (VkPipelineDynamicStateCreateInfo) {
                .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
                .dynamicStateCount = count,
-               .pDynamicStates = dynamic_states,
+               .pDynamicStates = s->dynamic_states,
            };
-           pipeline_info.pDynamicState = &dy_info;
+           s->pipeline_info.pDynamicState = &s->dy_info;
         }
     }
 
     // Look for vertex or fragment shaders in the chain
     bool has_fs = false, has_vs = false;
-    for (unsigned i = 0; i < pipeline_info.stageCount; i++) {
-        switch (pipeline_info.pStages[i].stage) {
+    for (unsigned i = 0; i < s->pipeline_info.stageCount; i++) {
+        switch (s->pipeline_info.pStages[i].stage) {
         case VK_SHADER_STAGE_VERTEX_BIT:
             has_vs = true;
             break;
@@ -162,50 +209,18 @@ qoCreateGraphicsPipeline(VkDevice device,
         }
     }
 
-    VkPipelineVertexInputStateCreateInfo vi_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .vertexBindingDescriptionCount = 2,
-        .pVertexBindingDescriptions = (VkVertexInputBindingDescription[]) {
-            {
-                .binding = 0,
-                .stride = 8,
-                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
-            },
-            {
-                .binding = 1,
-                .stride = 16,
-                .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
-            }
-        },
-        .vertexAttributeDescriptionCount = 2,
-        .pVertexAttributeDescriptions = (VkVertexInputAttributeDescription[]) {
-            {
-                .location = 0,
-                .binding = 0,
-                .format = VK_FORMAT_R32G32_SFLOAT,
-                .offset = 0
-            },
-            {
-                .location = 1,
-                .binding = 1,
-                .format = VK_FORMAT_R32G32B32A32_SFLOAT,
-                .offset = 0
-            }
-        }
-    };
-
-    if (pipeline_info.pVertexInputState == NULL) {
+    if (s->pipeline_info.pVertexInputState == NULL) {
         /* They should be using one of our shaders if they use this */
         assert(!has_vs || !has_fs);
-        pipeline_info.pVertexInputState = &vi_info;
+        s->pipeline_info.pVertexInputState = &default_vi_info;
     }
 
     if (!has_vs || !has_fs || extra->geometryShader != VK_NULL_HANDLE) {
         /* Make a copy of the shader stages so that we can modify it */
-        assert(pipeline_info.stageCount < NUM_SHADER_STAGES);
-        memcpy(stage_info, pipeline_info.pStages,
-               pipeline_info.stageCount * sizeof(*pipeline_info.pStages));
-        pipeline_info.pStages = stage_info;
+        assert(s->pipeline_info.stageCount < NUM_SHADER_STAGES);
+        memcpy(s->stage_info, s->pipeline_info.pStages,
+               s->pipeline_info.stageCount * sizeof(*s->pipeline_info.pStages));
+        s->pipeline_info.pStages = s->stage_info;
     }
 
     if (!has_vs) {
@@ -224,7 +239,7 @@ qoCreateGraphicsPipeline(VkDevice device,
             );
         }
 
-        stage_info[pipeline_info.stageCount++] =
+        s->stage_info[s->pipeline_info.stageCount++] =
             (VkPipelineShaderStageCreateInfo) {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                 .stage = VK_SHADER_STAGE_VERTEX_BIT,
@@ -237,7 +252,7 @@ qoCreateGraphicsPipeline(VkDevice device,
     if (extra->geometryShader != VK_NULL_HANDLE) {
         // We're assuming here that they didn't try to set the geometry
         // shader both ways (through extra and normally).
-        stage_info[pipeline_info.stageCount++] =
+        s->stage_info[s->pipeline_info.stageCount++] =
             (VkPipelineShaderStageCreateInfo) {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                 .stage = VK_SHADER_STAGE_GEOMETRY_BIT,
@@ -261,7 +276,7 @@ qoCreateGraphicsPipeline(VkDevice device,
             );
         }
 
-        stage_info[pipeline_info.stageCount++] =
+        s->stage_info[s->pipeline_info.stageCount++] =
             (VkPipelineShaderStageCreateInfo) {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                 .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
@@ -270,9 +285,21 @@ qoCreateGraphicsPipeline(VkDevice device,
                 .pSpecializationInfo = NULL,
             };
     }
+}
+
+VkPipeline
+qoCreateGraphicsPipeline(VkDevice device,
+                         VkPipelineCache pipeline_cache,
+                         const QoExtraGraphicsPipelineCreateInfo *extra)
+{
+    struct pipeline_state s;
+    VkPipeline pipeline;
+    VkResult result;
+
+    resolve_pipeline_state(device, extra, &s);
 
     result = vkCreateGraphicsPipelines(device, pipeline_cache,
-                                       1, &pipeline_info, NULL, &pipeline);
+                                       1, &s.pipeline_info, NULL, &pipeline);
 
     t_assert(result == VK_SUCCESS);
     t_assert(pipeline != VK_NULL_HANDLE);
@@ -280,3 +307,117 @@ qoCreateGraphicsPipeline(VkDevice device,
 
     return pipeline;
 }
+
+/// One thread's share of a qoCreateGraphicsPipelines() batch.
+struct pipeline_slice {
+    pthread_t thread;
+    bool has_thread;
+
+    VkDevice device;
+    VkPipelineCache pipeline_cache;
+    uint32_t count;
+    const VkGraphicsPipelineCreateInfo *infos;
+    VkPipeline *pipelines;
+
+    VkResult result;
+};
+
+/// Runs on a worker thread. The Vulkan calls here must not end the test, so
+/// the calling thread checks the result.
+static void *
+create_pipeline_slice(void *data)
+{
+    struct pipeline_slice *slice = data;
+
+    slice->result = vkCreateGraphicsPipelines(slice->device,
+                                              slice->pipeline_cache,
+                                              slice->count, slice->infos,
+                                              NULL, slice->pipelines);
+
+    return NULL;
+}
+
+/// Create \a info->count graphics pipelines, filling in defaults for each
+/// QoExtraGraphicsPipelineCreateInfo as qoCreateGraphicsPipeline() does.
+///
+/// If \a info->threadCount is 1, the pipelines are created in one
+/// vkCreateGraphicsPipelines() call. Otherwise they are split into that many
+/// slices, each created on its own thread. The threads share
+/// \a pipeline_cache, which Vulkan synchronizes internally.
+void
+__qoCreateGraphicsPipelines(VkDevice device,
+                            VkPipelineCache pipeline_cache,
+                            const QoGraphicsPipelineBatchInfo *info,
+                            VkPipeline *pipelines)
+{
+    const uint32_t count = info->count;
+    uint32_t num_slices = info->threadCount ? info->threadCount : 1;
+    VkResult result = VK_SUCCESS;
+
+    if (count == 0)
+        return;
+
+    if (num_slices > count)
+        num_slices = count;
+
+    struct pipeline_state *states = xmalloc(count * sizeof(*states));
+    VkGraphicsPipelineCreateInfo *infos = xmalloc(count * sizeof(*infos));
+    t_cleanup_push_free(states);
+    t_cleanup_push_free(infos);
+
+    // Resolve every pipeline up front so that the worker threads touch no
+    // qonos or test state.
+    for (uint32_t i = 0; i < count; i++) {
+        resolve_pipeline_state(device, &info->pInfos[i], &states[i]);
+        infos[i] = states[i].pipeline_info;
+        pipelines[i] = VK_NULL_HANDLE;
+    }
+
+    struct pipeline_slice slices[num_slices];
+
+    for (uint32_t i = 0; i < num_slices; i++) {
+        const uint32_t first = (uint64_t) count * i / num_slices;
+        const uint32_t end = (uint64_t) count * (i + 1) / num_slices;
+
+        slices[i] = (struct pipeline_slice) {
+            .device = device,
+            .pipeline_cache = pipeline_cache,
+            .count = end - first,
+            .infos = &infos[first],
+            .pipelines = &pipelines[first],
+        };
+
+        // The calling thread takes the last slice itself, and any slice
+        // whose thread could not be started.
+        if (i + 1 < num_slices) {
+            slices[i].has_thread = pthread_create(&slices[i].thread, NULL,
+                                                  create_pipeline_slice,
+                                                  &slices[i]) == 0;
+        }
+    }
+
+    for (uint32_t i = 0; i < num_slices; i++) {
+        if (!slices[i].has_thread)
+            create_pipeline_slice(&slices[i]);
+    }
+
+    for (uint32_t i = 0; i < num_slices; i++) {
+        if (slices[i].has_thread)
+            pthread_join(slices[i].thread, NULL);
+
+        if (slices[i].result != VK_SUCCESS)
+            result = slices[i].result;
+    }
+
+    // Push every pipeline that was created before checking the results, so
+    // that none leaks if the test fails.
+    for (uint32_t i = 0; i < count; i++) {
+        if (pipelines[i] != VK_NULL_HANDLE)
+            t_cleanup_push_vk_pipeline(device, pipelines[i]);
+    }
+
+    t_assert(result == VK_SUCCESS);
+
+    for (uint32_t i = 0; i < count; i++)
+        t_assert(pipelines[i] != VK_NULL_HANDLE);
+}
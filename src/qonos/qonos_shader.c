@@ -0,0 +1,221 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/// \file
+/// \brief Shader module cache
+///
+/// qoCreateShaderModule() and qoCreateShaderModuleGLSL() return the same
+/// VkShaderModule for the same SPIR-V on the same device, so a statement that
+/// runs many times, as in a parameterized test's loop, makes the driver parse
+/// its SPIR-V only once. Modules are keyed by a hash of the SPIR-V content,
+/// and the content itself is compared on a hash match, so SPIR-V need not
+/// outlive the call.
+///
+/// Each call pushes onto the cleanup stack a reference to the module, and the
+/// module is destroyed when the last reference is released.
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "qonos/qonos.h"
+#include "tapi/t_cleanup.h"
+#include "tapi/t_result.h"
+#include "util/xalloc.h"
+
+struct module {
+    struct module *next;
+    VkDevice dev;
+    VkShaderModule module;
+
+    uint64_t hash;
+    size_t size;
+    void *spirv;
+
+    /// Number of cleanup stack references. Protected by the mutex.
+    uint32_t refs;
+};
+
+/// Protects all_modules and each module's refcount.
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct module *all_modules = NULL;
+
+static atomic_uint_fast64_t num_hits;
+static atomic_uint_fast64_t num_misses;
+
+static void
+lock(void)
+{
+    if (pthread_mutex_lock(&mutex))
+        t_failf("%s: failed to lock mutex", __func__);
+}
+
+static void
+unlock(void)
+{
+    if (pthread_mutex_unlock(&mutex))
+        t_failf("%s: failed to unlock mutex", __func__);
+}
+
+/// FNV-1a.
+static uint64_t
+hash_spirv(const void *spirv, size_t size)
+{
+    const uint8_t *p = spirv;
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+/// Must be called with the mutex held.
+static struct module *
+find_module(VkDevice dev, uint64_t hash, const void *spirv, size_t size)
+{
+    for (struct module *m = all_modules; m; m = m->next) {
+        if (m->dev == dev && m->hash == hash && m->size == size &&
+            memcmp(m->spirv, spirv, size) == 0)
+            return m;
+    }
+
+    return NULL;
+}
+
+/// Cleanup callback. Release one reference to the module.
+static void
+put_module(void *data)
+{
+    struct module *m = data;
+    bool last;
+
+    pthread_mutex_lock(&mutex);
+
+    last = --m->refs == 0;
+    if (last) {
+        for (struct module **p = &all_modules; *p; p = &(*p)->next) {
+            if (*p == m) {
+                *p = m->next;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    if (last) {
+        vkDestroyShaderModule(m->dev, m->module, NULL);
+        free(m->spirv);
+        free(m);
+    }
+}
+
+static VkShaderModule
+create_module(VkDevice dev, const QoShaderModuleCreateInfo *info)
+{
+    VkShaderModule module = VK_NULL_HANDLE;
+    VkResult result;
+
+    result = vkCreateShaderModule(dev,
+        &(VkShaderModuleCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .pNext = info->pNext,
+            .codeSize = info->spirvSize,
+            .pCode = info->pSpirv,
+        }, NULL, &module);
+
+    t_assert(result == VK_SUCCESS);
+    t_assert(module != VK_NULL_HANDLE);
+
+    return module;
+}
+
+VkShaderModule
+__qoCreateShaderModule(VkDevice dev, const QoShaderModuleCreateInfo *info)
+{
+    assert(info->pSpirv != NULL);
+
+    // Extension structs may change how the module is created, so don't
+    // share such modules.
+    if (info->pNext) {
+        VkShaderModule module = create_module(dev, info);
+        t_cleanup_push_vk_shader_module(dev, module);
+        return module;
+    }
+
+    const uint64_t hash = hash_spirv(info->pSpirv, info->spirvSize);
+    struct module *m;
+
+    lock();
+    m = find_module(dev, hash, info->pSpirv, info->spirvSize);
+    if (m)
+        m->refs++;
+    unlock();
+
+    if (m) {
+        atomic_fetch_add(&num_hits, 1);
+    } else {
+        atomic_fetch_add(&num_misses, 1);
+
+        // Create the module outside the lock, because the driver may take a
+        // while and because failure ends the test.
+        VkShaderModule module = create_module(dev, info);
+
+        lock();
+        m = find_module(dev, hash, info->pSpirv, info->spirvSize);
+        if (m) {
+            // Another thread created the same module meanwhile.
+            m->refs++;
+        } else {
+            m = xzalloc(sizeof(*m));
+            m->dev = dev;
+            m->module = module;
+            m->hash = hash;
+            m->size = info->spirvSize;
+            m->spirv = xmalloc(info->spirvSize);
+            memcpy(m->spirv, info->pSpirv, info->spirvSize);
+            m->refs = 1;
+            m->next = all_modules;
+            all_modules = m;
+        }
+        unlock();
+
+        if (m->module != module)
+            vkDestroyShaderModule(dev, module, NULL);
+    }
+
+    t_cleanup_push_callback(put_module, m);
+
+    return m->module;
+}
+
+/// Report how many qoCreateShaderModule() calls in this process found their
+/// module in the cache, and how many created one.
+void
+qoGetShaderModuleCacheStats(uint64_t *hits, uint64_t *misses)
+{
+    *hits = atomic_load(&num_hits);
+    *misses = atomic_load(&num_misses);
+}
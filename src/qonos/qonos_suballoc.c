@@ -0,0 +1,237 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/// \file
+/// \brief Device memory suballocator
+///
+/// Qonos suballocates small buffer and image allocations from large
+/// VkDeviceMemory blocks, one list of blocks per (VkDevice, memoryTypeIndex,
+/// resource kind). Blocks are carved linearly and are never recycled until
+/// the test's cleanup phase frees them, because qonos never frees a single
+/// allocation earlier than that.
+///
+/// Placement must respect bufferImageGranularity: a linear resource (a buffer
+/// or a VK_IMAGE_TILING_LINEAR image) and a non-linear one (an
+/// VK_IMAGE_TILING_OPTIMAL image) must not share a page of that size.
+/// Buffers and images never share a block. qoAllocImageMemory() does not know
+/// the image's tiling, so all images share the image blocks, and each image
+/// starts and ends on a page boundary so that no two images share a page.
+///
+/// \see QoMemoryAllocateFromRequirementsInfo::pOffset
+
+#include <pthread.h>
+
+#include "qonos/qonos.h"
+#include "tapi/t_cleanup.h"
+#include "tapi/t_data.h"
+#include "tapi/t_result.h"
+#include "util/misc.h"
+#include "util/xalloc.h"
+
+/// Preferred size of each block. The size shrinks for small heaps.
+#define BLOCK_SIZE (16 * 1024 * 1024)
+
+/// Allocations larger than this fraction of the block size get a dedicated
+/// VkDeviceMemory.
+#define MAX_SUBALLOC_FRACTION 8
+
+enum resource_kind {
+    RESOURCE_KIND_BUFFER,
+    RESOURCE_KIND_IMAGE,
+    RESOURCE_KIND_COUNT,
+};
+
+struct block {
+    struct block *next;
+    VkDeviceMemory mem;
+    VkDeviceSize size;
+
+    /// Offset of the first unused byte.
+    VkDeviceSize used;
+};
+
+struct device_pools {
+    struct device_pools *next;
+    VkDevice dev;
+    struct block *blocks[VK_MAX_MEMORY_TYPES][RESOURCE_KIND_COUNT];
+};
+
+/// Protects all_pools and everything reachable from it.
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct device_pools *all_pools = NULL;
+
+static void
+lock(void)
+{
+    if (pthread_mutex_lock(&mutex))
+        t_failf("%s: failed to lock mutex", __func__);
+}
+
+static void
+unlock(void)
+{
+    if (pthread_mutex_unlock(&mutex))
+        t_failf("%s: failed to unlock mutex", __func__);
+}
+
+/// Cleanup callback. Only frees host memory; each block's VkDeviceMemory has
+/// its own command on the cleanup stack.
+static void
+destroy_device_pools(void *data)
+{
+    struct device_pools *pools = data;
+
+    pthread_mutex_lock(&mutex);
+
+    for (struct device_pools **p = &all_pools; *p; p = &(*p)->next) {
+        if (*p == pools) {
+            *p = pools->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+        for (uint32_t k = 0; k < RESOURCE_KIND_COUNT; k++) {
+            struct block *b = pools->blocks[i][k];
+            while (b) {
+                struct block *next = b->next;
+                free(b);
+                b = next;
+            }
+        }
+    }
+
+    free(pools);
+}
+
+/// Must be called with the mutex held. Set \a *created if the pools are new.
+static struct device_pools *
+get_device_pools(VkDevice dev, bool *created)
+{
+    *created = false;
+
+    for (struct device_pools *p = all_pools; p; p = p->next) {
+        if (p->dev == dev)
+            return p;
+    }
+
+    struct device_pools *p = xzalloc(sizeof(*p));
+    p->dev = dev;
+    p->next = all_pools;
+    all_pools = p;
+
+    *created = true;
+    return p;
+}
+
+/// Must be called with the mutex held.
+///
+/// The allocation occupies whole pages of size \a granularity; pass 1 to
+/// pack allocations tightly.
+static bool
+carve(struct block *b, const VkMemoryRequirements *mem_reqs,
+      VkDeviceSize granularity, VkDeviceSize *offset)
+{
+    // Vulkan guarantees that the alignment and the granularity are powers
+    // of two.
+    const VkDeviceSize align = MAX(mem_reqs->alignment, granularity);
+    VkDeviceSize start = (b->used + align - 1) & ~(align - 1);
+    VkDeviceSize end = (start + mem_reqs->size + granularity - 1) &
+                       ~(granularity - 1);
+
+    if (start + mem_reqs->size > b->size)
+        return false;
+
+    b->used = MIN(end, b->size);
+    *offset = start;
+
+    return true;
+}
+
+/// Suballocate memory of type \a memory_type_index that satisfies \a mem_reqs.
+///
+/// Return VK_NULL_HANDLE if the request is too large to suballocate. The
+/// caller should then make a dedicated allocation.
+VkDeviceMemory
+__qoSubAllocMemory(VkDevice dev, const VkMemoryRequirements *mem_reqs,
+                   uint32_t memory_type_index, bool is_image,
+                   VkDeviceSize *offset)
+{
+    const VkPhysicalDeviceMemoryProperties *props = t_physical_dev_mem_props;
+    const enum resource_kind kind = is_image ? RESOURCE_KIND_IMAGE
+                                             : RESOURCE_KIND_BUFFER;
+    const VkDeviceSize granularity =
+        is_image ? t_physical_dev_props->limits.bufferImageGranularity : 1;
+    struct device_pools *pools;
+    VkDeviceMemory mem = VK_NULL_HANDLE;
+    bool created;
+
+    t_assert(memory_type_index < props->memoryTypeCount);
+
+    const uint32_t heap_index = props->memoryTypes[memory_type_index].heapIndex;
+    const VkDeviceSize block_size =
+        MIN(BLOCK_SIZE, props->memoryHeaps[heap_index].size / 8);
+
+    if (mem_reqs->size > block_size / MAX_SUBALLOC_FRACTION)
+        return VK_NULL_HANDLE;
+
+    lock();
+
+    pools = get_device_pools(dev, &created);
+
+    for (struct block *b = pools->blocks[memory_type_index][kind]; b;
+         b = b->next) {
+        if (carve(b, mem_reqs, granularity, offset)) {
+            mem = b->mem;
+            break;
+        }
+    }
+
+    unlock();
+
+    // Push the callback outside the lock, because pushing may fail the test.
+    if (created)
+        t_cleanup_push_callback(destroy_device_pools, pools);
+
+    if (mem != VK_NULL_HANDLE)
+        return mem;
+
+    // No block has room. Allocate a new block outside the lock, because
+    // qoAllocMemory() may fail the test. The cleanup stack frees the block.
+    mem = qoAllocMemory(dev,
+        .allocationSize = block_size,
+        .memoryTypeIndex = memory_type_index);
+
+    struct block *b = xzalloc(sizeof(*b));
+    b->mem = mem;
+    b->size = block_size;
+
+    carve(b, mem_reqs, granularity, offset);
+
+    lock();
+    b->next = pools->blocks[memory_type_index][kind];
+    pools->blocks[memory_type_index][kind] = b;
+    unlock();
+
+    return mem;
+}
@@ -0,0 +1,280 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/// \file
+/// \brief Batched submission and timeline semaphores
+///
+/// qoQueueWaitIdle() after each qoQueueSubmit() idles the queue between
+/// steps. Instead, submit many VkSubmitInfos at once with
+/// qoQueueSubmitBatch(), have the batch signal a QoTimeline, and wait for or
+/// poll just the value that the next step depends on.
+///
+/// A QoTimeline is a VK_KHR_timeline_semaphore semaphore plus the last value
+/// submitted for it. Tests that use one must require the extension; the test
+/// framework enables the timelineSemaphore feature whenever the extension is
+/// enabled.
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "qonos/qonos.h"
+#include "tapi/t_cleanup.h"
+#include "tapi/t_result.h"
+#include "util/xalloc.h"
+
+struct QoTimeline_ {
+    VkDevice dev;
+    VkSemaphore semaphore;
+
+    /// The last value that a batch was submitted to signal.
+    atomic_uint_fast64_t last_value;
+
+    PFN_vkGetSemaphoreCounterValueKHR GetSemaphoreCounterValueKHR;
+    PFN_vkWaitSemaphoresKHR WaitSemaphoresKHR;
+};
+
+/// Create a timeline whose semaphore starts at \a info->initialValue.
+QoTimeline
+__qoCreateTimeline(VkDevice dev, const QoTimelineCreateInfo *info)
+{
+    QoTimeline tl = xzalloc(sizeof(*tl));
+    VkResult result;
+
+    tl->dev = dev;
+    atomic_init(&tl->last_value, info->initialValue);
+    tl->GetSemaphoreCounterValueKHR = (PFN_vkGetSemaphoreCounterValueKHR)
+        vkGetDeviceProcAddr(dev, "vkGetSemaphoreCounterValueKHR");
+    tl->WaitSemaphoresKHR = (PFN_vkWaitSemaphoresKHR)
+        vkGetDeviceProcAddr(dev, "vkWaitSemaphoresKHR");
+
+    if (!tl->GetSemaphoreCounterValueKHR || !tl->WaitSemaphoresKHR) {
+        free(tl);
+        t_failf("%s: VK_KHR_timeline_semaphore is not enabled", __func__);
+    }
+
+    t_cleanup_push_free(tl);
+
+    result = vkCreateSemaphore(dev,
+        &(VkSemaphoreCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &(VkSemaphoreTypeCreateInfoKHR) {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+                .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+                .initialValue = info->initialValue,
+            },
+        }, NULL, &tl->semaphore);
+    t_assert(result == VK_SUCCESS);
+    t_cleanup_push_vk_semaphore(dev, tl->semaphore);
+
+    return tl;
+}
+
+/// Return the timeline's semaphore, for use in the test's own
+/// VkTimelineSemaphoreSubmitInfoKHR.
+VkSemaphore
+qoGetTimelineSemaphore(QoTimeline tl)
+{
+    return tl->semaphore;
+}
+
+/// Return the semaphore's current value, which is the last value that the
+/// device has signaled. Does not block.
+uint64_t
+qoGetTimelineValue(QoTimeline tl)
+{
+    uint64_t value;
+    VkResult result;
+
+    result = tl->GetSemaphoreCounterValueKHR(tl->dev, tl->semaphore, &value);
+    t_assert(result == VK_SUCCESS);
+
+    return value;
+}
+
+/// Return true if the device has reached \a value. Does not block.
+bool
+qoPollTimeline(QoTimeline tl, uint64_t value)
+{
+    return qoGetTimelineValue(tl) >= value;
+}
+
+/// Block until the device reaches \a value.
+void
+qoWaitTimeline(QoTimeline tl, uint64_t value)
+{
+    VkResult result;
+
+    result = tl->WaitSemaphoresKHR(tl->dev,
+        &(VkSemaphoreWaitInfoKHR) {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+            .semaphoreCount = 1,
+            .pSemaphores = &tl->semaphore,
+            .pValues = &value,
+        }, UINT64_MAX);
+    t_assert(result == VK_SUCCESS);
+}
+
+/// Return true if \a fence is signaled. Does not block.
+bool
+qoPollFence(VkDevice dev, VkFence fence)
+{
+    VkResult result = vkGetFenceStatus(dev, fence);
+
+    t_assert(result == VK_SUCCESS || result == VK_NOT_READY);
+
+    return result == VK_SUCCESS;
+}
+
+static bool
+has_timeline_submit_info(const VkSubmitInfo *submit)
+{
+    for (const VkBaseInStructure *s = submit->pNext; s; s = s->pNext) {
+        if (s->sType == VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR)
+            return true;
+    }
+
+    return false;
+}
+
+/// Submit \a info->submitCount VkSubmitInfos to \a queue in one
+/// vkQueueSubmit().
+///
+/// If \a info->waitTimeline is set, the first submit also waits for the
+/// timeline to reach \a info->waitValue at \a info->waitDstStageMask. If
+/// \a info->signalTimeline is set, the last submit also signals the next
+/// value of the timeline. Submits that qonos extends this way must not
+/// already chain a VkTimelineSemaphoreSubmitInfoKHR.
+///
+/// Timeline values must increase in submission order, so batches that
+/// signal the same timeline must not be submitted concurrently.
+///
+/// Return the value that the batch signals, or 0 if it signals no timeline.
+uint64_t
+__qoQueueSubmitBatch(VkQueue queue, const QoSubmitBatchInfo *info)
+{
+    QoTimeline wait_tl = info->waitTimeline;
+    QoTimeline signal_tl = info->signalTimeline;
+    uint64_t signal_value = 0;
+    VkResult result;
+
+    if (!wait_tl && !signal_tl) {
+        result = vkQueueSubmit(queue, info->submitCount, info->pSubmits,
+                               info->fence);
+        t_assert(result == VK_SUCCESS);
+        return 0;
+    }
+
+    // An empty batch still needs a submit to carry the semaphores.
+    const uint32_t count = info->submitCount ? info->submitCount : 1;
+    VkSubmitInfo submits[count];
+
+    if (info->submitCount) {
+        memcpy(submits, info->pSubmits, count * sizeof(submits[0]));
+    } else {
+        submits[0] = (VkSubmitInfo) {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        };
+    }
+
+    VkSubmitInfo *first = &submits[0];
+    VkSubmitInfo *last = &submits[count - 1];
+
+    // Binary semaphores ignore their entries in the value arrays, so only
+    // the timeline's entry need be meaningful.
+    const uint32_t n_waits = first->waitSemaphoreCount + (wait_tl ? 1 : 0);
+    const uint32_t n_signals = last->signalSemaphoreCount + (signal_tl ? 1 : 0);
+
+    // The extra element avoids zero-length arrays.
+    VkSemaphore wait_sems[n_waits + 1];
+    VkPipelineStageFlags wait_stages[n_waits + 1];
+    uint64_t wait_values[n_waits + 1];
+    VkSemaphore signal_sems[n_signals + 1];
+    uint64_t signal_values[n_signals + 1];
+
+    VkTimelineSemaphoreSubmitInfoKHR first_ts = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+    };
+    VkTimelineSemaphoreSubmitInfoKHR last_ts = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+    };
+
+    // If the batch has one submit, it both waits and signals, and one
+    // VkTimelineSemaphoreSubmitInfoKHR must carry both arrays.
+    VkTimelineSemaphoreSubmitInfoKHR *wait_ts = &first_ts;
+    VkTimelineSemaphoreSubmitInfoKHR *signal_ts = first == last ? &first_ts
+                                                                : &last_ts;
+
+    if (wait_tl) {
+        t_assert(!has_timeline_submit_info(first));
+
+        for (uint32_t i = 0; i < first->waitSemaphoreCount; i++) {
+            wait_sems[i] = first->pWaitSemaphores[i];
+            wait_stages[i] = first->pWaitDstStageMask[i];
+            wait_values[i] = 0;
+        }
+
+        wait_sems[n_waits - 1] = wait_tl->semaphore;
+        wait_stages[n_waits - 1] = info->waitDstStageMask;
+        wait_values[n_waits - 1] = info->waitValue;
+
+        first->waitSemaphoreCount = n_waits;
+        first->pWaitSemaphores = wait_sems;
+        first->pWaitDstStageMask = wait_stages;
+
+        wait_ts->waitSemaphoreValueCount = n_waits;
+        wait_ts->pWaitSemaphoreValues = wait_values;
+    }
+
+    if (signal_tl) {
+        t_assert(!has_timeline_submit_info(last));
+
+        for (uint32_t i = 0; i < last->signalSemaphoreCount; i++) {
+            signal_sems[i] = last->pSignalSemaphores[i];
+            signal_values[i] = 0;
+        }
+
+        signal_value = atomic_fetch_add(&signal_tl->last_value, 1) + 1;
+        signal_sems[n_signals - 1] = signal_tl->semaphore;
+        signal_values[n_signals - 1] = signal_value;
+
+        last->signalSemaphoreCount = n_signals;
+        last->pSignalSemaphores = signal_sems;
+
+        signal_ts->signalSemaphoreValueCount = n_signals;
+        signal_ts->pSignalSemaphoreValues = signal_values;
+    }
+
+    // Chain the timeline info ahead of the submit's own extensions.
+    if (wait_tl || first == last) {
+        first_ts.pNext = first->pNext;
+        first->pNext = &first_ts;
+    }
+
+    if (signal_tl && first != last) {
+        last_ts.pNext = last->pNext;
+        last->pNext = &last_ts;
+    }
+
+    result = vkQueueSubmit(queue, count, submits, info->fence);
+    t_assert(result == VK_SUCCESS);
+
+    return signal_value;
+}
@@ -104,7 +104,12 @@ test_large_copy(void)
     qoBindBufferMemory(t_device, buffer1, mem, 0);
     qoBindBufferMemory(t_device, buffer2, mem, total_buffer_reqs.size / 2);
 
-    VkCommandBuffer cmd_buffer = qoAllocateCommandBuffer(t_device, t_cmd_pool);
+    // Recycle one command buffer across all the size steps, rather than
+    // allocating one per step.
+    QoCommandBufferManager cmd_buffers = qoCreateCommandBufferManager(t_device);
+
+    VkCommandBuffer cmd_buffer =
+        qoAcquireCommandBuffer(cmd_buffers, t_queue_family_index);
     qoBeginCommandBuffer(cmd_buffer);
     vkCmdPipelineBarrier(cmd_buffer, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
                          0, NULL, 2,
@@ -127,7 +132,7 @@ test_large_copy(void)
             },
         }, 0, NULL);
     qoEndCommandBuffer(cmd_buffer);
-    qoQueueSubmit(t_queue, 1, &cmd_buffer, VK_NULL_HANDLE);
+    qoSubmitCommandBuffer(cmd_buffers, t_queue, cmd_buffer);
 
     VkQueryPool query = qoCreateQueryPool(t_device,
                                           .queryType = VK_QUERY_TYPE_TIMESTAMP,
@@ -141,7 +146,7 @@ test_large_copy(void)
         uint64_t cmd_buffer_copy_size = 1ull << bytes_to_copy_log2;
         uint64_t single_copy_size = 1ull << s;
 
-        cmd_buffer = qoAllocateCommandBuffer(t_device, t_cmd_pool);
+        cmd_buffer = qoAcquireCommandBuffer(cmd_buffers, t_queue_family_index);
         qoBeginCommandBuffer(cmd_buffer);
 
         vkCmdWriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
@@ -200,6 +205,9 @@ test_large_copy(void)
             time += query_results[1] - query_results[0];
         }
 
+        // The queue is idle, so the buffer is free for the next size.
+        qoReleaseCommandBuffer(cmd_buffers, cmd_buffer);
+
         double seconds =
             (time * (double)t_physical_dev_props->limits.timestampPeriod) /
             1000000000.0;
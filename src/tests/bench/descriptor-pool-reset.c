@@ -39,10 +39,10 @@ gettime_ns()
     return (uint64_t) current.tv_sec * 1000000000ULL + current.tv_nsec;
 }
 
-static void
-test()
+static VkDescriptorSetLayout
+create_layout(void)
 {
-    VkDescriptorSetLayout layout = qoCreateDescriptorSetLayout(t_device,
+    return qoCreateDescriptorSetLayout(t_device,
         .bindingCount = 2,
         .pBindings = (VkDescriptorSetLayoutBinding[]) {
             {
@@ -60,6 +60,12 @@ test()
                 .pImmutableSamplers = NULL,
             },
         });
+}
+
+static void
+test()
+{
+    VkDescriptorSetLayout layout = create_layout();
 
     VkDescriptorPool pool;
     vkCreateDescriptorPool(t_device,
@@ -109,3 +115,59 @@ test_define {
     .start = test,
     .no_image = true,
 };
+
+enum allocator_strategy {
+    /// Return all sets at once with qoResetDescriptorAllocator().
+    STRATEGY_RESET_POOL,
+
+    /// Return each set with qoFreeDescriptorSet().
+    STRATEGY_FREE_SET,
+};
+
+/// Like test(), but allocate one set at a time from a QoDescriptorAllocator,
+/// which chains pools as they fill.
+static void
+test_allocator(void)
+{
+    const enum allocator_strategy strategy = (uintptr_t) t_user_data;
+    const bool free_set = strategy == STRATEGY_FREE_SET;
+
+    VkDescriptorSetLayout layout = create_layout();
+
+    QoDescriptorAllocator allocator = qoCreateDescriptorAllocator(t_device,
+        .freeDescriptorSet = free_set);
+
+    uint64_t start = gettime_ns();
+
+    VkDescriptorSet sets[DESCRIPTOR_SETS_PER_POOL];
+    VkDescriptorPool pools[DESCRIPTOR_SETS_PER_POOL];
+    for (unsigned i = 0; i < CREATE_RESET_CYCLES; i++) {
+        for (unsigned j = 0; j < DESCRIPTOR_SETS_PER_POOL; j++)
+            sets[j] = qoAllocateDescriptorSetFrom(allocator, layout, &pools[j]);
+
+        if (free_set) {
+            for (unsigned j = 0; j < DESCRIPTOR_SETS_PER_POOL; j++)
+                qoFreeDescriptorSet(allocator, pools[j], sets[j]);
+        } else {
+            qoResetDescriptorAllocator(allocator);
+        }
+    }
+
+    uint64_t end = gettime_ns();
+
+    logi("Time: %f seconds\n", (double)(end - start) / 1000000000.0);
+}
+
+test_define {
+    .name = "bench.descriptor-allocator.reset-pool",
+    .start = test_allocator,
+    .user_data = (void *) STRATEGY_RESET_POOL,
+    .no_image = true,
+};
+
+test_define {
+    .name = "bench.descriptor-allocator.free-set",
+    .start = test_allocator,
+    .user_data = (void *) STRATEGY_FREE_SET,
+    .no_image = true,
+};
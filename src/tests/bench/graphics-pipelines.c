@@ -0,0 +1,205 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+// \file graphics-pipelines.c
+// \brief Create a sweep of graphics pipeline variants.
+//
+// The variants differ in blend and rasterization state, as in a test that
+// sweeps those states. Compare creating them one at a time, in one
+// vkCreateGraphicsPipelines() call, and spread across threads.
+
+#include <time.h>
+#include <unistd.h>
+
+#include "tapi/t.h"
+
+static const VkBlendOp blend_ops[] = {
+    VK_BLEND_OP_ADD,
+    VK_BLEND_OP_SUBTRACT,
+    VK_BLEND_OP_REVERSE_SUBTRACT,
+    VK_BLEND_OP_MIN,
+    VK_BLEND_OP_MAX,
+};
+
+static const VkBlendFactor blend_factors[] = {
+    VK_BLEND_FACTOR_ONE,
+    VK_BLEND_FACTOR_SRC_ALPHA,
+    VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+    VK_BLEND_FACTOR_DST_COLOR,
+    VK_BLEND_FACTOR_CONSTANT_COLOR,
+};
+
+static const VkCullModeFlags cull_modes[] = {
+    VK_CULL_MODE_NONE,
+    VK_CULL_MODE_FRONT_BIT,
+    VK_CULL_MODE_BACK_BIT,
+    VK_CULL_MODE_FRONT_AND_BACK,
+};
+
+#define NUM_PIPELINES (ARRAY_LENGTH(blend_ops) * \
+                       ARRAY_LENGTH(blend_factors) * \
+                       ARRAY_LENGTH(cull_modes))
+
+enum strategy {
+    /// Call qoCreateGraphicsPipeline() once per variant.
+    STRATEGY_SERIAL,
+
+    /// Call qoCreateGraphicsPipelines() on one thread.
+    STRATEGY_BATCH,
+
+    /// Call qoCreateGraphicsPipelines() on one thread per CPU.
+    STRATEGY_THREADED,
+};
+
+static uint64_t
+gettime_ns()
+{
+    struct timespec current;
+    int ret = clock_gettime(CLOCK_MONOTONIC, &current);
+    t_assert (ret >= 0);
+    if (ret < 0)
+        return 0;
+
+    return (uint64_t) current.tv_sec * 1000000000ULL + current.tv_nsec;
+}
+
+static void
+test(void)
+{
+    const enum strategy strategy = (uintptr_t) t_user_data;
+
+    VkRenderPass pass = qoCreateRenderPass(t_device,
+        .attachmentCount = 1,
+        .pAttachments = (VkAttachmentDescription[]) {
+            {
+                QO_ATTACHMENT_DESCRIPTION_DEFAULTS,
+                .format = VK_FORMAT_R8G8B8A8_UNORM,
+            },
+        },
+        .subpassCount = 1,
+        .pSubpasses = (VkSubpassDescription[]) {
+            {
+                QO_SUBPASS_DESCRIPTION_DEFAULTS,
+                .colorAttachmentCount = 1,
+                .pColorAttachments = (VkAttachmentReference[]) {
+                    {
+                        .attachment = 0,
+                        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    },
+                },
+            },
+        });
+
+    VkPipelineLayout layout = qoCreatePipelineLayout(t_device);
+
+    VkPipelineRasterizationStateCreateInfo rs_infos[NUM_PIPELINES];
+    VkPipelineColorBlendAttachmentState cb_atts[NUM_PIPELINES];
+    VkPipelineColorBlendStateCreateInfo cb_infos[NUM_PIPELINES];
+    VkGraphicsPipelineCreateInfo pipeline_infos[NUM_PIPELINES];
+    QoExtraGraphicsPipelineCreateInfo extras[NUM_PIPELINES];
+    VkPipeline pipelines[NUM_PIPELINES];
+    unsigned n = 0;
+
+    for (unsigned o = 0; o < ARRAY_LENGTH(blend_ops); o++) {
+        for (unsigned f = 0; f < ARRAY_LENGTH(blend_factors); f++) {
+            for (unsigned c = 0; c < ARRAY_LENGTH(cull_modes); c++) {
+                rs_infos[n] = (VkPipelineRasterizationStateCreateInfo) {
+                    QO_PIPELINE_RASTERIZATION_STATE_CREATE_INFO_DEFAULTS,
+                    .cullMode = cull_modes[c],
+                };
+                cb_atts[n] = (VkPipelineColorBlendAttachmentState) {
+                    QO_PIPELINE_COLOR_BLEND_ATTACHMENT_STATE_DEFAULTS,
+                    .blendEnable = true,
+                    .srcColorBlendFactor = blend_factors[f],
+                    .dstColorBlendFactor = VK_BLEND_FACTOR_ONE,
+                    .colorBlendOp = blend_ops[o],
+                };
+                cb_infos[n] = (VkPipelineColorBlendStateCreateInfo) {
+                    QO_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO_DEFAULTS,
+                    .attachmentCount = 1,
+                    .pAttachments = &cb_atts[n],
+                };
+                pipeline_infos[n] = (VkGraphicsPipelineCreateInfo) {
+                    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                    .pRasterizationState = &rs_infos[n],
+                    .pColorBlendState = &cb_infos[n],
+                    .renderPass = pass,
+                    .subpass = 0,
+                    .layout = layout,
+                };
+                extras[n] = (QoExtraGraphicsPipelineCreateInfo) {
+                    QO_EXTRA_GRAPHICS_PIPELINE_CREATE_INFO_DEFAULTS,
+                    .pNext = &pipeline_infos[n],
+                };
+                n++;
+            }
+        }
+    }
+
+    uint64_t start = gettime_ns();
+
+    switch (strategy) {
+    case STRATEGY_SERIAL:
+        for (unsigned i = 0; i < NUM_PIPELINES; i++) {
+            pipelines[i] = qoCreateGraphicsPipeline(t_device, t_pipeline_cache,
+                                                    &extras[i]);
+        }
+        break;
+    case STRATEGY_BATCH:
+        qoCreateGraphicsPipelines(t_device, t_pipeline_cache, pipelines,
+            .count = NUM_PIPELINES,
+            .pInfos = extras);
+        break;
+    case STRATEGY_THREADED:
+        qoCreateGraphicsPipelines(t_device, t_pipeline_cache, pipelines,
+            .count = NUM_PIPELINES,
+            .pInfos = extras,
+            .threadCount = sysconf(_SC_NPROCESSORS_ONLN));
+        break;
+    }
+
+    uint64_t end = gettime_ns();
+
+    logi("%u pipelines: %f seconds\n", (unsigned) NUM_PIPELINES,
+         (double)(end - start) / 1000000000.0);
+}
+
+test_define {
+    .name = "bench.graphics-pipelines.serial",
+    .start = test,
+    .user_data = (void *) STRATEGY_SERIAL,
+    .no_image = true,
+};
+
+test_define {
+    .name = "bench.graphics-pipelines.batch",
+    .start = test,
+    .user_data = (void *) STRATEGY_BATCH,
+    .no_image = true,
+};
+
+test_define {
+    .name = "bench.graphics-pipelines.threaded",
+    .start = test,
+    .user_data = (void *) STRATEGY_THREADED,
+    .no_image = true,
+};
@@ -195,16 +195,8 @@ test_view_count(VkBuffer position_buffer, VkBuffer color_buffer,
             .depth = 1,
         });
 
-    VkDescriptorSet set;
-
-    VkResult result = vkAllocateDescriptorSets(t_device,
-        &(VkDescriptorSetAllocateInfo) {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-            .descriptorPool = t_descriptor_pool,
-            .descriptorSetCount = 1,
-            .pSetLayouts = &set_layout,
-        }, &set);
-    t_assert(result == VK_SUCCESS);
+    VkDescriptorSet set = qoAllocateDescriptorSet(t_device,
+        .pSetLayouts = &set_layout);
     
     /* We just want to force non-trivial work to happen, but not
      * change the result as we check each view will look exactly the
@@ -307,7 +299,7 @@ test_view_count(VkBuffer position_buffer, VkBuffer color_buffer,
         qoQueueWaitIdle(t_queue);
     }
 
-    vkResetDescriptorPool(t_device, t_descriptor_pool, 0);
+    qoResetDescriptorAllocator(t_descriptor_allocator);
 
     return image;
 }
@@ -315,8 +307,6 @@ test_view_count(VkBuffer position_buffer, VkBuffer color_buffer,
 static void
 test()
 {
-    t_require_ext("VK_KHR_multiview");
-
     VkPhysicalDeviceMultiviewProperties multiview_props = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_PROPERTIES,
     };
@@ -485,4 +475,5 @@ test_define {
     .name = "bench.multiview",
     .start = test,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_KHR_multiview"),
 };
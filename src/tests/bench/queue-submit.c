@@ -93,8 +93,10 @@ test_queue_submit(void)
     for (unsigned i = MIN_BUFFER_COUNT; i <= MAX_BUFFER_COUNT; i *= 2) {
         while (buffer_count < i) {
             VkBuffer buffer = qoCreateBuffer(t_device, .size = BUFFER_SIZE);
-            VkDeviceMemory mem = qoAllocBufferMemory(t_device, buffer);
-            vkBindBufferMemory(t_device, buffer, mem, 0);
+            VkDeviceSize offset;
+            VkDeviceMemory mem = qoAllocBufferMemory(t_device, buffer,
+                                                     .pOffset = &offset);
+            vkBindBufferMemory(t_device, buffer, mem, offset);
             buffers[buffer_count++] = buffer;
         }
         test_queue_submit_variable(buffer_count, buffers);
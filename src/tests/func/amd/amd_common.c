@@ -60,7 +60,6 @@ common_init(VkShaderModule cs, const uint32_t ssbo_size)
 
     VkDescriptorSet set =
         qoAllocateDescriptorSet(t_device,
-                                .descriptorPool = t_descriptor_pool,
                                 .pSetLayouts = &set_layout);
 
     VkBuffer buffer_out = qoCreateBuffer(t_device, .size = ssbo_size);
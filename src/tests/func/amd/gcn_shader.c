@@ -28,7 +28,6 @@
 static void
 time(void)
 {
-    t_require_ext("VK_AMD_gcn_shader");
     VkShaderModule fs = qoCreateShaderModuleGLSL(
         t_device, FRAGMENT,
         QO_EXTENSION GL_ARB_gpu_shader_int64 : enable
@@ -58,12 +57,13 @@ test_define {
     .name = "func.amd.gcn-shader.time",
     .start = time,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS("VK_AMD_gcn_shader"),
+    .required_features = { .shaderInt64 = true },
 };
 
 static void
 cubeFaceCoordTC(void)
 {
-    t_require_ext("VK_AMD_gcn_shader");
     VkShaderModule cs = qoCreateShaderModuleGLSL(
         t_device, COMPUTE,
         QO_EXTENSION GL_AMD_gcn_shader : enable
@@ -103,12 +103,12 @@ test_define {
     .name = "func.amd.gcn-shader.cube-face-coord-tc",
     .start = cubeFaceCoordTC,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_AMD_gcn_shader"),
 };
 
 static void
 cubeFaceCoordSC(void)
 {
-    t_require_ext("VK_AMD_gcn_shader");
     VkShaderModule cs = qoCreateShaderModuleGLSL(
         t_device, COMPUTE,
         QO_EXTENSION GL_AMD_gcn_shader : enable
@@ -148,12 +148,12 @@ test_define {
     .name = "func.amd.gcn-shader.cube-face-coord-sc",
     .start = cubeFaceCoordSC,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_AMD_gcn_shader"),
 };
 
 static void
 cubeFaceIndex(void)
 {
-    t_require_ext("VK_AMD_gcn_shader");
     VkShaderModule cs = qoCreateShaderModuleGLSL(
         t_device, COMPUTE,
         QO_EXTENSION GL_AMD_gcn_shader : enable
@@ -193,13 +193,13 @@ test_define {
     .name = "func.amd.gcn-shader.cube-face-index",
     .start = cubeFaceIndex,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_AMD_gcn_shader"),
 };
 
 
 static void
 constant_folding(void)
 {
-    t_require_ext("VK_AMD_gcn_shader");
     VkShaderModule fs = qoCreateShaderModuleGLSL(
         t_device, FRAGMENT,
         QO_EXTENSION GL_AMD_gcn_shader : enable
@@ -258,4 +258,5 @@ test_define {
     .name = "func.amd.gcn-shader.constant",
     .start = constant_folding,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS("VK_AMD_gcn_shader"),
 };
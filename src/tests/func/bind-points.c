@@ -146,18 +146,10 @@ test_bind_points(void)
             .subpass = 0,
         }});
 
-    VkDescriptorSet set[2];
-    result = vkAllocateDescriptorSets(t_device,
-        &(VkDescriptorSetAllocateInfo) {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-            .descriptorPool = t_descriptor_pool,
-            .descriptorSetCount = 2,
-            .pSetLayouts = (VkDescriptorSetLayout[]) {
-                compute_set_layout,
-                graphics_set_layout,
-            },
-        }, set);
-    t_assert(result == VK_SUCCESS);
+    VkDescriptorSet set[2] = {
+        qoAllocateDescriptorSet(t_device, .pSetLayouts = &compute_set_layout),
+        qoAllocateDescriptorSet(t_device, .pSetLayouts = &graphics_set_layout),
+    };
 
     static const float uniform_data[12] = {
         0.0, 0.2, 0.0, 0.0,
@@ -130,9 +130,6 @@ test_common(VkShaderModule cs, bool int64, unsigned num_values, void *init, void
 static void
 test32()
 {
-    t_require_ext("VK_EXT_buffer_device_address");
-    t_require_ext("VK_KHR_shader_atomic_int64");
-
     VkShaderModule cs = qoCreateShaderModuleGLSL(t_device, COMPUTE,
         QO_EXTENSION GL_EXT_buffer_reference : require
 
@@ -288,14 +285,14 @@ test_define {
     .name = "func.buffer_reference.atomic32",
     .start = test32,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS(
+        "VK_EXT_buffer_device_address",
+        "VK_KHR_shader_atomic_int64"),
 };
 
 static void
 test64()
 {
-    t_require_ext("VK_EXT_buffer_device_address");
-    t_require_ext("VK_KHR_shader_atomic_int64");
-
     VkShaderModule cs = qoCreateShaderModuleGLSL(t_device, COMPUTE,
         QO_EXTENSION GL_EXT_buffer_reference : require
         QO_EXTENSION GL_ARB_gpu_shader_int64 : require
@@ -463,5 +460,9 @@ test_define {
     .name = "func.buffer_reference.atomic64",
     .start = test64,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS(
+        "VK_EXT_buffer_device_address",
+        "VK_KHR_shader_atomic_int64"),
+    .required_features = { .shaderInt64 = true },
 };
 
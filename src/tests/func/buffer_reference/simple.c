@@ -31,8 +31,6 @@
 static void
 simple(void)
 {
-    t_require_ext("VK_KHR_buffer_device_address");
-
     GET_DEVICE_FUNCTION_PTR(vkGetBufferDeviceAddressKHR);
 
     VkShaderModule cs = qoCreateShaderModuleGLSL(t_device, COMPUTE,
@@ -89,14 +87,16 @@ test_define {
     .name = "func.buffer_reference.simple",
     .start = simple,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS(
+        "VK_KHR_buffer_device_address",
+        "VK_KHR_device_group",
+        "VK_KHR_device_group_creation"),
 };
 
 
 static void
 simple_ext(void)
 {
-    t_require_ext("VK_EXT_buffer_device_address");
-
     GET_DEVICE_FUNCTION_PTR(vkGetBufferDeviceAddressEXT);
 
     VkShaderModule cs = qoCreateShaderModuleGLSL(t_device, COMPUTE,
@@ -152,4 +152,5 @@ test_define {
     .name = "func.buffer_reference.simple_ext",
     .start = simple_ext,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_buffer_device_address"),
 };
@@ -29,8 +29,6 @@
 static void
 test_funcs(void)
 {
-    t_require_ext("VK_EXT_calibrated_timestamps");
-
     GET_INSTANCE_FUNCTION_PTR(GetPhysicalDeviceCalibrateableTimeDomainsEXT);
     GET_DEVICE_FUNCTION_PTR(GetCalibratedTimestampsEXT);
 
@@ -42,6 +40,7 @@ test_define {
     .name = "func.calibrated-timestamps.funcs",
     .start = test_funcs,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_calibrated_timestamps"),
 };
 
 /* Test 2: Make sure all of the domains offered by the driver are in range
@@ -49,8 +48,6 @@ test_define {
 static void
 test_domains(void)
 {
-    t_require_ext("VK_EXT_calibrated_timestamps");
-
     GET_INSTANCE_FUNCTION_PTR(GetPhysicalDeviceCalibrateableTimeDomainsEXT);
     GET_DEVICE_FUNCTION_PTR(GetCalibratedTimestampsEXT);
 
@@ -88,6 +85,7 @@ test_define {
     .name = "func.calibrated-timestamps.domains",
     .start = test_domains,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_calibrated_timestamps"),
 };
 
 static uint64_t
@@ -122,8 +120,6 @@ crucible_clock_gettime(VkTimeDomainEXT domain)
 static void
 test_monotonic(void)
 {
-    t_require_ext("VK_EXT_calibrated_timestamps");
-
     GET_INSTANCE_FUNCTION_PTR(GetPhysicalDeviceCalibrateableTimeDomainsEXT);
     GET_DEVICE_FUNCTION_PTR(GetCalibratedTimestampsEXT);
 
@@ -204,6 +200,7 @@ test_define {
     .name = "func.calibrated-timestamps.monotonic",
     .start = test_monotonic,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_calibrated_timestamps"),
 };
 
 
@@ -227,8 +224,6 @@ device_time_to_ns(uint64_t device_time)
 static void
 test_device(void)
 {
-    t_require_ext("VK_EXT_calibrated_timestamps");
-
     GET_INSTANCE_FUNCTION_PTR(GetPhysicalDeviceCalibrateableTimeDomainsEXT);
     GET_DEVICE_FUNCTION_PTR(GetCalibratedTimestampsEXT);
 
@@ -344,6 +339,7 @@ test_define {
     .name = "func.calibrated-timestamps.device",
     .start = test_device,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_calibrated_timestamps"),
 };
 
 static uint64_t
@@ -372,8 +368,6 @@ get_timestamps(void)
 static void
 test_command(void)
 {
-    t_require_ext("VK_EXT_calibrated_timestamps");
-
     GET_INSTANCE_FUNCTION_PTR(GetPhysicalDeviceCalibrateableTimeDomainsEXT);
     GET_DEVICE_FUNCTION_PTR(GetCalibratedTimestampsEXT);
 
@@ -436,4 +430,5 @@ test_define {
     .name = "func.calibrated-timestamps.command",
     .start = test_command,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_calibrated_timestamps"),
 };
@@ -27,8 +27,6 @@
 static void
 group_none(void)
 {
-    t_require_ext("VK_NV_compute_shader_derivatives");
-
     VkShaderModule cs = qoCreateShaderModuleGLSL(t_device, COMPUTE,
         QO_EXTENSION GL_NV_compute_shader_derivatives: require
 
@@ -84,6 +82,7 @@ test_define {
     .start = group_none,
     .no_image = true,
     .queue_setup = QUEUE_SETUP_COMPUTE,
+    .required_extensions = TEST_EXTENSIONS("VK_NV_compute_shader_derivatives"),
 };
 
 static VkPhysicalDeviceComputeShaderDerivativesFeaturesNV
@@ -103,8 +102,6 @@ get_compute_shader_derivatives_features(void)
 static void
 group_linear(void)
 {
-    t_require_ext("VK_NV_compute_shader_derivatives");
-
     VkPhysicalDeviceComputeShaderDerivativesFeaturesNV features =
         get_compute_shader_derivatives_features();
     if (!features.computeDerivativeGroupLinear)
@@ -174,13 +171,12 @@ test_define {
     .start = group_linear,
     .no_image = true,
     .queue_setup = QUEUE_SETUP_COMPUTE,
+    .required_extensions = TEST_EXTENSIONS("VK_NV_compute_shader_derivatives"),
 };
 
 static void
 group_quads(void)
 {
-    t_require_ext("VK_NV_compute_shader_derivatives");
-
     VkPhysicalDeviceComputeShaderDerivativesFeaturesNV features =
         get_compute_shader_derivatives_features();
     if (!features.computeDerivativeGroupQuads)
@@ -250,13 +246,12 @@ test_define {
     .start = group_quads,
     .no_image = true,
     .queue_setup = QUEUE_SETUP_COMPUTE,
+    .required_extensions = TEST_EXTENSIONS("VK_NV_compute_shader_derivatives"),
 };
 
 static void
 group_quads_multiple_subgroups(void)
 {
-    t_require_ext("VK_NV_compute_shader_derivatives");
-
     VkPhysicalDeviceSubgroupProperties subgroup_props = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
     };
@@ -332,5 +327,6 @@ test_define {
     .start = group_quads_multiple_subgroups,
     .no_image = true,
     .queue_setup = QUEUE_SETUP_COMPUTE,
+    .required_extensions = TEST_EXTENSIONS("VK_NV_compute_shader_derivatives"),
 };
 
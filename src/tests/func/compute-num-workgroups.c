@@ -86,7 +86,6 @@ common_init(CTX *ctx)
     t_cleanup_push_vk_pipeline(t_device, ctx->pipeline);
 
     ctx->set = qoAllocateDescriptorSet(t_device,
-                                       .descriptorPool = t_descriptor_pool,
                                        .pSetLayouts = &set_layout);
 
     ctx->ssbo_buf = qoCreateBuffer(t_device,
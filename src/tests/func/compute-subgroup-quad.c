@@ -123,7 +123,6 @@ subgroup_quad_swap_vertical_grid(void)
     if (!has_subgroup_quad_operations())
         t_skipf("subgroupQuad operations not supported");
 
-    t_require_ext("VK_NV_compute_shader_derivatives");
     if (!has_derivative_group_quads())
         t_skipf("derivative_group_quadsNV not supported");
 
@@ -174,4 +173,5 @@ test_define {
     .no_image = true,
     .queue_setup = QUEUE_SETUP_COMPUTE,
     .api_version = VK_MAKE_VERSION(1, 1, 0),
+    .required_extensions = TEST_EXTENSIONS("VK_NV_compute_shader_derivatives"),
 };
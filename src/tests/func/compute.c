@@ -80,7 +80,6 @@ test(void)
 
     VkDescriptorSet set =
         qoAllocateDescriptorSet(t_device,
-                                .descriptorPool = t_descriptor_pool,
                                 .pSetLayouts = &set_layout);
 
     VkBuffer buffer = qoCreateBuffer(t_device,
@@ -191,7 +191,6 @@ test(void)
     // Create a descriptor set that the shaders will access
     VkDescriptorSet desc_set =
         qoAllocateDescriptorSet(t_device,
-                                .descriptorPool = t_descriptor_pool,
                                 .pSetLayouts = &ds_layout);
     vkUpdateDescriptorSets(t_device, 2, (VkWriteDescriptorSet[]) {
 	    {
@@ -309,5 +308,6 @@ test_define {
     .name = "func.depthstencil.arrayed_clear",
     .start = test,
     .no_image = true,
+    .required_features = { .vertexPipelineStoresAndAtomics = true },
 };
 
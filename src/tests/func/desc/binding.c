@@ -85,7 +85,6 @@ test(void)
             });
 
     VkDescriptorSet set = qoAllocateDescriptorSet(t_device,
-                                .descriptorPool = t_descriptor_pool,
                                 .pSetLayouts = &set_layout);
 
     /* Update some number of bindings in the set, leaving the remaining
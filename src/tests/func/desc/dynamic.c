@@ -141,7 +141,6 @@ test(void)
 
     VkDescriptorSet set =
         qoAllocateDescriptorSet(t_device,
-                                .descriptorPool = t_descriptor_pool,
                                 .pSetLayouts = &set_layout);
 
     VkBuffer buffer = qoCreateBuffer(t_device,
@@ -246,7 +245,8 @@ test_define {
     .image_filename = "func.desc.dynamic.uniform-buffer.ref.png",
     .user_data = &(struct params) {
         .descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
-    }
+    },
+    .required_features = { .vertexPipelineStoresAndAtomics = true },
 };
 
 test_define {
@@ -153,15 +153,10 @@ test(void)
 
     VkPipeline pipeline = create_pipeline(t_device, pipeline_layout);
 
-    VkDescriptorSet set[2];
-    VkResult result = vkAllocateDescriptorSets(t_device,
-        &(VkDescriptorSetAllocateInfo) {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-            .descriptorPool = t_descriptor_pool,
-            .descriptorSetCount = 2,
-            .pSetLayouts = set_layout,
-        }, set);
-    t_assert(result == VK_SUCCESS);
+    VkDescriptorSet set[2] = {
+        qoAllocateDescriptorSet(t_device, .pSetLayouts = &set_layout[0]),
+        qoAllocateDescriptorSet(t_device, .pSetLayouts = &set_layout[1]),
+    };
 
     static const float uniform_data[12] = {
         0.0, 0.2, 0.0, 0.0,
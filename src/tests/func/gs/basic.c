@@ -161,4 +161,5 @@ test_basic_gs(void)
 test_define {
     .name = "func.gs.basic",
     .start = test_basic_gs,
+    .required_features = { .geometryShader = true },
 };
@@ -57,8 +57,6 @@ print_memory_budget(unsigned heap_index, const char *message,
 static void
 test_memory_budget(void)
 {
-    t_require_ext("VK_EXT_memory_budget");
-
     for (uint32_t type_index = 0;
          type_index < t_physical_dev_mem_props->memoryTypeCount;
          type_index++)
@@ -109,4 +107,5 @@ test_define {
     .name = "func.memory_budget",
     .start = test_memory_budget,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_memory_budget"),
 };
@@ -19,11 +19,15 @@
 #define GET_DEVICE_FUNCTION_PTR(name) \
     PFN_vk##name name = (PFN_vk##name)vkGetDeviceProcAddr(t_device, "vk"#name)
 
+/* VK_KHR_external_memory_fd and the extensions that it depends on. */
+#define EXTERNAL_MEMORY_FD_EXTENSIONS \
+    "VK_KHR_external_memory_capabilities", \
+    "VK_KHR_external_memory", \
+    "VK_KHR_external_memory_fd"
+
 static void
 test_funcs(void)
 {
-    t_require_ext("VK_KHR_external_memory_fd");
-
     GET_DEVICE_FUNCTION_PTR(GetMemoryFdKHR);
 
     t_assert(GetMemoryFdKHR != NULL);
@@ -33,13 +37,12 @@ test_define {
     .name = "func.memory-fd.funcs",
     .start = test_funcs,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS(EXTERNAL_MEMORY_FD_EXTENSIONS),
 };
 
 static void
 test_read(int handle_type)
 {
-    t_require_ext("VK_KHR_external_memory_fd");
-
     GET_DEVICE_FUNCTION_PTR(GetMemoryFdKHR);
 
     t_assert(GetMemoryFdKHR != NULL);
@@ -99,12 +102,12 @@ test_define {
     .name = "func.memory-fd.opaque.read",
     .start = test_read_opaque,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS(EXTERNAL_MEMORY_FD_EXTENSIONS),
 };
 
 static void
 test_read_dma_buf(void)
 {
-    t_require_ext("VK_EXT_external_memory_dma_buf");
     test_read(VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT);
 }
 
@@ -112,13 +115,14 @@ test_define {
     .name = "func.memory-fd.dma-buf.read",
     .start = test_read_dma_buf,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS(
+        EXTERNAL_MEMORY_FD_EXTENSIONS,
+        "VK_EXT_external_memory_dma_buf"),
 };
 
 static void
 test_write(int handle_type)
 {
-    t_require_ext("VK_KHR_external_memory_fd");
-
     GET_DEVICE_FUNCTION_PTR(GetMemoryFdKHR);
 
     t_assert(GetMemoryFdKHR != NULL);
@@ -178,12 +182,12 @@ test_define {
     .name = "func.memory-fd.opaque.write",
     .start = test_write_opaque,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS(EXTERNAL_MEMORY_FD_EXTENSIONS),
 };
 
 static void
 test_write_dma_buf(void)
 {
-    t_require_ext("VK_EXT_external_memory_dma_buf");
     test_write(VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT);
 }
 
@@ -191,4 +195,7 @@ test_define {
     .name = "func.memory-fd.dma-buf.write",
     .start = test_write_dma_buf,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS(
+        EXTERNAL_MEMORY_FD_EXTENSIONS,
+        "VK_EXT_external_memory_dma_buf"),
 };
@@ -173,8 +173,11 @@ fill_rect_with_canary(void *pixels,
 {
     static const float peach[] = {1.0, 0.4, 0.2, 1.0};
 
-    if (format_info->num_type == CRU_NUM_TYPE_UNORM &&
-        format_info->num_channels == 4) {
+    if (format_info->is_compressed) {
+        memset(pixels, 0,
+               cru_format_get_image_size(format_info, width, height, 1));
+    } else if (format_info->num_type == CRU_NUM_TYPE_UNORM &&
+               format_info->num_channels == 4) {
         for (uint32_t i = 0; i < width * height; ++i) {
             uint8_t *rgba = pixels + (4 * i);
             rgba[0] = 255 * peach[0];
@@ -190,8 +193,6 @@ fill_rect_with_canary(void *pixels,
         }
     } else if (format_info->format == VK_FORMAT_S8_UINT) {
         memset(pixels, 0x19, width * height);
-    } else if (format_info->format == VK_FORMAT_BC3_UNORM_BLOCK) {
-        memset(pixels, 0, width * height);
     } else {
         t_failf("unsupported cru_format_info");
     }
@@ -365,8 +366,8 @@ miptree_calc_buffer_size(void)
 {
     const test_params_t *p = t_user_data;
 
+    const cru_format_info_t *format_info = t_format_info(p->format);
     size_t buffer_size = 0;
-    const uint32_t cpp = 4;
     const uint32_t width = p->width;
     const uint32_t height = p->height;
     const uint32_t depth = p->depth;
@@ -419,8 +420,9 @@ miptree_calc_buffer_size(void)
             buffer_size += mem_reqs.size * cru_minify(depth, l);
             vkDestroyImage(t_device, test_vk_image, NULL);
         } else
-            buffer_size += cpp * level_width * level_height *
-                             cru_minify(depth, l);
+            buffer_size += cru_format_get_image_size(format_info,
+                                                     level_width, level_height,
+                                                     cru_minify(depth, l));
     }
 
     buffer_size *= p->array_length;
@@ -453,7 +455,7 @@ mipslice_make_template_image(const struct cru_format_info *format_info,
         t_assert(pixels);
 
         uint32_t level_width = cru_minify(image_width, level);
-        uint32_t stride = level_width * format_info->cpp;
+        uint32_t stride = cru_format_get_row_size(format_info, level_width);
 
         t_assert(level_width == cru_image_get_width(file_img));
         t_assert(layer < cru_image_get_height(file_img));
@@ -516,7 +518,6 @@ miptree_create(void)
 
     const VkFormat format = params->format;
     const cru_format_info_t *format_info = t_format_info(format);
-    const uint32_t cpp = format_info->cpp;
     const uint32_t levels = params->levels;
     const uint32_t width = params->width;
     const uint32_t height = params->height;
@@ -769,7 +770,7 @@ miptree_create(void)
             t_assert(level_width == cru_image_get_width(templ_image));
             t_assert(level_height == cru_image_get_height(templ_image));
 
-            if (cru_image_get_format(templ_image) == VK_FORMAT_BC3_UNORM_BLOCK) {
+            if (format_info->is_compressed) {
                 src_image = templ_image;
             } else {
                 src_image = t_new_cru_image_from_pixels(src_pixels,
@@ -819,7 +820,9 @@ miptree_create(void)
             if (use_img_size)
                 buffer_offset += img_size;
             else
-                buffer_offset += cpp * level_width * level_height;
+                buffer_offset += cru_format_get_image_size(format_info,
+                                                           level_width,
+                                                           level_height, 1);
         }
     }
 
@@ -1083,7 +1086,6 @@ copy_color_images_with_draw(const test_data_t *data,
     VkDescriptorSet desc_sets[count];
     for (uint32_t i = 0; i < count; i++) {
         desc_sets[i] = qoAllocateDescriptorSet(t_device,
-            .descriptorPool = t_descriptor_pool,
             .pSetLayouts = &data->draw.set_layout);
     }
 
@@ -344,7 +344,7 @@ template = dedent("""
                 ".upload-{upload}.download-{download}.intermediate-{intermediate}",
         .start = test,
         .skip = {skip},
-        .no_image = true,
+        .no_image = true,{required_features}
         .user_data = &(test_params_t) {{
             .format = {format[1]},
             .aspect = VK_IMAGE_ASPECT_{aspect_caps}_BIT,
@@ -407,6 +407,12 @@ def get_array_length_str(params):
     else:
         raise Exception('unhandled view in get_array_length_str')
 
+def get_required_features_str(params):
+    if params.format.vk_name.startswith('VK_FORMAT_BC'):
+        return '\n    .required_features = { .textureCompressionBC = true },'
+    else:
+        return ''
+
 def main():
     out_filename = __file__.replace('.py', '.c')
 
@@ -431,6 +437,7 @@ def main():
                 upload_caps = to_caps(p.upload),
                 download_caps = to_caps(p.download),
                 intermediate_caps = to_caps(p.intermediate),
+                required_features = get_required_features_str(p),
                 skip = 'false')
             out_file.write(test_def)
 
@@ -36,8 +36,6 @@ struct params {
 static void
 test_multiview()
 {
-    t_require_ext("VK_KHR_multiview");
-
     const struct params *params = t_user_data;
 
     VkRenderPass pass = qoCreateRenderPass(t_device,
@@ -327,6 +325,7 @@ test_define {
     .name = "func.multiview.count_2",
     .start = test_multiview,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_KHR_multiview"),
     .user_data = &(struct params) {
         .view_count = 2,
         .view_mask = (1 << 2) - 1,
@@ -337,6 +336,7 @@ test_define {
     .name = "func.multiview.count_2.masked_0",
     .start = test_multiview,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_KHR_multiview"),
     .user_data = &(struct params) {
         .view_count = 2,
         .view_mask = (1 << 0),
@@ -347,6 +347,7 @@ test_define {
     .name = "func.multiview.count_2.masked_1",
     .start = test_multiview,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_KHR_multiview"),
     .user_data = &(struct params) {
         .view_count = 2,
         .view_mask = (1 << 1),
@@ -357,6 +358,7 @@ test_define {
     .name = "func.multiview.count_6",
     .start = test_multiview,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_KHR_multiview"),
     .user_data = &(struct params) {
         .view_count = 6,
         .view_mask = (1 << 6) - 1,
@@ -367,6 +369,7 @@ test_define {
     .name = "func.multiview.count_6.masked_0_2",
     .start = test_multiview,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_KHR_multiview"),
     .user_data = &(struct params) {
         .view_count = 6,
         .view_mask = (1 << 0) | (1 << 2),
@@ -377,6 +380,7 @@ test_define {
     .name = "func.multiview.count_6.masked_1_3_5",
     .start = test_multiview,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_KHR_multiview"),
     .user_data = &(struct params) {
         .view_count = 6,
         .view_mask = (1 << 1) | (1 << 3) | (1 << 5),
@@ -387,6 +391,7 @@ test_define {
     .name = "func.multiview.count_6.masked_3_4",
     .start = test_multiview,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_KHR_multiview"),
     .user_data = &(struct params) {
         .view_count = 6,
         .view_mask = (1 << 3) | (1 << 4),
@@ -158,7 +158,6 @@ test(void)
         });
 
     VkDescriptorSet set = qoAllocateDescriptorSet(t_device,
-        .descriptorPool = t_descriptor_pool,
         .pSetLayouts = &set_layout);
 
     vkUpdateDescriptorSets(t_device,
@@ -27,8 +27,6 @@
 static void
 pack_double(void)
 {
-    t_require_feature(shaderFloat64);
-
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
         layout(location = 0) out vec4 f_color;
         layout(push_constant) uniform push_consts {
@@ -60,13 +58,12 @@ test_define {
     .name = "func.shader.packDouble2x32.basic",
     .start = pack_double,
     .image_filename = "32x32-green.ref.png",
+    .required_features = { .shaderFloat64 = true },
 };
 
 static void
 unpack_double(void)
 {
-    t_require_feature(shaderFloat64);
-
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
         layout(location = 0) out vec4 f_color;
         layout(push_constant) uniform push_consts {
@@ -98,13 +95,12 @@ test_define {
     .name = "func.shader.unpackDouble2x32.basic",
     .start = unpack_double,
     .image_filename = "32x32-green.ref.png",
+    .required_features = { .shaderFloat64 = true },
 };
 
 static void
 pack_int64(void)
 {
-    t_require_feature(shaderInt64);
-
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
     QO_EXTENSION GL_ARB_gpu_shader_int64 : enable
         layout(location = 0) out vec4 f_color;
@@ -137,13 +133,12 @@ test_define {
     .name = "func.shader.packUint2x32.basic",
     .start = pack_int64,
     .image_filename = "32x32-green.ref.png",
+    .required_features = { .shaderInt64 = true },
 };
 
 static void
 unpack_int64(void)
 {
-    t_require_feature(shaderInt64);
-
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
     QO_EXTENSION GL_ARB_gpu_shader_int64 : enable
         layout(location = 0) out vec4 f_color;
@@ -176,5 +171,6 @@ test_define {
     .name = "func.shader.unpackUint2x32.basic",
     .start = unpack_int64,
     .image_filename = "32x32-green.ref.png",
+    .required_features = { .shaderInt64 = true },
 };
 
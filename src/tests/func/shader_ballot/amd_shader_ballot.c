@@ -28,8 +28,6 @@
 static void
 basic(void)
 {
-    t_require_ext("VK_EXT_shader_subgroup_ballot");
-    t_require_ext("VK_AMD_shader_ballot");
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
     QO_EXTENSION GL_ARB_gpu_shader_int64 : enable
     QO_EXTENSION GL_ARB_shader_ballot : enable
@@ -59,13 +57,15 @@ test_define {
     .name = "func.amd-shader-ballot.basic",
     .start = basic,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS(
+        "VK_EXT_shader_subgroup_ballot",
+        "VK_AMD_shader_ballot"),
+    .required_features = { .shaderInt64 = true },
 };
 
 static void
 inclusive_scan_iadd(void)
 {
-    t_require_ext("VK_EXT_shader_subgroup_ballot");
-    t_require_ext("VK_AMD_shader_ballot");
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
     QO_EXTENSION GL_ARB_gpu_shader_int64 : enable
     QO_EXTENSION GL_ARB_shader_ballot : enable
@@ -102,6 +102,10 @@ test_define {
     .name = "func.amd-shader-ballot.inclusive-scan-iadd",
     .start = inclusive_scan_iadd,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS(
+        "VK_EXT_shader_subgroup_ballot",
+        "VK_AMD_shader_ballot"),
+    .required_features = { .shaderInt64 = true },
 };
 
 static VkDeviceMemory
@@ -156,7 +160,6 @@ common_init(VkShaderModule cs, const uint32_t ssbo_size)
 
     VkDescriptorSet set =
         qoAllocateDescriptorSet(t_device,
-                                .descriptorPool = t_descriptor_pool,
                                 .pSetLayouts = &set_layout);
 
     VkBuffer buffer_out = qoCreateBuffer(t_device, .size = ssbo_size);
@@ -206,8 +209,6 @@ dispatch_and_wait(uint32_t x, uint32_t y, uint32_t z)
 static void
 inclusive_scan_iadd_compute(void)
 {
-    t_require_ext("VK_AMD_shader_ballot");
-
     VkShaderModule cs = qoCreateShaderModuleGLSL(
         t_device, COMPUTE,
     QO_EXTENSION GL_AMD_shader_ballot : enable
@@ -241,13 +242,12 @@ test_define {
     .name = "func.amd-shader-ballot.inclusive-scan-iadd-compute",
     .start = inclusive_scan_iadd_compute,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_AMD_shader_ballot"),
 };
 
 static void
 ballot_if_else(void)
 {
-    t_require_ext("VK_EXT_shader_subgroup_ballot");
-    t_require_ext("VK_AMD_shader_ballot");
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
     QO_EXTENSION GL_ARB_shader_ballot : enable
     QO_EXTENSION GL_AMD_shader_ballot : enable
@@ -283,6 +283,10 @@ test_define {
     .name = "func.amd-shader-ballot.if-else",
     .start = ballot_if_else,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS(
+        "VK_EXT_shader_subgroup_ballot",
+        "VK_AMD_shader_ballot"),
+    .required_features = { .shaderInt64 = true },
 };
 
 
@@ -24,26 +24,14 @@
 
 #include "ext_shader_ballot-spirv.h"
 
-static void
-require_shader_int64(void)
-{
-    VkPhysicalDeviceFeatures features = {};
-    vkGetPhysicalDeviceFeatures(t_physical_dev, &features);
-    if (!features.shaderInt64)
-        t_skipf("shaderInt64 not supported");
-}
+/* GL_ARB_shader_ballot implicitly requires int64 support, so every test
+ * here requires shaderInt64.  See
+ * https://github.com/KhronosGroup/glslang/issues/1292 for discussion.
+ */
 
 static void
 ballot_basic(void)
 {
-    t_require_ext("VK_EXT_shader_subgroup_ballot");
-
-    /* GL_ARB_shader_ballot implicitly requires int64 support.  See
-     * https://github.com/KhronosGroup/glslang/issues/1292 for
-     * discussion.
-     */
-    require_shader_int64();
-
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
     QO_EXTENSION GL_ARB_shader_ballot : enable
         layout(location = 0) out vec4 f_color;
@@ -64,14 +52,13 @@ test_define {
     .name = "func.shader-ballot.basic",
     .start = ballot_basic,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_shader_subgroup_ballot"),
+    .required_features = { .shaderInt64 = true },
 };
 
 static void
 ballot_if_else(void)
 {
-    t_require_ext("VK_EXT_shader_subgroup_ballot");
-    require_shader_int64();
-
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
     QO_EXTENSION GL_ARB_gpu_shader_int64 : enable
     QO_EXTENSION GL_ARB_shader_ballot : enable
@@ -142,15 +129,14 @@ test_define {
     .name = "func.shader-ballot.if-else",
     .start = ballot_if_else,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_shader_subgroup_ballot"),
+    .required_features = { .shaderInt64 = true },
 };
 
 
 static void
 builtins(void)
 {
-    t_require_ext("VK_EXT_shader_subgroup_ballot");
-    require_shader_int64();
-
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
     QO_EXTENSION GL_ARB_gpu_shader_int64 : enable
     QO_EXTENSION GL_ARB_shader_ballot : enable
@@ -204,14 +190,13 @@ test_define {
     .name = "func.shader-ballot.builtins",
     .start = builtins,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_shader_subgroup_ballot"),
+    .required_features = { .shaderInt64 = true },
 };
 
 static void
 read_first_invocation(void)
 {
-    t_require_ext("VK_EXT_shader_subgroup_ballot");
-    require_shader_int64();
-
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
     QO_EXTENSION GL_ARB_gpu_shader_int64 : enable
     QO_EXTENSION GL_ARB_shader_ballot : enable
@@ -251,5 +236,7 @@ test_define {
     .name = "func.shader-ballot.readFirstInvocation",
     .start = read_first_invocation,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_shader_subgroup_ballot"),
+    .required_features = { .shaderInt64 = true },
 };
 
@@ -27,7 +27,6 @@
 static void
 basic(void)
 {
-    t_require_ext("VK_EXT_shader_subgroup_vote");
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
     QO_EXTENSION GL_ARB_shader_group_vote : enable
         layout(location = 0) out vec4 f_color;
@@ -60,19 +59,12 @@ test_define {
     .name = "func.shader-subgroup-vote.basic",
     .start = basic,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS("VK_EXT_shader_subgroup_vote"),
 };
 
 static void
 advanced(void)
 {
-    t_require_ext("VK_EXT_shader_subgroup_vote");
-    t_require_ext("VK_EXT_shader_subgroup_ballot");
-
-    VkPhysicalDeviceFeatures features = {};
-    vkGetPhysicalDeviceFeatures(t_physical_dev, &features);
-    if (!features.shaderInt64)
-        t_skipf("shaderInt64 not supported");
-
     VkShaderModule fs = qoCreateShaderModuleGLSL(t_device, FRAGMENT,
     QO_EXTENSION GL_ARB_shader_group_vote : enable
     QO_EXTENSION GL_ARB_shader_ballot : enable
@@ -123,4 +115,8 @@ test_define {
     .name = "func.shader-subgroup-vote.advanced",
     .start = advanced,
     .image_filename = "32x32-green.ref.png",
+    .required_extensions = TEST_EXTENSIONS(
+        "VK_EXT_shader_subgroup_vote",
+        "VK_EXT_shader_subgroup_ballot"),
+    .required_features = { .shaderInt64 = true },
 };
@@ -112,7 +112,6 @@ test(void)
 
     VkDescriptorSet set =
         qoAllocateDescriptorSet(t_device,
-                                .descriptorPool = t_descriptor_pool,
                                 .pSetLayouts = &set_layout);
 
     VkBuffer buffer_in = qoCreateBuffer(t_device, .size = 4096);
@@ -199,4 +198,5 @@ test_define {
     .name = "func.ssbo.interleave",
     .start = test,
     .image_filename = "32x32-green.ref.png",
+    .required_features = { .vertexPipelineStoresAndAtomics = true },
 };
@@ -42,6 +42,33 @@ struct buffer_layout {
     uint32_t data[LOCAL_WORKGROUP_SIZE][2];
 };
 
+/* The test creates its own devices, so t_has_ext() doesn't tell whether an
+ * optional extension is available to them.
+ */
+static bool
+physical_dev_has_ext(const char *name)
+{
+    uint32_t count = 0;
+    VkResult result = vkEnumerateDeviceExtensionProperties(t_physical_dev,
+                                                           NULL, &count, NULL);
+    t_assert(result == VK_SUCCESS);
+
+    VkExtensionProperties *props = malloc(count * sizeof(*props));
+    t_assert(props);
+    t_cleanup_push_free(props);
+
+    result = vkEnumerateDeviceExtensionProperties(t_physical_dev, NULL,
+                                                  &count, props);
+    t_assert(result == VK_SUCCESS);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(props[i].extensionName, name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
 static void
 init_context(struct test_context *ctx, float priority,
              VkQueueGlobalPriorityEXT g_priority)
@@ -55,7 +82,7 @@ init_context(struct test_context *ctx, float priority,
    };
 
     bool use_global_priority =
-        t_has_ext("VK_EXT_global_priority");
+        physical_dev_has_ext("VK_EXT_global_priority");
 
     VkDeviceQueueGlobalPriorityCreateInfoEXT gp_info = {
        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_GLOBAL_PRIORITY_CREATE_INFO_EXT,
@@ -651,6 +678,13 @@ test_define {
     .name = "func.sync.semaphore-fd.sanity",
     .start = test_sanity,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS(
+        "VK_KHR_external_memory",
+        "VK_KHR_external_memory_capabilities",
+        "VK_KHR_external_memory_fd",
+        "VK_KHR_external_semaphore",
+        "VK_KHR_external_semaphore_capabilities",
+        "VK_KHR_external_semaphore_fd"),
 };
 
 static void
@@ -682,11 +716,6 @@ require_handle_type(VkExternalSemaphoreHandleTypeFlagBitsKHR handle_type)
 static void
 test_opaque_fd_no_sync(void)
 {
-    t_require_ext("VK_KHR_external_memory");
-    t_require_ext("VK_KHR_external_memory_capabilities");
-    t_require_ext("VK_KHR_external_memory_fd");
-    t_require_ext("VK_EXT_global_priority");
-
     struct test_context ctx1, ctx2;
     init_context(&ctx1, 1.0, VK_QUEUE_GLOBAL_PRIORITY_MEDIUM_EXT);
     init_context(&ctx2, 0.0, VK_QUEUE_GLOBAL_PRIORITY_LOW_EXT);
@@ -767,18 +796,19 @@ test_define {
     .name = "func.sync.semaphore-fd.no-sync",
     .start = test_opaque_fd_no_sync,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS(
+        "VK_KHR_external_memory",
+        "VK_KHR_external_memory_capabilities",
+        "VK_KHR_external_memory_fd",
+        "VK_KHR_external_semaphore",
+        "VK_KHR_external_semaphore_capabilities",
+        "VK_KHR_external_semaphore_fd",
+        "VK_EXT_global_priority"),
 };
 
 static void
 test_sync_fd(void)
 {
-    t_require_ext("VK_KHR_external_memory");
-    t_require_ext("VK_KHR_external_memory_capabilities");
-    t_require_ext("VK_KHR_external_memory_fd");
-    t_require_ext("VK_KHR_external_semaphore");
-    t_require_ext("VK_KHR_external_semaphore_capabilities");
-    t_require_ext("VK_KHR_external_semaphore_fd");
-
     require_handle_type(VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT_KHR);
 
     struct test_context ctx1, ctx2;
@@ -920,4 +950,11 @@ test_define {
     .name = "func.sync.semaphore-fd.sync-fd",
     .start = test_sync_fd,
     .no_image = true,
+    .required_extensions = TEST_EXTENSIONS(
+        "VK_KHR_external_memory",
+        "VK_KHR_external_memory_capabilities",
+        "VK_KHR_external_memory_fd",
+        "VK_KHR_external_semaphore",
+        "VK_KHR_external_semaphore_capabilities",
+        "VK_KHR_external_semaphore_fd"),
 };
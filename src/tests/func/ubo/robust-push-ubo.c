@@ -145,7 +145,6 @@ test(void)
     VkBuffer buffer = create_buffer(bind_offset);
 
     VkDescriptorSet set = qoAllocateDescriptorSet(t_device,
-        .descriptorPool = t_descriptor_pool,
         .pSetLayouts = &set_layout);
 
     vkUpdateDescriptorSets(t_device, 1, /* writeCount */
@@ -223,7 +222,6 @@ test_dynamic(void)
     VkBuffer buffer = create_buffer(bind_offset);
 
     VkDescriptorSet set = qoAllocateDescriptorSet(t_device,
-        .descriptorPool = t_descriptor_pool,
         .pSetLayouts = &set_layout);
 
     vkUpdateDescriptorSets(t_device, 1, /* writeCount */
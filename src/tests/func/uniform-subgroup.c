@@ -73,7 +73,6 @@ common_init(VkShaderModule cs, const uint32_t ssbo_size,
 
     VkDescriptorSet set =
         qoAllocateDescriptorSet(t_device,
-                                .descriptorPool = t_descriptor_pool,
                                 .pSetLayouts = &set_layout);
 
     VkBuffer buffer_out = qoCreateBuffer(t_device, .size = ssbo_size);
@@ -142,11 +141,6 @@ test(void)
     if (t_physical_dev_props->apiVersion < VK_API_VERSION_1_1)
         t_skipf("Vulkan 1.1 required");
 
-    if (params->bit_size == 8 || (params->bit_size == 16 && is_float))
-        t_require_ext("VK_KHR_shader_float16_int8");
-    if (params->bit_size != 32)
-        t_require_ext("VK_KHR_shader_subgroup_extended_types");
-
     VkPhysicalDeviceSubgroupProperties subgroup_props = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
     };
@@ -172,15 +166,8 @@ test(void)
 
     if (params->bit_size == 8 && !fp16_int8_features.shaderInt8)
         t_skipf("missing shaderInt8");
-    if (params->bit_size == 16 && !is_float && !features.features.shaderInt16)
-        t_skipf("missing shaderInt16");
-    if (params->bit_size == 64 && !is_float && !features.features.shaderInt64)
-        t_skipf("missing shaderInt64");
-
     if (params->bit_size == 16 && is_float && !fp16_int8_features.shaderFloat16)
         t_skipf("missing shaderFloat16");
-    if (params->bit_size == 64 && is_float && !features.features.shaderFloat64)
-        t_skipf("missing shaderFloat64");
 
     VkShaderModule cs = qoCreateShaderModuleGLSL(
         t_device, COMPUTE,
@@ -308,29 +295,54 @@ test(void)
     t_pass();
 }
 
-#define _TEST_DEF(bit_size, reduce, reduce_name, func, func_name) \
+/* The extensions and core features that each type needs.  shaderInt8 and
+ * shaderFloat16 are not core features, so test() checks them itself.
+ */
+#define INT8_REQS \
+    .required_extensions = TEST_EXTENSIONS( \
+        "VK_KHR_shader_float16_int8", \
+        "VK_KHR_shader_subgroup_extended_types"),
+#define INT16_REQS \
+    .required_extensions = TEST_EXTENSIONS( \
+        "VK_KHR_shader_subgroup_extended_types"), \
+    .required_features = { .shaderInt16 = true },
+#define INT32_REQS
+#define INT64_REQS \
+    .required_extensions = TEST_EXTENSIONS( \
+        "VK_KHR_shader_subgroup_extended_types"), \
+    .required_features = { .shaderInt64 = true },
+#define FLOAT16_REQS INT8_REQS
+#define FLOAT32_REQS
+#define FLOAT64_REQS \
+    .required_extensions = TEST_EXTENSIONS( \
+        "VK_KHR_shader_subgroup_extended_types"), \
+    .required_features = { .shaderFloat64 = true },
+
+#define _TEST_DEF(type, bit_size, reduce, reduce_name, func, func_name) \
 test_define { \
     .name = "func.uniform-subgroup." #reduce_name "." #func_name #bit_size, \
     .start = test, \
     .user_data = &(test_params_t) {reduce, bit_size, func}, \
     .no_image = true, \
+    .api_version = VK_MAKE_VERSION(1, 1, 0), \
+    type##bit_size##_REQS \
 };
 
-#define _TEST(bit_size, func, func_name) \
-_TEST_DEF(bit_size, 0, reduce, func, func_name) \
-_TEST_DEF(bit_size, 1, inclusive, func, func_name) \
-_TEST_DEF(bit_size, 2, exclusive, func, func_name)
+#define _TEST(type, bit_size, func, func_name) \
+_TEST_DEF(type, bit_size, 0, reduce, func, func_name) \
+_TEST_DEF(type, bit_size, 1, inclusive, func, func_name) \
+_TEST_DEF(type, bit_size, 2, exclusive, func, func_name)
 
 #define TEST_INT(func, func_name) \
-_TEST(8, func, func_name) \
-_TEST(16, func, func_name) \
-_TEST(32, func, func_name) \
-_TEST(64, func, func_name)
+_TEST(INT, 8, func, func_name) \
+_TEST(INT, 16, func, func_name) \
+_TEST(INT, 32, func, func_name) \
+_TEST(INT, 64, func, func_name)
 
 #define TEST_FLOAT(func, func_name) \
-_TEST(16, func, func_name) \
-_TEST(32, func, func_name) \
-_TEST(64, func, func_name)
+_TEST(FLOAT, 16, func, func_name) \
+_TEST(FLOAT, 32, func, func_name) \
+_TEST(FLOAT, 64, func, func_name)
 
 TEST_INT(0, iadd)
 TEST_INT(1, imin)
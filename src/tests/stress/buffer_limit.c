@@ -61,7 +61,6 @@ test_max_buffer()
             });
 
     VkDescriptorSet set = qoAllocateDescriptorSet(t_device,
-                                .descriptorPool = t_descriptor_pool,
                                 .pSetLayouts = &set_layout);
 
     vkUpdateDescriptorSets(t_device,
@@ -167,38 +167,11 @@ test_lots_of_surface_state(VkShaderModule vs, VkShaderModule fs,
                            (VkBuffer[]) { vbo },
                            (VkDeviceSize[]) { 0 });
 
-    const VkDescriptorPoolSize pool_sizes[2] = {
-        {
-            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-            .descriptorCount = 12
-        },
-        {
-            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = 12 * 1024
-        }
-    };
-
-    const VkDescriptorPoolCreateInfo create_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .maxSets = 1024,
-        .poolSizeCount = 2,
-        .pPoolSizes = pool_sizes
-    };
-
-    VkDescriptorPool desc_pool;
-    VkResult res = vkCreateDescriptorPool(t_device, &create_info, NULL,
-                                          &desc_pool);
-    t_assert(res == VK_SUCCESS);
-    t_cleanup_push_vk_descriptor_pool(t_device, desc_pool);
-
     VkDescriptorSet set[1024];
     if (use_dynamic_offsets) {
         // Allocate and set up a single descriptor set.  We'll just re-bind
         // it with new dynamic offsets each time.
         set[0] = qoAllocateDescriptorSet(t_device,
-                                         .descriptorPool = desc_pool,
                                          .pSetLayouts = &set_layout);
 
         VkDescriptorBufferInfo buffer_info[12];
@@ -224,18 +197,10 @@ test_lots_of_surface_state(VkShaderModule vs, VkShaderModule fs,
                 },
             }, 0, NULL);
     } else {
-        VkDescriptorSetLayout layouts[1024];
-        for (int i = 0; i < 1024; i++)
-            layouts[i] = set_layout;
-
-        VkResult result = vkAllocateDescriptorSets(t_device,
-            &(VkDescriptorSetAllocateInfo) {
-                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-                .descriptorPool = desc_pool,
-                .descriptorSetCount = 1024,
-                .pSetLayouts = layouts,
-            }, set);
-        t_assert(result == VK_SUCCESS);
+        for (int i = 0; i < 1024; i++) {
+            set[i] = qoAllocateDescriptorSet(t_device,
+                                             .pSetLayouts = &set_layout);
+        }
     }
 
     for (int i = 0; i < 1024; i++) {
@@ -531,44 +496,11 @@ test_lots_of_surface_state_cs(bool use_dynamic_offsets)
 
     vkCmdBindPipeline(t_cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
 
-    const VkDescriptorPoolCreateInfo create_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .maxSets = 1024,
-        .poolSizeCount = 4,
-        .pPoolSizes = (const VkDescriptorPoolSize[]) {
-            {
-                .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-                .descriptorCount = 12,
-            },
-            {
-                .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .descriptorCount = 12 * 1024,
-            },
-            {
-                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
-                .descriptorCount = 1,
-            },
-            {
-                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                .descriptorCount = 1 * 1024,
-            },
-        }
-    };
-
-    VkDescriptorPool desc_pool;
-    VkResult res = vkCreateDescriptorPool(t_device, &create_info, NULL,
-                                          &desc_pool);
-    t_assert(res == VK_SUCCESS);
-    t_cleanup_push_vk_descriptor_pool(t_device, desc_pool);
-
     VkDescriptorSet set[1024];
     if (use_dynamic_offsets) {
         // Allocate and set up a single descriptor set.  We'll just re-bind
         // it with new dynamic offsets each time.
         set[0] = qoAllocateDescriptorSet(t_device,
-                                         .descriptorPool = desc_pool,
                                          .pSetLayouts = &set_layout);
 
         VkDescriptorBufferInfo buffer_info[12];
@@ -608,18 +540,10 @@ test_lots_of_surface_state_cs(bool use_dynamic_offsets)
                 },
             }, 0, NULL);
     } else {
-        VkDescriptorSetLayout layouts[1024];
-        for (int i = 0; i < 1024; i++)
-            layouts[i] = set_layout;
-
-        VkResult result = vkAllocateDescriptorSets(t_device,
-            &(VkDescriptorSetAllocateInfo) {
-                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-                .descriptorPool = desc_pool,
-                .descriptorSetCount = 1024,
-                .pSetLayouts = layouts,
-            }, set);
-        t_assert(result == VK_SUCCESS);
+        for (int i = 0; i < 1024; i++) {
+            set[i] = qoAllocateDescriptorSet(t_device,
+                                             .pSetLayouts = &set_layout);
+        }
     }
 
     for (int i = 0; i < 1024; i++) {
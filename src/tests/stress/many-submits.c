@@ -0,0 +1,141 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// \file many-submits.c
+// \brief Keep many submits in flight, tracked by a timeline semaphore.
+//
+// Each submit fills one dword of a buffer with its index. Submits go out in
+// batches that each signal the next value of a timeline, and the test never
+// idles the queue: it reuses a command buffer only once the batch that last
+// used it is complete.
+
+#include <string.h>
+
+#include "tapi/t.h"
+
+#define NUM_SUBMITS 16384
+#define SUBMITS_PER_BATCH 16
+#define MAX_SUBMITS_IN_FLIGHT 1024
+
+static void
+test(void)
+{
+    const VkDeviceSize size = NUM_SUBMITS * sizeof(uint32_t);
+
+    VkBuffer buffer = qoCreateBuffer(t_device,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .size = size);
+    VkDeviceMemory mem = qoAllocBufferMemory(t_device, buffer,
+        .properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    qoBindBufferMemory(t_device, buffer, mem, 0);
+
+    uint32_t *map = qoMapMemory(t_device, mem, 0, size, 0);
+    memset(map, 0xff, size);
+
+    VkCommandBuffer cmds[MAX_SUBMITS_IN_FLIGHT];
+    for (unsigned i = 0; i < MAX_SUBMITS_IN_FLIGHT; i++)
+        cmds[i] = qoAllocateCommandBuffer(t_device, t_cmd_pool);
+
+    QoTimeline timeline = qoCreateTimeline(t_device);
+    uint64_t value = 0;
+    unsigned stalls = 0;
+
+    for (unsigned b = 0; b < NUM_SUBMITS / SUBMITS_PER_BATCH; b++) {
+        VkSubmitInfo submits[SUBMITS_PER_BATCH];
+
+        for (unsigned s = 0; s < SUBMITS_PER_BATCH; s++) {
+            const unsigned i = b * SUBMITS_PER_BATCH + s;
+            VkCommandBuffer cmd = cmds[i % MAX_SUBMITS_IN_FLIGHT];
+
+            // The command buffer was last used by submit i -
+            // MAX_SUBMITS_IN_FLIGHT, which the timeline reports done once
+            // its batch's value is reached.
+            if (i >= MAX_SUBMITS_IN_FLIGHT) {
+                uint64_t needed =
+                    (i - MAX_SUBMITS_IN_FLIGHT) / SUBMITS_PER_BATCH + 1;
+
+                if (!qoPollTimeline(timeline, needed)) {
+                    stalls++;
+                    qoWaitTimeline(timeline, needed);
+                }
+            }
+
+            qoBeginCommandBuffer(cmd);
+            vkCmdFillBuffer(cmd, buffer, i * sizeof(uint32_t),
+                            sizeof(uint32_t), i);
+            qoEndCommandBuffer(cmd);
+
+            submits[s] = (VkSubmitInfo) {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &cmds[i % MAX_SUBMITS_IN_FLIGHT],
+            };
+        }
+
+        value = qoQueueSubmitBatch(t_queue,
+            .submitCount = SUBMITS_PER_BATCH,
+            .pSubmits = submits,
+            .signalTimeline = timeline);
+    }
+
+    // Make the fills visible to the host. The barrier's scope covers every
+    // earlier submit on the queue.
+    vkCmdPipelineBarrier(t_cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1,
+        &(VkBufferMemoryBarrier) {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+            .buffer = buffer,
+            .offset = 0,
+            .size = size,
+        }, 0, NULL);
+    qoEndCommandBuffer(t_cmd_buffer);
+
+    value = qoQueueSubmitBatch(t_queue,
+        .submitCount = 1,
+        .pSubmits = &(VkSubmitInfo) {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &t_cmd_buffer,
+        },
+        .signalTimeline = timeline);
+
+    qoWaitTimeline(timeline, value);
+
+    logi("%u submits in batches of %u, %u stalls for a free command buffer",
+         NUM_SUBMITS, SUBMITS_PER_BATCH, stalls);
+
+    for (unsigned i = 0; i < NUM_SUBMITS; i++) {
+        if (map[i] != i)
+            t_failf("dword %u is 0x%x, expected 0x%x", i, map[i], i);
+    }
+
+    t_pass();
+}
+
+test_define {
+    .name = "stress.many-submits",
+    .start = test,
+    .no_image = true,
+    .required_extensions = TEST_EXTENSIONS("VK_KHR_timeline_semaphore"),
+};
@@ -20,7 +20,9 @@
 // IN THE SOFTWARE.
 
 #include <assert.h>
+#include <stdalign.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include <pthread.h>
@@ -28,10 +30,33 @@
 #include "util/cru_cleanup.h"
 #include "util/cru_image.h"
 #include "util/log.h"
+#include "util/misc.h"
 #include "util/cru_refcount.h"
-#include "util/cru_vec.h"
 #include "util/xalloc.h"
 
+/// Size of each arena chunk, including its header.
+#define CHUNK_SIZE 4096
+
+/// Each command, and each command header, is padded to this alignment.
+#define CMD_ALIGN 8
+
+/// Maximum number of released stacks kept in each thread's free list.
+#define MAX_FREE_STACKS 8
+
+/// Maximum number of handles freed by a single batched Vulkan call.
+#define MAX_BATCH 64
+
+struct cleanup_chunk {
+    struct cleanup_chunk *prev;
+
+    /// Number of bytes used in cleanup_chunk::data.
+    size_t used;
+
+    alignas(CMD_ALIGN) uint8_t data[];
+};
+
+#define CHUNK_DATA_SIZE (CHUNK_SIZE - sizeof(struct cleanup_chunk))
+
 struct cru_cleanup_stack {
     /// \brief Stack of commands
     ///
@@ -46,11 +71,33 @@ struct cru_cleanup_stack {
     /// The metadata (the header) must come *after* its command because (1)
     /// commands are variable length and (2) the stack is unwound in LIFO
     /// order.
-    cru_void_vec_t commands;
+    ///
+    /// The commands live in a list of fixed-size chunks, newest chunk first.
+    /// A push that does not fit in the top chunk starts a new chunk; no entry
+    /// ever straddles or moves between chunks. Therefore pushing never
+    /// reallocates nor copies the existing commands.
+    struct cleanup_chunk *top;
+
+    /// A chunk that was emptied by popping, kept to avoid malloc churn when
+    /// the stack repeatedly crosses a chunk boundary.
+    struct cleanup_chunk *spare;
 
     cru_refcount_t refcount;
+
+    /// Link in the thread's free list of recyclable stacks.
+    cru_cleanup_stack_t *next_free;
 };
 
+/// Released stacks owned by a single thread, ready for reuse by
+/// cru_cleanup_create().
+struct free_list {
+    cru_cleanup_stack_t *head;
+    uint32_t len;
+};
+
+static pthread_key_t free_list_key;
+static pthread_once_t free_list_once = PTHREAD_ONCE_INIT;
+
 struct cmd_header {
    enum cru_cleanup_cmd cmd_type;
 };
@@ -201,14 +248,176 @@ struct cmd_vk_shader_module {
     VkShaderModule x;
 };
 
+static struct cleanup_chunk *
+chunk_new(cru_cleanup_stack_t *c)
+{
+    struct cleanup_chunk *chunk;
+
+    if (c->spare) {
+        chunk = c->spare;
+        c->spare = NULL;
+    } else {
+        chunk = xmalloc(CHUNK_SIZE);
+    }
+
+    chunk->prev = NULL;
+    chunk->used = 0;
+
+    return chunk;
+}
+
+/// Reserve \a size bytes at the top of the stack.
+static void *
+stack_push(cru_cleanup_stack_t *c, size_t size)
+{
+    size = cru_align_size(size, CMD_ALIGN);
+    assert(size <= CHUNK_DATA_SIZE);
+
+    if (c->top->used + size > CHUNK_DATA_SIZE) {
+        struct cleanup_chunk *chunk = chunk_new(c);
+        chunk->prev = c->top;
+        c->top = chunk;
+    }
+
+    void *p = c->top->data + c->top->used;
+    c->top->used += size;
+
+    return p;
+}
+
+/// Drop to the next non-empty chunk, if the top chunk is empty. Return
+/// false if the whole stack is empty.
+static bool
+stack_settle(cru_cleanup_stack_t *c)
+{
+    while (c->top->used == 0) {
+        struct cleanup_chunk *empty = c->top;
+
+        if (!empty->prev)
+            return false;
+
+        c->top = empty->prev;
+
+        if (c->spare)
+            free(empty);
+        else
+            c->spare = empty;
+    }
+
+    return true;
+}
+
+/// Release the top \a size bytes of the stack. The returned pointer remains
+/// valid until the next push.
+static void *
+stack_pop(cru_cleanup_stack_t *c, size_t size)
+{
+    size = cru_align_size(size, CMD_ALIGN);
+
+    if (!stack_settle(c))
+        log_internal_error("cleanup stack underflow");
+
+    assert(c->top->used >= size);
+    c->top->used -= size;
+
+    return c->top->data + c->top->used;
+}
+
+/// Return the top command's header without popping it, or NULL if the stack
+/// is empty.
+static struct cmd_header *
+stack_peek_header(cru_cleanup_stack_t *c)
+{
+    if (!stack_settle(c))
+        return NULL;
+
+    const size_t size = cru_align_size(sizeof(struct cmd_header), CMD_ALIGN);
+    assert(c->top->used >= size);
+
+    return (struct cmd_header *) (c->top->data + c->top->used - size);
+}
+
+/// Discard all commands, and all chunks but the bottom one, without doing
+/// the commands.
+static void
+stack_reset(cru_cleanup_stack_t *c)
+{
+    while (c->top->prev) {
+        struct cleanup_chunk *chunk = c->top;
+        c->top = chunk->prev;
+        free(chunk);
+    }
+
+    c->top->used = 0;
+}
+
+static void
+stack_destroy(cru_cleanup_stack_t *c)
+{
+    stack_reset(c);
+    free(c->top);
+    free(c->spare);
+    free(c);
+}
+
+static void
+free_list_destroy(void *data)
+{
+    struct free_list *list = data;
+    cru_cleanup_stack_t *c;
+
+    while ((c = list->head)) {
+        list->head = c->next_free;
+        stack_destroy(c);
+    }
+
+    free(list);
+}
+
+static void
+free_list_init(void)
+{
+    if (pthread_key_create(&free_list_key, free_list_destroy))
+        log_abort("%s: failed to create thread key", __func__);
+}
+
+static struct free_list *
+get_free_list(void)
+{
+    struct free_list *list;
+
+    if (pthread_once(&free_list_once, free_list_init))
+        log_abort("%s: pthread_once failed", __func__);
+
+    list = pthread_getspecific(free_list_key);
+    if (!list) {
+        list = xzalloc(sizeof(*list));
+        if (pthread_setspecific(free_list_key, list))
+            log_abort("%s: failed to set thread key", __func__);
+    }
+
+    return list;
+}
+
+/// Reuse a stack from the calling thread's free list, if one is available.
+/// Otherwise create a new stack.
 cru_cleanup_stack_t*
 cru_cleanup_create(void)
 {
+    struct free_list *list = get_free_list();
     cru_cleanup_stack_t *c = NULL;
 
-    c = xmalloc(sizeof(*c));
+    if (list->head) {
+        c = list->head;
+        list->head = c->next_free;
+        list->len--;
+    } else {
+        c = xzalloc(sizeof(*c));
+        c->top = chunk_new(c);
+    }
+
+    c->next_free = NULL;
     cru_refcount_init(&c->refcount);
-    cru_vec_init(&c->commands);
 
     return c;
 }
@@ -220,6 +429,7 @@ cru_cleanup_reference(cru_cleanup_stack_t *c)
 }
 
 /// All commands are popped off the stack when the last refcount is dropped.
+/// The emptied stack then goes to the calling thread's free list.
 void
 cru_cleanup_release(cru_cleanup_stack_t *c)
 {
@@ -227,8 +437,17 @@ cru_cleanup_release(cru_cleanup_stack_t *c)
         return;
 
     cru_cleanup_pop_all(c);
-    cru_vec_finish(&c->commands);
-    free(c);
+
+    struct free_list *list = get_free_list();
+
+    if (list->len >= MAX_FREE_STACKS) {
+        stack_destroy(c);
+        return;
+    }
+
+    c->next_free = list->head;
+    list->head = c;
+    list->len++;
 }
 
 void
@@ -250,7 +469,7 @@ cru_cleanup_push_commandv(cru_cleanup_stack_t *c,
     struct cmd_header *header;
 
    #define CMD_CREATE(T) \
-        T *cmd = cru_vec_push(&c->commands, sizeof(*cmd))
+        T *cmd = stack_push(c, sizeof(*cmd))
 
    #define CMD_SET(var) \
         cmd->var = va_arg(va, __typeof__(cmd->var))
@@ -444,7 +663,7 @@ cru_cleanup_push_commandv(cru_cleanup_stack_t *c,
         }
     }
 
-    header = cru_vec_push(&c->commands, sizeof(*header));
+    header = stack_push(c, sizeof(*header));
     header->cmd_type = cmd_type;
 
    #undef CMD_CREATE
@@ -456,14 +675,18 @@ static bool
 cru_cleanup_pop_impl(cru_cleanup_stack_t *c, bool noop)
 {
     struct cmd_header *header;
+    enum cru_cleanup_cmd cmd_type;
 
-    if (c->commands.len == 0)
+    if (!stack_peek_header(c))
         return false;
 
-    header = cru_vec_pop(&c->commands, sizeof(*header));
+    // Copy the type, because popping the command may free the header's
+    // chunk.
+    header = stack_pop(c, sizeof(*header));
+    cmd_type = header->cmd_type;
 
     #define CMD_GET(T) \
-        T *cmd = cru_vec_pop(&c->commands, sizeof(*cmd))
+        T *cmd = stack_pop(c, sizeof(*cmd))
 
     // If this pop is a no-op, then don't do the command.
     #define CMD_DO(func_call) \
@@ -473,7 +696,7 @@ cru_cleanup_pop_impl(cru_cleanup_stack_t *c, bool noop)
             } \
         } while (0)
 
-    switch (header->cmd_type) {
+    switch (cmd_type) {
         // Misc objects
         case CRU_CLEANUP_CMD_CALLBACK: {
             CMD_GET(struct cmd_callback);
@@ -639,6 +862,70 @@ cru_cleanup_pop_impl(cru_cleanup_stack_t *c, bool noop)
     #undef CMD_DO
 }
 
+/// Pop the run of consecutive CRU_CLEANUP_CMD_VK_COMMAND_BUFFER commands at
+/// the top of the stack, freeing those that share a pool with a single call.
+static void
+pop_cmd_buffer_run(cru_cleanup_stack_t *c)
+{
+    VkCommandBuffer batch[MAX_BATCH];
+    VkDevice dev = VK_NULL_HANDLE;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    uint32_t n = 0;
+
+    for (;;) {
+        struct cmd_header *header = stack_peek_header(c);
+        if (!header || header->cmd_type != CRU_CLEANUP_CMD_VK_COMMAND_BUFFER)
+            break;
+
+        stack_pop(c, sizeof(*header));
+        struct cmd_vk_cmd_buffer *cmd = stack_pop(c, sizeof(*cmd));
+
+        if (n > 0 && (n == MAX_BATCH || cmd->dev != dev || cmd->pool != pool)) {
+            vkFreeCommandBuffers(dev, pool, n, batch);
+            n = 0;
+        }
+
+        dev = cmd->dev;
+        pool = cmd->pool;
+        batch[n++] = cmd->x;
+    }
+
+    if (n > 0)
+        vkFreeCommandBuffers(dev, pool, n, batch);
+}
+
+/// Pop the run of consecutive CRU_CLEANUP_CMD_VK_DESCRIPTOR_SET commands at
+/// the top of the stack, freeing those that share a pool with a single call.
+static void
+pop_descriptor_set_run(cru_cleanup_stack_t *c)
+{
+    VkDescriptorSet batch[MAX_BATCH];
+    VkDevice dev = VK_NULL_HANDLE;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    uint32_t n = 0;
+
+    for (;;) {
+        struct cmd_header *header = stack_peek_header(c);
+        if (!header || header->cmd_type != CRU_CLEANUP_CMD_VK_DESCRIPTOR_SET)
+            break;
+
+        stack_pop(c, sizeof(*header));
+        struct cmd_vk_descriptor_set *cmd = stack_pop(c, sizeof(*cmd));
+
+        if (n > 0 && (n == MAX_BATCH || cmd->dev != dev || cmd->pool != pool)) {
+            vkFreeDescriptorSets(dev, pool, n, batch);
+            n = 0;
+        }
+
+        dev = cmd->dev;
+        pool = cmd->pool;
+        batch[n++] = cmd->set;
+    }
+
+    if (n > 0)
+        vkFreeDescriptorSets(dev, pool, n, batch);
+}
+
 void
 cru_cleanup_pop(cru_cleanup_stack_t *c)
 {
@@ -651,16 +938,32 @@ cru_cleanup_pop_noop(cru_cleanup_stack_t *c)
     cru_cleanup_pop_impl(c, true);
 }
 
+/// Pop all commands in LIFO order. Runs of consecutive command buffers or
+/// descriptor sets are freed in batches.
 void
 cru_cleanup_pop_all(cru_cleanup_stack_t *c)
 {
-    while (cru_cleanup_pop_impl(c, false))
-      ;;
+    struct cmd_header *header;
+
+    while ((header = stack_peek_header(c))) {
+        switch (header->cmd_type) {
+        case CRU_CLEANUP_CMD_VK_COMMAND_BUFFER:
+            pop_cmd_buffer_run(c);
+            break;
+        case CRU_CLEANUP_CMD_VK_DESCRIPTOR_SET:
+            pop_descriptor_set_run(c);
+            break;
+        default:
+            cru_cleanup_pop_impl(c, false);
+            break;
+        }
+    }
 }
 
+/// Discard all commands without doing them. This costs O(1) per chunk
+/// rather than per command.
 void
 cru_cleanup_pop_all_noop(cru_cleanup_stack_t *c)
 {
-    while (cru_cleanup_pop_impl(c, true))
-      ;;
+    stack_reset(c);
 }
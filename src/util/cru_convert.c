@@ -0,0 +1,380 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+/// \file
+/// \brief Pixel format conversion for cru_image_copy()
+///
+/// A conversion between two formats is composed of two row kernels. The
+/// source format's unpack kernel expands a chunk of pixels to RGBA floats,
+/// and the destination format's pack kernel encodes them. Each kernel is a
+/// tight loop over one format, which the compiler vectorizes; that gives
+/// every (source, destination) pair a specialized path without writing N^2
+/// kernels. Pairs that need no arithmetic, such as reinterpreting S8_UINT
+/// as R8_UNORM or swapping the red and blue channels, get dedicated kernels.
+///
+/// The kernels are compiled once per instruction set, and the fastest set
+/// that the CPU supports is chosen at runtime. The build compiles this file
+/// with optimization, even in debug builds, so that the kernels vectorize.
+///
+/// Conversions follow the Vulkan rules: UNORM decodes as x / max and encodes
+/// with clamping and rounding to nearest; UINT converts by value, with
+/// clamping; SFLOAT16 rounds to nearest even. Converting between UNORM and UINT formats of the
+/// same layout, such as between S8_UINT and R8_UNORM, copies the bits, as
+/// cru_image_compare() treats such images as equal.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/macros.h"
+#include "util/misc.h"
+
+#include "cru_image.h"
+
+/// Number of pixels converted per chunk. The chunk of unpacked pixels lives
+/// on the stack and should stay in L1.
+#define CHUNK_WIDTH 256
+
+#define D24_MAX 0xffffffu
+
+/// X(layout, format) for each supported pixel layout. Formats that share a
+/// layout, such as D16_UNORM and R16_UNORM, are listed in get_layout().
+#define CONVERT_LAYOUTS(X) \
+    X(r8_unorm,             VK_FORMAT_R8_UNORM) \
+    X(r8g8b8a8_unorm,       VK_FORMAT_R8G8B8A8_UNORM) \
+    X(b8g8r8a8_unorm,       VK_FORMAT_B8G8R8A8_UNORM) \
+    X(r16_unorm,            VK_FORMAT_R16_UNORM) \
+    X(r16g16b16a16_unorm,   VK_FORMAT_R16G16B16A16_UNORM) \
+    X(x8_d24_unorm,         VK_FORMAT_X8_D24_UNORM_PACK32) \
+    X(r16_sfloat,           VK_FORMAT_R16_SFLOAT) \
+    X(r16g16b16a16_sfloat,  VK_FORMAT_R16G16B16A16_SFLOAT) \
+    X(r32_sfloat,           VK_FORMAT_R32_SFLOAT) \
+    X(r32g32b32a32_sfloat,  VK_FORMAT_R32G32B32A32_SFLOAT) \
+    X(r8_uint,              VK_FORMAT_R8_UINT) \
+    X(r16_uint,             VK_FORMAT_R16_UINT)
+
+enum layout {
+    LAYOUT_NONE = -1,
+#define LAYOUT_ENUM(layout, format) LAYOUT_##layout,
+    CONVERT_LAYOUTS(LAYOUT_ENUM)
+#undef LAYOUT_ENUM
+    NUM_LAYOUTS,
+};
+
+typedef void (*unpack_func_t)(const uint8_t *restrict src,
+                              float *restrict dest, uint32_t width);
+typedef void (*pack_func_t)(const float *restrict src,
+                            uint8_t *restrict dest, uint32_t width);
+typedef void (*swizzle_func_t)(const uint8_t *restrict src,
+                               uint8_t *restrict dest, uint32_t width);
+
+struct convert_kernels {
+    struct {
+        unpack_func_t unpack;
+        pack_func_t pack;
+    } layouts[NUM_LAYOUTS];
+
+    /// Swap the first and third channels of 4-channel, 8-bit pixels.
+    swizzle_func_t swizzle_rgba8;
+};
+
+static inline uint16_t
+load_u16(const uint8_t *p)
+{
+    uint16_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static inline void
+store_u16(uint8_t *p, uint16_t x)
+{
+    memcpy(p, &x, sizeof(x));
+}
+
+static inline uint32_t
+load_u32(const uint8_t *p)
+{
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static inline void
+store_u32(uint8_t *p, uint32_t x)
+{
+    memcpy(p, &x, sizeof(x));
+}
+
+static inline float
+load_f32(const uint8_t *p)
+{
+    float x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static inline void
+store_f32(uint8_t *p, float x)
+{
+    memcpy(p, &x, sizeof(x));
+}
+
+static inline float
+unorm_to_float(uint32_t x, uint32_t max)
+{
+    return (float) x / (float) max;
+}
+
+/// Round to nearest, and encode NaN as 0. The conversion goes through
+/// int32_t, which the vector units support, and \a max must fit in it.
+static inline uint32_t
+float_to_unorm(float f, uint32_t max)
+{
+    int32_t x = CLAMP(f, 0.0f, 1.0f) * (float) max + 0.5f;
+
+    // For 24-bit UNORM, the addition may round up past max.
+    return MIN((uint32_t) x, max);
+}
+
+/// \see float_to_unorm()
+static inline uint32_t
+float_to_uint(float f, uint32_t max)
+{
+    int32_t x = CLAMP(f, 0.0f, (float) max) + 0.5f;
+
+    return MIN((uint32_t) x, max);
+}
+
+/// Exact for all inputs, including denormals, infinities, and NaNs.
+static inline float
+half_to_float(uint16_t h)
+{
+    const uint32_t shifted_exp = 0x7c00u << 13;
+    union { uint32_t u; float f; } o;
+    union { uint32_t u; float f; } magic = { .u = 113u << 23 };
+
+    o.u = (uint32_t) (h & 0x7fffu) << 13;
+    uint32_t exp = shifted_exp & o.u;
+    o.u += (127u - 15u) << 23;
+
+    if (exp == shifted_exp) {
+        // Infinity or NaN
+        o.u += (128u - 16u) << 23;
+    } else if (exp == 0) {
+        // Zero or denormal
+        o.u += 1u << 23;
+        o.f -= magic.f;
+    }
+
+    o.u |= (uint32_t) (h & 0x8000u) << 16;
+
+    return o.f;
+}
+
+/// Round to nearest even. Overflow produces infinity, and NaN produces a
+/// quiet NaN.
+static inline uint16_t
+float_to_half(float f)
+{
+    const uint32_t f32_infinity = 255u << 23;
+    const uint32_t f16_max = (127u + 16u) << 23;
+    union { uint32_t u; float f; } in = { .f = f };
+    union { uint32_t u; float f; } denorm_magic = {
+        .u = ((127u - 15u) + (23u - 10u) + 1u) << 23,
+    };
+    uint16_t o;
+
+    uint32_t sign = in.u & 0x80000000u;
+    in.u ^= sign;
+
+    if (in.u >= f16_max) {
+        o = in.u > f32_infinity ? 0x7e00 : 0x7c00;
+    } else if (in.u < (113u << 23)) {
+        // The result is denormal or zero. Let the FPU do the rounding.
+        in.f += denorm_magic.f;
+        o = in.u - denorm_magic.u;
+    } else {
+        uint32_t mant_odd = (in.u >> 13) & 1;
+        in.u += ((15u - 127u) << 23) + 0xfff;
+        in.u += mant_odd;
+        o = in.u >> 13;
+    }
+
+    return o | (sign >> 16);
+}
+
+// Baseline kernels. On x86-64, the baseline includes SSE2.
+#define KERNEL_SUFFIX generic
+#include "cru_convert_kernels.h"
+#undef KERNEL_SUFFIX
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__clang__)
+// Do not enable FMA: contracting the kernels' multiply-adds would change
+// their rounding, and the result of a conversion must not depend on the CPU.
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define KERNEL_SUFFIX avx2
+#include "cru_convert_kernels.h"
+#undef KERNEL_SUFFIX
+#pragma GCC pop_options
+#define HAVE_AVX2_KERNELS 1
+#endif
+
+static const struct convert_kernels *
+get_kernels(void)
+{
+#ifdef HAVE_AVX2_KERNELS
+    if (__builtin_cpu_supports("avx2"))
+        return &kernels_avx2;
+#endif
+
+    return &kernels_generic;
+}
+
+static enum layout
+get_layout(VkFormat format)
+{
+    switch (format) {
+#define LAYOUT_CASE(layout, format) case format: return LAYOUT_##layout;
+    CONVERT_LAYOUTS(LAYOUT_CASE)
+#undef LAYOUT_CASE
+    case VK_FORMAT_D16_UNORM:
+        return LAYOUT_r16_unorm;
+    case VK_FORMAT_D32_SFLOAT:
+        return LAYOUT_r32_sfloat;
+    case VK_FORMAT_S8_UINT:
+        return LAYOUT_r8_uint;
+    default:
+        return LAYOUT_NONE;
+    }
+}
+
+/// Return true if converting between the formats copies the bits. This
+/// holds if the formats have the same layout, or if one is UNORM and the
+/// other is UINT with the same channel sizes.
+static bool
+is_bit_copy(const cru_format_info_t *src, const cru_format_info_t *dest)
+{
+    enum layout src_layout = get_layout(src->format);
+    enum layout dest_layout = get_layout(dest->format);
+
+    if (src_layout == dest_layout)
+        return true;
+
+    if ((src_layout == LAYOUT_r8_unorm && dest_layout == LAYOUT_r8_uint) ||
+        (src_layout == LAYOUT_r8_uint && dest_layout == LAYOUT_r8_unorm) ||
+        (src_layout == LAYOUT_r16_unorm && dest_layout == LAYOUT_r16_uint) ||
+        (src_layout == LAYOUT_r16_uint && dest_layout == LAYOUT_r16_unorm))
+        return true;
+
+    return false;
+}
+
+static bool
+is_rgba8_swizzle(const cru_format_info_t *src, const cru_format_info_t *dest)
+{
+    enum layout src_layout = get_layout(src->format);
+    enum layout dest_layout = get_layout(dest->format);
+
+    return (src_layout == LAYOUT_r8g8b8a8_unorm &&
+            dest_layout == LAYOUT_b8g8r8a8_unorm) ||
+           (src_layout == LAYOUT_b8g8r8a8_unorm &&
+            dest_layout == LAYOUT_r8g8b8a8_unorm);
+}
+
+bool
+cru_convert_supported(const cru_format_info_t *src,
+                      const cru_format_info_t *dest)
+{
+    if (src == dest)
+        return true;
+
+    return get_layout(src->format) != LAYOUT_NONE &&
+           get_layout(dest->format) != LAYOUT_NONE;
+}
+
+bool
+cru_convert_pixels(uint32_t width, uint32_t height,
+                   const cru_format_info_t *src_format,
+                   const void *src, uint32_t src_stride,
+                   const cru_format_info_t *dest_format,
+                   void *dest, uint32_t dest_stride)
+{
+    const uint32_t src_cpp = src_format->cpp;
+    const uint32_t dest_cpp = dest_format->cpp;
+    const struct convert_kernels *kernels;
+
+    if (!cru_convert_supported(src_format, dest_format)) {
+        loge("%s: unsupported format combination: %s to %s", __func__,
+             src_format->name, dest_format->name);
+        return false;
+    }
+
+    if (src_format == dest_format || is_bit_copy(src_format, dest_format)) {
+        assert(src_cpp == dest_cpp);
+
+        if (src_stride == dest_stride) {
+            memcpy(dest, src, (size_t) height * src_stride);
+        } else {
+            for (uint32_t y = 0; y < height; ++y) {
+                memcpy(dest + (size_t) y * dest_stride,
+                       src + (size_t) y * src_stride,
+                       (size_t) width * src_cpp);
+            }
+        }
+
+        return true;
+    }
+
+    kernels = get_kernels();
+
+    if (is_rgba8_swizzle(src_format, dest_format)) {
+        for (uint32_t y = 0; y < height; ++y) {
+            kernels->swizzle_rgba8(src + (size_t) y * src_stride,
+                                   dest + (size_t) y * dest_stride, width);
+        }
+
+        return true;
+    }
+
+    unpack_func_t unpack =
+        kernels->layouts[get_layout(src_format->format)].unpack;
+    pack_func_t pack =
+        kernels->layouts[get_layout(dest_format->format)].pack;
+
+    float chunk[4 * CHUNK_WIDTH] __attribute__((aligned(32)));
+
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t *src_row = src + (size_t) y * src_stride;
+        uint8_t *dest_row = dest + (size_t) y * dest_stride;
+
+        for (uint32_t x = 0; x < width; x += CHUNK_WIDTH) {
+            uint32_t n = MIN(CHUNK_WIDTH, width - x);
+
+            unpack(src_row + x * src_cpp, chunk, n);
+            pack(chunk, dest_row + x * dest_cpp, n);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,291 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+/// \file
+/// \brief Per-format row kernels for cru_convert.c
+///
+/// This file is a template. cru_convert.c includes it once per instruction
+/// set, each time with a different KERNEL_SUFFIX and a different set of
+/// target options in effect, so that the compiler vectorizes each copy of
+/// the loops for its instruction set.
+///
+/// Unpack kernels expand each pixel to four floats in RGBA order. Channels
+/// that the format lacks become (0, 0, 0, 1). Pack kernels take the channels
+/// they need and ignore the rest.
+
+#ifndef KERNEL_SUFFIX
+#error "KERNEL_SUFFIX must be defined"
+#endif
+
+#define KERNEL(name) CRU_CAT(CRU_CAT(name, _), KERNEL_SUFFIX)
+
+static void
+KERNEL(unpack_r8_unorm)(const uint8_t *restrict src, float *restrict dest,
+                        uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x) {
+        dest[4 * x + 0] = unorm_to_float(src[x], UINT8_MAX);
+        dest[4 * x + 1] = 0.0f;
+        dest[4 * x + 2] = 0.0f;
+        dest[4 * x + 3] = 1.0f;
+    }
+}
+
+static void
+KERNEL(pack_r8_unorm)(const float *restrict src, uint8_t *restrict dest,
+                      uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x)
+        dest[x] = float_to_unorm(src[4 * x], UINT8_MAX);
+}
+
+static void
+KERNEL(unpack_r8g8b8a8_unorm)(const uint8_t *restrict src,
+                              float *restrict dest, uint32_t width)
+{
+    for (size_t i = 0; i < 4 * (size_t) width; ++i)
+        dest[i] = unorm_to_float(src[i], UINT8_MAX);
+}
+
+static void
+KERNEL(pack_r8g8b8a8_unorm)(const float *restrict src, uint8_t *restrict dest,
+                            uint32_t width)
+{
+    for (size_t i = 0; i < 4 * (size_t) width; ++i)
+        dest[i] = float_to_unorm(src[i], UINT8_MAX);
+}
+
+static void
+KERNEL(unpack_b8g8r8a8_unorm)(const uint8_t *restrict src,
+                              float *restrict dest, uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x) {
+        dest[4 * x + 0] = unorm_to_float(src[4 * x + 2], UINT8_MAX);
+        dest[4 * x + 1] = unorm_to_float(src[4 * x + 1], UINT8_MAX);
+        dest[4 * x + 2] = unorm_to_float(src[4 * x + 0], UINT8_MAX);
+        dest[4 * x + 3] = unorm_to_float(src[4 * x + 3], UINT8_MAX);
+    }
+}
+
+static void
+KERNEL(pack_b8g8r8a8_unorm)(const float *restrict src, uint8_t *restrict dest,
+                            uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x) {
+        dest[4 * x + 0] = float_to_unorm(src[4 * x + 2], UINT8_MAX);
+        dest[4 * x + 1] = float_to_unorm(src[4 * x + 1], UINT8_MAX);
+        dest[4 * x + 2] = float_to_unorm(src[4 * x + 0], UINT8_MAX);
+        dest[4 * x + 3] = float_to_unorm(src[4 * x + 3], UINT8_MAX);
+    }
+}
+
+static void
+KERNEL(unpack_r16_unorm)(const uint8_t *restrict src, float *restrict dest,
+                         uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x) {
+        dest[4 * x + 0] = unorm_to_float(load_u16(src + 2 * x), UINT16_MAX);
+        dest[4 * x + 1] = 0.0f;
+        dest[4 * x + 2] = 0.0f;
+        dest[4 * x + 3] = 1.0f;
+    }
+}
+
+static void
+KERNEL(pack_r16_unorm)(const float *restrict src, uint8_t *restrict dest,
+                       uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x)
+        store_u16(dest + 2 * x, float_to_unorm(src[4 * x], UINT16_MAX));
+}
+
+static void
+KERNEL(unpack_r16g16b16a16_unorm)(const uint8_t *restrict src,
+                                  float *restrict dest, uint32_t width)
+{
+    for (size_t i = 0; i < 4 * (size_t) width; ++i)
+        dest[i] = unorm_to_float(load_u16(src + 2 * i), UINT16_MAX);
+}
+
+static void
+KERNEL(pack_r16g16b16a16_unorm)(const float *restrict src,
+                                uint8_t *restrict dest, uint32_t width)
+{
+    for (size_t i = 0; i < 4 * (size_t) width; ++i)
+        store_u16(dest + 2 * i, float_to_unorm(src[i], UINT16_MAX));
+}
+
+static void
+KERNEL(unpack_x8_d24_unorm)(const uint8_t *restrict src, float *restrict dest,
+                            uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x) {
+        uint32_t d = load_u32(src + 4 * x) & D24_MAX;
+        dest[4 * x + 0] = unorm_to_float(d, D24_MAX);
+        dest[4 * x + 1] = 0.0f;
+        dest[4 * x + 2] = 0.0f;
+        dest[4 * x + 3] = 1.0f;
+    }
+}
+
+static void
+KERNEL(pack_x8_d24_unorm)(const float *restrict src, uint8_t *restrict dest,
+                          uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x)
+        store_u32(dest + 4 * x, float_to_unorm(src[4 * x], D24_MAX));
+}
+
+static void
+KERNEL(unpack_r16_sfloat)(const uint8_t *restrict src, float *restrict dest,
+                          uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x) {
+        dest[4 * x + 0] = half_to_float(load_u16(src + 2 * x));
+        dest[4 * x + 1] = 0.0f;
+        dest[4 * x + 2] = 0.0f;
+        dest[4 * x + 3] = 1.0f;
+    }
+}
+
+static void
+KERNEL(pack_r16_sfloat)(const float *restrict src, uint8_t *restrict dest,
+                        uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x)
+        store_u16(dest + 2 * x, float_to_half(src[4 * x]));
+}
+
+static void
+KERNEL(unpack_r16g16b16a16_sfloat)(const uint8_t *restrict src,
+                                   float *restrict dest, uint32_t width)
+{
+    for (size_t i = 0; i < 4 * (size_t) width; ++i)
+        dest[i] = half_to_float(load_u16(src + 2 * i));
+}
+
+static void
+KERNEL(pack_r16g16b16a16_sfloat)(const float *restrict src,
+                                 uint8_t *restrict dest, uint32_t width)
+{
+    for (size_t i = 0; i < 4 * (size_t) width; ++i)
+        store_u16(dest + 2 * i, float_to_half(src[i]));
+}
+
+static void
+KERNEL(unpack_r32_sfloat)(const uint8_t *restrict src, float *restrict dest,
+                          uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x) {
+        dest[4 * x + 0] = load_f32(src + 4 * x);
+        dest[4 * x + 1] = 0.0f;
+        dest[4 * x + 2] = 0.0f;
+        dest[4 * x + 3] = 1.0f;
+    }
+}
+
+static void
+KERNEL(pack_r32_sfloat)(const float *restrict src, uint8_t *restrict dest,
+                        uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x)
+        store_f32(dest + 4 * x, src[4 * x]);
+}
+
+static void
+KERNEL(unpack_r32g32b32a32_sfloat)(const uint8_t *restrict src,
+                                   float *restrict dest, uint32_t width)
+{
+    memcpy(dest, src, 16 * width);
+}
+
+static void
+KERNEL(pack_r32g32b32a32_sfloat)(const float *restrict src,
+                                 uint8_t *restrict dest, uint32_t width)
+{
+    memcpy(dest, src, 16 * width);
+}
+
+static void
+KERNEL(unpack_r8_uint)(const uint8_t *restrict src, float *restrict dest,
+                       uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x) {
+        dest[4 * x + 0] = src[x];
+        dest[4 * x + 1] = 0.0f;
+        dest[4 * x + 2] = 0.0f;
+        dest[4 * x + 3] = 1.0f;
+    }
+}
+
+static void
+KERNEL(pack_r8_uint)(const float *restrict src, uint8_t *restrict dest,
+                     uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x)
+        dest[x] = float_to_uint(src[4 * x], UINT8_MAX);
+}
+
+static void
+KERNEL(unpack_r16_uint)(const uint8_t *restrict src, float *restrict dest,
+                        uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x) {
+        dest[4 * x + 0] = load_u16(src + 2 * x);
+        dest[4 * x + 1] = 0.0f;
+        dest[4 * x + 2] = 0.0f;
+        dest[4 * x + 3] = 1.0f;
+    }
+}
+
+static void
+KERNEL(pack_r16_uint)(const float *restrict src, uint8_t *restrict dest,
+                      uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x)
+        store_u16(dest + 2 * x, float_to_uint(src[4 * x], UINT16_MAX));
+}
+
+static void
+KERNEL(swizzle_rgba8)(const uint8_t *restrict src, uint8_t *restrict dest,
+                      uint32_t width)
+{
+    for (size_t x = 0; x < width; ++x) {
+        dest[4 * x + 0] = src[4 * x + 2];
+        dest[4 * x + 1] = src[4 * x + 1];
+        dest[4 * x + 2] = src[4 * x + 0];
+        dest[4 * x + 3] = src[4 * x + 3];
+    }
+}
+
+#define LAYOUT_KERNELS(layout, format) \
+    [LAYOUT_##layout] = { KERNEL(unpack_##layout), KERNEL(pack_##layout) },
+
+static const struct convert_kernels KERNEL(kernels) = {
+    .layouts = {
+        CONVERT_LAYOUTS(LAYOUT_KERNELS)
+    },
+    .swizzle_rgba8 = KERNEL(swizzle_rgba8),
+};
+
+#undef LAYOUT_KERNELS
+#undef KERNEL
@@ -19,109 +19,58 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
-#include "util/cru_format.h"
 
-#define FMT(__vk_token) .format = __vk_token, .name = #__vk_token
+#include "util/cru_format.h"
+#include "util/macros.h"
 
-static const struct cru_format_info
-cru_format_info_table[] = {
-    {
-        FMT(VK_FORMAT_R8_UNORM),
-        .num_type = CRU_NUM_TYPE_UNORM,
-        .num_channels = 1,
-        .cpp = 1,
-        .is_color = true,
-    },
-    {
-        FMT(VK_FORMAT_R8G8B8A8_UNORM),
-        .num_type = CRU_NUM_TYPE_UNORM,
-        .num_channels = 4,
-        .cpp = 4,
-        .is_color = true,
-        .has_alpha = true,
-    },
-    {
-        FMT(VK_FORMAT_R16_UNORM),
-        .num_type = CRU_NUM_TYPE_UNORM,
-        .num_channels = 1,
-        .cpp = 2,
-        .is_color = true,
-    },
-    {
-        FMT(VK_FORMAT_D16_UNORM),
-        .num_type = CRU_NUM_TYPE_UNORM,
-        .num_channels = 1,
-        .cpp = 2,
-        .depth_format = VK_FORMAT_D16_UNORM,
-    },
-    {
-        FMT(VK_FORMAT_X8_D24_UNORM_PACK32),
-        .num_type = CRU_NUM_TYPE_UNORM,
-        .num_channels = 1,
-        .cpp = 3,
-        .depth_format = VK_FORMAT_X8_D24_UNORM_PACK32,
-    },
-    {
-        FMT(VK_FORMAT_D32_SFLOAT),
-        .num_type = CRU_NUM_TYPE_SFLOAT,
-        .num_channels = 1,
-        .cpp = 4,
-        .depth_format = VK_FORMAT_D32_SFLOAT,
-    },
-    {
-        FMT(VK_FORMAT_S8_UINT),
-        .num_type = CRU_NUM_TYPE_UINT,
-        .num_channels = 1,
-        .cpp = 1,
-        .stencil_format = VK_FORMAT_S8_UINT,
-    },
-    {
-        FMT(VK_FORMAT_D16_UNORM_S8_UINT),
-        .num_type = CRU_NUM_TYPE_UNDEFINED,
-        .num_channels = 2,
-        .cpp = 3,
-        .depth_format = VK_FORMAT_D16_UNORM,
-        .stencil_format = VK_FORMAT_S8_UINT,
-    },
-    {
-        FMT(VK_FORMAT_D24_UNORM_S8_UINT),
-        .num_type = CRU_NUM_TYPE_UNDEFINED,
-        .num_channels = 2,
-        .cpp = 4,
-        .depth_format = VK_FORMAT_X8_D24_UNORM_PACK32,
-        .stencil_format = VK_FORMAT_S8_UINT,
-    },
-    {
-        FMT(VK_FORMAT_D32_SFLOAT_S8_UINT),
-        .num_type = CRU_NUM_TYPE_UNDEFINED,
-        .num_channels = 2,
-        .cpp = 5,
-        .depth_format = VK_FORMAT_D32_SFLOAT,
-        .stencil_format = VK_FORMAT_S8_UINT,
-    },
-    {
-        FMT(VK_FORMAT_BC3_UNORM_BLOCK),
-        .num_type = CRU_NUM_TYPE_UNORM,
-        .is_color = true,
-    },
-    {
-        FMT(VK_FORMAT_UNDEFINED),
-    },
-};
+// The table is generated from vulkan_core.h by misc/gen_format_table.py.
+#include "cru_format_table.h"
 
-#undef FMT
+// Must match ext_hash() in misc/gen_format_table.py.
+static inline uint32_t
+cru_format_ext_hash(uint32_t format)
+{
+    return (format * 2654435761u) >> (32 - CRU_FORMAT_EXT_HASH_BITS);
+}
 
 const struct cru_format_info *
 cru_format_get_info(VkFormat format)
 {
+    const uint32_t mask = (1u << CRU_FORMAT_EXT_HASH_BITS) - 1;
     const struct cru_format_info *info;
 
-    for (info = cru_format_info_table;
-         info->format != VK_FORMAT_UNDEFINED; ++info) {
-        if (info->format == format) {
+    if ((uint32_t) format < ARRAY_LENGTH(cru_format_core_table)) {
+        info = &cru_format_core_table[format];
+
+        // Only VK_FORMAT_UNDEFINED has no entry.
+        return info->name ? info : NULL;
+    }
+
+    for (uint32_t h = cru_format_ext_hash(format); ; h = (h + 1) & mask) {
+        uint16_t slot = cru_format_ext_slots[h];
+        if (slot == 0)
+            return NULL;
+
+        info = &cru_format_ext_table[slot - 1];
+        if (info->format == format)
             return info;
-        }
     }
+}
+
+uint32_t
+cru_format_get_row_size(const struct cru_format_info *info, uint32_t width)
+{
+    uint32_t blocks = (width + info->block_width - 1) / info->block_width;
+
+    return blocks * info->block_size;
+}
+
+size_t
+cru_format_get_image_size(const struct cru_format_info *info,
+                          uint32_t width, uint32_t height, uint32_t depth)
+{
+    size_t rows = (height + info->block_height - 1) / info->block_height;
+    size_t slices = (depth + info->block_depth - 1) / info->block_depth;
 
-    return NULL;
+    return cru_format_get_row_size(info, width) * rows * slices;
 }
@@ -0,0 +1,200 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include <string.h>
+
+#include "util/cru_hash.h"
+
+#define PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+#define PRIME64_2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 UINT64_C(0x165667B19E3779F9)
+#define PRIME64_4 UINT64_C(0x85EBCA77C2B2AE63)
+#define PRIME64_5 UINT64_C(0x27D4EB2F165667C5)
+
+static inline uint64_t
+rotl64(uint64_t x, unsigned r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// The hash is defined on little-endian words. Crucible only runs on
+// little-endian hosts, so a plain load suffices; memcpy avoids unaligned
+// access.
+static inline uint64_t
+read64(const uint8_t *p)
+{
+    uint64_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static inline uint32_t
+read32(const uint8_t *p)
+{
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static inline uint64_t
+round64(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t
+merge_round64(uint64_t acc, uint64_t val)
+{
+    acc ^= round64(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+/// Consume whole 32-byte stripes and return the number of bytes consumed.
+static size_t
+consume_stripes(uint64_t acc[static 4], const uint8_t *p, size_t size)
+{
+    uint64_t v0 = acc[0];
+    uint64_t v1 = acc[1];
+    uint64_t v2 = acc[2];
+    uint64_t v3 = acc[3];
+    const uint8_t *const end = p + (size & ~(size_t) 31);
+    const uint8_t *const start = p;
+
+    // Keep the lanes in locals so the compiler can interleave them.
+    for (; p < end; p += 32) {
+        v0 = round64(v0, read64(p + 0));
+        v1 = round64(v1, read64(p + 8));
+        v2 = round64(v2, read64(p + 16));
+        v3 = round64(v3, read64(p + 24));
+    }
+
+    acc[0] = v0;
+    acc[1] = v1;
+    acc[2] = v2;
+    acc[3] = v3;
+
+    return p - start;
+}
+
+void
+cru_hash_init(cru_hash_t *h, uint64_t seed)
+{
+    h->acc[0] = seed + PRIME64_1 + PRIME64_2;
+    h->acc[1] = seed + PRIME64_2;
+    h->acc[2] = seed;
+    h->acc[3] = seed - PRIME64_1;
+    h->buf_len = 0;
+    h->total_len = 0;
+    h->seed = seed;
+}
+
+void
+cru_hash_update(cru_hash_t *h, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+
+    h->total_len += size;
+
+    if (h->buf_len > 0) {
+        size_t n = sizeof(h->buf) - h->buf_len;
+        if (n > size)
+            n = size;
+
+        memcpy(h->buf + h->buf_len, p, n);
+        h->buf_len += n;
+        p += n;
+        size -= n;
+
+        if (h->buf_len < sizeof(h->buf))
+            return;
+
+        consume_stripes(h->acc, h->buf, sizeof(h->buf));
+        h->buf_len = 0;
+    }
+
+    size_t n = consume_stripes(h->acc, p, size);
+    p += n;
+    size -= n;
+
+    if (size > 0) {
+        memcpy(h->buf, p, size);
+        h->buf_len = size;
+    }
+}
+
+uint64_t
+cru_hash_final(const cru_hash_t *h)
+{
+    const uint8_t *p = h->buf;
+    const uint8_t *const end = h->buf + h->buf_len;
+    uint64_t x;
+
+    if (h->total_len >= 32) {
+        x = rotl64(h->acc[0], 1) + rotl64(h->acc[1], 7) +
+            rotl64(h->acc[2], 12) + rotl64(h->acc[3], 18);
+        x = merge_round64(x, h->acc[0]);
+        x = merge_round64(x, h->acc[1]);
+        x = merge_round64(x, h->acc[2]);
+        x = merge_round64(x, h->acc[3]);
+    } else {
+        x = h->seed + PRIME64_5;
+    }
+
+    x += h->total_len;
+
+    for (; p + 8 <= end; p += 8) {
+        x ^= round64(0, read64(p));
+        x = rotl64(x, 27) * PRIME64_1 + PRIME64_4;
+    }
+
+    if (p + 4 <= end) {
+        x ^= (uint64_t) read32(p) * PRIME64_1;
+        x = rotl64(x, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+
+    for (; p < end; ++p) {
+        x ^= *p * PRIME64_5;
+        x = rotl64(x, 11) * PRIME64_1;
+    }
+
+    x ^= x >> 33;
+    x *= PRIME64_2;
+    x ^= x >> 29;
+    x *= PRIME64_3;
+    x ^= x >> 32;
+
+    return x;
+}
+
+uint64_t
+cru_hash_buffer(const void *data, size_t size, uint64_t seed)
+{
+    cru_hash_t h;
+
+    cru_hash_init(&h, seed);
+    cru_hash_update(&h, data, size);
+
+    return cru_hash_final(&h);
+}
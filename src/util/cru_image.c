@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "util/cru_hash.h"
 #include "util/log.h"
 #include "util/misc.h"
 #include "util/string.h"
@@ -30,11 +31,6 @@
 
 #include "cru_image.h"
 
-typedef bool (*pixel_copy_func_t)(
-                uint32_t width, uint32_t height,
-                void *src, uint32_t src_x, uint32_t src_y, uint32_t src_stride,
-                void *dest, uint32_t dest_x, uint32_t dest_y, uint32_t dest_stride);
-
 /// Caller must free the returned string.
 char *
 cru_image_get_abspath(const char *filename)
@@ -84,7 +80,10 @@ cru_image_get_height(cru_image_t *image)
 uint32_t
 cru_image_get_pitch_bytes(cru_image_t *image)
 {
-    return image->pitch_bytes ? image->pitch_bytes : image->width * image->format_info->cpp;
+    if (image->pitch_bytes)
+        return image->pitch_bytes;
+
+    return cru_format_get_row_size(image->format_info, image->width);
 }
 
 VkFormat
@@ -201,115 +200,12 @@ cru_image_write_file(cru_image_t *image, const char *_filename)
     return res;
 }
 
-static bool
-copy_unorm8_to_uint8(
-    uint32_t width, uint32_t height,
-    void *src, uint32_t src_x, uint32_t src_y, uint32_t src_stride,
-    void *dest, uint32_t dest_x, uint32_t dest_y, uint32_t dest_stride)
-{
-    const uint32_t cpp = 1;
-
-    for (uint32_t y = 0; y < height; ++y) {
-        void *src_row = src + ((src_y + y) * src_stride + src_x * cpp);
-        void *dest_row = dest + ((dest_y + y) * dest_stride + dest_x * cpp);
-        memcpy(dest_row, src_row, width * cpp);
-    }
-
-    return true;
-}
-
-static bool
-copy_uint8_to_unorm8(
-    uint32_t width, uint32_t height,
-    void *src, uint32_t src_x, uint32_t src_y, uint32_t src_stride,
-    void *dest, uint32_t dest_x, uint32_t dest_y, uint32_t dest_stride)
-{
-    return copy_unorm8_to_uint8(width, height,
-                                src, src_x, src_y, src_stride,
-                                dest, dest_x, dest_y, dest_stride);
-}
-
-static bool
-copy_unorm8_to_f32(
-    uint32_t width, uint32_t height,
-    void *src, uint32_t src_x, uint32_t src_y, uint32_t src_stride,
-    void *dest, uint32_t dest_x, uint32_t dest_y, uint32_t dest_stride)
-{
-    const uint32_t src_cpp = 1;
-    const uint32_t dest_cpp = 4;
-
-    for (uint32_t y = 0; y < height; ++y) {
-        void *src_row = src + ((src_y + y) * src_stride +
-                               src_x * src_cpp);
-
-        void *dest_row = dest + ((dest_y + y) * dest_stride +
-                                 dest_x * dest_cpp);
-
-        for (uint32_t x = 0; x < width; ++x) {
-            uint8_t *src_pix = src_row + (x * src_cpp);
-            float *dest_pix = dest_row + (x * dest_cpp);
-
-            dest_pix[0] = (float) src_pix[0] / UINT8_MAX;
-        }
-    }
-
-    return true;
-}
-
-static bool
-copy_f32_to_unorm8(
-    uint32_t width, uint32_t height,
-    void *src, uint32_t src_x, uint32_t src_y, uint32_t src_stride,
-    void *dest, uint32_t dest_x, uint32_t dest_y, uint32_t dest_stride)
-{
-    const uint32_t src_cpp = 4;
-    const uint32_t dest_cpp = 1;
-
-    for (uint32_t y = 0; y < height; ++y) {
-        void *src_row = src + ((src_y + y) * src_stride +
-                               src_x * src_cpp);
-
-        void *dest_row = dest + ((dest_y + y) * dest_stride +
-                                 dest_x * dest_cpp);
-
-        for (uint32_t x = 0; x < width; ++x) {
-            float *src_pix = src_row + (x * src_cpp);
-            uint8_t *dest_pix = dest_row + (x * dest_cpp);
-
-            dest_pix[0] = UINT8_MAX * src_pix[0];
-        }
-    }
-
-    return true;
-}
-
-static bool
-copy_oneshot_memcpy(
-    uint32_t width, uint32_t height,
-    void *src, uint32_t src_x, uint32_t src_y, uint32_t src_stride,
-    void *dest, uint32_t dest_x, uint32_t dest_y, uint32_t dest_stride)
-{
-    assert(src_x == 0);
-    assert(src_y == 0);
-    assert(dest_x == 0);
-    assert(dest_y == 0);
-    assert(src_stride == dest_stride);
-
-    memcpy(dest, src, height * src_stride);
-
-    return true;
-}
-
 static bool
 cru_image_copy_pixels_to_pixels(cru_image_t *dest, cru_image_t *src)
 {
     bool result = false;
     uint8_t *src_pixels = NULL;
     uint8_t *dest_pixels = NULL;
-    pixel_copy_func_t copy_func;
-
-    const VkFormat src_format = src->format_info->format;
-    const VkFormat dest_format = dest->format_info->format;
 
     const uint32_t width = src->width;
     const uint32_t height = src->height;
@@ -324,6 +220,11 @@ cru_image_copy_pixels_to_pixels(cru_image_t *dest, cru_image_t *src)
     assert(src->width == dest->width);
     assert(src->height == dest->height);
 
+    if (!cru_convert_supported(src->format_info, dest->format_info)) {
+        loge("%s: unsupported format combination", __func__);
+        return false;
+    }
+
     src_pixels = src->map_pixels(src, CRU_IMAGE_MAP_ACCESS_READ);
     if (!src_pixels)
         goto fail_map_src_pixels;
@@ -332,31 +233,9 @@ cru_image_copy_pixels_to_pixels(cru_image_t *dest, cru_image_t *src)
     if (!dest_pixels)
         goto fail_map_dest_pixels;
 
-    if (src->format_info == dest->format_info
-        && src_stride == dest_stride) {
-        copy_func = copy_oneshot_memcpy;
-    } else if (src_format == VK_FORMAT_R8_UNORM &&
-               dest_format == VK_FORMAT_D32_SFLOAT) {
-        copy_func = copy_unorm8_to_f32;
-    } else if (src_format == VK_FORMAT_D32_SFLOAT &&
-               dest_format == VK_FORMAT_R8_UNORM) {
-        copy_func = copy_f32_to_unorm8;
-    } else if (src_format == VK_FORMAT_R8_UNORM &&
-               dest_format == VK_FORMAT_S8_UINT) {
-        copy_func = copy_unorm8_to_uint8;
-    } else if (src_format == VK_FORMAT_S8_UINT &&
-               dest_format == VK_FORMAT_R8_UNORM) {
-        copy_func = copy_uint8_to_unorm8;
-    } else {
-        loge("%s: unsupported format combination", __func__);
-        goto fail_no_copy_func;
-    }
-
-    result = copy_func(width, height,
-                       src_pixels, 0, 0, src_stride,
-                       dest_pixels, 0, 0, dest_stride);
-
-fail_no_copy_func:
+    result = cru_convert_pixels(width, height,
+                                src->format_info, src_pixels, src_stride,
+                                dest->format_info, dest_pixels, dest_stride);
 
     // Check the result of unmapping the destination image because writeback
     // can fail during unmap.
@@ -402,6 +281,36 @@ cru_image_compare(cru_image_t *a, cru_image_t *b)
     return cru_image_compare_rect(a, 0, 0, b, 0, 0, a->width, a->height);
 }
 
+/// Hash the image's pixels as if they were tightly packed, ignoring any row
+/// padding. The hash does not cover the image's format or dimensions, so an
+/// S8_UINT image and an R8_UNORM image with equal bytes hash equally, just as
+/// cru_image_compare() considers them equal.
+bool
+cru_image_hash(cru_image_t *image, uint64_t *out_hash)
+{
+    const uint32_t row_size = image->width * image->format_info->cpp;
+    const uint32_t stride = cru_image_get_pitch_bytes(image);
+    const uint8_t *map;
+    cru_hash_t h;
+
+    map = image->map_pixels(image, CRU_IMAGE_MAP_ACCESS_READ);
+    if (!map)
+        return false;
+
+    cru_hash_init(&h, 0);
+
+    if (stride == row_size) {
+        cru_hash_update(&h, map, (size_t) row_size * image->height);
+    } else {
+        for (uint32_t y = 0; y < image->height; ++y)
+            cru_hash_update(&h, map + (size_t) y * stride, row_size);
+    }
+
+    *out_hash = cru_hash_final(&h);
+
+    return image->unmap_pixels(image);
+}
+
 bool
 cru_image_compare_rect(cru_image_t *a, uint32_t a_x, uint32_t a_y,
                        cru_image_t *b, uint32_t b_x, uint32_t b_y,
@@ -433,6 +342,16 @@ cru_image_compare_rect(cru_image_t *a, uint32_t a_x, uint32_t a_y,
         goto cleanup;
     }
 
+    // Stream PNG images rather than decode them whole. Prefer to stream b,
+    // which is the reference image in t_compare_image().
+    if (b->type == CRU_IMAGE_TYPE_PNG)
+        return cru_png_image_compare_rect(b, b_x, b_y, a, a_x, a_y,
+                                          width, height);
+
+    if (a->type == CRU_IMAGE_TYPE_PNG)
+        return cru_png_image_compare_rect(a, a_x, a_y, b, b_x, b_y,
+                                          width, height);
+
     const uint32_t cpp = a->format_info->cpp;
     const uint32_t row_size = cpp * width;
     const uint32_t a_stride = cru_image_get_pitch_bytes(a);
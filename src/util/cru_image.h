@@ -65,10 +65,24 @@ cru_image_init(cru_image_t *image, enum cru_image_type type, VkFormat format,
                uint32_t width, uint32_t height, bool read_only);
 char *cru_image_get_abspath(const char *filename);
 
+// file: cru_convert.c
+bool cru_convert_supported(const cru_format_info_t *src,
+                           const cru_format_info_t *dest);
+bool cru_convert_pixels(uint32_t width, uint32_t height,
+                        const cru_format_info_t *src_format,
+                        const void *src, uint32_t src_stride,
+                        const cru_format_info_t *dest_format,
+                        void *dest, uint32_t dest_stride);
+
 // file: cru_png_image.c
 cru_image_t *cru_png_image_load_file(const char *filename);
 bool cru_png_image_write_file(cru_image_t *image, const string_t *filename);
 bool cru_png_image_copy_to_pixels(cru_image_t *png_image, cru_image_t *dest);
+bool cru_png_image_compare_rect(cru_image_t *png_image,
+                                uint32_t png_x, uint32_t png_y,
+                                cru_image_t *other,
+                                uint32_t other_x, uint32_t other_y,
+                                uint32_t width, uint32_t height);
 
 // file: cru_ktx_image.c
 cru_image_array_t *cru_ktx_image_array_load_file(const char *filename);
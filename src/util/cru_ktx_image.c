@@ -21,26 +21,63 @@
 
 #include <alloca.h>
 #include <endian.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "util/log.h"
+#include "util/macros.h"
+#include "util/misc.h"
 #include "util/xalloc.h"
 #include "cru_image.h"
 
 #include "vulkan/vulkan_core.h"
 
-/* TODO add support for more compressed formats */
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
 #define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define GL_COMPRESSED_RED_RGTC1 0x8DBB
+#define GL_COMPRESSED_RG_RGTC2 0x8DBD
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+
+/// Level sizes are derived from the format's block metadata, so supporting
+/// another compressed format only requires an entry here.
+static const struct {
+    uint32_t gl_internal_format;
+    VkFormat vk_format;
+} cru_ktx_formats[] = {
+    { GL_COMPRESSED_RGB_S3TC_DXT1_EXT,  VK_FORMAT_BC1_RGB_UNORM_BLOCK },
+    { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, VK_FORMAT_BC1_RGBA_UNORM_BLOCK },
+    { GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, VK_FORMAT_BC2_UNORM_BLOCK },
+    { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, VK_FORMAT_BC3_UNORM_BLOCK },
+    { GL_COMPRESSED_RED_RGTC1,          VK_FORMAT_BC4_UNORM_BLOCK },
+    { GL_COMPRESSED_RG_RGTC2,           VK_FORMAT_BC5_UNORM_BLOCK },
+    { GL_COMPRESSED_RGBA_BPTC_UNORM,    VK_FORMAT_BC7_UNORM_BLOCK },
+    { GL_COMPRESSED_RGB8_ETC2,          VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK },
+    { GL_COMPRESSED_RGBA8_ETC2_EAC,     VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK },
+};
 
 typedef struct cru_ktx_image cru_ktx_image_t;
 
+/// The file is mapped read-only and never copied. Each cru_ktx_image points
+/// into the mapping, and holds a reference on the info, which unmaps the file
+/// when the last image is destroyed. Because the mapping is backed by the page
+/// cache, concurrently running slave processes share a single copy of the
+/// file's pages.
 struct ktx_image_info {
-    FILE *file;
-    const char *filename;
+    char *filename;
     size_t size;
     void *data;
+
+    /// The mapping's length. The parsed size may be shorter.
+    size_t map_size;
+
     VkFormat vk_format;
     VkImageViewType target;
     uint32_t gl_type;
@@ -54,6 +91,7 @@ struct ktx_image_info {
     uint32_t array_length;
     uint32_t num_faces;
     uint32_t num_miplevels;
+    uint32_t bytes_of_key_value_data;
     uint32_t num_images;
 
     cru_refcount_t refcount;
@@ -62,7 +100,10 @@ struct ktx_image_info {
 struct cru_ktx_image {
     cru_image_t image;
 
+    /// The image's pixels, within the file mapping.
     void *data;
+    size_t size;
+
     struct ktx_image_info *info;
 
     struct {
@@ -87,7 +128,8 @@ static void
 cru_ktx_image_info_unref(struct ktx_image_info *image_info)
 {
     if (cru_refcount_put(&image_info->refcount) == 0) {
-        fclose(image_info->file);
+        munmap(image_info->data, image_info->map_size);
+        free(image_info->filename);
         free(image_info);
     }
 }
@@ -115,6 +157,13 @@ cru_ktx_image_map_pixels(cru_image_t *image, uint32_t access)
     if (ktx_image->map.pixels)
         return ktx_image->map.pixels;
 
+    // The caller is about to read, and likely upload, the pixels. Ask the
+    // kernel to start paging them in.
+    long page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) ktx_image->data & ~(page_size - 1);
+    uintptr_t end = (uintptr_t) ktx_image->data + ktx_image->size;
+    madvise((void *) start, end - start, MADV_WILLNEED);
+
     ktx_image->map.access = access;
     ktx_image->map.pixels = ktx_image->data;
     return ktx_image->data;
@@ -135,11 +184,14 @@ cru_ktx_image_unmap_pixels(cru_image_t *image)
 static bool
 cru_ktx_get_vk_format(struct ktx_image_info *image)
 {
-    /* add more format translation */
-    if (image->gl_internal_format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
-        image->vk_format = VK_FORMAT_BC3_UNORM_BLOCK;
-        return true;
+    for (size_t i = 0; i < ARRAY_LENGTH(cru_ktx_formats); ++i) {
+        if (cru_ktx_formats[i].gl_internal_format == image->gl_internal_format) {
+            image->vk_format = cru_ktx_formats[i].vk_format;
+            return true;
+        }
     }
+
+    loge("unsupported KTX glInternalFormat 0x%x", image->gl_internal_format);
     return false;
 }
 
@@ -273,6 +325,13 @@ cru_ktx_parse_header(struct ktx_image_info *image)
     image->array_length = u32[12];
     image->num_faces = u32[13];
     image->num_miplevels = u32[14];
+    image->bytes_of_key_value_data = u32[15];
+
+    if (image->bytes_of_key_value_data >
+        image->size - cru_ktx_header_length) {
+        loge("KTX key/value data extends past end of file");
+        return false;
+    }
 
     if (image->num_miplevels == 0) {
         loge("KTX header requests automatic mipmap generation, which crucible does not support");
@@ -320,15 +379,19 @@ cru_ktx_parse_images(struct ktx_image_info *image_info,
     uint32_t pixel_height;
     uint32_t pixel_depth;
 
+    const cru_format_info_t *format_info =
+        cru_format_get_info(image_info->vk_format);
+
     cru_ktx_calc_base_image_size(image_info, &pixel_width,
                                  &pixel_height, &pixel_depth);
     /* Loop counters */
     int miplevel;
     int face;
 
-    /* Skip header. */
+    /* Skip header and key/value data. */
     p.u8 = image_info->data;
     p.u8 += cru_ktx_header_length;
+    p.u8 += image_info->bytes_of_key_value_data;
 
     int idx = 0;
     struct cru_ktx_image *ktx_image = (struct cru_ktx_image *)ia->images[0];
@@ -338,13 +401,25 @@ cru_ktx_parse_images(struct ktx_image_info *image_info,
     for (miplevel = 0; miplevel < image_info->num_miplevels; ++miplevel) {
         uint32_t image_size;
 
-        if (image_info->size < CUR_SIZE + 1) {
+        if (image_info->size < CUR_SIZE + sizeof(uint32_t)) {
             return false;
         }
 
         image_size = *p.u32;
         ++p.u32;
 
+        // For cube maps, imageSize covers one face. Otherwise it covers the
+        // whole level, including all array layers.
+        size_t expected_size =
+            cru_format_get_image_size(format_info, pixel_width,
+                                      MAX(pixel_height, 1),
+                                      MAX(pixel_depth, 1));
+        if (image_size < expected_size) {
+            loge("mip level %d of %s holds %u bytes, but needs %zu",
+                 miplevel, format_info->name, image_size, expected_size);
+            return false;
+        }
+
         for (face = 0; face < 6; ++face) {
             cru_image_init(&ktx_image->image, CRU_IMAGE_TYPE_KTX,
                            image_info->vk_format, pixel_width, pixel_height, true);
@@ -352,7 +427,17 @@ cru_ktx_parse_images(struct ktx_image_info *image_info,
             ktx_image->image.destroy = cru_ktx_image_destroy;
             ktx_image->image.map_pixels = cru_ktx_image_map_pixels;
             ktx_image->image.unmap_pixels = cru_ktx_image_unmap_pixels;
+
+            // The mapping ends at the end of the file, so never point an
+            // image past it.
+            if (CUR_SIZE > image_info->size ||
+                image_size > image_info->size - CUR_SIZE) {
+                loge("size of data stream incorrect");
+                return false;
+            }
+
             ktx_image->data = p.u8;
+            ktx_image->size = image_size;
             p.u8 += image_size;
             idx++;
             if (idx >= image_info->num_images)
@@ -406,85 +491,77 @@ cru_ktx_parse_images(struct ktx_image_info *image_info,
 cru_image_array_t *
 cru_ktx_image_array_load_file(const char *filename)
 {
+    struct ktx_image_info *image_info = NULL;
+    cru_image_array_t *ia = NULL;
     char *abs_filename = NULL;
-    FILE *file;
-    int error = 0;
-    bool ok;
-    uint32_t size;
+    struct stat st;
+    void *map;
+    int fd;
 
     abs_filename = cru_image_get_abspath(filename);
     if (!abs_filename)
-        goto fail_filename;
+        return NULL;
 
-    file = fopen(abs_filename, "rb");
-    if (!file) {
+    fd = open(abs_filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
         loge("failed to open file for reading: %s", abs_filename);
-        goto fail_fopen;
+        free(abs_filename);
+        return NULL;
     }
 
-    error = fseek(file, 0, SEEK_END);
-    if (error)
-        goto bad_read;
-    size = ftell(file);
-    error = fseek(file, 0, SEEK_SET);
-    if (error)
-        goto bad_read;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        loge("failed to stat file: %s", abs_filename);
+        close(fd);
+        free(abs_filename);
+        return NULL;
+    }
 
-    struct ktx_image_info *image_info = calloc(1, sizeof(struct ktx_image_info) + size);
-    if (!image_info)
-        goto fail_alloc;
+    // The mapping does not need the fd.
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        loge("failed to mmap file: %s", abs_filename);
+        free(abs_filename);
+        return NULL;
+    }
 
+    image_info = xzalloc(sizeof(*image_info));
     cru_refcount_init(&image_info->refcount);
-    image_info->file = file;
-    image_info->size = size;
     image_info->filename = abs_filename;
-    image_info->data = image_info + 1;
-
-    size_t size_read = fread(image_info->data, 1, image_info->size, file);
-    if (size_read < image_info->size)
-        goto fail_read_file;
+    image_info->data = map;
+    image_info->size = st.st_size;
+    image_info->map_size = st.st_size;
 
-    ok = cru_ktx_parse_header(image_info);
-    if (!ok)
-        goto fail_read_file;
+    if (!cru_ktx_parse_header(image_info))
+        goto fail;
 
-    cru_image_array_t *ia = calloc(1, sizeof(*ia));
-    if (!ia)
-        goto bad_ia_alloc;
+    ia = xzalloc(sizeof(*ia));
     cru_refcount_init(&ia->refcount);
     ia->num_images = image_info->num_images;
+
     /* allocate an array of images for each image in the ktx file. */
-    ia->images = calloc(image_info->num_images, sizeof(struct cru_ktx_image *));
-    if (!ia->images)
-        goto bad_ia_image_ptrs_alloc;
+    ia->images = xzalloc(image_info->num_images * sizeof(ia->images[0]));
     for (unsigned i = 0; i < image_info->num_images; i++) {
-        ia->images[i] = calloc(1, sizeof(struct cru_ktx_image));
-        struct cru_ktx_image *ktx_image = (struct cru_ktx_image *)ia->images[i];
+        struct cru_ktx_image *ktx_image = xzalloc(sizeof(*ktx_image));
         ktx_image->info = image_info;
         cru_refcount_get(&image_info->refcount);
-
-        if (!ia->images[i])
-            goto bad_ia_images_alloc;
+        ia->images[i] = &ktx_image->image;
     }
-    ok = cru_ktx_parse_images(image_info, ia);
-    if (!ok)
-        goto bad_read;
+
+    if (!cru_ktx_parse_images(image_info, ia))
+        goto fail;
 
     cru_ktx_image_info_unref(image_info);
     return ia;
 
-bad_ia_images_alloc:
-    for (unsigned i = 0; i < ia->num_images; i++)
-        cru_ktx_image_destroy((struct cru_image *)ia->images[i]);
-bad_ia_image_ptrs_alloc:
-    free(ia->images);
-bad_ia_alloc:
-fail_read_file:
-    free(image_info);
-fail_alloc:
-bad_read:
-    fclose(file);
-fail_fopen:
-fail_filename:
+fail:
+    if (ia) {
+        for (unsigned i = 0; i < ia->num_images; i++)
+            cru_ktx_image_destroy(ia->images[i]);
+        free(ia->images);
+        free(ia);
+    }
+
+    cru_ktx_image_info_unref(image_info);
     return NULL;
 }
@@ -43,6 +43,9 @@ struct cru_png_image {
     uint8_t png_color_type;
     uint8_t png_bit_depth;
 
+    /// Value is one of PNG_INTERLACE_*.
+    uint8_t png_interlace_type;
+
     struct {
         /// When mapping the cru_png_image for reading, we decode the file into
         /// this pixel array.
@@ -92,6 +95,7 @@ static bool
 cru_png_image_read_file_info(FILE *file, const char *debug_filename,
                              uint8_t *out_png_color_type,
                              uint8_t *out_bit_depth,
+                             uint8_t *out_interlace_type,
                              uint32_t *out_width,
                              uint32_t *out_height)
 {
@@ -118,6 +122,7 @@ cru_png_image_read_file_info(FILE *file, const char *debug_filename,
 
     *out_png_color_type = png_get_color_type(png_reader, png_info);
     *out_bit_depth = png_get_bit_depth(png_reader, png_info);
+    *out_interlace_type = png_get_interlace_type(png_reader, png_info);
     *out_width = png_get_image_width(png_reader, png_info);
     *out_height = png_get_image_height(png_reader, png_info);
 
@@ -129,49 +134,33 @@ fail_create_png_reader:
     return result;
 }
 
+/// Create a libpng reader positioned at the PNG's first row. The reader
+/// transforms the file's pixel format to the crucible image's pixel format,
+/// \a dest_format.
+///
+/// On success, the caller must destroy the reader with
+/// png_destroy_read_struct().
 static bool
-copy_direct_from_png(cru_image_t *src, cru_image_t *dest)
+begin_read_png_rows(cru_png_image_t *png_image,
+                    const cru_format_info_t *dest_format,
+                    png_structp *out_reader, png_infop *out_info)
 {
-    cru_png_image_t *png_image;
-
-    bool result = false;
     png_structp png_reader = NULL;
     png_infop png_info = NULL;
 
-    const uint32_t width = src->width;
-    const uint32_t height = src->height;
-    const uint32_t stride = width * src->format_info->cpp;
-    uint8_t *dest_pixels = NULL;
-    uint8_t *dest_rows[height];
-
-    assert(src->format_info == dest->format_info);
-    assert(src->type == CRU_IMAGE_TYPE_PNG);
-    assert(src->width == dest->width);
-    assert(src->height == dest->height);
-
-    png_image = (cru_png_image_t *) src;
-
-    assert(!dest->read_only);
-    dest_pixels = dest->map_pixels(dest, CRU_IMAGE_MAP_ACCESS_WRITE);
-    if (!dest_pixels)
-        return false;
-
-    for (uint32_t y = 0; y < height; ++y) {
-        dest_rows[y] = dest_pixels + y * stride;
-    }
-
     // FINISHME: Error callbacks for libpng
     png_reader = png_create_read_struct(PNG_LIBPNG_VER_STRING,
                                        NULL, NULL, NULL);
     if (!png_reader) {
         loge("failed to create png reader");
-        goto fail_create_png_reader;
+        return false;
     }
 
     png_info = png_create_info_struct(png_reader);
     if (!png_info) {
         loge("failed to create png reader info");
-        goto fail_create_png_info;
+        png_destroy_read_struct(&png_reader, NULL, NULL);
+        return false;
     }
 
     rewind(png_image->file);
@@ -182,13 +171,13 @@ copy_direct_from_png(cru_image_t *src, cru_image_t *dest)
     switch (png_image->png_color_type) {
     case PNG_COLOR_TYPE_RGB:
     case PNG_COLOR_TYPE_GRAY:
-        if (dest->format_info->has_alpha) {
+        if (dest_format->has_alpha) {
             png_set_add_alpha(png_reader, UINT32_MAX, PNG_FILLER_AFTER);
         }
         break;
     case PNG_COLOR_TYPE_RGB_ALPHA:
     case PNG_COLOR_TYPE_GRAY_ALPHA:
-        if (!dest->format_info->has_alpha) {
+        if (!dest_format->has_alpha) {
             png_set_strip_alpha(png_reader);
         }
         break;
@@ -198,15 +187,55 @@ copy_direct_from_png(cru_image_t *src, cru_image_t *dest)
         break;
     }
 
+    *out_reader = png_reader;
+    *out_info = png_info;
+
+    return true;
+}
+
+static bool
+copy_direct_from_png(cru_image_t *src, cru_image_t *dest)
+{
+    cru_png_image_t *png_image;
+
+    bool result = false;
+    png_structp png_reader = NULL;
+    png_infop png_info = NULL;
+
+    const uint32_t width = src->width;
+    const uint32_t height = src->height;
+    const uint32_t stride = width * src->format_info->cpp;
+    uint8_t *dest_pixels = NULL;
+    uint8_t *dest_rows[height];
+
+    assert(src->format_info == dest->format_info);
+    assert(src->type == CRU_IMAGE_TYPE_PNG);
+    assert(src->width == dest->width);
+    assert(src->height == dest->height);
+
+    png_image = (cru_png_image_t *) src;
+
+    assert(!dest->read_only);
+    dest_pixels = dest->map_pixels(dest, CRU_IMAGE_MAP_ACCESS_WRITE);
+    if (!dest_pixels)
+        return false;
+
+    for (uint32_t y = 0; y < height; ++y) {
+        dest_rows[y] = dest_pixels + y * stride;
+    }
+
+    if (!begin_read_png_rows(png_image, dest->format_info,
+                             &png_reader, &png_info))
+        goto fail_begin_read;
+
     png_read_rows(png_reader, dest_rows, NULL, height);
     png_read_end(png_reader, NULL);
 
-    result = true;
+    png_destroy_read_struct(&png_reader, &png_info, NULL);
 
-fail_create_png_info:
+    result = true;
 
-    png_destroy_read_struct(&png_reader, &png_info, NULL);
-fail_create_png_reader:
+fail_begin_read:
 
     if (!dest->unmap_pixels(dest)) {
         loge("failed to unmap pixel image");
@@ -314,6 +343,110 @@ cru_png_image_unmap_pixels(cru_image_t *image)
     return true;
 }
 
+/// Compare via the fully decoded image.
+static bool
+compare_rect_decoded(cru_png_image_t *png_image, uint32_t png_x, uint32_t png_y,
+                     cru_image_t *other, uint32_t other_x, uint32_t other_y,
+                     uint32_t width, uint32_t height)
+{
+    cru_image_t *image = &png_image->image;
+    bool result;
+
+    if (!image->map_pixels(image, CRU_IMAGE_MAP_ACCESS_READ))
+        return false;
+
+    result = cru_image_compare_rect(png_image->map.pixel_image, png_x, png_y,
+                                    other, other_x, other_y, width, height);
+
+    image->unmap_pixels(image);
+
+    return result;
+}
+
+/// Compare a rect of a PNG image to a rect of another image.
+///
+/// Unlike mapping the PNG image, this decodes the PNG one row at a time into
+/// a single row buffer, so the decoded image is never materialized. Decoding
+/// stops at the bottom of the rect or at the first row that differs.
+///
+/// The caller must have checked that the images are compatible and that the
+/// rects lie within the images.
+bool
+cru_png_image_compare_rect(cru_image_t *image, uint32_t png_x, uint32_t png_y,
+                           cru_image_t *other, uint32_t other_x,
+                           uint32_t other_y, uint32_t width, uint32_t height)
+{
+    cru_png_image_t *png_image = (cru_png_image_t *) image;
+
+    bool result = false;
+    png_structp png_reader = NULL;
+    png_infop png_info = NULL;
+    uint8_t *row = NULL;
+    const uint8_t *other_map = NULL;
+
+    const uint32_t cpp = image->format_info->cpp;
+    const uint32_t row_size = cpp * width;
+    const uint32_t other_stride = cru_image_get_pitch_bytes(other);
+
+    assert(image->type == CRU_IMAGE_TYPE_PNG);
+    assert(png_x + width <= image->width);
+    assert(png_y + height <= image->height);
+
+    // If the image is already decoded, then decoding it again would be
+    // wasteful. Interlaced images cannot be decoded in a single pass of rows.
+    if (png_image->map.pixels ||
+        png_image->png_interlace_type != PNG_INTERLACE_NONE) {
+        return compare_rect_decoded(png_image, png_x, png_y,
+                                    other, other_x, other_y, width, height);
+    }
+
+    other_map = other->map_pixels(other, CRU_IMAGE_MAP_ACCESS_READ);
+    if (!other_map)
+        return false;
+
+    if (!begin_read_png_rows(png_image, image->format_info,
+                             &png_reader, &png_info))
+        goto cleanup;
+
+    png_read_update_info(png_reader, png_info);
+    if (png_get_rowbytes(png_reader, png_info) !=
+        (size_t) image->width * cpp) {
+        log_internal_error("png row size does not match image format");
+        goto cleanup;
+    }
+
+    row = xmalloc((size_t) image->width * cpp);
+
+    // Rows above the rect must still be decoded, but are not compared.
+    for (uint32_t y = 0; y < png_y; ++y)
+        png_read_row(png_reader, row, NULL);
+
+    // FINISHME: Support a configurable tolerance.
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t *other_row = other_map +
+            ((size_t) (other_y + y) * other_stride + other_x * cpp);
+
+        png_read_row(png_reader, row, NULL);
+
+        if (memcmp(row + png_x * cpp, other_row, row_size) != 0) {
+            loge("%s: diff found in row %u of rect", __func__, y);
+            goto cleanup;
+        }
+    }
+
+    result = true;
+
+cleanup:
+    // Skip png_read_end(). The rest of the file is of no interest, and the
+    // next reader rewinds the file.
+    if (png_reader)
+        png_destroy_read_struct(&png_reader, &png_info, NULL);
+    free(row);
+    other->unmap_pixels(other);
+
+    return result;
+}
+
 static void
 cru_png_image_destroy(cru_image_t *image)
 {
@@ -340,6 +473,7 @@ cru_png_image_load_file(const char *filename)
     FILE *file = NULL;
     uint8_t png_color_type; // PNG_COLOR_TYPE_*
     uint8_t png_bit_depth;
+    uint8_t png_interlace_type; // PNG_INTERLACE_*
     uint32_t width, height;
     VkFormat format;
 
@@ -355,6 +489,7 @@ cru_png_image_load_file(const char *filename)
 
     if (!cru_png_image_read_file_info(file, filename,
                                       &png_color_type, &png_bit_depth,
+                                      &png_interlace_type,
                                       &width, &height)) {
         goto fail_read_file;
     }
@@ -379,6 +514,7 @@ cru_png_image_load_file(const char *filename)
     png_image->filename = abs_filename;
     png_image->file = file;
     png_image->png_color_type = png_color_type;
+    png_image->png_interlace_type = png_interlace_type;
     png_image->map.access = 0;
     png_image->map.pixels = NULL;
     png_image->map.pixel_image = NULL;
@@ -509,15 +645,13 @@ write_indirect_to_png(cru_image_t *image, const string_t *filename)
     cru_image_t *tmp_image = NULL;
     bool result = false;
 
-    switch (image->format_info->format) {
-    case VK_FORMAT_R8G8B8A8_UNORM:
-    case VK_FORMAT_R8_UNORM:
-        tmp_format = image->format_info->format;
-        break;
-    case VK_FORMAT_D32_SFLOAT:
-    case VK_FORMAT_S8_UINT:
+    switch (image->format_info->num_channels) {
+    case 1:
         tmp_format = VK_FORMAT_R8_UNORM;
         break;
+    case 4:
+        tmp_format = VK_FORMAT_R8G8B8A8_UNORM;
+        break;
     default:
         loge("cannot write %s to PNG", image->format_info->name);
         return false;
@@ -0,0 +1,374 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include <errno.h>
+#include <glob.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/cru_ref_index.h"
+#include "util/cru_vec.h"
+#include "util/log.h"
+#include "util/string.h"
+#include "util/xalloc.h"
+
+#include "cru_image.h"
+
+typedef struct ref_entry ref_entry_t;
+
+struct ref_entry {
+    /// Relative to the data directory.
+    char *filename;
+
+    uint64_t hash;
+    uint32_t width;
+    uint32_t height;
+
+    /// The file's size and modification time when it was hashed.
+    uint64_t file_size;
+    int64_t mtime_sec;
+    int32_t mtime_nsec;
+};
+
+CRU_VEC_DEFINE(struct ref_entry_vec, ref_entry_t)
+
+static const char index_header[] =
+    "# Crucible reference image index. Generated by `crucible hash-refs`.\n"
+    "# hash width height file-size mtime filename\n";
+
+static struct ref_entry_vec cached_index = CRU_VEC_INIT;
+static pthread_once_t cached_index_once = PTHREAD_ONCE_INIT;
+
+static int
+compare_entries(const void *a, const void *b)
+{
+    const ref_entry_t *ea = a;
+    const ref_entry_t *eb = b;
+
+    return strcmp(ea->filename, eb->filename);
+}
+
+static void
+free_entries(struct ref_entry_vec *entries)
+{
+    ref_entry_t *e;
+
+    cru_vec_foreach(e, entries) {
+        free(e->filename);
+    }
+
+    cru_vec_finish(entries);
+}
+
+static bool
+stat_file(const char *filename, ref_entry_t *e)
+{
+    char *abspath = cru_image_get_abspath(filename);
+    struct stat st;
+    bool result = false;
+
+    if (stat(abspath, &st) != 0)
+        goto cleanup;
+
+    e->file_size = st.st_size;
+    e->mtime_sec = st.st_mtim.tv_sec;
+    e->mtime_nsec = st.st_mtim.tv_nsec;
+    result = true;
+
+cleanup:
+    free(abspath);
+    return result;
+}
+
+/// A missing index is not an error; it reads as empty. Malformed lines are
+/// skipped, because the index is only an optimization.
+static bool
+read_index(struct ref_entry_vec *entries)
+{
+    char *path = cru_image_get_abspath(CRU_REF_INDEX_FILENAME);
+    FILE *f = NULL;
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t line_len;
+    uint32_t line_num = 0;
+    bool result = false;
+
+    f = fopen(path, "r");
+    if (!f) {
+        result = errno == ENOENT;
+        if (!result)
+            loge("failed to open %s: %s", path, strerror(errno));
+        goto cleanup;
+    }
+
+    while ((line_len = getline(&line, &line_cap, f)) != -1) {
+        ref_entry_t e;
+        int n = 0;
+
+        ++line_num;
+
+        if (line_len > 0 && line[line_len - 1] == '\n')
+            line[--line_len] = '\0';
+
+        if (line_len == 0 || line[0] == '#')
+            continue;
+
+        if (sscanf(line, "%16" SCNx64 " %" SCNu32 " %" SCNu32 " %" SCNu64
+                   " %" SCNd64 ".%" SCNd32 " %n",
+                   &e.hash, &e.width, &e.height, &e.file_size,
+                   &e.mtime_sec, &e.mtime_nsec, &n) < 6 ||
+            n == 0 || line[n] == '\0') {
+            loge("%s:%u: malformed line", path, line_num);
+            continue;
+        }
+
+        e.filename = xstrdup(line + n);
+        *cru_vec_push(entries, 1) = e;
+    }
+
+    if (ferror(f)) {
+        loge("failed to read %s", path);
+        goto cleanup;
+    }
+
+    qsort(entries->data, entries->len, sizeof(entries->data[0]),
+          compare_entries);
+
+    result = true;
+
+cleanup:
+    if (f)
+        fclose(f);
+    free(line);
+    free(path);
+    return result;
+}
+
+static bool
+write_index(const struct ref_entry_vec *entries)
+{
+    char *path = cru_image_get_abspath(CRU_REF_INDEX_FILENAME);
+    string_t tmp_path = STRING_INIT;
+    const ref_entry_t *e;
+    FILE *f = NULL;
+    bool result = false;
+
+    // Write a temporary file and rename it so that concurrent readers never
+    // see a partial index.
+    string_printf(&tmp_path, "%s.tmp.%d", path, getpid());
+
+    f = fopen(string_data(&tmp_path), "w");
+    if (!f) {
+        loge("failed to open %s: %s", string_data(&tmp_path), strerror(errno));
+        goto cleanup;
+    }
+
+    fputs(index_header, f);
+
+    cru_vec_foreach(e, entries) {
+        fprintf(f, "%016" PRIx64 " %" PRIu32 " %" PRIu32 " %" PRIu64
+                " %" PRId64 ".%09" PRId32 " %s\n",
+                e->hash, e->width, e->height, e->file_size,
+                e->mtime_sec, e->mtime_nsec, e->filename);
+    }
+
+    bool write_failed = ferror(f);
+    if (fclose(f) != 0)
+        write_failed = true;
+    f = NULL;
+
+    if (write_failed) {
+        loge("failed to write %s", string_data(&tmp_path));
+        goto cleanup;
+    }
+
+    if (rename(string_data(&tmp_path), path) != 0) {
+        loge("failed to rename %s to %s: %s", string_data(&tmp_path), path,
+             strerror(errno));
+        goto cleanup;
+    }
+
+    result = true;
+
+cleanup:
+    if (f)
+        fclose(f);
+    if (!result)
+        unlink(string_data(&tmp_path));
+    string_finish(&tmp_path);
+    free(path);
+    return result;
+}
+
+static bool
+hash_file(const char *filename, ref_entry_t *e)
+{
+    cru_image_t *image = NULL;
+    bool result = false;
+
+    // Stat the file before reading it. If the file changes after the stat,
+    // then the entry will be stale rather than wrong.
+    if (!stat_file(filename, e)) {
+        loge("failed to stat reference image %s", filename);
+        goto cleanup;
+    }
+
+    image = cru_image_from_filename(filename);
+    if (!image)
+        goto cleanup;
+
+    if (!cru_image_hash(image, &e->hash)) {
+        loge("failed to hash reference image %s", filename);
+        goto cleanup;
+    }
+
+    e->width = cru_image_get_width(image);
+    e->height = cru_image_get_height(image);
+    e->filename = xstrdup(filename);
+    result = true;
+
+cleanup:
+    if (image)
+        cru_image_release(image);
+    return result;
+}
+
+static void
+load_cached_index(void)
+{
+    if (!read_index(&cached_index))
+        free_entries(&cached_index);
+}
+
+bool
+cru_ref_index_lookup(const char *filename, uint32_t *width,
+                     uint32_t *height, uint64_t *hash)
+{
+    const ref_entry_t key = { .filename = (char *) filename };
+    const ref_entry_t *e;
+    ref_entry_t st;
+
+    pthread_once(&cached_index_once, load_cached_index);
+
+    if (cached_index.len == 0)
+        return false;
+
+    e = bsearch(&key, cached_index.data, cached_index.len,
+                sizeof(cached_index.data[0]), compare_entries);
+    if (!e)
+        return false;
+
+    if (!stat_file(filename, &st))
+        return false;
+
+    if (st.file_size != e->file_size ||
+        st.mtime_sec != e->mtime_sec ||
+        st.mtime_nsec != e->mtime_nsec)
+        return false;
+
+    *width = e->width;
+    *height = e->height;
+    *hash = e->hash;
+
+    return true;
+}
+
+bool
+cru_ref_index_update(const char *const *filenames, uint32_t count,
+                     bool keep_others)
+{
+    struct ref_entry_vec entries = CRU_VEC_INIT;
+    bool result = false;
+
+    if (keep_others && !read_index(&entries))
+        goto cleanup;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        ref_entry_t new_entry;
+        ref_entry_t *e;
+
+        if (!hash_file(filenames[i], &new_entry))
+            goto cleanup;
+
+        cru_vec_foreach(e, &entries) {
+            if (strcmp(e->filename, new_entry.filename) == 0)
+                break;
+        }
+
+        if (e < entries.data + entries.len) {
+            free(e->filename);
+            *e = new_entry;
+        } else {
+            *cru_vec_push(&entries, 1) = new_entry;
+        }
+    }
+
+    qsort(entries.data, entries.len, sizeof(entries.data[0]),
+          compare_entries);
+
+    result = write_index(&entries);
+
+cleanup:
+    free_entries(&entries);
+    return result;
+}
+
+bool
+cru_ref_index_rebuild(void)
+{
+    static const char *const patterns[] = {
+        "*.ref.png",
+        "*.ref-stencil.png",
+    };
+
+    glob_t g = {0};
+    const char **filenames = NULL;
+    bool result = false;
+
+    for (uint32_t i = 0; i < ARRAY_LENGTH(patterns); ++i) {
+        char *pattern = cru_image_get_abspath(patterns[i]);
+        int err = glob(pattern, i > 0 ? GLOB_APPEND : 0, NULL, &g);
+        free(pattern);
+
+        if (err != 0 && err != GLOB_NOMATCH) {
+            loge("failed to list reference images");
+            goto cleanup;
+        }
+    }
+
+    filenames = xmallocn(g.gl_pathc + 1, sizeof(*filenames));
+    for (size_t i = 0; i < g.gl_pathc; ++i)
+        filenames[i] = basename(g.gl_pathv[i]);
+
+    result = cru_ref_index_update(filenames, g.gl_pathc, false);
+
+cleanup:
+    free(filenames);
+    globfree(&g);
+    return result;
+}
@@ -212,7 +212,6 @@ void run_simple_compute_pipeline(VkShaderModule cs,
     t_cleanup_push_vk_pipeline(t_device, pipeline);
 
     VkDescriptorSet set = qoAllocateDescriptorSet(t_device,
-        .descriptorPool = t_descriptor_pool,
         .pSetLayouts = &set_layout);
 
     VkBuffer storage_buf;
@@ -0,0 +1,335 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "util/log.h"
+#include "util/string.h"
+#include "util/trace.h"
+#include "util/xalloc.h"
+
+#define EVENTS_PER_BUFFER 4096
+
+struct trace_event {
+    /// A string literal.
+    const char *name;
+
+    /// Usually the name of the test. Not copied, so it must outlive the
+    /// process's recording, like a test_def_t::name.
+    const char *detail;
+
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+/// Events recorded by one thread. Only that thread writes to the buffer.
+struct trace_buffer {
+    struct trace_buffer *next;
+    pid_t tid;
+    uint32_t len;
+    struct trace_event events[EVENTS_PER_BUFFER];
+};
+
+static struct {
+    /// NULL if tracing is disabled.
+    char *filepath;
+
+    /// All buffers in this process, newest first.
+    _Atomic(struct trace_buffer *) buffers;
+
+    /// Processes whose trace files the master merges. Master only.
+    pid_t *children;
+    uint32_t num_children;
+    uint32_t max_children;
+} trace;
+
+static __thread struct trace_buffer *thread_buffer;
+
+static uint64_t
+get_time_ns(void)
+{
+    struct timespec ts;
+
+    // CLOCK_MONOTONIC is shared by all processes, so the master's and
+    // slaves' spans line up.
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/// A forked child starts with no events and no children of its own. The
+/// buffers inherited from the parent are dropped, not freed, because they
+/// may belong to threads that do not exist in the child.
+static void
+trace_atfork_child(void)
+{
+    atomic_store(&trace.buffers, NULL);
+    thread_buffer = NULL;
+
+    free(trace.children);
+    trace.children = NULL;
+    trace.num_children = 0;
+    trace.max_children = 0;
+}
+
+/// Enable tracing for this process and the processes it later forks.
+void
+trace_init(const char *filepath)
+{
+    if (trace.filepath)
+        return;
+
+    trace.filepath = xstrdup(filepath);
+
+    if (pthread_atfork(NULL, NULL, trace_atfork_child))
+        log_abort("%s: pthread_atfork failed", __func__);
+}
+
+bool
+trace_is_enabled(void)
+{
+    return trace.filepath != NULL;
+}
+
+/// Return the start time of a span to pass to trace_span(), or 0 if tracing
+/// is disabled.
+uint64_t
+trace_start(void)
+{
+    if (!trace.filepath)
+        return 0;
+
+    return get_time_ns();
+}
+
+/// Record a span on the calling thread from \a start_ns until now. The
+/// \a name must be a string literal. \a detail may be NULL. It is not
+/// copied, so it must outlive the process's recording, as a
+/// test_def_t::name does.
+void
+trace_span(const char *name, const char *detail, uint64_t start_ns)
+{
+    if (!trace.filepath || start_ns == 0)
+        return;
+
+    trace_span_ns(name, detail, start_ns, get_time_ns());
+}
+
+/// Like trace_span(), but the span ends at \a end_ns rather than now. Both
+/// times are CLOCK_MONOTONIC nanoseconds.
+void
+trace_span_ns(const char *name, const char *detail, uint64_t start_ns,
+              uint64_t end_ns)
+{
+    struct trace_buffer *buf = thread_buffer;
+
+    if (!trace.filepath || start_ns == 0)
+        return;
+
+    if (!buf || buf->len == EVENTS_PER_BUFFER) {
+        buf = xzalloc(sizeof(*buf));
+        buf->tid = syscall(SYS_gettid);
+        buf->next = atomic_load(&trace.buffers);
+
+        while (!atomic_compare_exchange_weak(&trace.buffers, &buf->next, buf))
+            ;
+
+        thread_buffer = buf;
+    }
+
+    struct trace_event *ev = &buf->events[buf->len];
+
+    ev->name = name;
+    ev->detail = detail;
+    ev->start_ns = start_ns;
+    ev->end_ns = end_ns;
+
+    // Publish the event only after it is complete.
+    atomic_thread_fence(memory_order_release);
+    buf->len++;
+}
+
+/// Merge the trace of child process \a pid when the master finishes.
+void
+trace_add_child(pid_t pid)
+{
+    if (!trace.filepath)
+        return;
+
+    if (trace.num_children == trace.max_children) {
+        trace.max_children = trace.max_children ? 2 * trace.max_children : 16;
+        trace.children = xrealloc(trace.children,
+                                  trace.max_children * sizeof(pid_t));
+    }
+
+    trace.children[trace.num_children++] = pid;
+}
+
+static void
+write_json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', f);
+
+        if ((unsigned char) *s < 0x20) {
+            fprintf(f, "\\u%04x", *s);
+        } else {
+            fputc(*s, f);
+        }
+    }
+
+    fputc('"', f);
+}
+
+static void
+get_process_filepath(string_t *path, pid_t pid)
+{
+    string_printf(path, "%s.%d", trace.filepath, pid);
+}
+
+/// Write this process's events to FILE.<pid>, one JSON object per line,
+/// each followed by a comma. Call only when no other thread is recording.
+void
+trace_write_process(const char *process_name)
+{
+    string_t path = STRING_INIT;
+    const pid_t pid = getpid();
+    FILE *f;
+
+    if (!trace.filepath)
+        return;
+
+    get_process_filepath(&path, pid);
+
+    f = fopen(string_data(&path), "w");
+    if (!f) {
+        loge("failed to open trace file: %s", string_data(&path));
+        string_finish(&path);
+        return;
+    }
+
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+            "\"args\":{\"name\":", pid);
+    write_json_string(f, process_name);
+    fprintf(f, "}},\n");
+
+    for (struct trace_buffer *buf = atomic_load(&trace.buffers); buf;
+         buf = buf->next) {
+        const uint32_t len = buf->len;
+
+        atomic_thread_fence(memory_order_acquire);
+
+        for (uint32_t i = 0; i < len; i++) {
+            const struct trace_event *ev = &buf->events[i];
+
+            fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f",
+                    ev->name, pid, buf->tid,
+                    ev->start_ns / 1000.0,
+                    (ev->end_ns - ev->start_ns) / 1000.0);
+
+            if (ev->detail) {
+                fprintf(f, ",\"args\":{\"test\":");
+                write_json_string(f, ev->detail);
+                fputc('}', f);
+            }
+
+            fprintf(f, "},\n");
+        }
+    }
+
+    if (fclose(f) != 0)
+        loge("failed to write trace file: %s", string_data(&path));
+
+    string_finish(&path);
+}
+
+/// Append the file at \a path to \a out, and remove it. Return false if the
+/// file does not exist, for example because its process crashed.
+static bool
+append_file(FILE *out, const char *path)
+{
+    char buf[4096];
+    size_t n;
+    FILE *in;
+
+    in = fopen(path, "r");
+    if (!in)
+        return false;
+
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        fwrite(buf, 1, n, out);
+
+    fclose(in);
+    unlink(path);
+
+    return true;
+}
+
+/// Write the master's events, merge the children's, and write the whole
+/// trace to the file given to trace_init().
+bool
+trace_finish(void)
+{
+    string_t path = STRING_INIT;
+    bool ok = true;
+    FILE *f;
+
+    if (!trace.filepath)
+        return true;
+
+    trace_write_process("crucible master");
+
+    f = fopen(trace.filepath, "w");
+    if (!f) {
+        loge("failed to open trace file: %s", trace.filepath);
+        return false;
+    }
+
+    fprintf(f, "{\"traceEvents\":[\n");
+
+    get_process_filepath(&path, getpid());
+    append_file(f, string_data(&path));
+
+    for (uint32_t i = 0; i < trace.num_children; i++) {
+        get_process_filepath(&path, trace.children[i]);
+        append_file(f, string_data(&path));
+    }
+
+    // Every event line ends with a comma, so close the array with an empty
+    // object, which trace viewers ignore.
+    fprintf(f, "{}\n]}\n");
+
+    if (fclose(f) != 0) {
+        loge("failed to write trace file: %s", trace.filepath);
+        ok = false;
+    }
+
+    string_finish(&path);
+    return ok;
+}
@@ -0,0 +1,62 @@
+// Copyright 2015 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice (including the next
+// paragraph) shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+// This file needs the loader's real entry points, not the wrappers.
+#define CRU_VK_NO_DISPATCH_WRAPPERS
+
+#define VK_PROTOTYPES
+#include "util/vk_dispatch.h"
+
+const struct cru_vk_device_dispatch cru_vk_loader_dispatch = {
+    .key = NULL,
+#define CRU_VK_DISPATCH_ENTRY(name) .name = vk##name,
+    CRU_VK_DEVICE_ENTRYPOINTS(CRU_VK_DISPATCH_ENTRY)
+#undef CRU_VK_DISPATCH_ENTRY
+};
+
+_Atomic(const struct cru_vk_device_dispatch *) cru_vk_direct_dispatch;
+
+void
+cru_vk_device_dispatch_init(struct cru_vk_device_dispatch *d, VkDevice device)
+{
+    d->key = *(const void *const *) device;
+
+#define CRU_VK_DISPATCH_ENTRY(name) \
+    d->name = (PFN_vk##name) vkGetDeviceProcAddr(device, "vk" #name); \
+    if (!d->name) \
+        d->name = cru_vk_loader_dispatch.name;
+
+    CRU_VK_DEVICE_ENTRYPOINTS(CRU_VK_DISPATCH_ENTRY)
+#undef CRU_VK_DISPATCH_ENTRY
+}
+
+void
+cru_vk_set_direct_dispatch(const struct cru_vk_device_dispatch *d)
+{
+    atomic_store(&cru_vk_direct_dispatch, d);
+}
+
+void
+cru_vk_clear_direct_dispatch(const struct cru_vk_device_dispatch *d)
+{
+    atomic_compare_exchange_strong(&cru_vk_direct_dispatch, &d, NULL);
+}